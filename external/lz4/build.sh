@@ -0,0 +1,25 @@
+#!/bin/sh -e
+
+prefix=`pwd`
+
+
+custom_build_func=custom_build
+
+
+custom_build()
+{
+	# ビルド (lz4 は configure を持たないので make を直接呼ぶ)
+	make -C lib liblz4.a
+
+	# 対象ディレクトリを作成
+	mkdir $prefix/include || true
+	mkdir $prefix/lib || true
+
+	# ヘッダファイルをコピー
+	cp lib/lz4.h lib/lz4hc.h $prefix/include
+
+	# ライブラリをコピー
+	cp lib/liblz4.a $prefix/lib
+}
+
+. ../build_common.sh
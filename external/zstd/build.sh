@@ -0,0 +1,25 @@
+#!/bin/sh -e
+
+prefix=`pwd`
+
+
+custom_build_func=custom_build
+
+
+custom_build()
+{
+	# ビルド (zstd は configure を持たないので make を直接呼ぶ)
+	make -C lib libzstd.a
+
+	# 対象ディレクトリを作成
+	mkdir $prefix/include || true
+	mkdir $prefix/lib || true
+
+	# ヘッダファイルをコピー
+	cp lib/zstd.h $prefix/include
+
+	# ライブラリをコピー
+	cp lib/libzstd.a $prefix/lib
+}
+
+. ../build_common.sh
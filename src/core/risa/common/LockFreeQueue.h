@@ -0,0 +1,154 @@
+//---------------------------------------------------------------------------
+/*
+	Risa [りさ]      alias 吉里吉里3 [kirikiri-3]
+	 stands for "Risa Is a Stagecraft Architecture"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief ロックフリーな複数生産者・単一消費者キュー
+//---------------------------------------------------------------------------
+#ifndef LockFreeQueueH
+#define LockFreeQueueH
+
+#include "risa/common/RisaThread.h"
+
+/*
+	複数のスレッドから Push() でき、単一のスレッドが Pop() する FIFO キュー。
+	Dmitry Vyukov による intrusive MPSC node-based queue のアルゴリズムを用いる。
+
+	Push() はアトミックなポインタの交換を一回行うだけで、ロックを取らず、
+	ほかのスレッドを待つこともない。キューに入れる要素は tLockFreeQueueNode
+	を継承している必要があり、要素自体がリンクを持つので Push() の際に
+	メモリの確保は行われない。同じ要素を同時に複数のキューに入れることは
+	できない。
+
+	Pop() は同時に一つのスレッドからしか呼んではならない。複数のスレッドから
+	Pop() する可能性がある場合は、呼び出し側でクリティカルセクションなどで
+	保護すること。
+	Push() の途中 (ポインタの交換を終えてリンクをつなぐ前) のスレッドが
+	あると、Pop() はそれ以降に Push() された要素があっても NULL を返す
+	ことがある。Push() したスレッドはその後で消費者に通知を行うこと。
+*/
+
+namespace Risa {
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * tLockFreeQueue に入れる要素の基本クラス
+ */
+class tLockFreeQueueNode
+{
+	template <typename T> friend class tLockFreeQueue;
+
+	tLockFreeQueueNode * volatile Next; //!< キュー内の次の要素
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tLockFreeQueueNode() : Next(NULL) {;}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * ロックフリーな複数生産者・単一消費者キュー
+ * @note	T は tLockFreeQueueNode を継承していること
+ */
+template <typename T>
+class tLockFreeQueue : public tCollectee
+{
+	tLockFreeQueueNode * volatile Head; //!< 最後に Push() された要素 (生産者側)
+	tLockFreeQueueNode * Tail; //!< 次に Pop() される要素 (消費者側)
+	tLockFreeQueueNode Stub; //!< 番兵
+
+	tLockFreeQueue(const tLockFreeQueue &); //!< non-copyable
+	void operator = (const tLockFreeQueue &); //!< non-copyable
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tLockFreeQueue()
+	{
+		Head = &Stub;
+		Tail = &Stub;
+	}
+
+	/**
+	 * 末尾に要素を追加する
+	 * @param item	要素
+	 * @note	どのスレッドから呼んでもよい
+	 */
+	void Push(T * item)
+	{
+		PushNode(static_cast<tLockFreeQueueNode *>(item));
+	}
+
+	/**
+	 * 先頭から要素を取り出す
+	 * @return	要素 (キューが空の場合は NULL)
+	 * @note	同時に一つのスレッドからしか呼んではならない
+	 */
+	T * Pop()
+	{
+		tLockFreeQueueNode * tail = Tail;
+		tLockFreeQueueNode * next = tail->Next;
+
+		// 番兵は飛ばす
+		if(tail == &Stub)
+		{
+			if(!next) return NULL; // 空
+			Tail = next;
+			tail = next;
+			next = next->Next;
+		}
+
+		if(next)
+		{
+			Tail = next;
+			return static_cast<T *>(tail);
+		}
+
+		// tail が最後の要素でなければ、ほかのスレッドが Push() の途中
+		if(tail != Head) return NULL;
+
+		// tail が最後の要素なので、番兵を入れ直してから取り出す
+		PushNode(&Stub);
+		next = tail->Next;
+		if(next)
+		{
+			Tail = next;
+			return static_cast<T *>(tail);
+		}
+
+		return NULL; // 番兵を入れ直す前にほかのスレッドが Push() を始めた
+	}
+
+private:
+	/**
+	 * 末尾にノードを追加する
+	 * @param node	ノード
+	 */
+	void PushNode(tLockFreeQueueNode * node)
+	{
+		node->Next = NULL;
+		tLockFreeQueueNode * prev = static_cast<tLockFreeQueueNode *>(
+			AtomicExchangePointer(reinterpret_cast<void * volatile *>(&Head), node));
+		prev->Next = node;
+	}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+} // namespace Risa
+
+
+#endif
@@ -14,6 +14,13 @@
 #include "risa/common/RisaGC.h"
 
 #include "risseGC.h"
+#include <algorithm>
+
+#ifdef __WXMSW__
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+#endif
 
 namespace Risa {
 RISSE_DEFINE_SOURCE_ID(13921,35495,35132,18542,18346,21061,47449,62904);
@@ -95,6 +102,15 @@ RISSE_DEFINE_SOURCE_ID(13921,35495,35132,18542,18346,21061,47449,62904);
 	ファイナライザが呼ばれるスレッドはもっぱらこのスレッドになるが、このスレッド
 	であると仮定してはならない (他のスレッドが資源の強制的な開放などの目的で
 	GC_invoke_finalizers() を呼んだときはそのスレッドからの呼び出しとなる )
+
+	この版の GC の GC_invoke_finalizers() は、その時点で実行可能なファイナライザ
+	をすべて実行するまで戻らず、実行する数を制限することはできない。ただし
+	これはコレクタスレッド上で実行されるため、メインスレッドを止めることは
+	ない。メインスレッドで行わなければならない後始末 (tMainThreadAutoPtr など)
+	はファイナライザからは tMainThreadDestructorQueue に登録されるだけで、
+	実際のデストラクタの呼び出しはメインスレッドのアイドル時に、一定の時間の
+	範囲内で少しずつ行われる。大量のイメージバッファなどが一度に解放されても
+	一つのフレームが長く止まることのないようにするためである。
 */
 
 
@@ -135,11 +151,7 @@ void tCollectorThread::tThreadImpl::Execute()
 
 		// 実行すべきファイナライザがあればそれを実行する
 		if(GC_should_invoke_finalizers())
-		{
-			fprintf(stderr, "finalizing...\n");
-			fflush(stderr);
-			GC_invoke_finalizers();
-		}
+			Owner.InvokeFinalizers();
 	}
 }
 //---------------------------------------------------------------------------
@@ -148,6 +160,13 @@ void tCollectorThread::tThreadImpl::Execute()
 //---------------------------------------------------------------------------
 tCollectorThread::tCollectorThread()
 {
+	Statistics.Passes = 0;
+	Statistics.Finalized = 0;
+	Statistics.TotalTime = 0;
+	Statistics.MaxTime = 0;
+	Statistics.MaxLatency = 0;
+	NotifiedTick = 0;
+
 	// GC の初期化
 	GC_init();
 
@@ -175,6 +194,63 @@ tCollectorThread::~tCollectorThread()
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+tCollectorThread::tStatistics tCollectorThread::GetStatistics()
+{
+	volatile tCriticalSection::tLocker cs_holder(CS);
+	return Statistics;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_uint64 tCollectorThread::GetMicroTick()
+{
+#ifdef __WXMSW__
+	static LARGE_INTEGER freq = { 0 };
+	if(freq.QuadPart == 0) ::QueryPerformanceFrequency(&freq);
+	LARGE_INTEGER count;
+	::QueryPerformanceCounter(&count);
+	return (risse_uint64)(count.QuadPart / freq.QuadPart * 1000000 +
+		count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#else
+	struct timeval tv;
+	::gettimeofday(&tv, NULL);
+	return (risse_uint64)tv.tv_sec * 1000000 + tv.tv_usec;
+#endif
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tCollectorThread::InvokeFinalizers()
+{
+	risse_uint64 start = GetMicroTick();
+	risse_uint64 notified;
+	{
+		volatile tCriticalSection::tLocker cs_holder(CS);
+		notified = NotifiedTick;
+		NotifiedTick = 0;
+	}
+
+	// ファイナライザを実行する
+	// (ファイナライザがこのオブジェクトをロックすることがあるかもしれないので
+	// CS はロックしない)
+	int count = GC_invoke_finalizers();
+
+	risse_uint64 time = GetMicroTick() - start;
+
+	volatile tCriticalSection::tLocker cs_holder(CS);
+	Statistics.Passes ++;
+	Statistics.Finalized += count;
+	Statistics.TotalTime += time;
+	if(Statistics.MaxTime < time) Statistics.MaxTime = time;
+	if(notified && notified <= start && Statistics.MaxLatency < start - notified)
+		Statistics.MaxLatency = start - notified;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 void tCollectorThread::FinalizerNotifier()
 {
@@ -183,7 +259,17 @@ void tCollectorThread::FinalizerNotifier()
 
 	// コレクタスレッドをたたき起こす
 	tCollectorThread * instance = tCollectorThread::instance();
-	if(instance) tCollectorThread::instance()->Thread->Wakeup();
+	if(instance)
+	{
+		// 通知を受けた時刻を記録する (まだ実行されていない通知があればそちらを優先)
+		// GC のロックを保持したまま呼ばれている可能性があるため、ここでは
+		// メモリ確保を行わないこと
+		{
+			volatile tCriticalSection::tLocker cs_holder(instance->CS);
+			if(!instance->NotifiedTick) instance->NotifiedTick = GetMicroTick();
+		}
+		instance->Thread->Wakeup();
+	}
 }
 //---------------------------------------------------------------------------
 
@@ -201,11 +287,26 @@ void tCollectorThread::FinalizerNotifier()
 
 
 
+//---------------------------------------------------------------------------
+tMainThreadDestructorQueue::tMainThreadDestructorQueue()
+{
+	Statistics.Enqueued = 0;
+	Statistics.Destroyed = 0;
+	Statistics.Length = 0;
+	Statistics.MaxLength = 0;
+	Statistics.TotalLatency = 0;
+	Statistics.MaxLatency = 0;
+	Budget = DefaultBudget;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tMainThreadDestructorQueue::~tMainThreadDestructorQueue()
 {
 	// とりあえずデストラクタを呼んでみる
-	CallDestructors();
+	// (ここでは時間の制限は行わず、すべて呼ぶ)
+	CallDestructors(0);
 }
 //---------------------------------------------------------------------------
 
@@ -213,39 +314,85 @@ tMainThreadDestructorQueue::~tMainThreadDestructorQueue()
 //---------------------------------------------------------------------------
 void tMainThreadDestructorQueue::Enqueue(tDestructorCaller * dtor)
 {
-	volatile tCriticalSection::tLocker cs_holder(CS);
+	tItem item;
+	item.Caller = dtor;
+	item.EnqueuedTick = tCollectorThread::GetMicroTick();
 
-fprintf(stderr, "enqueuing destructor %p ...\n", dtor);
-fflush(stderr);
+	volatile tCriticalSection::tLocker cs_holder(CS);
 
 	if(Pointers.size() == 0) ::wxWakeUpIdle(); // アイドルイベントを起動する
-	Pointers.push_back(dtor);
+	Pointers.push_back(item);
+
+	Statistics.Enqueued ++;
+	Statistics.Length = Pointers.size();
+	if(Statistics.MaxLength < Statistics.Length) Statistics.MaxLength = Statistics.Length;
 }
 //---------------------------------------------------------------------------
 
 
 
 //---------------------------------------------------------------------------
-void tMainThreadDestructorQueue::CallDestructors()
+bool tMainThreadDestructorQueue::CallDestructors(risse_uint64 budget)
 {
 	// このメソッドは、主にアプリケーションのidleループ中に呼ばれる
+	risse_uint64 start = tCollectorThread::GetMicroTick();
+	tItem batch[BatchSize];
 	while(true)
 	{
-		// キューから一個とってくる
-		tDestructorCaller * caller;
+		// キューから最大 BatchSize 個をまとめてとってくる
+		size_t count;
 		{
 			volatile tCriticalSection::tLocker cs_holder(CS);
-			if(Pointers.size() == 0) break;
-			caller = Pointers.front();
-			Pointers.pop_front();
+			count = Pointers.size() < BatchSize ? Pointers.size() : BatchSize;
+			if(count == 0) break;
+			std::copy(Pointers.begin(), Pointers.begin() + count, batch);
+			Pointers.erase(Pointers.begin(), Pointers.begin() + count);
 		}
 
 		// デストラクタを呼ぶために caller を delete する
-fprintf(stderr, "calling destructor %p ...\n", caller);
-fflush(stderr);
+		size_t done = 0;
+		risse_uint64 now = start;
+		risse_uint64 latency_sum = 0;
+		risse_uint64 latency_max = 0;
+		while(done < count)
+		{
+			delete batch[done].Caller;
+			now = tCollectorThread::GetMicroTick();
+			risse_uint64 latency = now - batch[done].EnqueuedTick;
+			latency_sum += latency;
+			if(latency_max < latency) latency_max = latency;
+			done ++;
+
+			// 時間切れか
+			if(budget && now - start >= budget) break;
+		}
+
+		{
+			volatile tCriticalSection::tLocker cs_holder(CS);
 
-		delete caller;
+			// 呼び出せなかった分は順番を保ったままキューの先頭に戻す
+			if(done < count)
+				Pointers.insert(Pointers.begin(), batch + done, batch + count);
+
+			Statistics.Destroyed += done;
+			Statistics.Length = Pointers.size();
+			Statistics.TotalLatency += latency_sum;
+			if(Statistics.MaxLatency < latency_max) Statistics.MaxLatency = latency_max;
+
+			if(budget && now - start >= budget)
+				return Pointers.size() != 0; // 時間切れ
+		}
 	}
+	return false;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tMainThreadDestructorQueue::tStatistics tMainThreadDestructorQueue::GetStatistics()
+{
+	volatile tCriticalSection::tLocker cs_holder(CS);
+	return Statistics;
 }
 //---------------------------------------------------------------------------
 
@@ -27,7 +27,23 @@ namespace Risa {
  */
 class tCollectorThread : public singleton_base<tCollectorThread>
 {
+public:
+	/**
+	 * ファイナライザの実行の統計
+	 */
+	struct tStatistics
+	{
+		risse_uint64 Passes; //!< ファイナライザをまとめて実行した回数
+		risse_uint64 Finalized; //!< 実行したファイナライザの数
+		risse_uint64 TotalTime; //!< ファイナライザの実行に要した時間の合計(マイクロ秒)
+		risse_uint64 MaxTime; //!< 一回の実行に要した時間の最大値(マイクロ秒)
+		risse_uint64 MaxLatency; //!< GC から通知を受けてから実行を開始するまでの時間の最大値(マイクロ秒)
+	};
+
+private:
 	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
+	tStatistics Statistics; //!< 統計
+	risse_uint64 NotifiedTick; //!< GC から最後に通知を受けた時刻 (0=通知を受けていない)
 
 	/**
 	 * コレクタスレッドのクラス
@@ -73,7 +89,25 @@ public:
 	 */
 	~tCollectorThread();
 
+	/**
+	 * ファイナライザの実行の統計を得る
+	 * @return	統計
+	 */
+	tStatistics GetStatistics();
+
+	/**
+	 * マイクロ秒単位の時刻を得る
+	 * @return	時刻(マイクロ秒; 二点間の時間の計測にのみ用いること)
+	 */
+	static risse_uint64 GetMicroTick();
+
 private:
+	/**
+	 * 実行すべきファイナライザをすべて実行する
+	 * @note	コレクタスレッドから呼ばれる
+	 */
+	void InvokeFinalizers();
+
 	/**
 	 * ファイナライズすべきオブジェクトがあった場合に
 	 * GC から呼ばれるコールバック
@@ -97,15 +131,43 @@ public:
 		virtual ~tDestructorCaller() {;}
 	};
 
+	/**
+	 * キューの統計
+	 */
+	struct tStatistics
+	{
+		risse_uint64 Enqueued; //!< キューに登録されたデストラクタの数
+		risse_uint64 Destroyed; //!< 呼び出したデストラクタの数
+		risse_uint64 Length; //!< 現在のキューの長さ
+		risse_uint64 MaxLength; //!< キューの長さの最大値
+		risse_uint64 TotalLatency; //!< 登録されてから呼び出されるまでの時間の合計(マイクロ秒)
+		risse_uint64 MaxLatency; //!< 登録されてから呼び出されるまでの時間の最大値(マイクロ秒)
+	};
+
+	static const risse_uint64 DefaultBudget = 2000; //!< 一回の CallDestructors で費やす時間のデフォルト(マイクロ秒)
+	static const size_t BatchSize = 64; //!< 一回のロックでキューから取り出す最大の数
+
 private:
-	std::deque<tDestructorCaller*> Pointers; // 削除まちオブジェクトへのポインタの配列
+	/**
+	 * キューの要素
+	 */
+	struct tItem
+	{
+		tDestructorCaller * Caller; //!< 削除まちオブジェクト
+		risse_uint64 EnqueuedTick; //!< 登録された時刻(マイクロ秒)
+	};
+
+	std::deque<tItem> Pointers; // 削除まちオブジェクトへのポインタの配列
 	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
+	tStatistics Statistics; //!< 統計
+	risse_uint64 Budget; //!< 一回の CallDestructors で費やす時間(マイクロ秒; 0=無制限)
+
 public:
 
 	/**
 	 * コンストラクタ
 	 */
-	tMainThreadDestructorQueue() {;}
+	tMainThreadDestructorQueue();
 
 	/**
 	 * デストラクタ
@@ -120,8 +182,37 @@ public:
 
 	/**
 	 * デストラクタを呼ぶ
+	 * @return	時間切れのため呼び出されずに残ったデストラクタがある場合に真
+	 * @note	キューに溜まったデストラクタを Budget で指定された時間の範囲で
+	 *			呼び出す。残ったデストラクタは次回の呼び出しに持ち越される。
+	 *			ただし、一回の呼び出しで少なくとも一つは呼び出す。
+	 */
+	bool CallDestructors() { return CallDestructors(Budget); }
+
+	/**
+	 * デストラクタを呼ぶ
+	 * @param budget	費やす時間(マイクロ秒; 0=キューが空になるまですべて呼ぶ)
+	 * @return	時間切れのため呼び出されずに残ったデストラクタがある場合に真
+	 */
+	bool CallDestructors(risse_uint64 budget);
+
+	/**
+	 * 一回の CallDestructors で費やす時間を得る
+	 * @return	時間(マイクロ秒; 0=無制限)
+	 */
+	risse_uint64 GetBudget() const { return Budget; }
+
+	/**
+	 * 一回の CallDestructors で費やす時間を設定する
+	 * @param budget	時間(マイクロ秒; 0=無制限)
+	 */
+	void SetBudget(risse_uint64 budget) { Budget = budget; }
+
+	/**
+	 * キューの統計を得る
+	 * @return	統計
 	 */
-	void CallDestructors();
+	tStatistics GetStatistics();
 };
 //---------------------------------------------------------------------------
 
@@ -293,7 +293,8 @@ bool tApplication::ProcessIdle()
 	}
 
 	// デストラクタの呼び出し
-	tMainThreadDestructorQueue::instance()->CallDestructors();
+	// (時間切れで残った場合はもう一度アイドルイベントを要求する)
+	cont = tMainThreadDestructorQueue::instance()->CallDestructors() || cont;
 
 	cont = wxApp::ProcessIdle() || cont;
 	return cont;
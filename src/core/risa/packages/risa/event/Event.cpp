@@ -77,7 +77,7 @@ void tEventSystem::SetCanDeliverEvents(bool b)
 tEventQueueInstance::tEventQueueInstance()
 {
 	// フィールドの初期化
-	HasPendingEvents = false;
+	PendingEvents = NULL;
 	QuitEventFound = false;
 	IsMainThreadQueue = false;
 	EventNotifier = new tThreadEvent();
@@ -98,6 +98,11 @@ void tEventQueueInstance::DeliverQueue(tEventInfo::tPriority prio, risse_uint64
 		{
 			volatile tSynchronizer sync(this); // sync
 
+			// 排他的イベントのキューにはセンチネルが無いので、配信中に
+			// ポストされたものもここで取り込む
+			if(prio == tEventInfo::epExclusive && queue.size() == 0)
+				FetchPostedEvents(prio);
+
 			if(queue.size() == 0) break;
 			event = queue.front();
 			if(!event) break; // イベントがNULLなのでpopせずに戻る
@@ -133,8 +138,7 @@ void tEventQueueInstance::DeliverQueue(tEventInfo::tPriority prio, risse_uint64
 			volatile tSynchronizer sync(this); // sync
 
 			// キューに epExclusive のイベントがpostされたら戻る
-			if(prio != tEventInfo::epExclusive &&
-				Queues[tEventInfo::epExclusive].size() != 0) break;
+			if(prio != tEventInfo::epExclusive && HasExclusiveEvents()) break;
 
 			// CanDeliverEvents が偽になったら戻る
 			if(!tEventSystem::instance()->GetCanDeliverEvents()) break;
@@ -156,12 +160,16 @@ void tEventQueueInstance::DeliverEvents(risse_uint64 mastertick)
 
 		if(!tEventSystem::instance()->GetCanDeliverEvents()) return; // イベントを配信できない
 
-		if(!HasPendingEvents) return; // 未配信のイベントはない
-		HasPendingEvents = false; // いったんこのフラグはここで偽に
+		// いったんこのフラグはここでクリアする
+		// (クリアしてからポストされたイベントを取り込むので、取り込んだ後に
+		// ポストされたイベントは必ずフラグを再び立てる)
+		if(AtomicCompareExchangePointer(&PendingEvents, this, NULL) == NULL)
+			return; // 未配信のイベントはない
 		QuitEventFound = false; // このフラグもここで偽に
 
 		for(int i = tEventInfo::epMin; i <= tEventInfo::epMax; i++)
 		{
+			FetchPostedEvents(static_cast<tEventInfo::tPriority>(i));
 			if(i != tEventInfo::epExclusive)
 				Queues[i].push_back(NULL);
 		}
@@ -185,7 +193,7 @@ void tEventQueueInstance::DeliverEvents(risse_uint64 mastertick)
 
 				// キューに epExclusive のイベントがpostされたら
 				// もう一度最初から
-				if(Queues[tEventInfo::epExclusive].size() != 0)
+				if(HasExclusiveEvents())
 				{
 					events_in_exclusive = true;
 					break;
@@ -235,7 +243,7 @@ void tEventQueueInstance::DeliverEvents(risse_uint64 mastertick)
 bool tEventQueueInstance::ProcessEvents(risse_uint64 mastertick)
 {
 	DeliverEvents(mastertick);
-	return HasPendingEvents;
+	return PendingEvents != NULL;
 }
 //---------------------------------------------------------------------------
 
@@ -264,7 +272,9 @@ void tEventQueueInstance::PostEvent(tEventInfo * event, tEventType type)
 {
 	if(!tEventInfo::IsPriorityValid(event->GetPriority())) return; // 優先度が無効
 
-	volatile tSynchronizer sync(this); // sync
+	// このメソッドはキューの操作にロックを取らない。
+	// 音声の監視スレッドやタイマ、デコードスレッドなどからのポストが
+	// イベントの配信やほかのポストを待つことのないようにするため。
 
 	// type をチェック
 	if((type & etDiscardable) && !tEventSystem::instance()->GetCanDeliverEvents())
@@ -274,29 +284,15 @@ void tEventQueueInstance::PostEvent(tEventInfo * event, tEventType type)
 		return; // 戻る
 	}
 
-	if((type & etSingle) && CountEventsInQueue(
-		event->GetId(), event->GetSource(), event->GetPriority()))
-	{
-		// イベントがすでにキュー内にある場合
-		delete event; // イベントを削除して
-		return; // 戻る
-	}
-
 	// イベントをキューに入れる
-	try
-	{
-		Queues[event->GetPriority()].push_back(event);
-	}
-	catch(...)
-	{
-		delete event;
-		throw;
-	}
+	// シングルイベントの重複は FetchPostedEvents() で取り除く
+	event->PostType = type;
+	PostedQueues[event->GetPriority()].Push(event);
 
 	// イベント配信をたたき起こす
-	if(!HasPendingEvents)
+	// (フラグを立てたスレッドだけが起こす)
+	if(AtomicCompareExchangePointer(&PendingEvents, NULL, this) == NULL)
 	{
-		HasPendingEvents = true;
 		if(IsMainThreadQueue)
 			::wxWakeUpIdle();
 		else
@@ -314,9 +310,19 @@ size_t tEventQueueInstance::CountEventsInQueue(
 
 	volatile tSynchronizer sync(this); // sync
 
+	FetchPostedEvents(prio);
+	return CountQueuedEvents(id, source, prio, limit);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+size_t tEventQueueInstance::CountQueuedEvents(
+	int id, void * source, tEventInfo::tPriority prio, size_t limit)
+{
 	// キューを検索する
 	size_t count = 0;
-	tQueue queue = Queues[prio];
+	tQueue & queue = Queues[prio];
 	for(tQueue::iterator i = queue.begin(); i != queue.end(); i++)
 	{
 		if(*i && (*i)->GetSource() == source && (*i)->GetId() == id)
@@ -331,6 +337,44 @@ size_t tEventQueueInstance::CountEventsInQueue(
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+void tEventQueueInstance::FetchPostedEvents(tEventInfo::tPriority prio)
+{
+	tQueue & queue = Queues[prio];
+	tEventInfo * event;
+	while((event = PostedQueues[prio].Pop()) != NULL)
+	{
+		if((event->PostType & etSingle) &&
+			CountQueuedEvents(event->GetId(), event->GetSource(), prio, 1))
+		{
+			// イベントがすでにキュー内にある場合
+			delete event; // イベントを削除する
+			continue;
+		}
+
+		try
+		{
+			queue.push_back(event);
+		}
+		catch(...)
+		{
+			delete event;
+			throw;
+		}
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tEventQueueInstance::HasExclusiveEvents()
+{
+	FetchPostedEvents(tEventInfo::epExclusive);
+	return Queues[tEventInfo::epExclusive].size() != 0;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 void tEventQueueInstance::InternalCancelEvents(void * source, tQueue * dest)
 {
@@ -340,6 +384,7 @@ void tEventQueueInstance::InternalCancelEvents(void * source, tQueue * dest)
 
 	for(int n = tEventInfo::epMin; n <= tEventInfo::epMax; n++)
 	{
+		FetchPostedEvents(static_cast<tEventInfo::tPriority>(n));
 		tQueue & queue = Queues[n];
 		for(tQueue::iterator i = queue.begin(); i != queue.end(); )
 		{
@@ -18,6 +18,7 @@
 #include "risa/common/RisaThread.h"
 #include "risa/common/Singleton.h"
 #include "risa/common/PointerList.h"
+#include "risa/common/LockFreeQueue.h"
 #include "risa/common/RisseEngine.h"
 #include "risa/common/RisaException.h"
 
@@ -100,7 +101,7 @@ public:
 /**
  * イベント情報クラス
  */
-class tEventInfo : public tCollectee
+class tEventInfo : public tCollectee, public tLockFreeQueueNode
 {
 	friend class tEventQueueInstance;
 public:
@@ -125,6 +126,7 @@ private:
 	tEventDestination * Destination; //!< イベントの配信先 Risse オブジェクト
 	tPriority Priority; //!< イベントの優先度
 	risse_uint64 Tick; //!< イベントが配信される tick
+	int PostType; //!< ポストされた際のイベントタイプ (tEventQueueInstance::tEventType)
 
 	void SetTick(risse_uint64 tick)  { Tick = tick; } // Tick を設定する
 
@@ -143,7 +145,8 @@ public:
 			Id(id),
 			Source(source),
 			Destination(destination),
-			Priority(prio)
+			Priority(prio),
+			PostType(0)
 	{
 	}
 
@@ -172,7 +175,7 @@ public:
  */
 class tEventSystem : public singleton_base<tEventSystem>
 {
-	bool CanDeliverEvents; //!< イベントを配信可能かどうか
+	volatile bool CanDeliverEvents; //!< イベントを配信可能かどうか
 	mutable tCriticalSection CS; //!< このインスタンスを保護するためのCS
 
 public:
@@ -211,8 +214,7 @@ public:
 	virtual ~tEventSystem() {}
 
 	bool GetCanDeliverEvents() const
-	{ volatile tCriticalSection::tLocker cs_holder(CS);
-	  return CanDeliverEvents; } //!< イベントを配信可能かどうかを返す
+	{ return CanDeliverEvents; } //!< イベントを配信可能かどうかを返す (PostEvent() から呼ばれるのでロックは取らない)
 	void SetCanDeliverEvents(bool b); //!< イベントを配信可能かどうかを設定する
 
 	pointer_list<tStateListener> & GetStateListeners() { return StateListeners; } //!< イベント状態リスナを得る
@@ -241,10 +243,12 @@ public:
 	};
 
 	typedef gc_deque<tEventInfo *> tQueue; //!< キュー用コンテナの typedef
+	typedef tLockFreeQueue<tEventInfo> tPostedQueue; //!< ポストされたイベントを受け取るキューの typedef
 
 private:
 	tQueue Queues[tEventInfo::epMax + 1]; //!< イベント用キュー
-	bool HasPendingEvents; //!< post してから処理されていないイベントが存在する場合に真
+	tPostedQueue PostedQueues[tEventInfo::epMax + 1]; //!< ポストされ、まだ Queues に取り込まれていないイベントのキュー
+	void * volatile PendingEvents; //!< post してから処理されていないイベントが存在する場合に非 NULL (アトミックに操作する)
 	bool QuitEventFound; //!< Quit イベントが見つかった場合に真
 	bool IsMainThreadQueue; //!< メインスレッド用のキューかどうか
 	tThreadEvent * EventNotifier; //!< イベントが到着したことを知らせる ThreadEvent (メインスレッド用でないキュー用)
@@ -281,6 +285,33 @@ private:
 	 */
 	void DiscardQueue(tQueue & queue);
 
+	/**
+	 * ポストされたイベントを Queues に取り込む
+	 * @param prio	優先度
+	 * @note	tSynchronizer で保護した状態で呼ぶこと。
+	 *			シングルイベントはここで重複を取り除く。
+	 */
+	void FetchPostedEvents(tEventInfo::tPriority prio);
+
+	/**
+	 * 排他的イベントが待っているかどうかを得る
+	 * @return	排他的イベントが待っているかどうか
+	 * @note	tSynchronizer で保護した状態で呼ぶこと
+	 */
+	bool HasExclusiveEvents();
+
+	/**
+	 * 指定されたイベントが Queues に入っている数を数える
+	 * @param id		イベントID
+	 * @param source	イベント発生元
+	 * @param prio		優先度
+	 * @param limit		数え上げる最大値(0=全部数える)
+	 * @return	id と source と prio が一致するイベントの数
+	 * @note	tSynchronizer で保護した状態で呼ぶこと
+	 */
+	size_t CountQueuedEvents(int id,
+		void * source, tEventInfo::tPriority prio, size_t limit);
+
 	/**
 	 * メインスレッド用のキューかどうかを設定する
 	 * @param b	メインスレッド用のキューかどうか
@@ -303,6 +334,9 @@ public:
 	 * イベントをポストする
 	 * @param event	イベント
 	 * @param type	イベントタイプ
+	 * @note	どのスレッドから呼んでもよく、キューの操作にロックを取らない。
+	 *			シングルイベントの重複は、イベントを配信する側がキューに
+	 *			取り込む際に取り除く。
 	 */
 	void PostEvent(tEventInfo * event, tEventType type = etDefault);
 
@@ -23,8 +23,6 @@ RISSE_DEFINE_SOURCE_ID(3263,62535,57591,17893,921,30607,15180,25430);
 tTimerScheduler::tTimerScheduler()
 {
 	// フィールドの初期化
-	NearestTick = tTickCount::InvalidTickCount;
-	NearestInfoValid = false;
 	NeedRescheduleOnPeriodChange = true;
 
 	// スレッドの実行
@@ -48,8 +46,14 @@ void tTimerScheduler::Register(tTimerConsumer * consumer)
 {
 	volatile tCriticalSection::tLocker cs_holder(CS);
 
+	// ヒープの末尾に追加して上に移動する
+	size_t index = Consumers.size();
 	Consumers.push_back(consumer);
-	Reschedule(); // スケジュールし直す
+	consumer->HeapIndex = index;
+	SiftUp(index);
+
+	// 先頭に来た場合はスケジュールし直す
+	if(consumer->HeapIndex == 0) Reschedule();
 }
 //---------------------------------------------------------------------------
 
@@ -59,12 +63,41 @@ void tTimerScheduler::Unregister(tTimerConsumer * consumer)
 {
 	volatile tCriticalSection::tLocker cs_holder(CS);
 
-	tConsumers::iterator i = std::find(Consumers.begin(), Consumers.end(), consumer);
-	if(i != Consumers.end())
+	size_t index = consumer->HeapIndex;
+	if(index == tTimerConsumer::InvalidHeapIndex) return;
+	RISSE_ASSERT(index < Consumers.size() && Consumers[index] == consumer);
+
+	// 末尾の要素を consumer のあった位置に移動し、ヒープを修復する
+	tTimerConsumer * last = Consumers.back();
+	Consumers.pop_back();
+	consumer->HeapIndex = tTimerConsumer::InvalidHeapIndex;
+	if(last != consumer)
 	{
-		Consumers.erase(i);
-		Reschedule(); // スケジュールし直す
+		SetHeapItem(index, last);
+		SiftUp(index);
+		SiftDown(last->HeapIndex);
 	}
+
+	// 先頭が変わった場合はスケジュールし直す
+	if(index == 0) Reschedule();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tTimerScheduler::Update(tTimerConsumer * consumer)
+{
+	size_t index = consumer->HeapIndex;
+	RISSE_ASSERT(index < Consumers.size() && Consumers[index] == consumer);
+
+	SiftUp(index);
+	SiftDown(consumer->HeapIndex);
+
+	// 先頭が変わった可能性がある場合はスケジュールし直す
+	// OnPeriod 内から呼ばれた場合は、結局の所 Execute() のループの先頭に
+	// 戻って先頭を見直すので、そういう無駄なことをしない
+	if(NeedRescheduleOnPeriodChange && (index == 0 || consumer->HeapIndex == 0))
+		Reschedule();
 }
 //---------------------------------------------------------------------------
 
@@ -72,38 +105,57 @@ void tTimerScheduler::Unregister(tTimerConsumer * consumer)
 //---------------------------------------------------------------------------
 void tTimerScheduler::Reschedule()
 {
-	NearestInfoValid = false; // NearestInfo をもう一度検索するように
 	Event.Signal(); // スレッドをたたき起こす
 }
 //---------------------------------------------------------------------------
 
 
 //---------------------------------------------------------------------------
-void tTimerScheduler::GetNearestInfo()
+void tTimerScheduler::SetHeapItem(size_t index, tTimerConsumer * consumer)
 {
-	size_t nearest_index = static_cast<size_t>(-1L);
-	risse_uint64 nearest_tick = tTickCount::InvalidTickCount;
+	Consumers[index] = consumer;
+	consumer->HeapIndex = index;
+}
+//---------------------------------------------------------------------------
+
 
-	// もっちも近い位置にある (もっとも値の小さいtickをもつ)Consumerを探す
-	size_t index = 0;
-	for(tConsumers::iterator i = Consumers.begin();
-		i != Consumers.end(); i++, index++)
+//---------------------------------------------------------------------------
+void tTimerScheduler::SiftUp(size_t index)
+{
+	// tTickCount::InvalidTickCount は risse_uint64 の最大値なので、
+	// OnPeriod を呼ぶ必要のない Consumer は自然にヒープの後ろの方に並ぶ
+	tTimerConsumer * consumer = Consumers[index];
+	risse_uint64 tick = consumer->NextTick;
+	while(index > 0)
 	{
-		risse_uint64 tick = (*i)->GetNextTick();
-		if(tick != tTickCount::InvalidTickCount)
-		{
-			if(nearest_tick == tTickCount::InvalidTickCount ||
-				nearest_tick > tick)
-			{
-				nearest_index = index;
-				nearest_tick = tick;
-			}
-		}
+		size_t parent = (index - 1) / 2;
+		if(Consumers[parent]->NextTick <= tick) break;
+		SetHeapItem(index, Consumers[parent]);
+		index = parent;
 	}
+	SetHeapItem(index, consumer);
+}
+//---------------------------------------------------------------------------
 
-	NearestTick = nearest_tick;
-	NearestIndex = nearest_index;
-	NearestInfoValid = true;
+
+//---------------------------------------------------------------------------
+void tTimerScheduler::SiftDown(size_t index)
+{
+	size_t count = Consumers.size();
+	tTimerConsumer * consumer = Consumers[index];
+	risse_uint64 tick = consumer->NextTick;
+	while(true)
+	{
+		size_t child = index * 2 + 1;
+		if(child >= count) break;
+		if(child + 1 < count &&
+			Consumers[child + 1]->NextTick < Consumers[child]->NextTick)
+			child ++; // 小さい方の子
+		if(tick <= Consumers[child]->NextTick) break;
+		SetHeapItem(index, Consumers[child]);
+		index = child;
+	}
+	SetHeapItem(index, consumer);
 }
 //---------------------------------------------------------------------------
 
@@ -118,18 +170,21 @@ void tTimerScheduler::Execute()
 		{
 			risse_uint64 current_tick = tTickCount::instance()->Get();
 
-			// 直近のTickを持つConsumerを探し、何ms後に起きれば良いのかを計算する
+			// 直近のTickを持つConsumer (ヒープの先頭) を得て、
+			// 何ms後に起きれば良いのかを計算する
 			{
 				volatile tCriticalSection::tLocker cs_holder(CS);
-				if(!NearestInfoValid) GetNearestInfo();
+				tTimerConsumer * nearest = Consumers.size() ? Consumers[0] : NULL;
+				risse_uint64 nearest_tick =
+					nearest ? nearest->GetNextTick() : tTickCount::InvalidTickCount;
 
-				if(NearestTick == tTickCount::InvalidTickCount)
+				if(nearest_tick == tTickCount::InvalidTickCount)
 				{
 					sleep_ms = -1L;
 					break; // 直近のTickを持つConsumerが居ない
 				}
 
-				sleep_ms = NearestTick - current_tick;
+				sleep_ms = nearest_tick - current_tick;
 				if(sleep_ms <= 0)
 				{
 					// すでに時間をすぎているのでOnPeriodを呼ぶ
@@ -138,9 +193,8 @@ void tTimerScheduler::Execute()
 					// リスケジュールするのでそういう無駄なことをしないように
 					// NeedRescheduleOnPeriodChange を false に設定する
 					NeedRescheduleOnPeriodChange = false;
-					Consumers[NearestIndex]->OnPeriod(NearestTick, current_tick);
+					nearest->OnPeriod(nearest_tick, current_tick);
 					NeedRescheduleOnPeriodChange = true;
-					NearestInfoValid = false; // NearestInfo を無効に
 				}
 				else
 				{
@@ -186,6 +240,7 @@ tTimerConsumer::tTimerConsumer(tTimerScheduler * owner) : Owner(owner)
 {
 	// フィールドの初期化
 	NextTick = tTickCount::InvalidTickCount;
+	HeapIndex = InvalidHeapIndex;
 	Enabled = false;
 }
 //---------------------------------------------------------------------------
@@ -214,16 +269,10 @@ void tTimerConsumer::SetNextTick(risse_uint64 nexttick)
 {
 	volatile tCriticalSection::tLocker cs_holder(Owner->GetCS());
 
-	if(Enabled && Owner->NeedRescheduleOnPeriodChange)
-	{
+	if(NextTick == nexttick) return;
 
-		NextTick = nexttick;
-		Owner->Reschedule(); // スケジュールをやり直すように
-	}
-	else
-	{
-		NextTick = nexttick;
-	}
+	NextTick = nexttick;
+	if(Enabled) Owner->Update(this); // ヒープ内の位置を更新し、必要ならばスケジュールをやり直す
 }
 //---------------------------------------------------------------------------
 
@@ -25,6 +25,12 @@
 	分解能を提供できるはずである。
 	精度については TickCount.cpp の説明も参照のこと。
 
+	登録されている tTimerConsumer は、次に OnPeriod を呼ぶべき Tick を
+	キーとしたヒープ (二分木による優先度付きキュー) で管理する。
+	直近の Tick を持つ Consumer はヒープの先頭にあるので O(1) で得られ、
+	SetNextTick() によるスケジュールのやり直しや登録・登録解除は O(log n)
+	で行える。各 Consumer は自分のヒープ内での位置を保持している。
+
 */
 
 #include "risa/common/Singleton.h"
@@ -51,11 +57,8 @@ class tTimerScheduler : protected depends_on<tTickCount>,
 	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
 	tThreadEvent Event; //!< イベント
 	typedef gc_vector<tTimerConsumer*> tConsumers; //!< tTimerConsumer の配列 の typedef
-	tConsumers Consumers; //!< tTimerConsumer の配列
+	tConsumers Consumers; //!< 登録されている tTimerConsumer のヒープ (先頭がもっとも Tick の小さい物)
 
-	risse_uint64 NearestTick; //!< もっとも時間的に近い位置にあるTick (tTickCount::InvalidTickCount の場合は無効)
-	size_t NearestIndex; //!< もっとも時間的に近い位置にある Consumer のConsumers内におけるインデックス
-	volatile bool NearestInfoValid; //!< Nearest* のメンバの情報が有効かどうか
 	volatile bool NeedRescheduleOnPeriodChange;
 		//!< tTimerConsumer::SetNextTick内でReschedule()が呼ばれたときに
 		//!< 本当にRescheduleする必要があるかどうか
@@ -94,15 +97,36 @@ private:
 	 */
 	void Unregister(tTimerConsumer * consumer);
 
+	/**
+	 * consumerの NextTick が変わったのでヒープ内の位置を更新する
+	 * @param consumer	コールバックを発生させるコンシューマオブジェクト
+	 * @note	consumer は登録されていなければならない
+	 */
+	void Update(tTimerConsumer * consumer);
+
 	/**
 	 * スケジュールをやり直す
 	 */
 	void Reschedule();
 
 	/**
-	 * もっとも近い位置にあるTickをもつConsumerを探す
+	 * ヒープ内の指定位置に consumer を置く
+	 * @param index		位置
+	 * @param consumer	コンシューマオブジェクト
 	 */
-	void GetNearestInfo();
+	void SetHeapItem(size_t index, tTimerConsumer * consumer);
+
+	/**
+	 * ヒープ内の指定位置にある要素を、親よりも小さい間は上に移動する
+	 * @param index		位置
+	 */
+	void SiftUp(size_t index);
+
+	/**
+	 * ヒープ内の指定位置にある要素を、子よりも大きい間は下に移動する
+	 * @param index		位置
+	 */
+	void SiftDown(size_t index);
 
 protected:
 	/**
@@ -131,8 +155,13 @@ protected:
  */
 class tTimerConsumer : public tCollectee
 {
+	friend class tTimerScheduler;
+
+	static const size_t InvalidHeapIndex = static_cast<size_t>(-1L); //!< ヒープに入っていないことを表す HeapIndex
+
 	tTimerScheduler * Owner;
 	risse_uint64 NextTick; // 次に OnPeriod を呼ぶべき絶対Tick
+	size_t HeapIndex; //!< Owner のヒープ内での位置 (登録されていない場合は InvalidHeapIndex)
 	bool Enabled; //!< タイマーが有効かどうか
 protected:
 	/**
@@ -15,6 +15,8 @@
 #include "risa/packages/risa/fs/osfs/OSFS.h"
 #include "risa/packages/risa/fs/FileSystem.h"
 #include "builtin/stream/risseStreamClass.h"
+#include "risseHeapProfiler.h"
+#include "risseArrayClass.h"
 
 
 namespace Risa {
@@ -93,6 +95,10 @@ tFileSystemManager::tFileSystemManager()
 {
 	// カレントディレクトリを / に設定
 	CurrentDirectory = RISSE_WS("/");
+	CurrentDirectoryGeneration = 0;
+
+	PathCacheHits = 0;
+	PathCacheMisses = 0;
 }
 //---------------------------------------------------------------------------
 
@@ -136,6 +142,10 @@ void tFileSystemManager::Mount(const tString & point,
 
 	// マウントポイントを追加
 	MountPoints.Add(path, fs_risseobj);
+
+	// パスの解決結果が変わるのでキャッシュを破棄する
+	ClearPathCache();
+	Prefetcher.CancelAll();
 }
 //---------------------------------------------------------------------------
 
@@ -161,6 +171,10 @@ void tFileSystemManager::Unmount(const tString & point)
 
 	// マウントポイントを削除
 	MountPoints.Delete(path);
+
+	// パスの解決結果が変わるのでキャッシュを破棄する
+	ClearPathCache();
+	Prefetcher.CancelAll();
 }
 //---------------------------------------------------------------------------
 
@@ -195,9 +209,9 @@ tString tFileSystemManager::NormalizePath(const tString & path)
 	tString ret(path);
 
 	// 相対ディレクトリかどうかをチェック
-	// 先頭が '/' でなければ相対パスとみなし、パスの先頭に CurrentDirectory
-	// を挿入する
-	if(ret[0] != RISSE_WC('/'))
+	// 先頭が '/' でなければ (空のパスも) 相対パスとみなし、パスの先頭に
+	// CurrentDirectory を挿入する
+	if(ret.IsEmpty() || ret[0] != RISSE_WC('/'))
 	{
 		volatile tCriticalSection::tLocker holder(CS);
 		ret = CurrentDirectory + ret;
@@ -340,8 +354,8 @@ bool tFileSystemManager::IsFile(const tString & filename)
 	volatile tCriticalSection::tLocker holder(CS);
 
 	tString fspath;
-	tString fullpath(NormalizePath(filename));
-	tFileSystemInstance * fs = FindFileSystemAt(fullpath, &fspath);
+	tString fullpath;
+	tFileSystemInstance * fs = ResolvePath(filename, fullpath, &fspath);
 	if(!fs) ThrowNoFileSystemError(filename);
 
 	RISA_PREPEND_EXCEPTION_MESSAGE_BEGIN()
@@ -362,8 +376,8 @@ bool tFileSystemManager::IsDirectory(const tString & dirname)
 	volatile tCriticalSection::tLocker holder(CS);
 
 	tString fspath;
-	tString fullpath(NormalizePath(dirname));
-	tFileSystemInstance * fs = FindFileSystemAt(fullpath, &fspath);
+	tString fullpath;
+	tFileSystemInstance * fs = ResolvePath(dirname, fullpath, &fspath);
 	if(!fs) ThrowNoFileSystemError(fullpath);
 	TrimLastPathDelimiter(fullpath);
 
@@ -385,10 +399,12 @@ void tFileSystemManager::RemoveFile(const tString & filename)
 	volatile tCriticalSection::tLocker holder(CS);
 
 	tString fspath;
-	tString fullpath(NormalizePath(filename));
-	tFileSystemInstance * fs = FindFileSystemAt(fullpath, &fspath);
+	tString fullpath;
+	tFileSystemInstance * fs = ResolvePath(filename, fullpath, &fspath);
 	if(!fs) ThrowNoFileSystemError(fullpath);
 
+	Prefetcher.Cancel(fullpath);
+
 	RISA_PREPEND_EXCEPTION_MESSAGE_BEGIN()
 	{
 		fs->Do(ocFuncCall, NULL, tSS<'r','e','m','o','v','e','F','i','l','e'>(),
@@ -435,6 +451,9 @@ void tFileSystemManager::RemoveDirectory(const tString & dirname, bool recursive
 		}
 	}
 
+	// ディレクトリ内のファイルの先読みは古くなるので破棄する
+	Prefetcher.CancelAll();
+
 	RISA_PREPEND_EXCEPTION_MESSAGE_BEGIN()
 	{
 		fs->Do(ocFuncCall, NULL, tSS<'r','e','m','o','v','e','D','i','r','e','c','t','o','r','y'>(),
@@ -507,8 +526,8 @@ tObjectInterface * tFileSystemManager::Stat(const tString & filename)
 	volatile tCriticalSection::tLocker holder(CS);
 
 	tString fspath;
-	tString fullpath(NormalizePath(filename));
-	tFileSystemInstance * fs = FindFileSystemAt(fullpath, &fspath);
+	tString fullpath;
+	tFileSystemInstance * fs = ResolvePath(filename, fullpath, &fspath);
 	if(!fs) ThrowNoFileSystemError(fullpath);
 
 	RISA_PREPEND_EXCEPTION_MESSAGE_BEGIN()
@@ -526,13 +545,40 @@ tObjectInterface * tFileSystemManager::Stat(const tString & filename)
 tStreamInstance * tFileSystemManager::Open(const tString & filename,
 	risse_uint32 flags)
 {
-	volatile tCriticalSection::tLocker holder(CS);
+	RISSE_HEAP_PROFILE_TAG("risa.fs.open");
 
-	// 通常のファイルシステム経由のストリームの作成
 	tString fspath;
-	tString fullpath(NormalizePath(filename));
-	tFileSystemInstance * fs = FindFileSystemAt(fullpath, &fspath);
+	tString fullpath;
+
+	{
+		volatile tCriticalSection::tLocker holder(CS);
+		if(!ResolvePath(filename, fullpath, &fspath)) ThrowNoFileSystemError(fullpath);
+	}
+
+	// 先読みキャッシュはロックの外で扱う。Prefetcher.Open() は読み込み中の
+	// 内容の完了を待つことがあり、その間ほかのスレッドの Open() を
+	// ブロックしないようにするため (また、読み込み中のファイルシステムが
+	// ファイルシステムマネージャを呼ぶ可能性があるため)
+	if((flags & omAccessMask) == omRead)
+	{
+		// 先読みされていればメモリ上の内容を返す
+		tStreamInstance * prefetched = Prefetcher.Open(fullpath);
+		if(prefetched) return prefetched;
+	}
+	else
+	{
+		// 書き込まれると先読みした内容は古くなる
+		Prefetcher.Cancel(fullpath);
+	}
+
+	// 通常のファイルシステム経由のストリームの作成
+	// (ロックを解放している間にマウントが変わっている可能性があるので、
+	// 改めてパスを解決する)
+	volatile tCriticalSection::tLocker holder(CS);
+
+	tFileSystemInstance * fs = ResolvePath(filename, fullpath, &fspath);
 	if(!fs) ThrowNoFileSystemError(fullpath);
+
 	tVariant val;
 
 	RISA_PREPEND_EXCEPTION_MESSAGE_BEGIN()
@@ -569,13 +615,39 @@ tStreamInstance * tFileSystemManager::Open(const tVariant & filename, risse_uint
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+bool tFileSystemManager::Map(const tString & filename, tOctet & octet)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	tString fspath;
+	tString fullpath;
+	tFileSystemInstance * fs = ResolvePath(filename, fullpath, &fspath);
+	if(!fs) ThrowNoFileSystemError(fullpath);
+
+	// OSFS 以外はマップに対応していない
+	tOSFSInstance * osfs = tVariant(static_cast<tObjectInterface*>(fs)).
+		CheckAndGetObjectInterafce(tClassHolder<tOSFSClass>::instance()->GetClass());
+	if(!osfs) return false;
+
+	RISA_PREPEND_EXCEPTION_MESSAGE_BEGIN()
+	{
+		octet = osfs->map(fspath);
+	}
+	RISA_PREPEND_EXCEPTION_MESSAGE_END(tRisseScriptEngine::instance()->GetScriptEngine(),
+			tString(RISSE_WS_TR("failed to map '%1': "), fullpath))
+	return true;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tFileSystemInstance * tFileSystemManager::GetFileSystemAt(const tString & path)
 {
 	volatile tCriticalSection::tLocker holder(CS);
 
-	tString fullpath(NormalizePath(path));
-	tFileSystemInstance * fs = FindFileSystemAt(fullpath, NULL);
+	tString fullpath;
+	tFileSystemInstance * fs = ResolvePath(path, fullpath);
 
 	return fs;
 }
@@ -658,6 +730,143 @@ tFileSystemInstance * tFileSystemManager::FindFileSystemAt(
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+void tFileSystemManager::GetPathCacheStatistics(risse_uint64 & hits, risse_uint64 & misses)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	hits = PathCacheHits;
+	misses = PathCacheMisses;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFileSystemManager::Prefetch(const gc_vector<tString> & paths, risse_int priority)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	for(gc_vector<tString>::const_iterator i = paths.begin(); i != paths.end(); i++)
+	{
+		tString fspath;
+		tString fullpath;
+		tFileSystemInstance * fs = ResolvePath(*i, fullpath, &fspath);
+		if(fs) Prefetcher.Add(fullpath, fs, fspath, priority);
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFileSystemManager::CancelPrefetch(const tString & filename)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	tString fullpath;
+	ResolvePath(filename, fullpath);
+	Prefetcher.Cancel(fullpath);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFileSystemManager::CancelAllPrefetches()
+{
+	Prefetcher.CancelAll();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFileSystemManager::WaitPrefetch()
+{
+	// ワーカースレッド上の読み込みがファイルシステムマネージャを呼ぶ
+	// 可能性があるので、ここではロックしない
+	Prefetcher.Wait();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFileSystemManager::SetPrefetchBudget(risse_uint64 budget)
+{
+	Prefetcher.SetBudget(budget);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_uint64 tFileSystemManager::GetPrefetchBudget()
+{
+	return Prefetcher.GetBudget();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFileSystemManager::GetPrefetchStatistics(risse_uint64 & hits, risse_uint64 & bytes)
+{
+	Prefetcher.GetStatistics(hits, bytes);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tFileSystemInstance * tFileSystemManager::ResolvePath(const tString & path,
+	tString & fullpath, tString * fspath)
+{
+	// キャッシュを探す
+	// 相対パスの結果はカレントディレクトリが解決した時点から変わっていない
+	// 場合のみ使える
+	tResolvedPath * cached = PathCache.FindAndTouch(path);
+	if(cached && (!cached->Relative ||
+		cached->DirectoryGeneration == CurrentDirectoryGeneration))
+	{
+		++PathCacheHits;
+		fullpath = cached->FullPath;
+		if(fspath) *fspath = cached->FsPath;
+		return cached->FileSystem;
+	}
+	++PathCacheMisses;
+
+	// 解決する
+	tResolvedPath item;
+	item.FullPath = NormalizePath(path);
+	item.FileSystem = FindFileSystemAt(item.FullPath, &item.FsPath);
+	item.Relative = path.IsEmpty() || path[0] != RISSE_WC('/');
+		// 空のパスは NormalizePath() でカレントディレクトリになるので相対パス
+	item.DirectoryGeneration = CurrentDirectoryGeneration;
+
+	fullpath = item.FullPath;
+	if(fspath) *fspath = item.FsPath;
+
+	// キャッシュに入れる (見つからなかった場合は入れない)
+	if(item.FileSystem)
+	{
+		if(cached)
+		{
+			*cached = item; // 古くなった要素を置き換える
+		}
+		else
+		{
+			PathCache.Add(path, item);
+			PathCache.Crop(PATH_CACHE_LIMIT);
+		}
+	}
+
+	return item.FileSystem;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFileSystemManager::ClearPathCache()
+{
+	PathCache.Clear();
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 void tFileSystemManager::ThrowNoFileSystemError(const tString & filename)
 {
@@ -814,10 +1023,13 @@ void tFileSystemManager::SetCurrentDirectory(const tString &dir)
 
 	tString fullpath(NormalizePath(dir));
 
-	if(fullpath.EndsWith(RISSE_WC('/')))
+	if(!fullpath.EndsWith(RISSE_WC('/'))) fullpath += RISSE_WC('/');
+
+	if(fullpath != CurrentDirectory)
+	{
 		CurrentDirectory = fullpath;
-	else
-		CurrentDirectory = fullpath + RISSE_WS("/");
+		++CurrentDirectoryGeneration; // 相対パスのキャッシュを無効にする
+	}
 }
 //---------------------------------------------------------------------------
 
@@ -990,6 +1202,75 @@ struct tRisaFsStaticMethods
 		tFileSystemManager::instance()->SetCurrentDirectory(dirname);
 	}
 
+	static risse_int64 get_pathCacheHits()
+	{
+		risse_uint64 hits, misses;
+		tFileSystemManager::instance()->GetPathCacheStatistics(hits, misses);
+		return (risse_int64)hits;
+	}
+
+	static risse_int64 get_pathCacheMisses()
+	{
+		risse_uint64 hits, misses;
+		tFileSystemManager::instance()->GetPathCacheStatistics(hits, misses);
+		return (risse_int64)misses;
+	}
+
+	static void prefetch(const tVariant & paths, const tMethodArgument &args)
+	{
+		// paths は文字列か、文字列を列挙できるオブジェクト (配列など)
+		gc_vector<tString> list;
+		if(paths.GetType() == tVariant::vtString)
+		{
+			list.push_back((tString)paths);
+		}
+		else
+		{
+			tEnumerableIterator it(paths);
+			while(it.Next()) list.push_back((tString)it.GetValue());
+		}
+		risse_int priority = args.HasArgument(1) ? (risse_int)(risse_int64)args[1] : 0;
+		tFileSystemManager::instance()->Prefetch(list, priority);
+	}
+
+	static void cancelPrefetch(const tMethodArgument &args)
+	{
+		// 引数が無い場合はすべての先読みをキャンセルする
+		if(args.HasArgument(0))
+			tFileSystemManager::instance()->CancelPrefetch((tString)args[0]);
+		else
+			tFileSystemManager::instance()->CancelAllPrefetches();
+	}
+
+	static void waitPrefetch()
+	{
+		tFileSystemManager::instance()->WaitPrefetch();
+	}
+
+	static risse_int64 get_prefetchBudget()
+	{
+		return (risse_int64)tFileSystemManager::instance()->GetPrefetchBudget();
+	}
+
+	static void set_prefetchBudget(risse_int64 budget)
+	{
+		tFileSystemManager::instance()->SetPrefetchBudget(budget < 0 ? 0 : (risse_uint64)budget);
+	}
+
+	static risse_int64 get_prefetchHits()
+	{
+		risse_uint64 hits, bytes;
+		tFileSystemManager::instance()->GetPrefetchStatistics(hits, bytes);
+		return (risse_int64)hits;
+	}
+
+	static risse_int64 get_prefetchedBytes()
+	{
+		risse_uint64 hits, bytes;
+		tFileSystemManager::instance()->GetPrefetchStatistics(hits, bytes);
+		return (risse_int64)bytes;
+	}
+
 };
 //---------------------------------------------------------------------------
 
@@ -1044,6 +1325,14 @@ public:
 		BindFunction(g, tSS<'e','x','t','r','a','c','t','P','a','t','h'>(), &tRisaFsStaticMethods::extractPath, final_const);
 		BindProperty(g, tSS<'c','w','d'>(), &tRisaFsStaticMethods::get_cwd, &tRisaFsStaticMethods::set_cwd/*, final_const*/);
 		// TODO: property の final_const なプロパティってちゃんと動作してる？
+		BindProperty(g, tSS<'p','a','t','h','C','a','c','h','e','H','i','t','s'>(), &tRisaFsStaticMethods::get_pathCacheHits);
+		BindProperty(g, tSS<'p','a','t','h','C','a','c','h','e','M','i','s','s','e','s'>(), &tRisaFsStaticMethods::get_pathCacheMisses);
+		BindFunction(g, tSS<'p','r','e','f','e','t','c','h'>(), &tRisaFsStaticMethods::prefetch, final_const);
+		BindFunction(g, tSS<'c','a','n','c','e','l','P','r','e','f','e','t','c','h'>(), &tRisaFsStaticMethods::cancelPrefetch, final_const);
+		BindFunction(g, tSS<'w','a','i','t','P','r','e','f','e','t','c','h'>(), &tRisaFsStaticMethods::waitPrefetch, final_const);
+		BindProperty(g, tSS<'p','r','e','f','e','t','c','h','B','u','d','g','e','t'>(), &tRisaFsStaticMethods::get_prefetchBudget, &tRisaFsStaticMethods::set_prefetchBudget);
+		BindProperty(g, tSS<'p','r','e','f','e','t','c','h','H','i','t','s'>(), &tRisaFsStaticMethods::get_prefetchHits);
+		BindProperty(g, tSS<'p','r','e','f','e','t','c','h','e','d','B','y','t','e','s'>(), &tRisaFsStaticMethods::get_prefetchedBytes);
 
 		global.RegisterFinalConstMember(
 				tSS<'o','m','R','e','a','d'>(),
@@ -1069,6 +1358,15 @@ public:
 		global.RegisterFinalConstMember(
 				tSS<'o','m','A','p','p','e','n','d','B','i','t'>(),
 				tVariant((risse_int64)omAppendBit));
+		global.RegisterFinalConstMember(
+				tSS<'o','m','S','e','q','u','e','n','t','i','a','l'>(),
+				tVariant((risse_int64)omSequential));
+		global.RegisterFinalConstMember(
+				tSS<'o','m','W','i','l','l','N','e','e','d'>(),
+				tVariant((risse_int64)omWillNeed));
+		global.RegisterFinalConstMember(
+				tSS<'o','m','D','i','r','e','c','t'>(),
+				tVariant((risse_int64)omDirect));
 	}
 };
 //---------------------------------------------------------------------------
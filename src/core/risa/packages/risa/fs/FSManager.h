@@ -20,8 +20,10 @@
 #include "risa/common/RisaThread.h"
 #include "risa/common/RisseEngine.h"
 #include "risseString.h"
+#include "risseOctet.h"
 #include "risseStream.h"
 #include "builtin/stream/risseStreamClass.h"
+#include "risa/packages/risa/fs/PrefetchCache.h"
 
 namespace Risa {
 //---------------------------------------------------------------------------
@@ -110,7 +112,12 @@ struct tFileOpenModes
 
 		omReadBit = 1 /*!< 読み込み */,
 		omWriteBit = 2 /*!< 書き込み */,
-		omAppendBit = 4 /*!< 追加 */
+		omAppendBit = 4 /*!< 追加 */,
+
+		omSequential = 0x10 /*!< 先頭から順に読むというヒント (OS の先読みを増やす; 対応するファイルシステムのみ) */,
+		omWillNeed = 0x20 /*!< すぐに全体を読むというヒント (OS に先読みを依頼する; 対応するファイルシステムのみ) */,
+		omDirect = 0x40 /*!< 巨大なシーケンシャル読み込みでページキャッシュを経由しないというヒント (対応するファイルシステムのみ) */,
+		omHintMask = 0x70 /*!< ヒントに対するマスク */
 	};
 };
 //---------------------------------------------------------------------------
@@ -131,6 +138,26 @@ class tFileSystemManager :
 {
 	tHashTable<tString, tFileSystemInstance *> MountPoints; //!< マウントポイントのハッシュ表
 	tString CurrentDirectory; //!< カレントディレクトリ (パスの最後に '/' を含む)
+	risse_uint32 CurrentDirectoryGeneration; //!< カレントディレクトリが変更されるたびに増える値
+
+	/**
+	 * パス解決キャッシュの要素
+	 */
+	struct tResolvedPath
+	{
+		tString FullPath; //!< 正規化されたフルパス
+		tString FsPath; //!< ファイルシステム内におけるパス
+		tFileSystemInstance * FileSystem; //!< ファイルシステムインスタンス
+		bool Relative; //!< 入力が相対パスだったかどうか
+		risse_uint32 DirectoryGeneration; //!< 解決した時点の CurrentDirectoryGeneration (相対パスの場合のみ意味を持つ)
+	};
+
+	static const risse_size PATH_CACHE_LIMIT = 1024; //!< パス解決キャッシュの最大要素数
+	tOrderedHashTable<tString, tResolvedPath> PathCache; //!< 入力パス → 解決結果 のキャッシュ
+	risse_uint64 PathCacheHits; //!< パス解決キャッシュにヒットした回数
+	risse_uint64 PathCacheMisses; //!< パス解決キャッシュにヒットしなかった回数
+
+	tPrefetchCache Prefetcher; //!< ファイルの先読みキャッシュ
 
 	tCriticalSection CS; //!< このファイルシステムマネージャを保護するクリティカルセクション
 
@@ -245,6 +272,16 @@ public:
 	 */
 	tStreamInstance * Open(const tVariant & filename, risse_uint32 flags);
 
+	/**
+	 * 指定されたファイルを読み込み専用でメモリにマップする
+	 * @param filename	ファイル名
+	 * @param octet		マップされた内容を参照するオクテット列の格納先 (内容はコピーされない)
+	 * @return	マップできた場合は真、ファイルのあるファイルシステムがマップに
+	 *			対応していない場合は偽
+	 * @note	現状、マップに対応しているのは OSFS のみ
+	 */
+	bool Map(const tString & filename, tOctet & octet);
+
 	/**
 	 * 指定された位置にあるファイルシステムインスタンスを得る
 	 * @param path	パス
@@ -252,6 +289,60 @@ public:
 	 */
 	tFileSystemInstance * GetFileSystemAt(const tString & path);
 
+	/**
+	 * パス解決キャッシュの統計を得る
+	 * @param hits		キャッシュにヒットした回数の格納先
+	 * @param misses	キャッシュにヒットしなかった回数の格納先
+	 */
+	void GetPathCacheStatistics(risse_uint64 & hits, risse_uint64 & misses);
+
+	/**
+	 * ファイルの先読みを要求する
+	 * @param paths		ファイル名の配列
+	 * @param priority	優先度 (大きい方が優先される)
+	 * @note	ファイルの内容はバックグラウンドで読み込まれてメモリ上に保持され、
+	 *			その後の読み込み専用の Open() はメモリから返される。
+	 *			ファイルシステムが見つからないファイルは無視する。
+	 *			読み込みに失敗したファイルも無視され、Open() の際に改めて
+	 *			例外が発生する。
+	 */
+	void Prefetch(const gc_vector<tString> & paths, risse_int priority = 0);
+
+	/**
+	 * ファイルの先読みをキャンセルし、先読みした内容を破棄する
+	 * @param filename	ファイル名
+	 */
+	void CancelPrefetch(const tString & filename);
+
+	/**
+	 * すべてのファイルの先読みをキャンセルし、先読みした内容を破棄する
+	 */
+	void CancelAllPrefetches();
+
+	/**
+	 * 要求されているすべての先読みが終わるまで待つ
+	 */
+	void WaitPrefetch();
+
+	/**
+	 * 先読みした内容の合計サイズの上限を設定する
+	 * @param budget	上限 (バイト単位)
+	 */
+	void SetPrefetchBudget(risse_uint64 budget);
+
+	/**
+	 * 先読みした内容の合計サイズの上限を得る
+	 * @return	上限 (バイト単位)
+	 */
+	risse_uint64 GetPrefetchBudget();
+
+	/**
+	 * 先読みの統計を得る
+	 * @param hits	Open() が先読みした内容から返された回数の格納先
+	 * @param bytes	先読みのために予約済み/保持している内容の合計サイズの格納先
+	 */
+	void GetPrefetchStatistics(risse_uint64 & hits, risse_uint64 & bytes);
+
 private:
 	/**
 	 * ファイル一覧を取得する(内部関数)
@@ -271,6 +362,26 @@ private:
 	 */
 	tFileSystemInstance * FindFileSystemAt(const tString & fullpath, tString * fspath = NULL);
 
+	/**
+	 * パスを正規化し、対応するファイルシステムを得る(キャッシュ付き)
+	 * @param path		パス(相対パスでもよい)
+	 * @param fullpath	正規化されたフルパスの格納先
+	 * @param fspath	ファイルシステム内におけるパス(興味がない場合はNULL可、最初の / は含まれない)
+	 * @return	ファイルシステムインスタンス
+	 * @note	NormalizePath と FindFileSystemAt の結果を PathCache に保持する。
+	 *			PathCache はマウント/アンマウントで破棄され、相対パスの結果は
+	 *			カレントディレクトリの変更で無効になる。
+	 *			このメソッドも CriticalSection 内で呼ぶこと。
+	 */
+	tFileSystemInstance * ResolvePath(const tString & path, tString & fullpath,
+		tString * fspath = NULL);
+
+	/**
+	 * パス解決キャッシュを破棄する
+	 * @note	CriticalSection 内で呼ぶこと
+	 */
+	void ClearPathCache();
+
 	/**
 	 * 「ファイルシステムが指定されたパスにはない」例外を発生させる(FileSystemException)
 	 * @param filename	マウントポイント
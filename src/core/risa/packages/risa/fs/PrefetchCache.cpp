@@ -0,0 +1,509 @@
+//---------------------------------------------------------------------------
+/*
+	Risa [りさ]      alias 吉里吉里3 [kirikiri-3]
+	 stands for "Risa Is a Stagecraft Architecture"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief ファイルの先読みキャッシュ
+//---------------------------------------------------------------------------
+#include "risa/prec.h"
+#include "risa/packages/risa/fs/PrefetchCache.h"
+#include "risa/packages/risa/fs/FileSystem.h"
+#include "risa/packages/risa/fs/tmpfs/MemoryStream.h"
+#include "risseTaskPool.h"
+
+
+namespace Risa {
+RISSE_DEFINE_SOURCE_ID(40372,29155,11846,19473,44029,5360,52718,37161);
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 先読みを行うタスク
+ * @note	一つのタスクは読み込み待ちの要素がなくなるまで読み込みを続ける
+ */
+class tPrefetchTask : public tTask
+{
+	tPrefetchCache * Cache; //!< 先読みキャッシュ
+	bool Stopping; //!< 読み込み中の要素の後で終了すべきかどうか (Cache の CS で保護される)
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param cache	先読みキャッシュ
+	 */
+	tPrefetchTask(tPrefetchCache * cache) { Cache = cache; Stopping = false; }
+
+	/**
+	 * 読み込み中の要素の後で終了するように指示する
+	 * @note	先読みキャッシュの CS 内で呼ぶこと
+	 */
+	void Stop() { Stopping = true; }
+
+	/**
+	 * 読み込み中の要素の後で終了すべきかどうかを得る
+	 * @return	終了すべきならば真
+	 * @note	先読みキャッシュの CS 内で呼ぶこと
+	 */
+	bool GetStopping() const { return Stopping; }
+
+protected:
+	/**
+	 * タスクの処理
+	 */
+	void Execute()
+	{
+		tPrefetchCache::tEntry * entry;
+		while((entry = Cache->Next(this)) != NULL)
+			Cache->Load(entry);
+	}
+};
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+tPrefetchCache::tPrefetchCache()
+{
+	Running = 0;
+	Serial = 0;
+	Budget = DEFAULT_BUDGET;
+	Used = 0;
+	Hits = 0;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::Add(const tString & path, tFileSystemInstance * fs,
+	const tString & fspath, risse_int priority)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	tEntry ** found = Entries.Find(path);
+	if(found)
+	{
+		// すでに要求されている
+		if((*found)->Priority < priority) (*found)->Priority = priority;
+		return;
+	}
+
+	tEntry * entry = new tEntry();
+	entry->Path = path;
+	entry->FileSystem = fs;
+	entry->FsPath = fspath;
+	entry->Priority = priority;
+	entry->Serial = Serial++;
+	entry->State = tEntry::esPending;
+	entry->Cancelled = false;
+	entry->Size = 0;
+	entry->Block = NULL;
+	entry->Task = NULL;
+
+	Entries.Add(path, entry);
+	Pending.push_back(entry);
+
+	Dispatch();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tStreamInstance * tPrefetchCache::Open(const tString & path)
+{
+	tPrefetchTask * task = NULL;
+
+	{
+		volatile tCriticalSection::tLocker holder(CS);
+
+		tEntry ** found = Entries.Find(path);
+		if(!found) return NULL;
+
+		tEntry * entry = *found;
+		if(entry->State == tEntry::esPending)
+		{
+			// まだ読み込みが始まっていない。呼び出し元が普通に開くので、
+			// この先読みは必要ない
+			Remove(entry);
+			return NULL;
+		}
+
+		if(entry->State == tEntry::esLoading)
+		{
+			// 読み込み中。読み込んでいるタスクにはこの要素の後で終了するように
+			// 指示し、読み込みが終わるのを待つ
+			task = entry->Task;
+			task->Stop();
+		}
+	}
+
+	// CS の外で待つ (Load() は CS を必要とする)
+	if(task) tTaskPool::GetInstance().Wait(task);
+
+	tMemoryStreamBlock * block;
+
+	{
+		volatile tCriticalSection::tLocker holder(CS);
+
+		// 待っている間に読み込みに失敗したりキャンセルされたりした可能性が
+		// あるので、改めて探す
+		tEntry ** found = Entries.Find(path);
+		if(!found) return NULL;
+
+		tEntry * entry = *found;
+		if(entry->State != tEntry::esReady)
+		{
+			// 待っている間に改めて要求されたもの。呼び出し元が普通に開くので、
+			// この先読みは必要ない
+			Remove(entry);
+			return NULL;
+		}
+
+		block = entry->Block;
+		Remove(entry);
+		++Hits;
+	}
+
+	// MemoryStreamClass からインスタンスを生成して返す
+	tVariant obj =
+		tClassHolder<tMemoryStreamClass>::instance()->GetClass()->
+			Invoke(ss_new, (risse_int64)tFileOpenModes::omRead, true);
+				// 第２引数の true は、ストリームになんらメモリブロックがアタッチ
+				// されずにストリームが作成されることを表す(下でアタッチする)
+	obj.AssertClass(tClassHolder<tMemoryStreamClass>::instance()->GetClass());
+	tMemoryStreamInstance *memstream =
+		static_cast<tMemoryStreamInstance *>(obj.GetObjectInterface());
+
+	memstream->SetMemoryBlock(block); // ここでアタッチ
+
+	return memstream;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::Cancel(const tString & path)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	tEntry ** found = Entries.Find(path);
+	if(found) Remove(*found);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::CancelAll()
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	// Remove() は Entries を変更するので、先に要素を列挙しておく
+	gc_vector<tEntry *> entries;
+	tHashTable<tString, tEntry *>::tIterator i(Entries);
+	for(; !i.End(); ++i) entries.push_back(i.GetValue());
+
+	for(gc_vector<tEntry *>::iterator i = entries.begin(); i != entries.end(); i++)
+		Remove(*i);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::Wait()
+{
+	while(true)
+	{
+		// タスクの完了を待っている間に新しいタスクが投入される可能性が
+		// あるので、完了していないタスクがなくなるまで繰り返す
+		gc_vector<tPrefetchTask *> tasks;
+		{
+			volatile tCriticalSection::tLocker holder(CS);
+			tasks = Tasks;
+		}
+
+		bool waited = false;
+		for(gc_vector<tPrefetchTask *>::iterator i = tasks.begin(); i != tasks.end(); i++)
+		{
+			if(!(*i)->GetDone())
+			{
+				tTaskPool::GetInstance().Wait(*i);
+				waited = true;
+			}
+		}
+		if(!waited) break;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::SetBudget(risse_uint64 budget)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	Budget = budget;
+
+	// 上限を超えている分は予約済み/読み込み済みの内容を破棄する
+	while(Used > Budget)
+	{
+		tEntry * victim = FindVictim(NULL);
+		if(!victim) break;
+		Remove(victim);
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_uint64 tPrefetchCache::GetBudget()
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	return Budget;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::GetStatistics(risse_uint64 & hits, risse_uint64 & used)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	hits = Hits;
+	used = Used;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::Dispatch()
+{
+	// 完了したタスクを取り除く
+	risse_size n = 0;
+	for(risse_size i = 0; i < Tasks.size(); i++)
+		if(!Tasks[i]->GetDone()) Tasks[n++] = Tasks[i];
+	Tasks.resize(n);
+
+	// 読み込み待ちの要素の数だけ、最大でワーカースレッドの半分の数まで
+	// タスクを投入する
+	tTaskPool & pool = tTaskPool::GetInstance();
+	risse_size limit = (pool.GetWorkerCount() + 1) / 2;
+	while(Running < limit && Running < Pending.size())
+	{
+		tPrefetchTask * task = new tPrefetchTask(this);
+		Tasks.push_back(task);
+		++Running;
+		pool.Submit(task);
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tPrefetchCache::tEntry * tPrefetchCache::Next(tPrefetchTask * task)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	if(task->GetStopping())
+	{
+		// Open() がこのタスクの完了を待っているので終了する。
+		// 残りの要素は代わりのタスクが読み込む
+		--Running;
+		Dispatch();
+		return NULL;
+	}
+
+	if(Pending.size() == 0)
+	{
+		// 読み込み待ちの要素がないので呼び出したタスクは終了する
+		--Running;
+		return NULL;
+	}
+
+	// 最も優先度の高い要素を探す
+	risse_size best = 0;
+	for(risse_size i = 1; i < Pending.size(); i++)
+	{
+		if(Pending[i]->Priority > Pending[best]->Priority ||
+			(Pending[i]->Priority == Pending[best]->Priority &&
+				Pending[i]->Serial < Pending[best]->Serial))
+			best = i;
+	}
+
+	tEntry * entry = Pending[best];
+	Pending.erase(Pending.begin() + best);
+	entry->State = tEntry::esLoading;
+	entry->Task = task;
+	return entry;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::Load(tEntry * entry)
+{
+	tMemoryStreamBlock * block = NULL;
+	risse_uint64 total = 0;
+
+	try
+	{
+		tStreamAdapter stream(entry->FileSystem->Invoke(tSS<'o','p','e','n'>(),
+			entry->FsPath,
+			(risse_int64)(tFileOpenModes::omRead | tFileOpenModes::omSequential)));
+		try
+		{
+			bool reserved;
+			risse_uint64 size = stream.GetSize();
+			{
+				volatile tCriticalSection::tLocker holder(CS);
+				reserved = !entry->Cancelled && Reserve(entry, size);
+			}
+
+			if(reserved)
+			{
+				// ページ単位で読み込む
+				block = new tMemoryStreamBlock();
+				risse_uint8 * buf = static_cast<risse_uint8 *>(
+					MallocAtomicCollectee(tMemoryStreamBlock::PAGE_SIZE));
+				while(!entry->Cancelled)
+				{
+					risse_size one = stream.Read(buf, tMemoryStreamBlock::PAGE_SIZE);
+					if(one == 0) break;
+					block->Write(static_cast<risse_size>(total), buf, one);
+					total += one;
+				}
+				block->Fit();
+			}
+		}
+		catch(...)
+		{
+			stream.Dispose();
+			throw;
+		}
+		stream.Dispose();
+	}
+	catch(...)
+	{
+		// 読み込みに失敗した場合は先読みをあきらめる
+		// (Open() の際に改めて例外が発生する)
+		block = NULL;
+	}
+
+	volatile tCriticalSection::tLocker holder(CS);
+
+	if(block && !entry->Cancelled)
+	{
+		// 読み込み中にファイルのサイズが変わった場合は予約を実際のサイズに合わせる
+		Used = Used - entry->Size + total;
+		entry->Size = total;
+		entry->Block = block;
+		entry->State = tEntry::esReady;
+		entry->Task = NULL;
+	}
+	else
+	{
+		// 予約を解放する
+		Used -= entry->Size;
+		entry->Size = 0;
+
+		// キャンセルされた物はすでに Entries から取り除かれている
+		if(!entry->Cancelled) Entries.Delete(entry->Path);
+		entry->Cancelled = true;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tPrefetchCache::Reserve(tEntry * entry, risse_uint64 size)
+{
+	if(size > Budget) return false;
+
+	// 足りない分は entry よりも後回しにすべき予約済み/読み込み済みの内容を破棄する
+	while(Used + size > Budget)
+	{
+		tEntry * victim = FindVictim(entry);
+		if(!victim) return false;
+		Remove(victim);
+	}
+
+	Used += size;
+	entry->Size = size;
+	return true;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tPrefetchCache::tEntry * tPrefetchCache::FindVictim(const tEntry * entry)
+{
+	// 優先度が低い物ほど、同じ優先度ならば後から要求された物ほど先に破棄する
+	// (Next() が読み込む順番の逆)
+	tEntry * victim = NULL;
+	tHashTable<tString, tEntry *>::tIterator i(Entries);
+	for(; !i.End(); ++i)
+	{
+		tEntry * item = i.GetValue();
+		if(item == entry) continue;
+		if(item->Size == 0) continue; // 予約していない物は破棄しても空かない
+		if(entry && !IsLaterThan(item, entry)) continue;
+		if(!victim || IsLaterThan(item, victim))
+			victim = item;
+	}
+	return victim;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tPrefetchCache::IsLaterThan(const tEntry * a, const tEntry * b)
+{
+	return a->Priority < b->Priority ||
+		(a->Priority == b->Priority && a->Serial > b->Serial);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tPrefetchCache::Remove(tEntry * entry)
+{
+	switch(entry->State)
+	{
+	case tEntry::esPending:
+		for(gc_vector<tEntry *>::iterator i = Pending.begin(); i != Pending.end(); i++)
+		{
+			if(*i == entry) { Pending.erase(i); break; }
+		}
+		break;
+
+	case tEntry::esLoading:
+		// 予約はここで解放する。Load() はキャンセルされたことを見て
+		// 読み込みを中断する
+		Used -= entry->Size;
+		entry->Size = 0;
+		entry->Cancelled = true;
+		break;
+
+	case tEntry::esReady:
+		Used -= entry->Size;
+		entry->Size = 0;
+		entry->Block = NULL;
+		break;
+	}
+
+	Entries.Delete(entry->Path);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+} // namespace Risa
+
@@ -0,0 +1,234 @@
+//---------------------------------------------------------------------------
+/*
+	Risa [りさ]      alias 吉里吉里3 [kirikiri-3]
+	 stands for "Risa Is a Stagecraft Architecture"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief ファイルの先読みキャッシュ
+//---------------------------------------------------------------------------
+#ifndef PrefetchCacheH
+#define PrefetchCacheH
+
+#include "risseHashTable.h"
+#include "risseString.h"
+#include "builtin/stream/risseStreamClass.h"
+#include "risa/common/RisaThread.h"
+#include "risa/common/RisaGC.h"
+
+/*
+	ファイルの内容をバックグラウンドで読み込んでメモリ上に保持しておき、
+	その後の読み込み専用の Open() をメモリから返すための仕組み。
+
+	先読みの要求は優先度の高い物から順に、最大でタスクプールのワーカー
+	スレッドの半分の数だけ同時に処理される (残りのワーカースレッドは画像の
+	デコードなどのために空けておく)。読み込みはファイルシステムの open で
+	得られたストリームを最後まで読むことで行うため、アーカイブ内の圧縮された
+	ファイルなどはここで展開され、OSFS 上のファイルはページキャッシュを経由して
+	読み込まれる。
+
+	保持する内容の合計サイズは Budget を超えない。読み込みを始める前に
+	ファイルのサイズ分を予約し、足りない場合はその要素よりも優先度の低い
+	(同じ優先度ならば後から要求された) 予約済み/読み込み済みの内容を破棄
+	する。それでも足りない場合はその先読みをあきらめる。このため、先に
+	要求された物が後から要求された同じ優先度の物に追い出されることはなく、
+	どちらが先に読み込まれても残る内容は同じになる。
+
+	先読みした内容は一度 Open() されるとキャッシュから取り除かれる。
+	読み込み中の物を Open() した場合は読み込みが終わるのを待つ。
+*/
+
+namespace Risa {
+//---------------------------------------------------------------------------
+
+class tFileSystemInstance;
+class tMemoryStreamBlock;
+class tPrefetchTask;
+//---------------------------------------------------------------------------
+/**
+ * ファイルの先読みキャッシュ
+ * @note	パスはすべて tFileSystemManager によって正規化されたフルパスで
+ *			扱う。
+ */
+class tPrefetchCache
+{
+	friend class tPrefetchTask;
+
+public:
+	static const risse_uint64 DEFAULT_BUDGET = 64*1024*1024; //!< デフォルトの Budget
+
+private:
+	/**
+	 * 先読みの要素
+	 */
+	struct tEntry : public tCollectee
+	{
+		/**
+		 * 状態
+		 */
+		enum tState
+		{
+			esPending /*!< 読み込み待ち */,
+			esLoading /*!< 読み込み中 */,
+			esReady /*!< 読み込み済み */
+		};
+
+		tString Path; //!< 正規化されたフルパス
+		tFileSystemInstance * FileSystem; //!< ファイルシステムインスタンス
+		tString FsPath; //!< ファイルシステム内におけるパス
+		risse_int Priority; //!< 優先度 (大きい方が優先される)
+		risse_uint64 Serial; //!< 要求された順番 (同じ優先度の場合は小さい方が優先される)
+		tState State; //!< 状態
+		volatile bool Cancelled; //!< 読み込み中にキャンセルされたかどうか
+		risse_uint64 Size; //!< 予約しているサイズ
+		tMemoryStreamBlock * Block; //!< 読み込んだ内容 (esReady の場合のみ)
+		tPrefetchTask * Task; //!< 読み込んでいるタスク (esLoading の場合のみ)
+	};
+
+	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
+	tHashTable<tString, tEntry *> Entries; //!< パス → 要素 のハッシュ表 (キャンセルされた物は含まない)
+	gc_vector<tEntry *> Pending; //!< 読み込み待ちの要素
+	gc_vector<tPrefetchTask *> Tasks; //!< タスクプールに投入したタスク
+	risse_size Running; //!< 実行中のタスクの数
+	risse_uint64 Serial; //!< 次の要素に与える Serial
+	risse_uint64 Budget; //!< 保持する内容の合計サイズの上限
+	risse_uint64 Used; //!< 予約済み/保持している内容の合計サイズ
+	risse_uint64 Hits; //!< Open() が先読みした内容から返された回数
+
+	tPrefetchCache(const tPrefetchCache &); //!< non-copyable
+	void operator = (const tPrefetchCache &); //!< non-copyable
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tPrefetchCache();
+
+	/**
+	 * 先読みを要求する
+	 * @param path		正規化されたフルパス
+	 * @param fs		ファイルシステムインスタンス
+	 * @param fspath	ファイルシステム内におけるパス
+	 * @param priority	優先度 (大きい方が優先される)
+	 * @note	すでに要求されているパスの場合は優先度を上げるだけ
+	 */
+	void Add(const tString & path, tFileSystemInstance * fs,
+		const tString & fspath, risse_int priority);
+
+	/**
+	 * 先読みした内容を取り出してストリームを作成する
+	 * @param path	正規化されたフルパス
+	 * @return	読み込み専用のメモリストリーム (先読みされていない場合は NULL)
+	 * @note	取り出した内容はキャッシュから取り除かれる。
+	 *			読み込み中の場合は、読み込みが終わるのを待ってその内容を返す。
+	 *			まだ読み込みが始まっていない場合は NULL を返し、その先読みは
+	 *			キャンセルする。
+	 */
+	tStreamInstance * Open(const tString & path);
+
+	/**
+	 * 先読みをキャンセルし、先読みした内容を破棄する
+	 * @param path	正規化されたフルパス
+	 */
+	void Cancel(const tString & path);
+
+	/**
+	 * すべての先読みをキャンセルし、先読みした内容をすべて破棄する
+	 */
+	void CancelAll();
+
+	/**
+	 * 要求されているすべての先読みが終わるまで待つ
+	 * @note	タスクプールのワーカースレッドから呼ばれた場合は、待っている間は
+	 *			タスクプールの他のタスクを実行する
+	 */
+	void Wait();
+
+	/**
+	 * 保持する内容の合計サイズの上限を設定する
+	 * @param budget	上限 (バイト単位)
+	 * @note	上限を超えている場合は読み込み済みの内容を破棄する
+	 */
+	void SetBudget(risse_uint64 budget);
+
+	/**
+	 * 保持する内容の合計サイズの上限を得る
+	 * @return	上限 (バイト単位)
+	 */
+	risse_uint64 GetBudget();
+
+	/**
+	 * 統計を得る
+	 * @param hits	Open() が先読みした内容から返された回数の格納先
+	 * @param used	予約済み/保持している内容の合計サイズの格納先
+	 */
+	void GetStatistics(risse_uint64 & hits, risse_uint64 & used);
+
+private:
+	/**
+	 * 必要ならばタスクをタスクプールに投入する
+	 * @note	CS 内で呼ぶこと
+	 */
+	void Dispatch();
+
+	/**
+	 * 次に読み込む要素を取り出す (tPrefetchTask から呼ばれる)
+	 * @param task	呼び出したタスク
+	 * @return	要素 (読み込み待ちの要素がないか、Open() がタスクの完了を
+	 *			待っている場合は NULL; この場合呼び出したタスクは終了しなければ
+	 *			ならない)
+	 */
+	tEntry * Next(tPrefetchTask * task);
+
+	/**
+	 * 要素を読み込む (tPrefetchTask から呼ばれる)
+	 * @param entry	要素
+	 */
+	void Load(tEntry * entry);
+
+	/**
+	 * 要素に必要なサイズを予約する
+	 * @param entry	要素
+	 * @param size	サイズ
+	 * @return	予約できれば真
+	 * @note	CS 内で呼ぶこと。足りない場合は entry よりも後回しにすべき
+	 *			予約済み/読み込み済みの内容を破棄する
+	 */
+	bool Reserve(tEntry * entry, risse_uint64 size);
+
+	/**
+	 * 最も先に破棄すべき予約済み/読み込み済みの要素を探す
+	 * @param entry	この要素よりも後回しにすべき要素のみを対象とする (NULL=制限しない)
+	 * @return	要素 (無い場合は NULL)
+	 * @note	CS 内で呼ぶこと
+	 */
+	tEntry * FindVictim(const tEntry * entry);
+
+	/**
+	 * 要素 a が要素 b よりも後回しにすべきものかどうかを判定する
+	 * @param a	要素
+	 * @param b	要素
+	 * @return	a の優先度が b よりも低いか、優先度が同じで a の方が後から
+	 *			要求された場合に真
+	 */
+	static bool IsLaterThan(const tEntry * a, const tEntry * b);
+
+	/**
+	 * 要素を取り除く
+	 * @param entry	要素
+	 * @note	CS 内で呼ぶこと。読み込み中の要素はキャンセルされ、予約は
+	 *			ただちに解放される
+	 */
+	void Remove(tEntry * entry);
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+} // namespace Risa
+
+
+#endif
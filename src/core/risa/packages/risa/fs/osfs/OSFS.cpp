@@ -269,6 +269,20 @@ tStreamInstance * tOSFSInstance::open(const tString & filename, risse_uint32 fla
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+tOctet tOSFSInstance::map(const tString & filename)
+{
+	volatile tSynchronizer sync(this); // sync
+
+	wxString native_name(BaseDirectory.c_str() + ConvertToNativePathDelimiter(filename.AsWxString()));
+	CheckFileNameCase(native_name);
+
+	tOSMappedFile * file = new tOSMappedFile(native_name);
+	return file->GetOctet(0, static_cast<risse_size>(file->GetSize()));
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 void tOSFSInstance::flush()
 {
@@ -367,6 +381,7 @@ RISSE_IMPL_CLASS_BEGIN(tOSFSClass, (tSS<'O','S','F','S'>()),
 	BindFunction(this, tSS<'s','t','a','t'>(), &tOSFSInstance::stat);
 	BindFunction(this, tSS<'o','p','e','n'>(), &tOSFSInstance::open);
 	BindFunction(this, tSS<'f','l','u','s','h'>(), &tOSFSInstance::flush);
+	BindFunction(this, tSS<'m','a','p'>(), &tOSFSInstance::map);
 
 	BindProperty(this, tSS<'s','o','u','r','c','e'>(), &tOSFSInstance::get_source);
 RISSE_IMPL_CLASS_END()
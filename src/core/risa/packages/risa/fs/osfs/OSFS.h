@@ -19,6 +19,7 @@
 #include "risseWCString.h"
 #include "builtin/stream/risseStreamClass.h"
 #include "risa/packages/risa/fs/osfs/OSNativeStream.h"
+#include "risa/packages/risa/fs/osfs/OSMappedFile.h"
 #include <wx/file.h>
 
 namespace Risa {
@@ -137,6 +138,16 @@ public: // Risse 用メソッドなど
 
 	//-- FileSystem メンバ ここまで
 
+	/**
+	 * 指定されたファイルを読み込み専用でメモリマップし、その内容を表すオクテット列を得る
+	 * @param filename	ファイル名
+	 * @return	ファイルの内容を表すオクテット列
+	 * @note	内容はコピーされない。オクテット列 (およびその部分オクテット列) が
+	 *			すべて回収されるまでマップは解除されない。
+	 *			マップ中にファイルの内容が外部から変更された場合の動作は未定義。
+	 */
+	tOctet map(const tString & filename);
+
 	tString get_source() const { return BaseDirectory; }
 
 private:
@@ -0,0 +1,104 @@
+//---------------------------------------------------------------------------
+/*
+	Risa [りさ]      alias 吉里吉里3 [kirikiri-3]
+	 stands for "Risa Is a Stagecraft Architecture"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief OS のファイルを読み込み専用でメモリマップする
+//---------------------------------------------------------------------------
+#include "risa/prec.h"
+#include "risa/packages/risa/fs/osfs/OSMappedFile.h"
+#include "risa/common/RisaException.h"
+#include "risseExceptionClass.h"
+#include <wx/file.h>
+
+#ifdef __WXMSW__
+	#include <windows.h>
+	#include <io.h>
+#else
+	#include <sys/mman.h>
+#endif
+
+
+
+namespace Risa {
+RISSE_DEFINE_SOURCE_ID(23310,52907,4561,19830,41262,8797,57113,36054);
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tOSMappedFile::tOSMappedFile(const wxString & native_name)
+{
+	Pointer = NULL;
+	Size = 0;
+
+	wxFile file;
+	if(!file.Open(native_name, wxFile::read))
+		tIOExceptionClass::Throw(
+			tString(RISSE_WS_TR("cannot open file %1"), tString(native_name.c_str())));
+
+	wxFileOffset length = file.Length();
+	if(length == wxInvalidOffset)
+		tIOExceptionClass::Throw(
+			tString(RISSE_WS_TR("cannot map file %1"), tString(native_name.c_str())));
+	if(length == 0) return; // 長さ 0 のファイルはマップしない
+	if(static_cast<risse_uint64>(length) > static_cast<risse_uint64>(risse_size_max))
+		tIOExceptionClass::Throw(
+			tString(RISSE_WS_TR("cannot map file %1: file too large"), tString(native_name.c_str())));
+
+	void * ptr = NULL;
+#ifdef __WXMSW__
+	HANDLE mapping = ::CreateFileMapping(
+		reinterpret_cast<HANDLE>(::_get_osfhandle(file.fd())),
+		NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping)
+	{
+		ptr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		// ビューが存在する限りマッピングは維持されるので、ハンドルはここで閉じてよい
+		::CloseHandle(mapping);
+	}
+#else
+	ptr = ::mmap(NULL, static_cast<size_t>(length), PROT_READ, MAP_PRIVATE, file.fd(), 0);
+	if(ptr == MAP_FAILED) ptr = NULL;
+#endif
+	if(!ptr)
+		tIOExceptionClass::Throw(
+			tString(RISSE_WS_TR("cannot map file %1"), tString(native_name.c_str())));
+
+	// マップした領域はファイルを閉じた後も有効
+	Pointer = static_cast<const risse_uint8 *>(ptr);
+	Size = static_cast<risse_uint64>(length);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tOSMappedFile::~tOSMappedFile()
+{
+	if(!Pointer) return;
+#ifdef __WXMSW__
+	::UnmapViewOfFile(Pointer);
+#else
+	::munmap(const_cast<risse_uint8 *>(Pointer), static_cast<size_t>(Size));
+#endif
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tOctet tOSMappedFile::GetOctet(risse_uint64 offset, risse_size length) const
+{
+	RISSE_ASSERT(offset <= Size && Size - offset >= length);
+	if(length == 0) return tOctet();
+	return tOctet(new tOctetBlock(
+		tOctetBlock::MakeReference(Pointer + offset, length, this)));
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+} // namespace Risa
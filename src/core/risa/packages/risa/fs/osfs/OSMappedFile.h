@@ -0,0 +1,75 @@
+//---------------------------------------------------------------------------
+/*
+	Risa [りさ]      alias 吉里吉里3 [kirikiri-3]
+	 stands for "Risa Is a Stagecraft Architecture"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief OS のファイルを読み込み専用でメモリマップする
+//---------------------------------------------------------------------------
+#ifndef _OSMappedFileH_
+#define _OSMappedFileH_
+
+#include "risseGC.h"
+#include "risseOctet.h"
+#include <wx/string.h>
+
+namespace Risa {
+//---------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------
+/**
+ * 読み込み専用でメモリマップされたファイル
+ * @note	GC の対象で、回収に際してデストラクタが呼ばれ、マップが解除される。
+ *			マップした領域を参照する tOctet は、このオブジェクトを Owner として
+ *			保持するため、それらが生きている限りマップは解除されない。
+ */
+class tOSMappedFile : public tDestructee
+{
+	const risse_uint8 * Pointer; //!< マップされた領域 (長さ 0 のファイルの場合は NULL)
+	risse_uint64 Size; //!< マップされた領域のサイズ
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param native_name	OS ネイティブなファイル名
+	 * @note	ファイルを開けない、あるいはマップできない場合は IOException が発生する
+	 */
+	tOSMappedFile(const wxString & native_name);
+
+	/**
+	 * デストラクタ
+	 */
+	virtual ~tOSMappedFile();
+
+	/**
+	 * マップされた領域を得る
+	 * @return	マップされた領域
+	 */
+	const risse_uint8 * GetPointer() const { return Pointer; }
+
+	/**
+	 * マップされた領域のサイズを得る
+	 * @return	マップされた領域のサイズ
+	 */
+	risse_uint64 GetSize() const { return Size; }
+
+	/**
+	 * マップされた領域の一部を参照するオクテット列を得る
+	 * @param offset	開始位置
+	 * @param length	長さ
+	 * @return	オクテット列 (内容はコピーされない)
+	 */
+	tOctet GetOctet(risse_uint64 offset, risse_size length) const;
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+} // namespace Risa
+
+
+#endif
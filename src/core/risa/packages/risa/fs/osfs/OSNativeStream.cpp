@@ -16,8 +16,17 @@
 #include "risseExceptionClass.h"
 #include "risseStaticStrings.h"
 #include <wx/filename.h>
+#include <wx/filefn.h>
 #include <wx/dir.h>
 
+#ifndef __WXMSW__
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <errno.h>
+#endif
+
 
 
 namespace Risa {
@@ -25,6 +34,128 @@ RISSE_DEFINE_SOURCE_ID(49572,65271,56057,18682,27296,33314,20965,8152);
 //---------------------------------------------------------------------------
 
 
+#ifndef __WXMSW__
+//---------------------------------------------------------------------------
+/**
+ * pread を中断やショートリードにかかわらず size バイト (あるいはファイルの終わり) まで行う
+ * @param fd		ファイルディスクリプタ
+ * @param buf		読み込み先
+ * @param size		読み込むサイズ
+ * @param offset	読み込み開始位置
+ * @return	実際に読み込まれたサイズ
+ */
+static risse_size ReadFully(int fd, risse_uint8 * buf, risse_size size, risse_uint64 offset)
+{
+	risse_size done = 0;
+	while(done < size)
+	{
+		ssize_t r = ::pread(fd, buf + done, size - done, static_cast<off_t>(offset + done));
+		if(r < 0)
+		{
+			if(errno == EINTR) continue;
+			break; // エラー
+		}
+		if(r == 0) break; // ファイルの終わり
+		done += static_cast<risse_size>(r);
+	}
+	return done;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tOSNativeStreamInstance::tInternal::~tInternal()
+{
+	if(DirectFd != -1) ::close(DirectFd);
+	if(Fd != -1) ::close(Fd);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tOSNativeStreamInstance::tInternal::Read(risse_uint8 * buf, risse_size size,
+	risse_uint64 offset)
+{
+	risse_size done = 0;
+
+#ifdef O_DIRECT
+	// 巨大な読み込みの場合は、ファイル中の位置がアラインメントのとれた部分を
+	// ページキャッシュを経由せずに読む。先頭と末尾の端数や、O_DIRECT での
+	// 読み込みに失敗した場合は通常のディスクリプタで読む。
+	// 読み込み先がアラインメントされていない場合は、アラインメントされた
+	// 中間バッファに読んでからコピーする。
+	if(DirectFd != -1 && size >= DIRECT_READ_THRESHOLD)
+	{
+		risse_size head = static_cast<risse_size>(
+			(DIRECT_ALIGNMENT - offset % DIRECT_ALIGNMENT) % DIRECT_ALIGNMENT);
+		done = ReadFully(Fd, buf, head, offset);
+		if(done == head)
+		{
+			risse_size body = (size - head) - (size - head) % DIRECT_ALIGNMENT;
+			risse_uint8 * dest = buf + head;
+			risse_size direct = 0;
+			if(reinterpret_cast<risse_ptruint>(dest) % DIRECT_ALIGNMENT == 0)
+			{
+				direct = ReadFully(DirectFd, dest, body, offset + head);
+				direct -= direct % DIRECT_ALIGNMENT; // ファイルの終わりで半端に読めた分は読み直す
+			}
+			else
+			{
+				risse_uint8 * bounce = static_cast<risse_uint8 *>(
+					AlignedMallocAtomicCollectee(DIRECT_BOUNCE_SIZE, DIRECT_ALIGNMENT_SHIFT));
+				while(direct < body)
+				{
+					risse_size one = body - direct;
+					if(one > DIRECT_BOUNCE_SIZE) one = DIRECT_BOUNCE_SIZE;
+					risse_size r = ReadFully(DirectFd, bounce, one, offset + head + direct);
+					r -= r % DIRECT_ALIGNMENT; // ファイルの終わりで半端に読めた分は読み直す
+					memcpy(dest + direct, bounce, r);
+					direct += r;
+					if(r < one) break; // ファイルの終わりかエラー
+				}
+				AlignedFreeCollectee(bounce);
+			}
+			done += direct;
+		}
+	}
+#endif
+
+	return done + ReadFully(Fd, buf + done, size - done, offset + done);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tOSNativeStreamInstance::tInternal::Write(const risse_uint8 * buf, risse_size size,
+	risse_uint64 offset)
+{
+	risse_size done = 0;
+	while(done < size)
+	{
+		ssize_t r = ::pwrite(Fd, buf + done, size - done, static_cast<off_t>(offset + done));
+		if(r < 0)
+		{
+			if(errno == EINTR) continue;
+			break; // エラー
+		}
+		done += static_cast<risse_size>(r);
+	}
+	return done;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_uint64 tOSNativeStreamInstance::tInternal::GetSize()
+{
+	struct stat st;
+	if(::fstat(Fd, &st) != 0) return 0;
+	return static_cast<risse_uint64>(st.st_size);
+}
+//---------------------------------------------------------------------------
+#endif
+
+
 //---------------------------------------------------------------------------
 void tOSNativeStreamInstance::initialize(const tString & path, risse_uint32 flags, const tNativeCallInfo &info)
 {
@@ -32,6 +163,7 @@ void tOSNativeStreamInstance::initialize(const tString & path, risse_uint32 flag
 
 	info.InitializeSuperClass();
 
+#ifdef __WXMSW__
 	// モードを決定する
 	wxFile::OpenMode mode;
 	switch(flags & tFileOpenModes::omAccessMask)
@@ -55,11 +187,56 @@ void tOSNativeStreamInstance::initialize(const tString & path, risse_uint32 flag
 			tString(RISSE_WS_TR("cannot open file %1"), path));
 	}
 
-	// 名前を
-
 	// APPEND の場合はファイルポインタを最後に移動する
 	if(flags & tFileOpenModes::omAppendBit)
 		Internal->File.SeekEnd();
+#else
+	// モードを決定する (wxFile と同じフラグ)
+	int oflags;
+	switch(flags & tFileOpenModes::omAccessMask)
+	{
+	case tFileOpenModes::omRead:
+		oflags = O_RDONLY; break;
+	case tFileOpenModes::omWrite:
+		oflags = O_WRONLY | O_CREAT | O_TRUNC; break;
+	case tFileOpenModes::omUpdate:
+		oflags = O_RDWR; break;
+	default:
+		oflags = O_RDONLY;
+	}
+
+	// ファイルを開く
+	wxString native_name(path.AsWxString());
+	Internal = new tInternal();
+	Internal->Fd = ::open(wxFNCONV(native_name), oflags, 0666);
+	if(Internal->Fd == -1)
+	{
+		delete Internal; Internal = NULL;
+		tIOExceptionClass::Throw(
+			tString(RISSE_WS_TR("cannot open file %1"), path));
+	}
+
+	// アクセスパターンのヒントを OS に伝える
+#ifdef POSIX_FADV_SEQUENTIAL
+	if(flags & tFileOpenModes::omSequential)
+		::posix_fadvise(Internal->Fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	if(flags & tFileOpenModes::omWillNeed)
+		::posix_fadvise(Internal->Fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+
+	// 読み込み専用で omDirect が指定された場合は O_DIRECT のディスクリプタも開く
+	// (ファイルシステムが O_DIRECT に対応していない場合は開けないので、
+	// その場合は通常のディスクリプタのみで読む)
+#ifdef O_DIRECT
+	if((flags & tFileOpenModes::omDirect) &&
+		(flags & tFileOpenModes::omAccessMask) == tFileOpenModes::omRead)
+		Internal->DirectFd = ::open(wxFNCONV(native_name), O_RDONLY | O_DIRECT);
+#endif
+
+	// APPEND の場合は現在位置を最後に移動する
+	if(flags & tFileOpenModes::omAppendBit)
+		Internal->Position = Internal->GetSize();
+#endif
 }
 //---------------------------------------------------------------------------
 
@@ -76,7 +253,17 @@ void tOSNativeStreamInstance::dispose()
 {
 	volatile tSynchronizer sync(this); // sync
 	if(Internal)
-		delete Internal, Internal = NULL;
+	{
+#ifndef __WXMSW__
+		// ロックの外で ReadAt() が読み込み中の場合は、最後の ReadAt() が
+		// 終わった時点で閉じる
+		if(Internal->Readers)
+			Internal->Disposed = true;
+		else
+#endif
+			delete Internal;
+		Internal = NULL;
+	}
 }
 //---------------------------------------------------------------------------
 
@@ -88,6 +275,7 @@ bool tOSNativeStreamInstance::seek(risse_int64 offset, tOrigin whence)
 
 	if(!Internal) tInaccessibleResourceExceptionClass::Throw();
 
+#ifdef __WXMSW__
 	wxSeekMode mode = wxFromCurrent;
 	switch(whence)
 	{
@@ -100,6 +288,21 @@ bool tOSNativeStreamInstance::seek(risse_int64 offset, tOrigin whence)
 	wxFileOffset newpos = Internal->File.Seek(offset, mode);
 	if(newpos == wxInvalidOffset)
 		return false;
+#else
+	risse_int64 base = static_cast<risse_int64>(Internal->Position);
+	switch(whence)
+	{
+	case soSet: base = 0;                                               break;
+	case soCur:                                                         break;
+	case soEnd: base = static_cast<risse_int64>(Internal->GetSize());   break;
+	default: offset = 0;
+	}
+
+	risse_int64 newpos = base + offset;
+	if(newpos < 0)
+		return false;
+	Internal->Position = static_cast<risse_uint64>(newpos);
+#endif
 
 	return true;
 }
@@ -113,7 +316,11 @@ risse_uint64 tOSNativeStreamInstance::tell()
 
 	if(!Internal) tInaccessibleResourceExceptionClass::Throw();
 
+#ifdef __WXMSW__
 	return Internal->File.Tell();
+#else
+	return Internal->Position;
+#endif
 }
 //---------------------------------------------------------------------------
 
@@ -130,9 +337,15 @@ risse_size tOSNativeStreamInstance::get(const tOctet & buf)
 	// これに限ってはこういう使い方をすると言うことになっている。
 	// というかそうした。
 
+#ifdef __WXMSW__
 	ssize_t read = Internal->File.Read(const_cast<risse_uint8*>(buf.Pointer()), buf.GetLength());
 
 	if(read < 0 || read == wxInvalidOffset) read = 0; // エラーと見なす
+#else
+	risse_size read = Internal->Read(const_cast<risse_uint8*>(buf.Pointer()), buf.GetLength(),
+		Internal->Position);
+	Internal->Position += read;
+#endif
 
 	return read;
 }
@@ -146,7 +359,53 @@ risse_size tOSNativeStreamInstance::put(const tOctet & buf)
 
 	if(!Internal) tInaccessibleResourceExceptionClass::Throw();
 
+#ifdef __WXMSW__
 	return Internal->File.Write(buf.Pointer(), buf.GetLength());
+#else
+	risse_size written = Internal->Write(buf.Pointer(), buf.GetLength(), Internal->Position);
+	Internal->Position += written;
+	return written;
+#endif
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tOSNativeStreamInstance::ReadAt(void * buf, risse_size size, risse_uint64 offset)
+{
+#ifdef __WXMSW__
+	volatile tSynchronizer sync(this); // sync
+
+	if(!Internal) tInaccessibleResourceExceptionClass::Throw();
+
+	// 現在位置を保存しておき、読み込み後に戻す
+	wxFileOffset pos = Internal->File.Tell();
+	if(Internal->File.Seek(offset, wxFromStart) == wxInvalidOffset) return 0;
+	ssize_t read = Internal->File.Read(buf, size);
+	Internal->File.Seek(pos, wxFromStart);
+
+	if(read < 0 || read == wxInvalidOffset) read = 0; // エラーと見なす
+	return read;
+#else
+	// pread は現在位置を使わないので、読み込み自体はロックの外で行う。
+	// 読み込み中に dispose() でファイルが閉じられないよう、Readers を
+	// 増やしておく
+	tInternal * internal;
+	{
+		volatile tSynchronizer sync(this); // sync
+		if(!Internal) tInaccessibleResourceExceptionClass::Throw();
+		internal = Internal;
+		++internal->Readers;
+	}
+
+	risse_size read = internal->Read(static_cast<risse_uint8*>(buf), size, offset);
+
+	{
+		volatile tSynchronizer sync(this); // sync
+		if(--internal->Readers == 0 && internal->Disposed) delete internal;
+	}
+	return read;
+#endif
 }
 //---------------------------------------------------------------------------
 
@@ -169,7 +428,11 @@ risse_uint64 tOSNativeStreamInstance::get_size()
 
 	if(!Internal) tInaccessibleResourceExceptionClass::Throw();
 
+#ifdef __WXMSW__
 	return Internal->File.Length();
+#else
+	return Internal->GetSize();
+#endif
 }
 //---------------------------------------------------------------------------
 
@@ -181,7 +444,11 @@ void tOSNativeStreamInstance::flush()
 
 	if(!Internal) tInaccessibleResourceExceptionClass::Throw();
 
+#ifdef __WXMSW__
 	Internal->File.Flush();
+#else
+	::fsync(Internal->Fd); // wxFile::Flush と同じ
+#endif
 }
 //---------------------------------------------------------------------------
 
@@ -25,10 +25,15 @@ namespace Risa {
 //---------------------------------------------------------------------------
 /**
  * OS ネイティブファイルストリーム(OSNativeStreamクラス)
+ * @note	Windows 以外では wxFile を用いず、pread/pwrite と自前の現在位置で
+ *			読み書きを行う。ReadAt() は現在位置を使わないので、読み込み自体は
+ *			ストリームのロックの外で行い、複数のスレッドから同時に呼ぶことが
+ *			できる。
  */
 class tOSNativeStreamInstance : public tStreamInstance
 {
 protected:
+#ifdef __WXMSW__
 	/**
 	 * 内部情報用構造体(GCの対象で、回収に際してデストラクタが呼ばれる)
 	 */
@@ -36,6 +41,58 @@ protected:
 	{
 		wxFile File;
 	} * Internal;
+#else
+	static const risse_size DIRECT_ALIGNMENT_SHIFT = 12; //!< O_DIRECT で読む際のアライメント (1<<DIRECT_ALIGNMENT_SHIFT バイト境界)
+	static const risse_size DIRECT_ALIGNMENT = 1 << DIRECT_ALIGNMENT_SHIFT; //!< O_DIRECT で読む際のアライメント
+	static const risse_size DIRECT_BOUNCE_SIZE = 1024*1024; //!< 読み込み先がアラインメントされていない場合に O_DIRECT で一度に読むサイズ
+	static const risse_size DIRECT_READ_THRESHOLD = 4*1024*1024; //!< これ以上のサイズの読み込みのみ O_DIRECT で行う
+
+	/**
+	 * 内部情報用構造体(GCの対象で、回収に際してデストラクタが呼ばれる)
+	 */
+	struct tInternal : public tDestructee
+	{
+		int Fd; //!< ファイルディスクリプタ
+		int DirectFd; //!< O_DIRECT で開いたファイルディスクリプタ (-1 = 使わない)
+		risse_uint64 Position; //!< 現在位置 (get/put はこの位置で pread/pwrite を行う)
+		risse_size Readers; //!< ロックの外で ReadAt() を実行中のスレッドの数 (ストリームのロックで保護される)
+		bool Disposed; //!< Readers が 0 でないうちに dispose() されたかどうか (ストリームのロックで保護される)
+
+		/**
+		 * コンストラクタ
+		 */
+		tInternal() { Fd = DirectFd = -1; Position = 0; Readers = 0; Disposed = false; }
+
+		/**
+		 * デストラクタ
+		 */
+		virtual ~tInternal();
+
+		/**
+		 * 指定位置から読み込む
+		 * @param buf		読み込み先
+		 * @param size		読み込むサイズ
+		 * @param offset	読み込み開始位置
+		 * @return	実際に読み込まれたサイズ
+		 */
+		risse_size Read(risse_uint8 * buf, risse_size size, risse_uint64 offset);
+
+		/**
+		 * 指定位置に書き込む
+		 * @param buf		書き込むデータ
+		 * @param size		書き込むサイズ
+		 * @param offset	書き込み開始位置
+		 * @return	実際に書き込まれたサイズ
+		 */
+		risse_size Write(const risse_uint8 * buf, risse_size size, risse_uint64 offset);
+
+		/**
+		 * ファイルのサイズを得る
+		 * @return	ファイルのサイズ
+		 */
+		risse_uint64 GetSize();
+	} * Internal;
+#endif
 
 public:
 	/**
@@ -88,6 +145,21 @@ public: // risse 用メソッドとか
 	 */
 	risse_size put(const tOctet & buf);
 
+	/**
+	 * 指定位置から読み込む (現在位置は変更しない)
+	 * @param buf		読み込み先
+	 * @param size		読み込むサイズ
+	 * @param offset	読み込み開始位置
+	 * @return	実際に読み込まれたサイズ
+	 * @note	Windows 以外では、ロックは Internal の参照を得る間と手放す間だけ
+	 *			取り、pread 自体はロックの外で行う。そのため複数のスレッドから
+	 *			同時に呼ぶことができる。読み込み中に dispose() された場合は、
+	 *			読み込みが終わった時点でファイルが閉じられる。
+	 *			Windows では現在位置の移動を伴うため、ストリームのロックを
+	 *			持ったまま読む。
+	 */
+	risse_size ReadAt(void * buf, risse_size size, risse_uint64 offset);
+
 	/**
 	 * ストリームを現在位置で切りつめる
 	 */
@@ -20,17 +20,31 @@ RISSE_DEFINE_SOURCE_ID(64253,18417,33137,18368,23694,7632,14591,23108);
 //---------------------------------------------------------------------------
 
 
-/*
-	将来的にはここは別の、もっと効率のよい固定ブロックベースのアロケータに変える予定。
-*/
+//---------------------------------------------------------------------------
+/**
+ * 最後のページを拡張する際の新しいアロケートサイズを決める
+ * @param current	現在のアロケートサイズ
+ * @param need		必要なサイズ (PAGE_SIZE 以下)
+ * @return	新しいアロケートサイズ
+ */
+static risse_size GetGrowSize(risse_size current, risse_size need)
+{
+	// 小さなファイルが無駄に大きな領域を持たないよう、最後のページは
+	// 倍々に拡張していく
+	risse_size size = current < 4*1024 ? 4*1024 : current;
+	while(size < need) size *= 2;
+	if(size > tMemoryStreamBlock::PAGE_SIZE) size = tMemoryStreamBlock::PAGE_SIZE;
+	return size;
+}
+//---------------------------------------------------------------------------
 
 
 //---------------------------------------------------------------------------
 tMemoryStreamBlock::tMemoryStreamBlock()
 {
-	Block = NULL;
 	Size = 0;
-	AllocSize = 0;
+	LastPageAllocSize = 0;
+	Flat = NULL;
 }
 //---------------------------------------------------------------------------
 
@@ -38,7 +52,10 @@ tMemoryStreamBlock::tMemoryStreamBlock()
 //---------------------------------------------------------------------------
 tMemoryStreamBlock::~tMemoryStreamBlock()
 {
-	if(Block) FreeCollectee(Block), Block = NULL;
+	// 共有していないページは明示的に解放する
+	for(gc_vector<tPage>::iterator i = Pages.begin(); i != Pages.end(); i++)
+		if(!i->Shared) FreeCollectee(i->Data);
+	Pages.clear();
 }
 //---------------------------------------------------------------------------
 
@@ -48,38 +65,45 @@ void tMemoryStreamBlock::ChangeSize(risse_size size)
 {
 	volatile tCriticalSection::tLocker holder(CS);
 
-	if(Size < size && size <= AllocSize)
+	Flat = NULL; // 内容が変わるので連続領域は破棄
+
+	risse_size count = (size + PAGE_SIZE - 1) / PAGE_SIZE; // 必要なページ数
+
+	if(count < Pages.size())
 	{
-		// サイズは拡張するが、すでに必要な容量は確保されている
-		Size = size;
-		return;
+		// 縮小される場合は余分なページを捨てる
+		// (新しく最後になるページは PAGE_SIZE 分確保されている)
+		Pages.resize(count);
+		LastPageAllocSize = count ? PAGE_SIZE : 0;
 	}
-
-	// サイズが縮小される場合、あるいはサイズを拡張しなければ
-	// ならない場合
-
-	// 確保するサイズを決定する
-	// XXX: おそらく間違いなく、ReallocCollectee では新しいメモリブロックの
-	// 確保と、そこへのメモリブロックのコピーが発生する。
-	// したがって非効率的。
-	risse_size onesize;
-	if(AllocSize < 64*1024) onesize = 4*1024;
-	else if(AllocSize < 512*1024) onesize = 16*1024;
-	else if(AllocSize < 4096*1024) onesize = 256*1024;
-	else onesize = 512*1024;
-	AllocSize = size + onesize;
-
-	// メモリを確保する
-	if(Block == NULL)
-		Block = MallocAtomicCollectee(AllocSize);
 	else
-		Block = ReallocCollectee(Block, AllocSize);
+	{
+		// 拡張される場合
+		// 今の最後のページを必要なだけ伸ばす
+		if(Pages.size() != 0)
+		{
+			risse_size last = Pages.size() - 1;
+			risse_size need = count > Pages.size() ? PAGE_SIZE : size - last * PAGE_SIZE;
+			if(need > LastPageAllocSize)
+				ResizePage(last, GetGrowSize(LastPageAllocSize, need));
+		}
 
-	if(AllocSize && !Block)
-		tIOExceptionClass::Throw(RISSE_WS_TR("insufficient memory"));
-		// this exception cannot be repaird; a fatal error.
+		// 足りないページを追加する
+		while(Pages.size() < count)
+		{
+			risse_size alloc = Pages.size() + 1 < count ? PAGE_SIZE :
+				GetGrowSize(0, size - Pages.size() * PAGE_SIZE);
+			tPage page;
+			page.Data = static_cast<risse_uint8 *>(MallocAtomicCollectee(alloc));
+			page.Shared = false;
+			if(!page.Data)
+				tIOExceptionClass::Throw(RISSE_WS_TR("insufficient memory"));
+			Pages.push_back(page);
+			LastPageAllocSize = alloc;
+		}
+	}
 
-	AllocSize = Size = size;
+	Size = size;
 }
 //---------------------------------------------------------------------------
 
@@ -87,22 +111,164 @@ void tMemoryStreamBlock::ChangeSize(risse_size size)
 //---------------------------------------------------------------------------
 void tMemoryStreamBlock::Fit()
 {
-	// 通常、AllocSize は Size よりも大きくなるが、
-	// Size よりも大きくて AllocSize よりも小さな部分は無駄である。
-	// このメソッドは、メモリブロックのサイズを Size ぴったりにすることにより
+	// 通常、最後のページのアロケートサイズはデータの入っている部分より
+	// 大きいが、その余分は無駄である。
+	// このメソッドは、最後のページのサイズをぴったりにすることにより
 	// この無駄な部分を解放する。
 	volatile tCriticalSection::tLocker holder(CS);
 
-	if(Size != AllocSize)
+	if(Pages.size() == 0) return;
+	risse_size last = Pages.size() - 1;
+	if(Pages[last].Shared) return; // 共有している場合はコピーになるのでしない
+
+	risse_size used = Size - last * PAGE_SIZE;
+	if(used != LastPageAllocSize) ResizePage(last, used);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tMemoryStreamBlock::Read(risse_size pos, void * buf, risse_size size)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	if(pos >= Size) return 0;
+	if(size > Size - pos) size = Size - pos;
+
+	risse_uint8 * dest = static_cast<risse_uint8 *>(buf);
+	risse_size remain = size;
+	while(remain)
 	{
-		if(Block == NULL)
-			Block = MallocAtomicCollectee(Size);
-		else
-			Block = ReallocCollectee(Block, Size);
-		if(Size && !Block)
+		risse_size index = pos / PAGE_SIZE;
+		risse_size offset = pos % PAGE_SIZE;
+		risse_size one = PAGE_SIZE - offset;
+		if(one > remain) one = remain;
+		memcpy(dest, Pages[index].Data + offset, one);
+		dest += one;
+		pos += one;
+		remain -= one;
+	}
+
+	return size;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tMemoryStreamBlock::Write(risse_size pos, const void * buf, risse_size size)
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	RISSE_ASSERT(pos <= Size);
+
+	if(size == 0) return;
+
+	// 必要ならばサイズを拡張する
+	if(pos + size > Size)
+		ChangeSize(pos + size);
+	else
+		Flat = NULL; // 内容が変わるので連続領域は破棄
+
+	const risse_uint8 * src = static_cast<const risse_uint8 *>(buf);
+	while(size)
+	{
+		risse_size index = pos / PAGE_SIZE;
+		risse_size offset = pos % PAGE_SIZE;
+		risse_size one = PAGE_SIZE - offset;
+		if(one > size) one = size;
+		memcpy(GetWritablePage(index) + offset, src, one);
+		src += one;
+		pos += one;
+		size -= one;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tMemoryStreamBlock::Assign(tMemoryStreamBlock * src)
+{
+	if(src == this) return;
+
+	// コピー元のページを共有とマークしてから、ページの配列をコピーする
+	// (デッドロックを避けるため、二つのクリティカルセクションを同時には取らない)
+	gc_vector<tPage> pages;
+	risse_size size;
+	risse_size last_alloc;
+	{
+		volatile tCriticalSection::tLocker holder(src->CS);
+		for(gc_vector<tPage>::iterator i = src->Pages.begin(); i != src->Pages.end(); i++)
+			i->Shared = true;
+		pages = src->Pages;
+		size = src->Size;
+		last_alloc = src->LastPageAllocSize;
+	}
+
+	volatile tCriticalSection::tLocker holder(CS);
+	Pages.swap(pages);
+	Size = size;
+	LastPageAllocSize = last_alloc;
+	Flat = NULL;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void * tMemoryStreamBlock::GetBlock()
+{
+	volatile tCriticalSection::tLocker holder(CS);
+
+	if(Pages.size() == 0) return NULL;
+	if(Pages.size() == 1) return Pages[0].Data; // すでに連続している
+
+	// ページを連結する
+	if(!Flat)
+	{
+		Flat = static_cast<risse_uint8 *>(MallocAtomicCollectee(Size));
+		if(!Flat)
 			tIOExceptionClass::Throw(RISSE_WS_TR("insufficient memory"));
-		AllocSize = Size;
+		Read(0, Flat, Size);
 	}
+	return Flat;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tMemoryStreamBlock::ResizePage(risse_size index, risse_size alloc)
+{
+	tPage & page = Pages[index];
+	risse_size current = GetPageAllocSize(index);
+
+	if(page.Shared)
+	{
+		// 共有しているページは ReallocCollectee できないのでコピーする
+		risse_uint8 * data = static_cast<risse_uint8 *>(MallocAtomicCollectee(alloc));
+		if(alloc && !data)
+			tIOExceptionClass::Throw(RISSE_WS_TR("insufficient memory"));
+		memcpy(data, page.Data, current < alloc ? current : alloc);
+		page.Data = data;
+		page.Shared = false;
+	}
+	else
+	{
+		page.Data = static_cast<risse_uint8 *>(ReallocCollectee(page.Data, alloc, hakAtomic));
+		if(alloc && !page.Data)
+			tIOExceptionClass::Throw(RISSE_WS_TR("insufficient memory"));
+			// this exception cannot be repaird; a fatal error.
+	}
+
+	if(index + 1 == Pages.size()) LastPageAllocSize = alloc;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_uint8 * tMemoryStreamBlock::GetWritablePage(risse_size index)
+{
+	if(Pages[index].Shared)
+		ResizePage(index, GetPageAllocSize(index)); // 同じサイズでコピーを作る
+	return Pages[index].Data;
 }
 //---------------------------------------------------------------------------
 
@@ -244,18 +410,8 @@ risse_size tMemoryStreamInstance::get(const tOctet & buf)
 		if(!(Flags & tFileOpenModes::omReadBit))
 			tIOExceptionClass::Throw(RISSE_WS_TR("access denied (stream has no read-access)"));
 
-		if(CurrentPos >= Block->GetSize()) return 0; // can not read from there
-
-		risse_size read_size = buf.GetLength();
-
-		if(CurrentPos + read_size >= Block->GetSize())
-		{
-			read_size = Block->GetSize() - CurrentPos;
-		}
-
-		memcpy(const_cast<risse_uint8*>(buf.Pointer()),
-			static_cast<risse_uint8*>(Block->GetBlock()) + CurrentPos,
-			read_size);
+		risse_size read_size = Block->Read(CurrentPos,
+			const_cast<risse_uint8*>(buf.Pointer()), buf.GetLength());
 
 		CurrentPos += read_size;
 
@@ -280,17 +436,9 @@ risse_size tMemoryStreamInstance::put(const tOctet & buf)
 		// writing may increase the internal buffer size.
 		risse_size write_size = buf.GetLength();
 
-		risse_uint newpos = CurrentPos + write_size;
-		if(newpos >= Block->GetSize())
-		{
-			// exceeds Size
-			Block->ChangeSize(newpos);
-		}
-
-		memcpy(static_cast<risse_uint8*>(Block->GetBlock()) + CurrentPos,
-			buf.Pointer(), write_size);
+		Block->Write(CurrentPos, buf.Pointer(), write_size);
 
-		CurrentPos = newpos;
+		CurrentPos += write_size;
 
 		return write_size;
 	}
@@ -24,14 +24,34 @@ namespace Risa {
 /**
  * メモリストリームで用いられるメモリブロック
  * @note	このメモリブロックは、複数のストリームで共有される可能性があり、
- *			複数スレッドから同時アクセスされる可能性がある
+ *			複数スレッドから同時アクセスされる可能性がある。
+ *			内容は PAGE_SIZE バイトごとのページに分けて保持する。ファイルが
+ *			大きくなってもそれまでの内容がコピーされることはない。
+ *			最後のページのみ、必要に応じて PAGE_SIZE まで伸縮する。
+ *			Assign() でコピーされたメモリブロックはページを共有し、
+ *			どちらかに書き込みがあった時点でそのページだけがコピーされる
+ *			(copy-on-write)。
  */
 class tMemoryStreamBlock : public tDestructee
 {
+public:
+	static const risse_size PAGE_SIZE = 64*1024; //!< ページのサイズ
+
+private:
+	/**
+	 * ページ
+	 */
+	struct tPage
+	{
+		risse_uint8 * Data; //!< ページのデータ
+		bool Shared; //!< 他のメモリブロックと共有している可能性があるかどうか
+	};
+
 	tCriticalSection CS;	//!< このメモリブロックへのアクセスを保護するクリティカルセクション
-	void * Block;			//!< メモリブロック
+	gc_vector<tPage> Pages;	//!< ページの配列 (最後のページ以外は PAGE_SIZE バイト)
 	risse_size Size;		//!< メモリブロックのデータが入っている部分のサイズ
-	risse_size AllocSize;	//!< メモリブロックのアロケートしているサイズ( Size <= AllocSize )
+	risse_size LastPageAllocSize;	//!< 最後のページのアロケートしているサイズ
+	risse_uint8 * Flat;		//!< GetBlock() で作成した連続領域 (内容が変更されると破棄される)
 
 public:
 	/**
@@ -55,14 +75,71 @@ public:
 	void ChangeSize(risse_size);
 
 	/**
-	 * メモリブロックのサイズをSizeぴったりのサイズに変更する
+	 * 最後のページのサイズをぴったりのサイズに変更する
 	 */
 	void Fit();
 
-	void * GetBlock() { return Block; } //!< ブロックを得る
+	/**
+	 * 内容を読み込む
+	 * @param pos	読み込み開始位置
+	 * @param buf	読み込み先
+	 * @param size	読み込むサイズ
+	 * @return	実際に読み込まれたサイズ
+	 */
+	risse_size Read(risse_size pos, void * buf, risse_size size);
+
+	/**
+	 * 内容を書き込む
+	 * @param pos	書き込み開始位置 (GetSize() 以下であること)
+	 * @param buf	書き込むデータ
+	 * @param size	書き込むサイズ
+	 * @note	必要ならばサイズが拡張される
+	 */
+	void Write(risse_size pos, const void * buf, risse_size size);
+
+	/**
+	 * 他のメモリブロックの内容をコピーする
+	 * @param src	コピー元のメモリブロック
+	 * @note	内容はコピーされず、ページが共有される
+	 */
+	void Assign(tMemoryStreamBlock * src);
+
+	/**
+	 * 内容を連続したメモリ領域として得る
+	 * @return	メモリ領域 (サイズが 0 の場合は NULL)
+	 * @note	ページが複数ある場合は連結したコピーを作成して返す。
+	 *			返されたメモリ領域に書き込んではならない。また、内容が
+	 *			変更されると、返されたメモリ領域の内容は古いままになる。
+	 */
+	void * GetBlock();
 
 	tCriticalSection & GetCS( ) { return CS; } //!< クリティカルセクションオブジェクトを得る
 	risse_size GetSize() const { return Size; } //!< ブロックのサイズを得る
+
+private:
+	/**
+	 * ページのアロケートしているサイズを得る
+	 * @param index	ページのインデックス
+	 * @return	アロケートしているサイズ
+	 */
+	risse_size GetPageAllocSize(risse_size index) const
+		{ return index + 1 == Pages.size() ? LastPageAllocSize : PAGE_SIZE; }
+
+	/**
+	 * ページのアロケートサイズを変更する
+	 * @param index	ページのインデックス
+	 * @param alloc	新しいアロケートサイズ
+	 * @note	共有しているページの場合はコピーを作成する
+	 */
+	void ResizePage(risse_size index, risse_size alloc);
+
+	/**
+	 * 書き込み可能なページを得る
+	 * @param index	ページのインデックス
+	 * @return	ページのデータ
+	 * @note	共有しているページの場合はコピーを作成する
+	 */
+	risse_uint8 * GetWritablePage(risse_size index);
 };
 //---------------------------------------------------------------------------
 
@@ -168,7 +245,7 @@ public: // risse 用メソッドとか
 	void flush();
 
 	// non-tBinaryStream based methods
-	void * GetInternalBuffer()  const { return Block->GetBlock(); }
+	void * GetInternalBuffer()  const { return Block->GetBlock(); } //!< 内容を連続したメモリ領域として得る (tMemoryStreamBlock::GetBlock() を参照)
 };
 //---------------------------------------------------------------------------
 
@@ -124,9 +124,17 @@ tTmpFSNode::tTmpFSNode(tTmpFSNode *parent, tTmpFSNode::tType type,
 		blocksize = wxUINT64_SWAP_ON_BE(blocksize);
 		if(static_cast<size_t>(blocksize) != blocksize)
 				tIOExceptionClass::Throw(RISSE_WS_TR("too big block size"));
-		File->ChangeSize(static_cast<size_t>(blocksize));
+		// ページ単位で読み込む
+		risse_size size = static_cast<risse_size>(blocksize);
+		unsigned char * buf = new (PointerFreeGC) unsigned char [tMemoryStreamBlock::PAGE_SIZE];
+		for(risse_size pos = 0; pos < size; pos += tMemoryStreamBlock::PAGE_SIZE)
+		{
+			risse_size one = size - pos;
+			if(one > tMemoryStreamBlock::PAGE_SIZE) one = tMemoryStreamBlock::PAGE_SIZE;
+			src.ReadBuffer(buf, one);
+			File->Write(pos, buf, one);
+		}
 		File->Fit();
-		src.ReadBuffer(File->GetBlock(), static_cast<size_t>(blocksize));
 	}
 
 	// 親に自分を登録
@@ -178,7 +186,15 @@ void tTmpFSNode::Serialize(tStreamAdapter dest) const
 		volatile tCriticalSection::tLocker  holder(File->GetCS());
 		i64 = wxUINT64_SWAP_ON_BE(File->GetSize());
 		dest.WriteBuffer(&i64, sizeof(i64));
-		dest.WriteBuffer(File->GetBlock(), File->GetSize());
+
+		// ページ単位で書き出す
+		risse_size size = File->GetSize();
+		unsigned char * buf = new (PointerFreeGC) unsigned char [tMemoryStreamBlock::PAGE_SIZE];
+		for(risse_size pos = 0; pos < size; pos += tMemoryStreamBlock::PAGE_SIZE)
+		{
+			risse_size one = File->Read(pos, buf, tMemoryStreamBlock::PAGE_SIZE);
+			dest.WriteBuffer(buf, one);
+		}
 	}
 }
 //---------------------------------------------------------------------------
@@ -597,6 +613,37 @@ tStreamInstance * tTmpFSInstance::open(const tString & filename,
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+void tTmpFSInstance::copyFile(const tString & srcname, const tString & destname)
+{
+	volatile tSynchronizer sync(this); // sync
+
+	tTmpFSNode * src = GetNodeAt(srcname);
+	if(!src) tFileSystemManager::RaiseNoSuchFileOrDirectoryError();
+	if(!src->IsFile()) tIOExceptionClass::Throw(RISSE_WS_TR("specified name is not a file"));
+
+	tTmpFSNode * dest = GetNodeAt(destname);
+	if(!dest)
+	{
+		// コピー先が存在しなければ新規作成する
+		tString parentdir, name;
+		tFileSystemManager::SplitPathAndName(destname, &parentdir, &name); // パスを分離
+		tTmpFSNode * parentnode = GetNodeAt(parentdir);
+		if(!parentnode) tFileSystemManager::RaiseNoSuchFileOrDirectoryError();
+		dest = parentnode->CreateFile(name);
+		if(!dest) tIOExceptionClass::Throw(RISSE_WS_TR("failed to create file"));
+	}
+	else if(!dest->IsFile())
+	{
+		tIOExceptionClass::Throw(RISSE_WS_TR("specified name is not a file"));
+	}
+
+	// ページを共有する (どちらかに書き込まれた時点でそのページだけがコピーされる)
+	dest->GetMemoryStreamBlock()->Assign(src->GetMemoryStreamBlock());
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 void tTmpFSInstance::flush()
 {
@@ -642,6 +689,7 @@ RISSE_IMPL_CLASS_BEGIN(tTmpFSClass, (tSS<'T','m','p','F','S'>()),
 	BindFunction(this, tSS<'s','t','a','t'>(), &tTmpFSInstance::stat);
 	BindFunction(this, tSS<'o','p','e','n'>(), &tTmpFSInstance::open);
 	BindFunction(this, tSS<'f','l','u','s','h'>(), &tTmpFSInstance::flush);
+	BindFunction(this, tSS<'c','o','p','y','F','i','l','e'>(), &tTmpFSInstance::copyFile);
 
 	BindFunction(this, tSS<'s','a','v','e'>(), &tTmpFSInstance::save);
 	BindFunction(this, tSS<'l','o','a','d'>(), &tTmpFSInstance::load);
@@ -246,6 +246,16 @@ public: // Risse 用メソッドなど
 
 	//-- FileSystem メンバ ここまで
 
+	/**
+	 * ファイルをコピーする
+	 * @param srcname	コピー元のファイル名
+	 * @param destname	コピー先のファイル名 (存在しなければ作成される)
+	 * @note	内容はすぐにはコピーされず、コピー元とコピー先で共有される。
+	 *			どちらかに書き込みがあった時点で、書き込まれた部分のページだけが
+	 *			コピーされる。
+	 */
+	void copyFile(const tString & srcname, const tString & destname);
+
 	/**
 	 * 内容をファイルに保存する
 	 * @param filename	保存先のストリームまたはファイル名
@@ -14,6 +14,8 @@
 #include "base/fs/xp4fs/DecompressedHolder.h"
 #include "base/exception/RisaException.h"
 #include <zlib.h>
+#include <lz4.h>
+#include <zstd.h>
 
 
 namespace Risa {
@@ -71,18 +73,44 @@ void tDecompressedHolder::Decompress(tDecompressedHolder::tMethod method, const
 	delete (PointerFreeGC) [] Data, Data = NULL;
 	Size = 0;
 
-	// メソッドをチェック (現在はzlibのみ)
-	if(method != dhmZLib) ThrowInternalError;
-
 	// 出力メモリブロックを確保
 	Size = uncomp_size;
 	Data = new (PointerFreeGC) risse_uint8[uncomp_size];
 
 	// uncompress data
-	unsigned long destlen = Size;
-	int result = uncompress( (unsigned char*)Data, &destlen,
-			(unsigned char*)indata, insize);
-	if(result != Z_OK || destlen != Size)
+	bool ok = false;
+	switch(method)
+	{
+	case dhmZLib:
+		{
+			unsigned long destlen = Size;
+			int result = uncompress( (unsigned char*)Data, &destlen,
+					(unsigned char*)indata, insize);
+			ok = result == Z_OK && destlen == Size;
+		}
+		break;
+
+	case dhmLZ4:
+		{
+			int result = LZ4_decompress_safe(
+				reinterpret_cast<const char *>(indata), reinterpret_cast<char *>(Data),
+				static_cast<int>(insize), static_cast<int>(Size));
+			ok = result >= 0 && static_cast<risse_size>(result) == Size;
+		}
+		break;
+
+	case dhmZstd:
+		{
+			size_t result = ZSTD_decompress(Data, Size, indata, insize);
+			ok = !ZSTD_isError(result) && result == Size;
+		}
+		break;
+
+	default:
+		ThrowInternalError;
+	}
+
+	if(!ok)
 		eRisaException::Throw(RISSE_WS_TR("decompression failed, data may be corrupted"));
 }
 //---------------------------------------------------------------------------
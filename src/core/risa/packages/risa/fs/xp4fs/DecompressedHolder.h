@@ -35,7 +35,9 @@ private:
 public:
 	enum tMethod 
 	{
-		dhmZLib // zlib 圧縮
+		dhmZLib, // zlib 圧縮
+		dhmLZ4, // LZ4 圧縮
+		dhmZstd // Zstandard 圧縮
 	};
 
 	/**
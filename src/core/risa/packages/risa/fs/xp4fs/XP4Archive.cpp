@@ -215,6 +215,22 @@ tXP4Archive::tXP4Archive(const tString & filename, iMapCallback & callback)
 	// アーカイブファイルを読み込む
 	FileName = filename;
 
+	// アーカイブファイルをメモリにマップする
+	// マップできた場合、無圧縮のセグメントはマップから直接読み出され、
+	// 圧縮されたセグメントもマップから直接展開される。
+	// マップできない場合 (ファイルシステムが対応していない場合やアドレス空間が
+	// 足りない場合など) は、従来通りストリーム経由で読み出す。
+	Mapped = false;
+	try
+	{
+		Mapped = tFileSystemManager::instance()->Map(filename, Mapping);
+	}
+	catch(...)
+	{
+		Mapped = false;
+	}
+	if(Mapped && Mapping.GetLength() == 0) Mapped = false;
+
 	// アーカイブファイルを開く
 	std::auto_ptr<tBinaryStream>
 		stream(tFileSystemManager::instance()->CreateStream(filename, RISSE_BS_READ));
@@ -344,6 +360,25 @@ tXP4Archive::tXP4Archive(const tString & filename, iMapCallback & callback)
 
 	delete (PointerFreeGC) [] raw_index;
 	delete (PointerFreeGC) [] compressed_index;
+
+	// マップされている場合は、すべてのセグメントがマップの範囲内にあるかを
+	// 確認する。範囲外のセグメントがある (インデックスが壊れている、あるいは
+	// ファイルが切り詰められている) 場合は、マップからは読み出さずに
+	// ストリーム経由で読み出す。
+	if(Mapped)
+	{
+		risse_uint64 length = Mapping.GetLength();
+		for(gc_vector<tSegment>::const_iterator i = Segments.begin();
+			i != Segments.end(); i++)
+		{
+			if(i->StoreOffset > length || i->StoreSize > length - i->StoreOffset)
+			{
+				Mapped = false;
+				Mapping = tOctet();
+				break;
+			}
+		}
+	}
 }
 //---------------------------------------------------------------------------
 
@@ -62,6 +62,15 @@ public:
 		bool IsCompressed() const
 			{ return (Flags & RISA_XP4_SEGM_ENCODE_METHOD_MASK) !=
 				RISA_XP4_SEGM_ENCODE_RAW; } //!< セグメントが圧縮されている場合に真
+		tDecompressedHolder::tMethod GetMethod() const
+		{
+			switch(Flags & RISA_XP4_SEGM_ENCODE_METHOD_MASK)
+			{
+			case RISA_XP4_SEGM_ENCODE_LZ4:  return tDecompressedHolder::dhmLZ4;
+			case RISA_XP4_SEGM_ENCODE_ZSTD: return tDecompressedHolder::dhmZstd;
+			default:                        return tDecompressedHolder::dhmZLib;
+			}
+		} //!< 圧縮されたセグメントの展開方法を返す
 	};
 
 	/**
@@ -79,6 +88,8 @@ private:
 	gc_vector<tSegment> Segments; //!< セグメントの配列
 
 	tString FileName;
+	tOctet Mapping; //!< メモリにマップされたアーカイブファイル (マップできなかった場合やマップの範囲外を指すセグメントがある場合は空)
+	bool Mapped; //!< アーカイブファイルがメモリにマップされているかどうか
 
 public:
 	/**
@@ -119,6 +130,27 @@ public:
 		{ return &(Segments[Files[idx].SegmentStart]); } //!< idx に対応するセグメント情報を返す
 	const tString & GetFileName() const
 		{ return FileName; } //!< ファイル名を返す
+	bool GetMapped() const
+		{ return Mapped; } //!< アーカイブファイルがメモリにマップされているかどうかを返す
+	const risse_uint8 * GetMappedPointer() const
+		{ return Mapped ? Mapping.Pointer() : NULL; } //!< マップされたアーカイブファイルの先頭を返す (マップされていない場合は NULL)
+
+	/**
+	 * マップされたアーカイブファイルの一部を参照するオクテット列を得る
+	 * @param offset	アーカイブファイル中のオフセット
+	 * @param length	長さ
+	 * @param octet		オクテット列の格納先 (内容はコピーされず、マップを参照する)
+	 * @return	得られた場合に真 (マップされていないか、範囲がマップの外に
+	 *			はみ出す場合は偽)
+	 */
+	bool GetMappedOctet(risse_uint64 offset, risse_size length, tOctet & octet) const
+	{
+		if(!Mapped) return false;
+		risse_uint64 mapped_length = Mapping.GetLength();
+		if(offset > mapped_length || length > mapped_length - offset) return false;
+		octet = tOctet(Mapping, static_cast<risse_size>(offset), length);
+		return true;
+	}
 };
 //---------------------------------------------------------------------------
 
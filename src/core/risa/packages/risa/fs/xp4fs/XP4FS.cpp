@@ -142,6 +142,9 @@ tXP4FS::tXP4FS(const tString & name)
 
 	// FileItems をソート (後に二分検索を行うため)
 	std::sort(FileItems.begin(), FileItems.end());
+
+	// 名前検索用のハッシュ表を作成
+	BuildHashIndex();
 }
 //---------------------------------------------------------------------------
 
@@ -157,8 +160,6 @@ tXP4FS::~tXP4FS()
 size_t tXP4FS::GetFileListAt(const tString & dirname,
 	tFileSystemIterationCallback * callback)
 {
-	volatile tCriticalSection::tLocker holder(CS);
-
 	// dir_name の最後に '/' がついていなければ追加
 	tString dir_name(dirname);
 	if(!dir_name.EndsWith(RISSE_WC('/'))) dir_name += RISSE_WC('/');
@@ -205,8 +206,6 @@ size_t tXP4FS::GetFileListAt(const tString & dirname,
 //---------------------------------------------------------------------------
 bool tXP4FS::FileExists(const tString & filename)
 {
-	volatile tCriticalSection::tLocker holder(CS);
-
 	if(filename.EndsWith(RISSE_WC('/'))) return false; // ディレクトリは違う
 
 	return GetFileItemIndex(filename) != static_cast<risse_size>(-1);
@@ -217,8 +216,6 @@ bool tXP4FS::FileExists(const tString & filename)
 //---------------------------------------------------------------------------
 bool tXP4FS::DirectoryExists(const tString & dirname)
 {
-	volatile tCriticalSection::tLocker holder(CS);
-
 	// dir_name の最後に '/' がついていなければ追加
 	tString dir_name(dirname);
 	if(!dir_name.EndsWith(RISSE_WC('/'))) dir_name += RISSE_WC('/');
@@ -255,8 +252,6 @@ void tXP4FS::CreateDirectory(const tString & dirname, bool recursive)
 //---------------------------------------------------------------------------
 void tXP4FS::Stat(const tString & filename, tStatStruc & struc)
 {
-	volatile tCriticalSection::tLocker holder(CS);
-
 	risse_size idx = GetFileItemIndex(filename);
 	if(idx == static_cast<risse_size>(-1))
 		tFileSystemManager::RaiseNoSuchFileOrDirectoryError();
@@ -269,8 +264,6 @@ void tXP4FS::Stat(const tString & filename, tStatStruc & struc)
 //---------------------------------------------------------------------------
 tBinaryStream * tXP4FS::CreateStream(const tString & filename, risse_uint32 flags)
 {
-	volatile tCriticalSection::tLocker holder(CS);
-
 	risse_size idx = GetFileItemIndex(filename);
 	if(idx == static_cast<risse_size>(-1))
 		tFileSystemManager::RaiseNoSuchFileOrDirectoryError();
@@ -327,31 +320,45 @@ risse_size tXP4FS::GetFileItemStartIndex(const tString & name)
 //---------------------------------------------------------------------------
 risse_size tXP4FS::GetFileItemIndex(const tString & name)
 {
-	risse_size total_count = FileItems.size();
-	risse_size s = 0, e = total_count;
-	while(e - s > 1)
+	// HashIndex を線形探査する
+	// HashIndex はコンストラクタ以降書き換えられないのでロックは必要ない
+	risse_uint32 hash = name.GetHash();
+	risse_size mask = HashIndex.size() - 1;
+	for(risse_size pos = hash & mask; ; pos = (pos + 1) & mask)
 	{
-		risse_int m = (e + s) / 2;
-		if(!(FileItems[m].Name < name))
-		{
-			// m is after or at the target
-			e = m;
-		}
-		else
-		{
-			// m is before the target
-			s = m;
-		}
+		risse_size n = HashIndex[pos];
+		if(n == 0) return static_cast<risse_size>(-1); // 空きに到達した; 見つからなかった
+		const tFileItemInfo & item = FileItems[n - 1];
+		if(item.Hash == hash && item.Name == name) return n - 1;
 	}
+}
+//---------------------------------------------------------------------------
 
-	// at this point, s or s+1 should point the target.
-	// be certain.
-	if(s >= total_count) return static_cast<risse_size>(-1); // out of the index
-	if(FileItems[s].Name == name) return s;
-	s++;
-	if(s >= total_count) return static_cast<risse_size>(-1); // out of the index
-	if(FileItems[s].Name == name) return s;
-	return static_cast<risse_size>(-1);
+
+//---------------------------------------------------------------------------
+void tXP4FS::BuildHashIndex()
+{
+	// ハッシュ表のサイズは要素数の二倍以上の2の累乗とする
+	// (常に空きがあるので、検索は必ず空きに到達して終了する)
+	risse_size size = 16;
+	while(size < FileItems.size() * 2) size <<= 1;
+	HashIndex.assign(size, 0);
+
+	risse_size mask = size - 1;
+	for(risse_size i = 0; i < FileItems.size(); i++)
+	{
+		tFileItemInfo & item = FileItems[i];
+
+		// 名前を \0 終端させておく。c_str() は \0 終端していない文字列に対して
+		// バッファを作り直すため、複数のスレッドから同時に呼ばれると競合する。
+		// ここで終端させておけば、以降の c_str() はバッファを書き換えない。
+		item.Name.c_str();
+		item.Hash = item.Name.GetHash();
+
+		risse_size pos = item.Hash & mask;
+		while(HashIndex[pos]) pos = (pos + 1) & mask;
+		HashIndex[pos] = i + 1;
+	}
 }
 //---------------------------------------------------------------------------
 
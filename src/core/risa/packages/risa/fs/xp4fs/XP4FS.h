@@ -17,7 +17,6 @@
 #include <boost/shared_ptr.hpp>
 #include "base/fs/common/FSManager.h"
 #include "base/fs/xp4fs/XP4Archive.h"
-#include "base/utils/RisaThread.h"
 
 namespace Risa {
 //---------------------------------------------------------------------------
@@ -26,11 +25,13 @@ namespace Risa {
 //---------------------------------------------------------------------------
 /**
  * XP4FS の実装
+ * @note	ファイルの一覧はコンストラクタで作成した後は変更されないため、
+ *			各メソッドはロックを取らずに複数のスレッドから同時に呼ぶことができる。
+ *			名前の検索にはハッシュ表を、ディレクトリの走査には名前順に
+ *			ソートされた配列を用いる。
  */
 class tXP4FS : public tFileSystem
 {
-	tCriticalSection CS; //!< このファイルシステムを保護するクリティカルセクション
-
 	/**
 	 * ファイル一個一個の情報
 	 */
@@ -41,19 +42,21 @@ class tXP4FS : public tFileSystem
 	};
 
 	/**
-	 * 
+	 * 名前付きのファイルの情報
 	 */
 	struct tFileItemInfo : public tFileItemBasicInfo
 	{
 		tString Name; //!< 名前
+		risse_uint32 Hash; //!< 名前のハッシュ
 		tFileItemInfo(const tFileItemBasicInfo & info, const tString & name) :
-			tFileItemBasicInfo(info), Name(name) {;} //!< コンストラクタ
+			tFileItemBasicInfo(info), Name(name), Hash(0) {;} //!< コンストラクタ
 		bool operator < (const tFileItemInfo & rhs) const 
 			{ return Name < rhs.Name; } //!< 比較関数
 	};
 
 	gc_vector<boost::shared_ptr<tXP4Archive> > Archives; //!< アーカイブの配列
-	gc_vector<tFileItemInfo> FileItems; //! ファイルの情報の配列
+	gc_vector<tFileItemInfo> FileItems; //!< ファイルの情報の配列 (名前順にソート済み)
+	gc_vector<risse_size> HashIndex; //!< 名前のハッシュ表 (FileItems内のインデックス+1, 0=空き; 要素数は2の累乗)
 
 public:
 	/**
@@ -142,6 +145,11 @@ private:
 	 */
 	risse_size GetFileItemIndex(const tString & name);
 
+	/**
+	 * FileItems から HashIndex を作成する
+	 */
+	void BuildHashIndex();
+
 };
 //---------------------------------------------------------------------------
 
@@ -34,6 +34,19 @@ RISSE_DEFINE_SOURCE_ID(49735,29532,60918,17253,28305,59876,22175,55631);
 tXP4SegmentCache::tXP4SegmentCache()
 {
 	TotalBytes = 0;
+	TotalLimit = DEFAULT_TOTAL_LIMIT;
+	OneLimit = DEFAULT_ONE_LIMIT;
+	MaxReadAhead = DEFAULT_MAX_READ_AHEAD;
+
+	// 上限を設定情報から読み出す
+	tConfigData & config = tConfig::instance()->GetSystemConfig();
+	long limit;
+	if(config.Read(wxT("fs/xp4/segment_cache/total_limit"), &limit) && limit >= 0)
+		TotalLimit = static_cast<risse_size>(limit);
+	if(config.Read(wxT("fs/xp4/segment_cache/one_limit"), &limit) && limit >= 0)
+		OneLimit = static_cast<risse_size>(limit);
+	if(config.Read(wxT("fs/xp4/segment_cache/read_ahead"), &limit) && limit >= 0)
+		MaxReadAhead = static_cast<risse_size>(limit);
 }
 //---------------------------------------------------------------------------
 
@@ -46,27 +59,23 @@ tXP4SegmentCache::~tXP4SegmentCache()
 
 
 //---------------------------------------------------------------------------
-void tXP4SegmentCache::CheckLimit()
+void tXP4SegmentCache::SetLimits(risse_size total_limit, risse_size one_limit)
 {
-	volatile tCriticalSection::tLocker cs_holder(CS);
+	TotalLimit = total_limit;
+	OneLimit = one_limit;
 
-	// TotalBytes が TOTAL_LIMIT 以下になるまでキャッシュの最後
-	// を削除する
-	while(TotalBytes > TOTAL_LIMIT)
+	CheckLimit();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tXP4SegmentCache::CheckLimit()
+{
+	for(risse_size n = 0; n < SHARD_COUNT; n++)
 	{
-		// chop last segment
-		tHashTable::tIterator i;
-		i = HashTable.GetLast();
-		if(!i.IsNull())
-		{
-			risse_size size = i.GetValue()->GetSize();
-			TotalBytes -= size;
-			HashTable.ChopLast(1);
-		}
-		else
-		{
-			break;
-		}
+		volatile tCriticalSection::tLocker cs_holder(Shards[n].CS);
+		if(CheckShardLimit(Shards[n], 0)) break;
 	}
 }
 //---------------------------------------------------------------------------
@@ -75,10 +84,37 @@ void tXP4SegmentCache::CheckLimit()
 //---------------------------------------------------------------------------
 void tXP4SegmentCache::Clear()
 {
-	volatile tCriticalSection::tLocker cs_holder(CS);
+	for(risse_size n = 0; n < SHARD_COUNT; n++)
+	{
+		volatile tCriticalSection::tLocker cs_holder(Shards[n].CS);
+		Shards[n].HashTable.Clear();
+		AddTotalBytes(-static_cast<risse_ptrint>(Shards[n].TotalBytes));
+		Shards[n].TotalBytes = 0;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tXP4SegmentCache::GetStatistics(tStatistics & stat)
+{
+	stat.Hits = 0;
+	stat.Misses = 0;
+	stat.Evictions = 0;
+	stat.BytesHeld = 0;
+	stat.SegmentCount = 0;
+	stat.TotalLimit = TotalLimit;
+	stat.OneLimit = OneLimit;
 
-	HashTable.Clear();
-	TotalBytes = 0;
+	for(risse_size n = 0; n < SHARD_COUNT; n++)
+	{
+		volatile tCriticalSection::tLocker cs_holder(Shards[n].CS);
+		stat.Hits += Shards[n].Hits;
+		stat.Misses += Shards[n].Misses;
+		stat.Evictions += Shards[n].Evictions;
+		stat.BytesHeld += Shards[n].TotalBytes;
+		stat.SegmentCount += Shards[n].HashTable.GetCount();
+	}
 }
 //---------------------------------------------------------------------------
 
@@ -87,6 +123,7 @@ void tXP4SegmentCache::Clear()
 tXP4SegmentCache::tDataBlock
 	tXP4SegmentCache::Find(void * pointer, risse_size storage_index,
 		risse_size segment_index,
+		tDecompressedHolder::tMethod method,
 		tBinaryStream * instream, risse_uint64 dataofs, risse_size insize,
 		risse_size uncomp_size)
 {
@@ -98,39 +135,171 @@ tXP4SegmentCache::tDataBlock
 
 	// ハッシュを作成
 	risse_uint32 hash = tKeyHasher::Make(key);
-
-	// これ以降をスレッド保護
-	volatile tCriticalSection::tLocker cs_holder(CS);
+	tShard & shard = GetShard(hash);
 
 	// ハッシュテーブルを検索する
-	boost::shared_ptr<tDecompressedHolder> * ptr = 
-		HashTable.FindAndTouchWithHash(key, hash);
-	if(ptr)
-	{
-		// キャッシュ中にあった
-		return *ptr; // データブロックを返す
-	}
+	tDataBlock block;
+	if(Lookup(shard, key, hash, block)) return block; // キャッシュ中にあった
 
 	// キャッシュ中にない
+	// 展開には時間がかかるので、ほかのスレッドをブロックしないよう
+	// シャードのロックの外で行う
 	// 入力ストリームをシーク
 	instream->SetPosition(dataofs);
 
 	// データブロックを新たに作成
-	tDataBlock block(
+	block.reset(
 		new tDecompressedHolder(
-			tDecompressedHolder::dhmZLib,
+			method,
 			instream,
 			insize,
 			uncomp_size));
 
-	// ハッシュに入れる
-	HashTable.AddWithHash(key, hash, block);
+	// ハッシュに入れてデータブロックを返す
+	return Store(shard, key, hash, block);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tXP4SegmentCache::tDataBlock
+	tXP4SegmentCache::Find(void * pointer, risse_size storage_index,
+		risse_size segment_index,
+		tDecompressedHolder::tMethod method,
+		const risse_uint8 * indata, risse_size insize,
+		risse_size uncomp_size)
+{
+	// 検索キーを作る
+	tKey key;
+	key.Pointer = pointer;
+	key.StorageIndex = storage_index;
+	key.SegmentIndex = segment_index;
+
+	// ハッシュを作成
+	risse_uint32 hash = tKeyHasher::Make(key);
+	tShard & shard = GetShard(hash);
+
+	// ハッシュテーブルを検索する
+	tDataBlock block;
+	if(Lookup(shard, key, hash, block)) return block; // キャッシュ中にあった
+
+	// キャッシュ中にない
+	// メモリ上のデータから直接展開する (シャードのロックの外で行う)
+	block.reset(
+		new tDecompressedHolder(
+			method,
+			indata,
+			insize,
+			uncomp_size));
+
+	// ハッシュに入れてデータブロックを返す
+	return Store(shard, key, hash, block);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tXP4SegmentCache::Lookup(tShard & shard, const tKey & key, risse_uint32 hash,
+	tDataBlock & block)
+{
+	volatile tCriticalSection::tLocker cs_holder(shard.CS);
+
+	tDataBlock * ptr = shard.HashTable.FindAndTouchWithHash(key, hash);
+	if(ptr)
+	{
+		// キャッシュ中にあった
+		shard.Hits ++;
+		block = *ptr;
+		return true;
+	}
+	shard.Misses ++;
+	return false;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tXP4SegmentCache::tDataBlock
+	tXP4SegmentCache::Store(tShard & shard, const tKey & key, risse_uint32 hash,
+		const tDataBlock & block)
+{
+	// 大きすぎるセグメントはキャッシュしない
+	risse_size size = block->GetSize();
+	if(size > OneLimit || size > TotalLimit)
+		return block;
+
+	{
+		volatile tCriticalSection::tLocker cs_holder(shard.CS);
+
+		// 展開している間にほかのスレッドが同じセグメントを入れていたら
+		// そちらを使う
+		tDataBlock * ptr = shard.HashTable.FindAndTouchWithHash(key, hash);
+		if(ptr) return *ptr;
+
+		// ハッシュに入れる
+		shard.HashTable.AddWithHash(key, hash, block);
+		shard.TotalBytes += size;
+		AddTotalBytes(static_cast<risse_ptrint>(size));
+
+		// はみ出た分をまずこのシャードから削除する
+		// (いま入れたセグメントは残す)
+		if(CheckShardLimit(shard, 1)) return block;
+	}
+
+	// このシャードだけでは足りなかったので、ほかのシャードからも削除する
+	// (デッドロックを避けるため、このシャードのロックを解放してから行う)
+	CheckLimit();
 
-	// データブロックを返す
 	return block;
 }
 //---------------------------------------------------------------------------
 
+
+//---------------------------------------------------------------------------
+risse_size tXP4SegmentCache::AddTotalBytes(risse_ptrint delta)
+{
+	volatile tCriticalSection::tLocker cs_holder(TotalCS);
+
+	TotalBytes += delta;
+	return TotalBytes;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tXP4SegmentCache::GetTotalBytes()
+{
+	volatile tCriticalSection::tLocker cs_holder(TotalCS);
+
+	return TotalBytes;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tXP4SegmentCache::CheckShardLimit(tShard & shard, risse_size keep)
+{
+	// キャッシュ全体のトータルのバイト数が上限以下になるまでシャードの
+	// キャッシュの最後を削除する
+	while(GetTotalBytes() > TotalLimit)
+	{
+		if(shard.HashTable.GetCount() <= keep) return false;
+
+		// chop last segment
+		tHashTable::tIterator i;
+		i = shard.HashTable.GetLast();
+		if(i.IsNull()) return false;
+
+		risse_size size = i.GetValue()->GetSize();
+		shard.TotalBytes -= size;
+		AddTotalBytes(-static_cast<risse_ptrint>(size));
+		shard.HashTable.ChopLast(1);
+		shard.Evictions ++;
+	}
+	return true;
+}
+//---------------------------------------------------------------------------
+
 //---------------------------------------------------------------------------
 } // namespace Risa
 
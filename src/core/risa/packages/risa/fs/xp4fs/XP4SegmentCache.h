@@ -20,6 +20,7 @@
 #include "base/fs/xp4fs/DecompressedHolder.h"
 #include "base/utils/Singleton.h"
 #include "base/utils/RisaThread.h"
+#include "risa/common/ConfigData.h"
 
 namespace Risa {
 //---------------------------------------------------------------------------
@@ -28,14 +29,25 @@ namespace Risa {
 //---------------------------------------------------------------------------
 /**
  * セグメントキャッシュクラス
+ * @note	キャッシュはキーのハッシュにより SHARD_COUNT 個のシャードに分割され、
+ *			シャードごとにクリティカルセクションと LRU を持つ。そのため、異なる
+ *			シャードに属するセグメントへのアクセスは互いにブロックしない。
+ *			容量の上限はシャードごとではなくキャッシュ全体に対して適用され、
+ *			保持しているトータルのバイト数は TotalCS で保護される。上限を
+ *			超えた場合は、まずセグメントを入れたシャードの LRU の末尾から削除する。
+ *			容量の上限は設定情報 (System realm) の
+ *			fs/xp4/segment_cache/total_limit と fs/xp4/segment_cache/one_limit
+ *			(いずれもバイト数) から読み込まれ、SetLimits() で変更できる。
+ *			tXP4ArchiveStream による先読みの最大セグメント数も同様に
+ *			fs/xp4/segment_cache/read_ahead から読み込まれ、SetMaxReadAhead() で
+ *			変更できる。
  */
-class tXP4SegmentCache : public singleton_base<tXP4SegmentCache>
+class tXP4SegmentCache : public singleton_base<tXP4SegmentCache>, protected depends_on<tConfig>
 {
-	static const risse_size ONE_LIMIT = 1024*1024; //!< これを超えるセグメントはキャッシュしない
-	static const risse_size TOTAL_LIMIT = 1024*1024; //!< トータルでこれ以上はキャッシュしない
-
-	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
-	risse_size TotalBytes; //!< このクラスが保持しているトータルのバイト数
+	static const risse_size SHARD_COUNT = 16; //!< シャードの数 (2の累乗であること)
+	static const risse_size DEFAULT_ONE_LIMIT = 4*1024*1024; //!< デフォルトの ONE_LIMIT (これを超えるセグメントはキャッシュしない)
+	static const risse_size DEFAULT_TOTAL_LIMIT = 32*1024*1024; //!< デフォルトの TOTAL_LIMIT (トータルでこれ以上はキャッシュしない)
+	static const risse_size DEFAULT_MAX_READ_AHEAD = 8; //!< デフォルトの先読みの最大セグメント数
 
 	/**
 	 * キャッシュアイテムのkeyとなる構造体
@@ -71,10 +83,54 @@ class tXP4SegmentCache : public singleton_base<tXP4SegmentCache>
 public:
 	typedef boost::shared_ptr<tDecompressedHolder> tDataBlock; //!< キャッシュアイテムのvalueのtypedef
 
+	/**
+	 * キャッシュの統計情報
+	 */
+	struct tStatistics
+	{
+		risse_uint64 Hits; //!< キャッシュ中に見つかった回数
+		risse_uint64 Misses; //!< キャッシュ中に見つからなかった回数
+		risse_uint64 Evictions; //!< 容量の上限のために追い出されたセグメントの数
+		risse_size BytesHeld; //!< 保持しているトータルのバイト数
+		risse_size SegmentCount; //!< 保持しているセグメントの数
+		risse_size TotalLimit; //!< トータルの上限 (バイト数)
+		risse_size OneLimit; //!< 一つのセグメントの上限 (バイト数)
+
+		/**
+		 * ヒット率を得る
+		 * @return	ヒット率 (0.0～1.0; 一度も検索されていなければ 0.0)
+		 */
+		double GetHitRate() const
+		{
+			risse_uint64 total = Hits + Misses;
+			return total ? static_cast<double>(Hits) / static_cast<double>(total) : 0.0;
+		}
+	};
+
 private:
 	typedef tHashTable<tKey, tDataBlock, tKeyHasher> tHashTable; //!< ハッシュテーブルのtypedef
 
-	tHashTable HashTable; //!< ハッシュテーブル
+	/**
+	 * シャード
+	 */
+	struct tShard
+	{
+		tCriticalSection CS; //!< このシャードを保護するクリティカルセクション
+		tHashTable HashTable; //!< ハッシュテーブル (LRU順に並ぶ)
+		risse_size TotalBytes; //!< このシャードが保持しているバイト数
+		risse_uint64 Hits; //!< キャッシュ中に見つかった回数
+		risse_uint64 Misses; //!< キャッシュ中に見つからなかった回数
+		risse_uint64 Evictions; //!< 容量の上限のために追い出されたセグメントの数
+
+		tShard() : TotalBytes(0), Hits(0), Misses(0), Evictions(0) {;}
+	};
+
+	tShard Shards[SHARD_COUNT]; //!< シャードの配列
+	tCriticalSection TotalCS; //!< TotalBytes を保護するクリティカルセクション (シャードのロックを持ったまま取ってよい)
+	risse_size TotalBytes; //!< キャッシュ全体で保持しているトータルのバイト数
+	volatile risse_size TotalLimit; //!< トータルの上限 (バイト数)
+	volatile risse_size OneLimit; //!< 一つのセグメントの上限 (バイト数)
+	volatile risse_size MaxReadAhead; //!< 先読みの最大セグメント数 (0=先読みしない)
 
 public:
 	/**
@@ -88,6 +144,38 @@ public:
 	~tXP4SegmentCache();
 
 public:
+	/**
+	 * 容量の上限を設定する
+	 * @param total_limit	トータルの上限 (バイト数)
+	 * @param one_limit		一つのセグメントの上限 (バイト数; これを超えるセグメントはキャッシュしない)
+	 * @note	上限が小さくなった場合ははみ出た分がただちに削除される
+	 */
+	void SetLimits(risse_size total_limit, risse_size one_limit);
+
+	/**
+	 * トータルの上限を得る
+	 * @return	トータルの上限 (バイト数)
+	 */
+	risse_size GetTotalLimit() const { return TotalLimit; }
+
+	/**
+	 * 一つのセグメントの上限を得る
+	 * @return	一つのセグメントの上限 (バイト数)
+	 */
+	risse_size GetOneLimit() const { return OneLimit; }
+
+	/**
+	 * 先読みの最大セグメント数を設定する
+	 * @param n	先読みの最大セグメント数 (0=先読みしない)
+	 */
+	void SetMaxReadAhead(risse_size n) { MaxReadAhead = n; }
+
+	/**
+	 * 先読みの最大セグメント数を得る
+	 * @return	先読みの最大セグメント数 (0=先読みしない)
+	 */
+	risse_size GetMaxReadAhead() const { return MaxReadAhead; }
+
 	/**
 	 * キャッシュの上限に達していないかどうかをチェックし、はみ出た分を削除
 	 */
@@ -95,24 +183,110 @@ public:
 
 	/**
 	 * キャッシュをすべてクリアする
+	 * @note	統計情報のうち回数はクリアされない
 	 */
 	void Clear();
 
+	/**
+	 * 統計情報を得る
+	 * @param stat	統計情報の格納先
+	 */
+	void GetStatistics(tStatistics & stat);
+
 	/**
 	 * キャッシュを検索する(無ければアイテムを作成して返す)
 	 * @param pointer		アーカイブインスタンスへのポインタ
 	 * @param storage_index	storage index in archive
 	 * @param segment_index	segment index in storage
+	 * @param method		圧縮メソッド
 	 * @param instream		キャッシュ中に無かった場合に読みに行くストリーム
 	 * @param dataofs		キャッシュ中に無かった場合に読みに行くストリーム中のデータブロックのオフセット
 	 * @param insize		キャッシュ中に無かった場合に読みに行くバイト数
 	 * @param uncomp_size	キャッシュ中に無かった場合に読みに行ったデータを展開したら何バイトになるか
 	 * @return	展開されたデータブロック
+	 * @note	どのスレッドから呼んでもよい。展開はシャードのロックの外で行われる。
+	 *			instream は呼び出し側で保護すること。
 	 */
 	tDataBlock
 		Find(void * pointer, risse_size storage_index, risse_size segment_index,
+			tDecompressedHolder::tMethod method,
 			tBinaryStream * instream, risse_uint64 dataofs, risse_size insize,
 			risse_size uncomp_size);
+
+	/**
+	 * キャッシュを検索する(無ければメモリ上のデータを展開してアイテムを作成して返す)
+	 * @param pointer		アーカイブインスタンスへのポインタ
+	 * @param storage_index	storage index in archive
+	 * @param segment_index	segment index in storage
+	 * @param method		圧縮メソッド
+	 * @param indata		キャッシュ中に無かった場合に展開する圧縮データ (マップされたアーカイブなど)
+	 * @param insize		圧縮データのバイト数
+	 * @param uncomp_size	圧縮データを展開したら何バイトになるか
+	 * @return	展開されたデータブロック
+	 * @note	どのスレッドから呼んでもよい。展開はシャードのロックの外で行われる。
+	 */
+	tDataBlock
+		Find(void * pointer, risse_size storage_index, risse_size segment_index,
+			tDecompressedHolder::tMethod method,
+			const risse_uint8 * indata, risse_size insize,
+			risse_size uncomp_size);
+
+private:
+	/**
+	 * キャッシュを検索する
+	 * @param shard	シャード
+	 * @param key	キー
+	 * @param hash	キーのハッシュ
+	 * @param block	見つかったデータブロックの格納先
+	 * @return	見つかった場合に真
+	 */
+	bool Lookup(tShard & shard, const tKey & key, risse_uint32 hash, tDataBlock & block);
+
+	/**
+	 * 展開したデータブロックをキャッシュに入れる
+	 * @param shard	シャード
+	 * @param key	キー
+	 * @param hash	キーのハッシュ
+	 * @param block	データブロック
+	 * @return	キャッシュ中のデータブロック (展開している間にほかのスレッドが
+	 *			同じセグメントを入れていた場合はそちら)
+	 */
+	tDataBlock Store(tShard & shard, const tKey & key, risse_uint32 hash, const tDataBlock & block);
+
+	/**
+	 * ハッシュからシャードを得る
+	 * @param hash	キーのハッシュ
+	 * @return	シャード
+	 */
+	tShard & GetShard(risse_uint32 hash)
+	{
+		// tKeyHasher のハッシュは下位ビットに偏りがあるので上位ビットも混ぜる
+		hash ^= hash >> 16;
+		hash ^= hash >> 8;
+		return Shards[hash & (SHARD_COUNT - 1)];
+	}
+
+	/**
+	 * キャッシュ全体で保持しているトータルのバイト数を増減する
+	 * @param delta	増減するバイト数
+	 * @return	増減後のトータルのバイト数
+	 */
+	risse_size AddTotalBytes(risse_ptrint delta);
+
+	/**
+	 * キャッシュ全体で保持しているトータルのバイト数を得る
+	 * @return	トータルのバイト数
+	 */
+	risse_size GetTotalBytes();
+
+	/**
+	 * キャッシュ全体が上限に達していないかどうかをチェックし、はみ出た分を
+	 * シャードの LRU の末尾から削除
+	 * @param shard	シャード (呼び出し側でロックしておくこと)
+	 * @param keep	削除せずに残すセグメントの数 (LRU の先頭から数えて)
+	 * @return	上限以下になった場合に真
+	 */
+	bool CheckShardLimit(tShard & shard, risse_size keep);
 };
 //---------------------------------------------------------------------------
 
@@ -24,6 +24,82 @@ RISSE_DEFINE_SOURCE_ID(9282,1527,60023,18507,43687,60046,2141,35691);
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+/**
+ * セグメントを先読みしてセグメントキャッシュに展開するタスク
+ * @note	このタスクは GC の管理下にありデストラクタが呼ばれないので、
+ *			展開したデータブロックは保持しない (キャッシュに入れるだけ)。
+ */
+class tXP4ReadAheadTask : public tTask
+{
+	boost::shared_ptr<tXP4Archive> Owner; //!< アーカイブ
+	risse_size FileIndex; //!< アーカイブ中でのインデックス
+	risse_size SegmentIndex; //!< セグメント番号
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param owner		アーカイブ
+	 * @param file_index	アーカイブ中でのインデックス
+	 * @param segment_index	セグメント番号
+	 */
+	tXP4ReadAheadTask(boost::shared_ptr<tXP4Archive> owner,
+		risse_size file_index, risse_size segment_index) :
+		Owner(owner), FileIndex(file_index), SegmentIndex(segment_index) {;}
+
+	risse_size GetSegmentIndex() const { return SegmentIndex; } //!< セグメント番号を得る
+
+protected:
+	/**
+	 * タスクの処理
+	 */
+	void Execute()
+	{
+		const tXP4Archive::tSegment & seg = Owner->GetSegmentInfo(FileIndex)[SegmentIndex];
+		const risse_uint8 * mapped = Owner->GetMappedPointer();
+		try
+		{
+			if(mapped)
+			{
+				tXP4SegmentCache::instance()->Find(
+					Owner.get(), FileIndex, SegmentIndex, seg.GetMethod(),
+					mapped + seg.StoreOffset,
+					static_cast<risse_size>(seg.StoreSize),
+					static_cast<risse_size>(seg.Size));
+			}
+			else
+			{
+				// 読み込み中のストリームとは別のストリームを使う
+				tBinaryStream * stream = tXP4StreamCache::instance()->GetStream(
+					Owner.get(), Owner->GetFileName());
+				try
+				{
+					tXP4SegmentCache::instance()->Find(
+						Owner.get(), FileIndex, SegmentIndex, seg.GetMethod(),
+						stream, seg.StoreOffset, seg.StoreSize, seg.Size);
+				}
+				catch(...)
+				{
+					tXP4StreamCache::instance()->ReleaseStream(Owner.get(), stream);
+					throw;
+				}
+				tXP4StreamCache::instance()->ReleaseStream(Owner.get(), stream);
+			}
+		}
+		catch(...)
+		{
+			// 先読みに失敗しても何もしない。実際にそのセグメントを読む際に
+			// もう一度展開が試みられ、そこで例外が報告される。
+		}
+
+		// このタスク自身は GC の管理下にありデストラクタが呼ばれないので、
+		// アーカイブへの参照はここで手放す
+		Owner.reset();
+	}
+};
+//---------------------------------------------------------------------------
+
+
 
 //---------------------------------------------------------------------------
 tXP4ArchiveStream::tXP4ArchiveStream(
@@ -39,8 +115,13 @@ tXP4ArchiveStream::tXP4ArchiveStream(
 	CurPos = 0;
 	SegmentRemain = 0;
 	SegmentPos = 0;
+	ReadAheadWindow = 0;
+	ReadAheadNext = 1;
 
-	Stream = depends_on<tXP4StreamCache>::locked_instance()->GetStream(Owner.get(), ptr->GetFileName());
+	// アーカイブがマップされている場合はストリームは使わない
+	MappedData = ptr->GetMappedPointer();
+	Stream = MappedData ? NULL :
+		depends_on<tXP4StreamCache>::locked_instance()->GetStream(Owner.get(), ptr->GetFileName());
 }
 //---------------------------------------------------------------------------
 
@@ -50,7 +131,8 @@ tXP4ArchiveStream::~tXP4ArchiveStream()
 {
 	volatile tCriticalSection::tLocker holder(CS);
 
-	depends_on<tXP4StreamCache>::locked_instance()->ReleaseStream(Owner.get(), Stream);
+	if(Stream)
+		depends_on<tXP4StreamCache>::locked_instance()->ReleaseStream(Owner.get(), Stream);
 }
 //---------------------------------------------------------------------------
 
@@ -65,8 +147,8 @@ void tXP4ArchiveStream::EnsureSegment()
 	if(LastOpenedSegmentNum == CurSegmentNum)
 	{
 		// セグメントが圧縮されていない場合はストリームをシークして返る
-		if(!SegmentInfo[CurSegmentNum].IsCompressed())
-			Stream->SetPosition(SegmentInfo[CurSegmentNum].StoreSize + SegmentPos);
+		if(!SegmentInfo[CurSegmentNum].IsCompressed() && Stream)
+			Stream->SetPosition(SegmentInfo[CurSegmentNum].StoreOffset + SegmentPos);
 		return;
 	}
 
@@ -74,21 +156,41 @@ void tXP4ArchiveStream::EnsureSegment()
 	if(SegmentInfo[CurSegmentNum].IsCompressed())
 	{
 		// a compressed segment
-		// セグメントキャッシュの中から探す
-		DecompressedData = depends_on<tXP4SegmentCache>::locked_instance()->Find(
-			Owner.get(), FileIndex, CurSegmentNum,
-			Stream, SegmentInfo[CurSegmentNum].StoreOffset,
-			SegmentInfo[CurSegmentNum].StoreSize,
-			SegmentInfo[CurSegmentNum].Size);
+		// 先読み中であればその完了を待つ (展開されたデータはセグメント
+		// キャッシュに入っている)。その後セグメントキャッシュの中から探す
+		// (キャッシュは内部でシャードごとに保護されているのでロックは取らない)
+		// キャッシュ中に無ければ (先読みしていないか、追い出されたか、先読みに
+		// 失敗した場合)、アーカイブがマップされている場合はマップから直接展開する
+		WaitReadAhead();
+		if(MappedData)
+			DecompressedData = tXP4SegmentCache::instance()->Find(
+				Owner.get(), FileIndex, CurSegmentNum,
+				SegmentInfo[CurSegmentNum].GetMethod(),
+				MappedData + SegmentInfo[CurSegmentNum].StoreOffset,
+				static_cast<risse_size>(SegmentInfo[CurSegmentNum].StoreSize),
+				static_cast<risse_size>(SegmentInfo[CurSegmentNum].Size));
+		else
+			DecompressedData = tXP4SegmentCache::instance()->Find(
+				Owner.get(), FileIndex, CurSegmentNum,
+				SegmentInfo[CurSegmentNum].GetMethod(),
+				Stream, SegmentInfo[CurSegmentNum].StoreOffset,
+				SegmentInfo[CurSegmentNum].StoreSize,
+				SegmentInfo[CurSegmentNum].Size);
 	}
 	else
 	{
 		// not a compressed segment
-		Stream->SetPosition(SegmentInfo[CurSegmentNum].StoreSize + SegmentPos);
+		// アーカイブがマップされている場合は Read() がマップから直接読むので
+		// シークの必要はない
+		if(Stream)
+			Stream->SetPosition(SegmentInfo[CurSegmentNum].StoreOffset + SegmentPos);
 	}
 
 	SegmentOpened = true;
 	LastOpenedSegmentNum = CurSegmentNum;
+
+	// 続くセグメントを先読みする
+	ReadAhead();
 }
 //---------------------------------------------------------------------------
 
@@ -115,6 +217,10 @@ void tXP4ArchiveStream::SeekToPosition(risse_uint64 pos)
 			st = m;
 	}
 
+	// 次のセグメント以外に移動する場合はランダムアクセスとみなす
+	if(seg_num != CurSegmentNum && seg_num != CurSegmentNum + 1)
+		ResetReadAhead(seg_num);
+
 	CurSegmentNum = seg_num;
 	SegmentOpened = false;
 
@@ -129,9 +235,15 @@ void tXP4ArchiveStream::SeekToPosition(risse_uint64 pos)
 bool tXP4ArchiveStream::OpenNextSegment()
 {
 	// open next segment
-	if(CurSegmentNum == FileInfo.SegmentCount)
+	if(CurSegmentNum + 1 >= FileInfo.SegmentCount)
 		return false; // no more segments
 	CurSegmentNum ++;
+
+	// 順次アクセスが続いているので先読みするセグメント数を増やす
+	risse_size max_window = tXP4SegmentCache::instance()->GetMaxReadAhead();
+	ReadAheadWindow = ReadAheadWindow ? ReadAheadWindow * 2 : 1;
+	if(ReadAheadWindow > max_window) ReadAheadWindow = max_window;
+
 	SegmentOpened = false;
 	SegmentPos = 0;
 	SegmentRemain = SegmentInfo[CurSegmentNum].Size;
@@ -142,6 +254,72 @@ bool tXP4ArchiveStream::OpenNextSegment()
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+void tXP4ArchiveStream::ReadAhead()
+{
+	if(ReadAheadWindow == 0) return;
+
+	// 先読みしたセグメントがキャッシュから追い出されないよう、
+	// 先読みするバイト数はキャッシュの上限の 1/4 までとする
+	tXP4SegmentCache * cache = tXP4SegmentCache::instance();
+	risse_uint64 budget = cache->GetTotalLimit() / 4;
+	risse_uint64 bytes = 0;
+
+	risse_size end = CurSegmentNum + 1 + ReadAheadWindow;
+	if(end > FileInfo.SegmentCount) end = FileInfo.SegmentCount;
+	risse_size seg = ReadAheadNext > CurSegmentNum ? ReadAheadNext : CurSegmentNum + 1;
+
+	// 先読み済みのセグメントの分も予算に含める
+	for(gc_deque<tXP4ReadAheadTask *>::iterator i = ReadAheadTasks.begin();
+		i != ReadAheadTasks.end(); i++)
+		bytes += SegmentInfo[(*i)->GetSegmentIndex()].Size;
+
+	for(; seg < end; seg++)
+	{
+		if(!SegmentInfo[seg].IsCompressed()) continue; // 無圧縮のセグメントは先読みしない
+		if(SegmentInfo[seg].Size > cache->GetOneLimit()) continue; // キャッシュされないセグメントも先読みしない
+		if(bytes + SegmentInfo[seg].Size > budget) break;
+		bytes += SegmentInfo[seg].Size;
+
+		tXP4ReadAheadTask * task = new tXP4ReadAheadTask(Owner, FileIndex, seg);
+		ReadAheadTasks.push_back(task);
+		tTaskPool::GetInstance().Submit(task);
+	}
+	if(seg > ReadAheadNext) ReadAheadNext = seg;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tXP4ArchiveStream::WaitReadAhead()
+{
+	// 現在のセグメントより前のタスクはもう必要ない
+	while(!ReadAheadTasks.empty() &&
+		ReadAheadTasks.front()->GetSegmentIndex() < CurSegmentNum)
+		ReadAheadTasks.pop_front();
+
+	if(ReadAheadTasks.empty() ||
+		ReadAheadTasks.front()->GetSegmentIndex() != CurSegmentNum) return;
+
+	// 完了を待つ (ワーカースレッド上では、Wait() は待っている間にほかのタスクも実行する)
+	tXP4ReadAheadTask * task = ReadAheadTasks.front();
+	ReadAheadTasks.pop_front();
+	tTaskPool::GetInstance().Wait(task);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tXP4ArchiveStream::ResetReadAhead(risse_size seg_num)
+{
+	// 要求済みのタスクは放っておく (完了すればキャッシュに入るだけ)
+	ReadAheadTasks.clear();
+	ReadAheadWindow = 0;
+	ReadAheadNext = seg_num + 1;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 risse_uint64 tXP4ArchiveStream::Seek(risse_int64 offset, risse_int whence)
 {
@@ -205,6 +383,13 @@ risse_uint tXP4ArchiveStream::Read(void *buffer, risse_size read_size)
 			memcpy((risse_uint8*)buffer + write_size,
 				DecompressedData->GetData() + static_cast<risse_size>(SegmentPos), one_size);
 		}
+		else if(MappedData)
+		{
+			// read directly from mapped archive
+			memcpy((risse_uint8*)buffer + write_size,
+				MappedData + SegmentInfo[CurSegmentNum].StoreOffset +
+					static_cast<risse_size>(SegmentPos), one_size);
+		}
 		else
 		{
 			// read directly from stream
@@ -224,6 +409,42 @@ risse_uint tXP4ArchiveStream::Read(void *buffer, risse_size read_size)
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+tOctet tXP4ArchiveStream::ReadOctet(risse_size read_size)
+{
+	{
+		volatile tCriticalSection::tLocker holder(CS);
+
+		// マップされた無圧縮セグメントの中に収まっていれば、マップを直接参照する
+		// (セグメントの格納範囲とマップの範囲の両方に収まっていることを確認する)
+		if(MappedData && CurSegmentNum < FileInfo.SegmentCount &&
+			!SegmentInfo[CurSegmentNum].IsCompressed() &&
+			read_size <= SegmentRemain &&
+			SegmentPos + read_size <= SegmentInfo[CurSegmentNum].StoreSize)
+		{
+			tOctet octet;
+			if(Owner->GetMappedOctet(
+				SegmentInfo[CurSegmentNum].StoreOffset + SegmentPos, read_size, octet))
+			{
+				EnsureSegment();
+				SegmentPos += read_size;
+				CurPos += read_size;
+				SegmentRemain -= read_size;
+				return octet;
+			}
+		}
+	}
+
+	// そうでなければコピーする
+	risse_uint8 * buf = new (PointerFreeGC) risse_uint8[read_size];
+	risse_size size = Read(buf, read_size);
+	tOctet octet(buf, size);
+	delete (PointerFreeGC) [] buf;
+	return octet;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 risse_uint tXP4ArchiveStream::Write(const void *buffer, risse_size write_size)
 {
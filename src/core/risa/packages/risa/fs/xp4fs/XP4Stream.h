@@ -18,9 +18,11 @@
 #include "base/fs/xp4fs/XP4FS.h"
 #include "base/fs/xp4fs/XP4SegmentCache.h"
 #include "base/utils/RisaThread.h"
+#include "risseTaskPool.h"
 
 
 namespace Risa {
+class tXP4ReadAheadTask;
 //---------------------------------------------------------------------------
 
 //---------------------------------------------------------------------------
@@ -38,7 +40,8 @@ class tXP4ArchiveStream : public tBinaryStream,
 	const tXP4Archive::tFile & FileInfo; //!< ファイル情報
 	const tXP4Archive::tSegment * SegmentInfo; //!< セグメント情報
 
-	tBinaryStream * Stream; //!< 内容にアクセスするためのバイナリストリーム
+	tBinaryStream * Stream; //!< 内容にアクセスするためのバイナリストリーム (アーカイブがマップされている場合は NULL)
+	const risse_uint8 * MappedData; //!< マップされたアーカイブファイルの先頭 (マップされていない場合は NULL)
 	risse_size CurSegmentNum; //!< 現在のファイルポインタのあるセグメント番号(0～)
 	risse_size LastOpenedSegmentNum; //!< 最後に開いていたセグメント番号(0～)
 	bool SegmentOpened; //!< セグメントが開かれているかどうか
@@ -47,6 +50,10 @@ class tXP4ArchiveStream : public tBinaryStream,
 	risse_uint64 SegmentPos; //!< offset from current segment's start
 	tXP4SegmentCache::tDataBlock DecompressedData; // decompressed segment data
 
+	risse_size ReadAheadWindow; //!< 先読みするセグメント数 (順次アクセスが続くと増え、ランダムアクセスで 0 に戻る)
+	risse_size ReadAheadNext; //!< 次に先読みを要求するセグメント番号
+	gc_deque<tXP4ReadAheadTask *> ReadAheadTasks; //!< 先読みを要求したタスク (セグメント番号順)
+
 public:
 	/**
 	 * コンストラクタ
@@ -81,6 +88,26 @@ private:
 	 */
 	bool OpenNextSegment();
 
+	/**
+	 * 現在のセグメントに続くセグメントの先読みを要求する
+	 * @note	先読みは圧縮されたセグメントのみが対象で、タスクプール上で
+	 *			セグメントキャッシュに展開される
+	 */
+	void ReadAhead();
+
+	/**
+	 * 現在のセグメントの先読みが要求されていればその完了を待つ
+	 * @note	先読みにより展開されたデータはセグメントキャッシュに入るので、
+	 *			呼び出し側は待った後にセグメントキャッシュから得ること
+	 */
+	void WaitReadAhead();
+
+	/**
+	 * 先読みをリセットする (ランダムアクセスを検出した場合)
+	 * @param seg_num	新しいセグメント番号
+	 */
+	void ResetReadAhead(risse_size seg_num);
+
 public:
 	/**
 	 * シーク
@@ -98,6 +125,16 @@ public:
 	 */
 	risse_size Read(void *buffer, risse_size read_size);
 
+	/**
+	 * 読み込み (オクテット列として)
+	 * @param read_size	読み込むバイト数
+	 * @return	読み込まれたオクテット列
+	 * @note	アーカイブがマップされていて、読み込む範囲が一つの無圧縮セグメントに
+	 *			収まっている場合は、内容をコピーせずにマップを直接参照する
+	 *			オクテット列を返す。そうでない場合は Read() で読み込む。
+	 */
+	tOctet ReadOctet(risse_size read_size);
+
 	/**
 	 * 書き込み
 	 * @param buffer	書き込むバッファ
@@ -0,0 +1,517 @@
+//---------------------------------------------------------------------------
+/*
+	Risa [りさ]      alias 吉里吉里3 [kirikiri-3]
+	 stands for "Risa Is a Stagecraft Architecture"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief ガーベジコレクタの制御と統計
+//---------------------------------------------------------------------------
+#include "risa/prec.h"
+#include "risa/packages/risa/gc/GCControl.h"
+#include "risa/common/RisseEngine.h"
+
+#include "risseGC.h"
+#include "risseExceptionClass.h"
+
+
+namespace Risa {
+RISSE_DEFINE_SOURCE_ID(47126,3381,18710,20468,59114,37026,11957,50219);
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tGCController::tGCController() : History(DefaultHistorySize)
+{
+	Incremental = false;
+	HeapProfile = false;
+	FrameBudget = DefaultFrameBudget;
+	LastGCNo = GC_gc_no;
+	TotalPause = 0;
+	MaxPause = 0;
+	ScannedBytes = 0;
+	AtomicBytes = 0;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::SetIncremental(bool b)
+{
+	volatile tCriticalSection::tLocker lock(CS);
+
+	if(Incremental == b) return;
+	Incremental = b;
+
+	if(Incremental)
+	{
+		// インクリメンタルモードを有効にする
+		// (一度有効にすると無効にはできないが、二度呼んでも問題はない)
+		GC_enable_incremental();
+
+		// 一回のスライスで GC が費やす時間の目安を設定する (ミリ秒単位)
+		GC_time_limit = (long)(FrameBudget / 1000);
+		if(GC_time_limit < 1) GC_time_limit = 1;
+	}
+
+	UpdateReceiveIdle();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::SetHeapProfile(bool b)
+{
+#ifdef RISSE_HEAP_PROFILE
+	volatile tCriticalSection::tLocker lock(CS);
+
+	if(HeapProfile == b) return;
+	HeapProfile = b;
+
+	if(HeapProfile)
+	{
+		tHeapProfiler::SetListener(this);
+		tHeapProfiler::Enable();
+	}
+	else
+	{
+		tHeapProfiler::Disable();
+		tHeapProfiler::SetListener(NULL);
+	}
+
+	UpdateReceiveIdle();
+#else
+	if(b)
+		tUnsupportedOperationExceptionClass::ThrowOperationIsNotImplemented();
+#endif
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::SetFrameBudget(risse_uint64 budget)
+{
+	volatile tCriticalSection::tLocker lock(CS);
+
+	FrameBudget = budget;
+	if(Incremental)
+	{
+		GC_time_limit = (long)(FrameBudget / 1000);
+		if(GC_time_limit < 1) GC_time_limit = 1;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::Collect()
+{
+	volatile tCriticalSection::tLocker lock(CS);
+
+	CheckImplicitCollections();
+
+	risse_uint64 used_before = GetUsedBytes();
+	risse_uint64 start = tCollectorThread::GetMicroTick();
+	GC_gcollect();
+	risse_uint64 pause = tCollectorThread::GetMicroTick() - start;
+
+	LastGCNo = GC_gc_no;
+	AddRecord(tGCRecord::gkFull, pause, used_before);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::GetRecords(gc_vector<tGCRecord> & records)
+{
+	volatile tCriticalSection::tLocker lock(CS);
+
+	CheckImplicitCollections();
+	size_t count = History.GetDataSize();
+	records.clear();
+	records.reserve(count);
+	for(size_t i = 0; i < count; i++)
+		records.push_back(History.GetAt(i));
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::ClearRecords()
+{
+	volatile tCriticalSection::tLocker lock(CS);
+
+	History.AdvanceReadPos(History.GetDataSize());
+	TotalPause = 0;
+	MaxPause = 0;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::CheckImplicitCollections()
+{
+	risse_uint64 gc_no = GC_gc_no;
+	if(gc_no == LastGCNo) return;
+
+	// 最後に確認した時点から GC_gc_no が進んでいる。
+	// 何回分のコレクションが行われたかはわかるが、それぞれの停止時間や
+	// 回収量はわからないので、まとめて一つの記録とする
+	LastGCNo = gc_no;
+	AddRecord(tGCRecord::gkImplicit, 0, 0);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::AddRecord(tGCRecord::tKind kind, risse_uint64 pause,
+	risse_uint64 used_before)
+{
+	tGCRecord & rec = History.GetLast();
+	rec.Kind = kind;
+	rec.GCNo = GC_gc_no;
+	rec.Tick = tTickCount::instance()->Get();
+	rec.Pause = pause;
+	rec.HeapSize = GC_get_heap_size();
+	rec.FreeBytes = GC_get_free_bytes();
+	risse_uint64 used_after = rec.HeapSize - rec.FreeBytes;
+	rec.Reclaimed = used_before > used_after ? used_before - used_after : 0;
+	History.AdvanceWritePosWithDiscard();
+
+	TotalPause += pause;
+	if(MaxPause < pause) MaxPause = pause;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_uint64 tGCController::GetUsedBytes()
+{
+	return (risse_uint64)GC_get_heap_size() - GC_get_free_bytes();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tGCController::UpdateReceiveIdle()
+{
+	if(Incremental || HeapProfile)
+		StartReceiveIdle();
+	else
+		EndReceiveIdle();
+}
+//---------------------------------------------------------------------------
+
+
+#ifdef RISSE_HEAP_PROFILE
+//---------------------------------------------------------------------------
+void tGCController::OnReport(const tHeapProfiler::tReport & report)
+{
+	// 上位 HeapProfileLogCount 個の確保位置をログに出力する
+	// GC がスキャンするものとしないものに分けて集計する
+	risse_uint64 scanned = 0;
+	risse_uint64 atomic = 0;
+	for(tHeapProfiler::tReport::const_iterator i = report.begin(); i != report.end(); i++)
+	{
+		if(tHeapProfiler::IsPointerFreeKind(i->Kind))
+			atomic += i->Bytes;
+		else
+			scanned += i->Bytes;
+	}
+	ScannedBytes = scanned;
+	AtomicBytes = atomic;
+
+	tLogger::Log(tString(RISSE_WS("heap profile after GC #%1: %2 bytes live, %3 bytes scanned, %4 bytes atomic (estimated)"),
+		tString::AsString((risse_int64)GC_gc_no),
+		tString::AsString((risse_int64)(scanned + atomic)),
+		tString::AsString((risse_int64)scanned),
+		tString::AsString((risse_int64)atomic)), tLogger::llDebug);
+
+	size_t count = report.size() < HeapProfileLogCount ? report.size() : HeapProfileLogCount;
+	for(size_t i = 0; i < count; i++)
+	{
+		const tHeapProfiler::tEntry & entry = report[i];
+		tLogger::Log(tString(RISSE_WS("  %1 bytes (%2 samples) %3 at %4"),
+			tString::AsString((risse_int64)entry.Bytes),
+			tString::AsString((risse_int64)entry.Samples),
+			tString(tHeapProfiler::GetKindName(entry.Kind)),
+			entry.Site), tLogger::llDebug);
+	}
+}
+//---------------------------------------------------------------------------
+#endif
+
+
+//---------------------------------------------------------------------------
+bool tGCController::OnIdle(risse_uint64 tick)
+{
+#ifdef RISSE_HEAP_PROFILE
+	// コレクションが行われていればヒーププロファイラの報告を出力させる
+	// (ログ出力を伴うので CS の外で行う)
+	tHeapProfiler::CheckCollection();
+#endif
+
+	volatile tCriticalSection::tLocker lock(CS);
+
+	if(!Incremental) return false;
+
+	CheckImplicitCollections();
+
+	// FrameBudget を使い切るまでスライスを実行する
+	risse_uint64 used_before = GetUsedBytes();
+	risse_uint64 gc_no = GC_gc_no;
+	risse_uint64 start = tCollectorThread::GetMicroTick();
+	risse_uint64 elapsed = 0;
+	bool worked = false;
+	bool in_progress;
+	do
+	{
+		in_progress = GC_collect_a_little() != 0;
+		if(in_progress) worked = true;
+		elapsed = tCollectorThread::GetMicroTick() - start;
+	} while(in_progress && elapsed < FrameBudget);
+
+	// 何か仕事をした場合のみ記録する
+	bool completed = GC_gc_no != gc_no;
+	if(worked || completed)
+	{
+		LastGCNo = GC_gc_no;
+		AddRecord(tGCRecord::gkSlice, elapsed, completed ? used_before : 0);
+	}
+
+	// コレクションが進行中ならばさらにアイドルイベントを要求する
+	return in_progress;
+}
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+/**
+ * risa.gc の static メソッド群
+ */
+struct tRisaGcStaticMethods
+{
+	static void collect()
+	{
+		tGCController::instance()->Collect();
+	}
+
+	static tVariant getHistory(const tNativeCallInfo &info)
+	{
+		// 記録を辞書の配列として返す
+		gc_vector<tGCRecord> records;
+		tGCController::instance()->GetRecords(records);
+		tVariant array = tVariant(info.engine->ArrayClass).New();
+		for(gc_vector<tGCRecord>::iterator i = records.begin(); i != records.end(); i++)
+		{
+			const tGCRecord & rec = *i;
+			tVariant dic = tVariant(info.engine->DictionaryClass).New();
+			dic.ISet(tVariant(tString(RISSE_WS("kind"))), tVariant((risse_int64)rec.Kind));
+			dic.ISet(tVariant(tString(RISSE_WS("gcNo"))), tVariant((risse_int64)rec.GCNo));
+			dic.ISet(tVariant(tString(RISSE_WS("tick"))), tVariant((risse_int64)rec.Tick));
+			dic.ISet(tVariant(tString(RISSE_WS("pause"))), tVariant((risse_int64)rec.Pause));
+			dic.ISet(tVariant(tString(RISSE_WS("heapSize"))), tVariant((risse_int64)rec.HeapSize));
+			dic.ISet(tVariant(tString(RISSE_WS("freeBytes"))), tVariant((risse_int64)rec.FreeBytes));
+			dic.ISet(tVariant(tString(RISSE_WS("reclaimed"))), tVariant((risse_int64)rec.Reclaimed));
+			array.Invoke_Object(tSS<'p','u','s','h'>(), dic);
+		}
+		return array;
+	}
+
+	static void clearHistory()
+	{
+		tGCController::instance()->ClearRecords();
+	}
+
+	static tVariant getFinalizationStatistics(const tNativeCallInfo &info)
+	{
+		// ファイナライザとメインスレッドでのデストラクタの呼び出しの統計を辞書として返す
+		tCollectorThread::tStatistics fin = tCollectorThread::instance()->GetStatistics();
+		tMainThreadDestructorQueue::tStatistics dtor =
+			tMainThreadDestructorQueue::instance()->GetStatistics();
+		tVariant dic = tVariant(info.engine->DictionaryClass).New();
+		dic.ISet(tVariant(tString(RISSE_WS("finalizerPasses"))), tVariant((risse_int64)fin.Passes));
+		dic.ISet(tVariant(tString(RISSE_WS("finalized"))), tVariant((risse_int64)fin.Finalized));
+		dic.ISet(tVariant(tString(RISSE_WS("finalizerTotalTime"))), tVariant((risse_int64)fin.TotalTime));
+		dic.ISet(tVariant(tString(RISSE_WS("finalizerMaxTime"))), tVariant((risse_int64)fin.MaxTime));
+		dic.ISet(tVariant(tString(RISSE_WS("finalizerMaxLatency"))), tVariant((risse_int64)fin.MaxLatency));
+		dic.ISet(tVariant(tString(RISSE_WS("destructorsEnqueued"))), tVariant((risse_int64)dtor.Enqueued));
+		dic.ISet(tVariant(tString(RISSE_WS("destructorsCalled"))), tVariant((risse_int64)dtor.Destroyed));
+		dic.ISet(tVariant(tString(RISSE_WS("destructorQueueLength"))), tVariant((risse_int64)dtor.Length));
+		dic.ISet(tVariant(tString(RISSE_WS("destructorQueueMaxLength"))), tVariant((risse_int64)dtor.MaxLength));
+		dic.ISet(tVariant(tString(RISSE_WS("destructorTotalLatency"))), tVariant((risse_int64)dtor.TotalLatency));
+		dic.ISet(tVariant(tString(RISSE_WS("destructorMaxLatency"))), tVariant((risse_int64)dtor.MaxLatency));
+		return dic;
+	}
+
+	static bool get_incremental()
+	{
+		return tGCController::instance()->GetIncremental();
+	}
+
+	static void set_incremental(bool b)
+	{
+		tGCController::instance()->SetIncremental(b);
+	}
+
+	static risse_int64 get_frameBudget()
+	{
+		return (risse_int64)tGCController::instance()->GetFrameBudget();
+	}
+
+	static void set_frameBudget(risse_int64 budget)
+	{
+		if(budget < 0) budget = 0;
+		tGCController::instance()->SetFrameBudget((risse_uint64)budget);
+	}
+
+	static risse_int64 get_destructorBudget()
+	{
+		return (risse_int64)tMainThreadDestructorQueue::instance()->GetBudget();
+	}
+
+	static void set_destructorBudget(risse_int64 budget)
+	{
+		if(budget < 0) budget = 0;
+		tMainThreadDestructorQueue::instance()->SetBudget((risse_uint64)budget);
+	}
+
+	static bool get_heapProfile()
+	{
+		return tGCController::instance()->GetHeapProfile();
+	}
+
+	static void set_heapProfile(bool b)
+	{
+		tGCController::instance()->SetHeapProfile(b);
+	}
+
+#ifdef RISSE_HEAP_PROFILE
+	static tVariant getHeapProfile(const tNativeCallInfo &info)
+	{
+		// 確保位置別の生存バイト数を辞書の配列として返す
+		tHeapProfiler::tReport report;
+		tHeapProfiler::GetReport(report);
+		tVariant array = tVariant(info.engine->ArrayClass).New();
+		for(tHeapProfiler::tReport::iterator i = report.begin(); i != report.end(); i++)
+		{
+			tVariant dic = tVariant(info.engine->DictionaryClass).New();
+			dic.ISet(tVariant(tString(RISSE_WS("site"))), tVariant(i->Site));
+			dic.ISet(tVariant(tString(RISSE_WS("kind"))), tVariant(tString(tHeapProfiler::GetKindName(i->Kind))));
+			dic.ISet(tVariant(tString(RISSE_WS("bytes"))), tVariant((risse_int64)i->Bytes));
+			dic.ISet(tVariant(tString(RISSE_WS("samples"))), tVariant((risse_int64)i->Samples));
+			array.Invoke_Object(tSS<'p','u','s','h'>(), dic);
+		}
+		return array;
+	}
+#endif
+
+	static risse_int64 get_heapSize()
+	{
+		return (risse_int64)GC_get_heap_size();
+	}
+
+	static risse_int64 get_freeBytes()
+	{
+		return (risse_int64)GC_get_free_bytes();
+	}
+
+	static risse_int64 get_totalPause()
+	{
+		return (risse_int64)tGCController::instance()->GetTotalPause();
+	}
+
+	static risse_int64 get_maxPause()
+	{
+		return (risse_int64)tGCController::instance()->GetMaxPause();
+	}
+
+	static risse_int64 get_scannedBytes()
+	{
+		return (risse_int64)tGCController::instance()->GetScannedBytes();
+	}
+
+	static risse_int64 get_atomicBytes()
+	{
+		return (risse_int64)tGCController::instance()->GetAtomicBytes();
+	}
+};
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+/**
+ * risa.gc のパッケージのメンバを初期化するためのシングルトンインスタンス
+ */
+class tRisaGcPackageMemberInitializer : public tPackageMemberInitializer,
+	public singleton_base<tRisaGcPackageMemberInitializer>,
+	protected depends_on<tGCController>,
+	protected depends_on<tMainThreadDestructorQueue>
+{
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tRisaGcPackageMemberInitializer()
+	{
+		tPackageRegisterer<tSS<'r','i','s','a','.','g','c'> >::instance()->AddInitializer(this);
+	}
+
+	void Initialize(tScriptEngine * engine, const tString & name,
+		const tVariant & global)
+	{
+		tObjectBase * g = static_cast<tObjectBase *>(global.GetObjectInterface());
+
+		tMemberAttribute final_const (	tMemberAttribute(tMemberAttribute::mcConst)|
+									tMemberAttribute(tMemberAttribute::ocFinal));
+
+		BindFunction(g, tSS<'c','o','l','l','e','c','t'>(), &tRisaGcStaticMethods::collect, final_const);
+		BindFunction(g, tSS<'g','e','t','H','i','s','t','o','r','y'>(), &tRisaGcStaticMethods::getHistory, final_const);
+		BindFunction(g, tSS<'c','l','e','a','r','H','i','s','t','o','r','y'>(), &tRisaGcStaticMethods::clearHistory, final_const);
+		BindFunction(g, tSS<'g','e','t','F','i','n','a','l','i','z','a','t','i','o','n','S','t','a','t','i','s','t','i','c','s'>(), &tRisaGcStaticMethods::getFinalizationStatistics, final_const);
+		BindProperty(g, tSS<'i','n','c','r','e','m','e','n','t','a','l'>(), &tRisaGcStaticMethods::get_incremental, &tRisaGcStaticMethods::set_incremental);
+		BindProperty(g, tSS<'f','r','a','m','e','B','u','d','g','e','t'>(), &tRisaGcStaticMethods::get_frameBudget, &tRisaGcStaticMethods::set_frameBudget);
+		BindProperty(g, tSS<'d','e','s','t','r','u','c','t','o','r','B','u','d','g','e','t'>(), &tRisaGcStaticMethods::get_destructorBudget, &tRisaGcStaticMethods::set_destructorBudget);
+		BindProperty(g, tSS<'h','e','a','p','P','r','o','f','i','l','e'>(), &tRisaGcStaticMethods::get_heapProfile, &tRisaGcStaticMethods::set_heapProfile);
+#ifdef RISSE_HEAP_PROFILE
+		BindFunction(g, tSS<'g','e','t','H','e','a','p','P','r','o','f','i','l','e'>(), &tRisaGcStaticMethods::getHeapProfile, final_const);
+#endif
+		BindProperty(g, tSS<'h','e','a','p','S','i','z','e'>(), &tRisaGcStaticMethods::get_heapSize);
+		BindProperty(g, tSS<'f','r','e','e','B','y','t','e','s'>(), &tRisaGcStaticMethods::get_freeBytes);
+		BindProperty(g, tSS<'t','o','t','a','l','P','a','u','s','e'>(), &tRisaGcStaticMethods::get_totalPause);
+		BindProperty(g, tSS<'m','a','x','P','a','u','s','e'>(), &tRisaGcStaticMethods::get_maxPause);
+		BindProperty(g, tSS<'s','c','a','n','n','e','d','B','y','t','e','s'>(), &tRisaGcStaticMethods::get_scannedBytes);
+		BindProperty(g, tSS<'a','t','o','m','i','c','B','y','t','e','s'>(), &tRisaGcStaticMethods::get_atomicBytes);
+
+		global.RegisterFinalConstMember(
+				tSS<'g','k','F','u','l','l'>(),
+				tVariant((risse_int64)tGCRecord::gkFull));
+		global.RegisterFinalConstMember(
+				tSS<'g','k','S','l','i','c','e'>(),
+				tVariant((risse_int64)tGCRecord::gkSlice));
+		global.RegisterFinalConstMember(
+				tSS<'g','k','I','m','p','l','i','c','i','t'>(),
+				tVariant((risse_int64)tGCRecord::gkImplicit));
+	}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+} // namespace Risa
+
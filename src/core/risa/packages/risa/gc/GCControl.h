@@ -0,0 +1,261 @@
+//---------------------------------------------------------------------------
+/*
+	Risa [りさ]      alias 吉里吉里3 [kirikiri-3]
+	 stands for "Risa Is a Stagecraft Architecture"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief ガーベジコレクタの制御と統計
+//---------------------------------------------------------------------------
+#ifndef _GCCONTROLH_
+#define _GCCONTROLH_
+
+/*! @note
+	tGCController は Boehm GC の動作モードの設定と、コレクションごとの
+	統計 (停止時間、ヒープサイズ、回収されたバイト数) の記録を行う。
+
+	インクリメンタルモードを有効にすると、コレクションはアイドルイベントの
+	たびに少しずつ (GC_collect_a_little() 単位で) 進められる。一回のアイドル
+	イベントで GC に費やす時間は FrameBudget (マイクロ秒) 以内に抑えられる。
+	このため、フレームの描画などの合間に GC の停止時間を分散させることが
+	できる。
+
+	統計は固定長のリングバッファに記録され、古い物から捨てられる。
+
+	この版の Boehm GC にはコレクションの開始/終了を通知するコールバックが
+	無いため、正確な停止時間を記録できるのは tGCController 自身が起動した
+	コレクション (Collect() およびアイドル時のスライス) だけである。
+	メモリ確保の延長で GC 側が勝手に行ったコレクションは、GC_gc_no の
+	変化によって検出し、停止時間不明 (0) の gkImplicit として記録する。
+
+	並列マーク (parallel mark) は Boehm GC のビルド時の設定 (PARALLEL_MARK)
+	であり、実行時に切り替えることはできない。
+
+	RISSE_HEAP_PROFILE を定義してビルドした場合は、Risse のヒーププロファイラ
+	(risseHeapProfiler.h) を有効にできる。有効にすると、コレクションが行われる
+	たびに確保位置別の生存バイト数の上位がログに出力される。また、生存バイト数
+	のうち GC がスキャンする (ポインタを含みうる) ものとスキャンしない (atomic な)
+	ものの内訳が記録される。この版の Boehm GC はこの内訳を公開していないため、
+	プロファイラの標本からの推定値となる。
+*/
+
+#include "risa/common/Singleton.h"
+#include "risa/common/RisaThread.h"
+#include "risa/common/RisaGC.h"
+#include "risa/common/RingBuffer.h"
+#include "risa/packages/risa/event/IdleEvent.h"
+#include "risa/packages/risa/event/TickCount.h"
+#include "risa/packages/risa/log/Log.h"
+#include "risseHeapProfiler.h"
+
+namespace Risa {
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * GC の一回分の記録
+ * @note	tRingBuffer に格納するため、コンストラクタやデストラクタを持たないこと
+ */
+struct tGCRecord
+{
+	/**
+	 * 記録の種類
+	 */
+	enum tKind
+	{
+		gkFull, //!< 明示的なフルコレクション
+		gkSlice, //!< アイドル時のインクリメンタルコレクションのスライス
+		gkImplicit //!< メモリ確保の延長で GC が自発的に行ったコレクション
+	};
+
+	tKind Kind; //!< 記録の種類
+	risse_uint64 GCNo; //!< 記録時点での GC_gc_no (完了したコレクションの数)
+	risse_uint64 Tick; //!< 記録時点での TickCount
+	risse_uint64 Pause; //!< 停止時間 (マイクロ秒; 不明の場合は 0)
+	risse_uint64 HeapSize; //!< 記録時点でのヒープサイズ (バイト)
+	risse_uint64 FreeBytes; //!< 記録時点でのヒープ中の空き容量 (バイト)
+	risse_uint64 Reclaimed; //!< 回収されたバイト数 (不明の場合は 0)
+};
+//---------------------------------------------------------------------------
+} // namespace Risa
+RISSE_DECLARE_POINTER_FREE(Risa::tGCRecord); // tRingBuffer<tGCRecord> の領域を atomic にする
+namespace Risa {
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * GC の制御と統計を行うクラス
+ */
+class tGCController : public singleton_base<tGCController>,
+	protected depends_on<tCollectorThread>,
+	protected depends_on<tTickCount>,
+	protected depends_on<tLogger>,
+#ifdef RISSE_HEAP_PROFILE
+	public tHeapProfiler::tListener,
+#endif
+	public tIdleEventDestination
+{
+public:
+	static const size_t DefaultHistorySize = 256; //!< 記録を保持する数のデフォルト
+	static const size_t HeapProfileLogCount = 10; //!< コレクションごとにログに出力する確保位置の数
+	static const risse_uint64 DefaultFrameBudget = 2000; //!< 一回のアイドルイベントで GC に費やす時間のデフォルト(マイクロ秒)
+
+private:
+	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
+	tRingBuffer<tGCRecord> History; //!< 記録のリングバッファ
+	bool Incremental; //!< インクリメンタルモードが有効かどうか
+	bool HeapProfile; //!< ヒーププロファイラが有効かどうか
+	risse_uint64 FrameBudget; //!< 一回のアイドルイベントで GC に費やす時間(マイクロ秒)
+	risse_uint64 LastGCNo; //!< 最後に確認した GC_gc_no
+	risse_uint64 TotalPause; //!< 記録された停止時間の合計(マイクロ秒)
+	risse_uint64 MaxPause; //!< 記録された停止時間の最大値(マイクロ秒)
+	risse_uint64 ScannedBytes; //!< 最後の報告での、GC がスキャンする生存バイト数(推定値)
+	risse_uint64 AtomicBytes; //!< 最後の報告での、GC がスキャンしない生存バイト数(推定値)
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tGCController();
+
+	/**
+	 * インクリメンタルモードが有効かどうかを得る
+	 * @return	インクリメンタルモードが有効かどうか
+	 */
+	bool GetIncremental() const { return Incremental; }
+
+	/**
+	 * インクリメンタルモードを設定する
+	 * @param b	インクリメンタルモードを有効にするかどうか
+	 * @note	Boehm GC は一度有効にしたインクリメンタルモードを無効にする
+	 *			ことができない。偽を指定した場合は、アイドル時のスライスの実行を
+	 *			停止するだけとなる。
+	 */
+	void SetIncremental(bool b);
+
+	/**
+	 * ヒーププロファイラが有効かどうかを得る
+	 * @return	ヒーププロファイラが有効かどうか
+	 */
+	bool GetHeapProfile() const { return HeapProfile; }
+
+	/**
+	 * ヒーププロファイラを有効/無効にする
+	 * @param b	ヒーププロファイラを有効にするかどうか
+	 * @note	RISSE_HEAP_PROFILE を定義せずにビルドした場合、真を指定すると例外が発生する
+	 */
+	void SetHeapProfile(bool b);
+
+	/**
+	 * 一回のアイドルイベントで GC に費やす時間を得る
+	 * @return	時間(マイクロ秒)
+	 */
+	risse_uint64 GetFrameBudget() const { return FrameBudget; }
+
+	/**
+	 * 一回のアイドルイベントで GC に費やす時間を設定する
+	 * @param budget	時間(マイクロ秒)
+	 */
+	void SetFrameBudget(risse_uint64 budget);
+
+	/**
+	 * フルコレクションを行う
+	 */
+	void Collect();
+
+	/**
+	 * 記録をすべて得る
+	 * @param records	記録の格納先 (古い順に格納される)
+	 * @note	記録の数と内容は一度のロックの中で取得するので、
+	 *			取得中に記録が追加されても食い違いは起きない
+	 */
+	void GetRecords(gc_vector<tGCRecord> & records);
+
+	/**
+	 * 記録をすべて消去する
+	 */
+	void ClearRecords();
+
+	/**
+	 * 記録された停止時間の合計を得る
+	 * @return	停止時間の合計(マイクロ秒)
+	 */
+	risse_uint64 GetTotalPause() const { return TotalPause; }
+
+	/**
+	 * 記録された停止時間の最大値を得る
+	 * @return	停止時間の最大値(マイクロ秒)
+	 */
+	risse_uint64 GetMaxPause() const { return MaxPause; }
+
+	/**
+	 * GC がスキャンする生存バイト数を得る
+	 * @return	バイト数 (ヒーププロファイラの最後の報告からの推定値; 報告が無い場合は 0)
+	 */
+	risse_uint64 GetScannedBytes() const { return ScannedBytes; }
+
+	/**
+	 * GC がスキャンしない (ポインタを含まない) 生存バイト数を得る
+	 * @return	バイト数 (ヒーププロファイラの最後の報告からの推定値; 報告が無い場合は 0)
+	 */
+	risse_uint64 GetAtomicBytes() const { return AtomicBytes; }
+
+private:
+	/**
+	 * 最後に確認して以降に GC が自発的に行ったコレクションを記録する
+	 * @note	CS をロックした状態で呼ぶこと
+	 */
+	void CheckImplicitCollections();
+
+	/**
+	 * 記録を追加する
+	 * @param kind		記録の種類
+	 * @param pause		停止時間(マイクロ秒)
+	 * @param used_before	コレクション前の使用中のバイト数(不明の場合は0)
+	 * @note	CS をロックした状態で呼ぶこと
+	 */
+	void AddRecord(tGCRecord::tKind kind, risse_uint64 pause, risse_uint64 used_before);
+
+	/**
+	 * 使用中のバイト数を得る
+	 * @return	使用中のバイト数
+	 */
+	static risse_uint64 GetUsedBytes();
+
+	/**
+	 * アイドルイベントの受信の開始/停止を行う
+	 * @note	インクリメンタルモードかヒーププロファイラのどちらかが有効な
+	 *			間はアイドルイベントを受信する
+	 */
+	void UpdateReceiveIdle();
+
+#ifdef RISSE_HEAP_PROFILE
+protected:
+	/**
+	 * ヒーププロファイラからの報告を受け取る(tHeapProfiler::tListener::OnReport 実装)
+	 * @param report	報告
+	 */
+	void OnReport(const tHeapProfiler::tReport & report);
+#endif
+
+protected:
+	/**
+	 * アイドルイベントが配信されるとき
+	 * @param tick	イベントが配信されたときの TickCount
+	 * @return	もっとアイドルイベントが欲しいときに真
+	 */
+	bool OnIdle(risse_uint64 tick);
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+} // namespace Risa
+
+
+#endif
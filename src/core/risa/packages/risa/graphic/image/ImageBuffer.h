@@ -276,6 +276,13 @@ public:
 	 */
 	tMemoryImageBuffer(risse_size w, risse_size h);
 
+	/**
+	 * デストラクタ
+	 * @note	ピクセルは GC の管理外 (aligned_allocator) に確保されているため、
+	 *			ファイナライザを待たずにここで直ちに解放する
+	 */
+	virtual ~tMemoryImageBuffer() { delete PixelStore; }
+
 public:
 	/**
 	 * 内容をクローンする
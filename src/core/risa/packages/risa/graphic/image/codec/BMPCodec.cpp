@@ -415,7 +415,7 @@ static void Convert32BitFieldsTo32Bit(
 
 //---------------------------------------------------------------------------
 #define RISSE_BMP_READ_LINE_MAX 8
-void tBMPImageDecoder::InternalLoadBMP(tStreamAdapter src,
+void tBMPImageDecoder::InternalLoadBMP(tBufferedStreamReader & src,
 					tPixel::tFormat pixel_format, tProgressCallback * callback,
 					tDictionaryInstance * dict, RISSE_WIN_BITMAPINFOHEADER & bi,
 					risse_uint8 * palsrc)
@@ -564,7 +564,7 @@ void tBMPImageDecoder::Process(tStreamInstance * stream,
 	// Windows BMP Loader
 	// mostly taken ( but totally re-written ) from SDL,
 	// http://www.libsdl.org/
-	tStreamAdapter src(stream);
+	tBufferedStreamReader src(stream);
 
 	// dict から読み取るべき内容は無し。dict をクリアする
 	if(dict)
@@ -45,7 +45,7 @@ private:
 	/**
 	 * 内部関数
 	 */
-	void InternalLoadBMP(tStreamAdapter src,
+	void InternalLoadBMP(tBufferedStreamReader & src,
 						tPixel::tFormat pixel_format, tProgressCallback * callback,
 						tDictionaryInstance * dict, RISSE_WIN_BITMAPINFOHEADER & bi,
 						risse_uint8 * palsrc);
@@ -160,7 +160,7 @@ loop:
 
 
 //---------------------------------------------------------------------------
-void tTLGImageDecoder::ProcessTLG5(tStreamAdapter & src,
+void tTLGImageDecoder::ProcessTLG5(tBufferedStreamReader & src,
 					tPixel::tFormat pixel_format, tProgressCallback * callback,
 					tDictionaryInstance * dict)
 {
@@ -1131,7 +1131,7 @@ static void TLG6DecodeLine(
 
 
 //---------------------------------------------------------------------------
-void tTLGImageDecoder::ProcessTLG6(tStreamAdapter & src,
+void tTLGImageDecoder::ProcessTLG6(tBufferedStreamReader & src,
 					tPixel::tFormat pixel_format, tProgressCallback * callback,
 					tDictionaryInstance * dict)
 {
@@ -1338,7 +1338,7 @@ TLG_DECODER_BENCH(fprintf(stderr, "filter %dms\n", filter);)
 
 
 //---------------------------------------------------------------------------
-void tTLGImageDecoder::ProcessTLG(tStreamAdapter & src,
+void tTLGImageDecoder::ProcessTLG(tBufferedStreamReader & src,
 					tPixel::tFormat pixel_format, tProgressCallback * callback,
 					tDictionaryInstance * dict)
 {
@@ -1363,7 +1363,7 @@ void tTLGImageDecoder::Process(tStreamInstance * stream,
 					tPixel::tFormat pixel_format, tProgressCallback * callback,
 					tDictionaryInstance * dict)
 {
-	tStreamAdapter src(stream);
+	tBufferedStreamReader src(stream);
 
 	// dict から読み取るべき内容は無し。dict をクリアする
 	if(dict)
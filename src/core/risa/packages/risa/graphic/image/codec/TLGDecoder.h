@@ -42,19 +42,19 @@ private:
 	/**
 	 * (内部関数)TLG5 のデコードを行う
 	 */
-	void ProcessTLG5(tStreamAdapter & src,
+	void ProcessTLG5(tBufferedStreamReader & src,
 						tPixel::tFormat pixel_format, tProgressCallback * callback,
 						tDictionaryInstance * dict);
 	/**
 	 * (内部関数)TLG6 のデコードを行う
 	 */
-	void ProcessTLG6(tStreamAdapter & src,
+	void ProcessTLG6(tBufferedStreamReader & src,
 						tPixel::tFormat pixel_format, tProgressCallback * callback,
 						tDictionaryInstance * dict);
 	/**
 	 * (内部関数)TLG5/TLG6 のデコードを行う
 	 */
-	void ProcessTLG(tStreamAdapter & src,
+	void ProcessTLG(tBufferedStreamReader & src,
 						tPixel::tFormat pixel_format, tProgressCallback * callback,
 						tDictionaryInstance * dict);
 
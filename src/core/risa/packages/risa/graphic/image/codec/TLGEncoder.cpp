@@ -535,7 +535,7 @@ public:
 			risse_size org_cap = BufferCapacity;
 			BufferCapacity += 0x1000;
 			if(Buffer)
-				Buffer = (risse_uint8 *)ReallocCollectee(Buffer, BufferCapacity);
+				Buffer = (risse_uint8 *)ReallocCollectee(Buffer, BufferCapacity, hakAtomic);
 			else
 				Buffer = (risse_uint8 *)MallocAtomicCollectee(BufferCapacity);
 			memset(Buffer + org_cap, 0, BufferCapacity - org_cap);
@@ -213,7 +213,7 @@ bool tALBuffer::Render(risse_uint8 * & render_buffer, size_t & render_buffer_siz
 				if(render_buffer == NULL)
 					newbuffer = MallocAtomicCollectee(buffer_size_needed);
 				else
-					newbuffer = ReallocCollectee(render_buffer, buffer_size_needed);
+					newbuffer = ReallocCollectee(render_buffer, buffer_size_needed, hakAtomic);
 				if(!newbuffer)
 				{
 					FreeCollectee(render_buffer), render_buffer = NULL;
@@ -237,7 +237,7 @@ bool tALBuffer::Render(risse_uint8 * & render_buffer, size_t & render_buffer_siz
 					if(ConvertBuffer == NULL)
 						newbuffer = MallocAtomicCollectee(buffer_size_needed);
 					else
-						newbuffer = ReallocCollectee(ConvertBuffer, buffer_size_needed);
+						newbuffer = ReallocCollectee(ConvertBuffer, buffer_size_needed, hakAtomic);
 					if(!newbuffer)
 					{
 						FreeCollectee(ConvertBuffer), ConvertBuffer = NULL;
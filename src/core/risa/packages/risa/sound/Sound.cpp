@@ -168,7 +168,7 @@ void tSoundInstance::Open(const tString & filename)
 				tFileSystemManager::instance()->Open(sli_filename,
 					tFileOpenModes::omRead));
 			risse_size sli_stream_size = sli_stream.GetSize();
-			char * sli_content = new (GC) char[sli_stream_size + 1];
+			char * sli_content = new (PointerFreeGC) char[sli_stream_size + 1];
 			sli_stream.Read(sli_content, sli_stream_size);
 			sli_content[sli_stream_size] = '\0';
 			sli_stream.Dispose();
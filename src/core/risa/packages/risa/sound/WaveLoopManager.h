@@ -113,6 +113,10 @@ struct tWaveLoopLink : public tAtomicCollectee
 	}
 };
 //---------------------------------------------------------------------------
+} // namespace Risa
+RISSE_DECLARE_POINTER_FREE(Risa::tWaveLoopLink); // gc_vector<tWaveLoopLink> の領域を atomic にする
+namespace Risa {
+//---------------------------------------------------------------------------
 
 
 
@@ -37,6 +37,10 @@ struct tWaveSegment : public tAtomicCollectee
 	risse_int64 FilteredLength; //!< フィルタ後の長さ (PCM サンプルグラニュール数単位)
 };
 //---------------------------------------------------------------------------
+} // namespace Risa
+RISSE_DECLARE_POINTER_FREE(Risa::tWaveSegment); // gc_deque<tWaveSegment> の領域を atomic にする
+namespace Risa {
+//---------------------------------------------------------------------------
 
 
 //---------------------------------------------------------------------------
@@ -185,53 +185,56 @@ bool tRIFFWaveDecoder::Open()
 	static const risse_uint8 data_mark[] =
 		{ /*d*/0x64, /*a*/0x61, /*t*/0x74, /*a*/0x61 };
 
+	// ヘッダは小さな読み込みの繰り返しになるので、バッファ付きのリーダを介して読む
+	tBufferedStreamReader reader(Stream);
+
 	risse_uint32 size;
 	risse_uint64 next;
 
 	// check RIFF mark
 	risse_uint8 buf[4];
-	if(4 != Stream.Read(buf, 4)) return false;
+	if(4 != reader.Read(buf, 4)) return false;
 	if(memcmp(buf, riff_mark, 4)) return false;
 
-	if(4 != Stream.Read(buf, 4)) return false; // RIFF chunk size; discard
+	if(4 != reader.Read(buf, 4)) return false; // RIFF chunk size; discard
 
 	// check WAVE subid
-	if(4 != Stream.Read(buf, 4)) return false;
+	if(4 != reader.Read(buf, 4)) return false;
 	if(memcmp(buf, wave_mark, 4)) return false;
 
 	// find fmt chunk
-	if(!FindRIFFChunk(Stream, fmt_mark)) return false;
+	if(!FindRIFFChunk(reader, fmt_mark)) return false;
 
-	size = Stream.ReadI32LE();
-	next = Stream.GetPosition() + size;
+	size = reader.ReadI32LE();
+	next = reader.GetPosition() + size;
 
 	// read FileInfo
-	risse_uint16 format_tag = Stream.ReadI16LE(); // wFormatTag
+	risse_uint16 format_tag = reader.ReadI16LE(); // wFormatTag
 	if(format_tag != WAVE_FORMAT_PCM &&
 		format_tag != WAVE_FORMAT_IEEE_FLOAT &&
 		format_tag != WAVE_FORMAT_EXTENSIBLE) return false;
 
 
-	FileInfo.Channels = Stream.ReadI16LE(); // nChannels
-	FileInfo.Frequency = Stream.ReadI32LE(); // nSamplesPerSec
+	FileInfo.Channels = reader.ReadI16LE(); // nChannels
+	FileInfo.Frequency = reader.ReadI32LE(); // nSamplesPerSec
 
-	if(4 != Stream.Read(buf, 4)) return false; // nAvgBytesPerSec; discard
+	if(4 != reader.Read(buf, 4)) return false; // nAvgBytesPerSec; discard
 
-	risse_uint16 block_align = Stream.ReadI16LE(); // nBlockAlign
+	risse_uint16 block_align = reader.ReadI16LE(); // nBlockAlign
 
-	int bits_per_sample = Stream.ReadI16LE(); // wBitsPerSample
+	int bits_per_sample = reader.ReadI16LE(); // wBitsPerSample
 	bool is_float = false;
 
-	risse_uint16 ext_size = Stream.ReadI16LE(); // cbSize
+	risse_uint16 ext_size = reader.ReadI16LE(); // cbSize
 	if(format_tag == WAVE_FORMAT_EXTENSIBLE)
 	{
 		if(ext_size != 22) return false; // invalid extension length
 		if(bits_per_sample & 0x07) return false;  // not integer multiply by 8
-		Stream.ReadI16LE(); // wValidBitsPerSample; discard
-		FileInfo.SpeakerConfig = Stream.ReadI32LE(); // dwChannelMask
+		reader.ReadI16LE(); // wValidBitsPerSample; discard
+		FileInfo.SpeakerConfig = reader.ReadI32LE(); // dwChannelMask
 
 		risse_uint8 guid[16];
-		if(16 != Stream.Read(guid, 16)) return false;
+		if(16 != reader.Read(guid, 16)) return false;
 		if(!memcmp(guid, RISA_GUID_KSDATAFORMAT_SUBTYPE_PCM, 16))
 			is_float = false;
 		else if(!memcmp(guid, RISA_GUID_KSDATAFORMAT_SUBTYPE_IEEE_FLOAT, 16))
@@ -269,17 +272,17 @@ bool tRIFFWaveDecoder::Open()
 	if((risse_int) block_align != (risse_int)((bits_per_sample / 8) * FileInfo.Channels))
 		return false; // invalid align
 
-	if(!Stream.Seek(next, tStreamConstants::soSet)) return false;
+	if(!reader.Seek(next, tStreamConstants::soSet)) return false;
 
 	// find data chunk
-	if(!FindRIFFChunk(Stream, data_mark)) return false;
+	if(!FindRIFFChunk(reader, data_mark)) return false;
 
-	size = Stream.ReadI32LE();
+	size = reader.ReadI32LE();
 
 	risse_int64 datastart;
 
-	risse_int64 remain_size = Stream.GetSize() -
-		(datastart = Stream.GetPosition());
+	risse_int64 remain_size = reader.GetSize() -
+		(datastart = reader.GetPosition());
 	if(size > remain_size) return false;
 		// data ends before "size" described in the header
 
@@ -287,6 +290,9 @@ bool tRIFFWaveDecoder::Open()
 	FileInfo.TotalSampleGranules = size / (FileInfo.Channels * (bits_per_sample / 8));
 	FileInfo.TotalTime = FileInfo.TotalSampleGranules * 1000 / FileInfo.Frequency;
 
+	// 以降は Stream から直接読むので、Stream の位置をデータの先頭に合わせる
+	reader.Sync();
+
 	// the stream is seekable
 	FileInfo.Seekable = true;
 
@@ -296,7 +302,7 @@ bool tRIFFWaveDecoder::Open()
 
 
 //---------------------------------------------------------------------------
-bool tRIFFWaveDecoder::FindRIFFChunk(tStreamAdapter stream, const risse_uint8 *chunk)
+bool tRIFFWaveDecoder::FindRIFFChunk(tBufferedStreamReader & stream, const risse_uint8 *chunk)
 {
 	risse_uint8 buf[4];
 	while(true)
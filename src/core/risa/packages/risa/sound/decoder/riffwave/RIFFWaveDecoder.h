@@ -85,7 +85,7 @@ private:
 	 * @param chunk		探したいチャンク
 	 * @return	指定された RIFF チャンクが見つかれば真
 	 */
-	static bool FindRIFFChunk(tStreamAdapter stream, const risse_uint8 *chunk);
+	static bool FindRIFFChunk(tBufferedStreamReader & stream, const risse_uint8 *chunk);
 };
 //---------------------------------------------------------------------------
 
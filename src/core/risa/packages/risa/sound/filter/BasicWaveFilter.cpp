@@ -145,7 +145,7 @@ void * tWaveFilterInstance::PrepareQueue(risse_uint numsamplegranules)
 		if(QueuedData == NULL)
 			newbuffer = MallocAtomicCollectee(buffer_size_needed);
 		else
-			newbuffer = ReallocCollectee(QueuedData, buffer_size_needed);
+			newbuffer = ReallocCollectee(QueuedData, buffer_size_needed, hakAtomic);
 		if(!newbuffer)
 		{
 			FreeCollectee(QueuedData), QueuedData = NULL;
@@ -242,7 +242,7 @@ risse_uint tWaveFilterInstance::Fill(void * dest, risse_uint numsamplegranules,
 					if(ConvertBuffer == NULL)
 						newbuffer = MallocAtomicCollectee(buffer_size_needed);
 					else
-						newbuffer = ReallocCollectee(ConvertBuffer, buffer_size_needed);
+						newbuffer = ReallocCollectee(ConvertBuffer, buffer_size_needed, hakAtomic);
 					if(!newbuffer)
 					{
 						FreeCollectee(ConvertBuffer), ConvertBuffer = NULL;
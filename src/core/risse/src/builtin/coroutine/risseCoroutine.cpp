@@ -17,6 +17,12 @@
 #include "risseCoroutine.h"
 #include "risseCoroutineClass.h"
 #include "../../risseExceptionClass.h"
+#include "../../risseFunctionClass.h"
+#include "../../risseCodeBlock.h"
+#include "../../risseCodeExecutor.h"
+#include "../../risseScriptBlockClass.h"
+#include "../../risseStaticStrings.h"
+#include "../../risseHeapProfiler.h"
 
 extern "C" {
 #include "private/gc_priv.h"
@@ -114,6 +120,10 @@ class tCoroutine;
 
 #if defined(BOOST_WINDOWS)
 	#define RISSE_CORO_WINDOWS
+#elif defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && \
+	!defined(RISSE_CORO_NO_NATIVE_SWITCH)
+	// RISSE_CORO_NO_NATIVE_SWITCH を定義すると自前の切り替えを使わない
+	#define RISSE_CORO_X86_64
 #elif defined(_XOPEN_SOURCE) && (_XOPEN_SOURCE >= 500)
 	#define RISSE_CORO_POSIX
 #elif defined BOOST_HAS_PTHREADS
@@ -139,6 +149,728 @@ class tCoroutine;
 */
     #error RISSE_CORO_LINUX is unsupported platform for now
 
+#elif defined(RISSE_CORO_X86_64)
+
+//========================================================================
+//                            x86-64 の場合
+//========================================================================
+
+/*
+	x86-64 (System V ABI) では hamigaki.coroutine を使わず、コンテキストの
+	切り替えを自前で行う。
+
+	・スタックは mmap で確保し、下端にガードページ (PROT_NONE) を置く。
+	  スタックのあふれはガードページへのアクセスとして検出される。
+	  使い終わったスタックはプールに戻され、次のコルーチンの作成時に再利用
+	  される (コルーチンの作成ごとに mmap/munmap を行わない)。
+	・切り替えは callee-saved なレジスタ (rbx, rbp, r12-r15) と MXCSR、
+	  x87 制御ワードのみを保存/復帰する。swapcontext と違ってシグナル
+	  マスクには触れないため、システムコールは発生しない。
+
+	Boehm GC との関係
+
+	GC はスレッドのスタックを「現在のスタックポインタ」から「スレッドの
+	スタックの上端」までスキャンする。コルーチンのスタック上を実行中は
+	スタックポインタがスレッドのスタックとは別の領域にあるため、このままでは
+	GC は二つのスタックの間の (マップされていない) 領域までスキャンしようと
+	してしまう。
+
+	そこで、切り替えのたびに GC が保持しているスレッドのスタックの上端
+	(メインスレッドならば GC_stackbottom、それ以外のスレッドでは
+	GC_Thread_Rep::stack_end) を切り替え先のスタックの上端に書き換える。
+	書き換えとスタックポインタの変更は、その間に GC が割り込んでも
+	「スタックポインタ > スタックの上端」となる (スキャン範囲が空になる)
+	順番で行う (risse_coro_switch の end_first 引数)。
+
+	スキャンされなくなった、中断中のスタック (スレッドの本来のスタックや、
+	別のコルーチンを resume して待っているコルーチンのスタック) は、
+	GC_push_other_roots をフックして、スレッドごとに記録されている実行中の
+	コルーチンの連鎖をたどってプッシュする。単に中断しているだけのコルーチン
+	のスタックは、これまで通り tCoroutinePtr のマーク関数からプッシュされる。
+*/
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#include "boost/tuple/tuple.hpp"
+
+extern "C" {
+#if defined(GC_PTHREADS)
+#include "private/pthread_support.h"
+#endif
+}
+
+
+//---------------------------------------------------------------------------
+// コンテキストの切り替え
+//---------------------------------------------------------------------------
+/*
+	void risse_coro_switch(void ** from_sp, void * to_sp,
+		char ** end_ptr, char * new_end, int end_first)
+
+	callee-saved なレジスタと MXCSR/x87 制御ワードを現在のスタックに保存し、
+	スタックポインタを *from_sp に保存してから to_sp に切り替え、
+	切り替え先で保存されていたレジスタを復帰する。
+	*end_ptr (GC が見るスレッドのスタックの上端) には new_end を書き込む。
+	end_first が真ならばスタックポインタの切り替えの前に、偽ならば後に書き込む。
+
+	スタックのレイアウト (to_sp からのオフセット)
+	 +0  : (未使用)
+	 +8  : MXCSR
+	 +12 : x87 制御ワード
+	 +16 : r15
+	 +24 : r14
+	 +32 : r13
+	 +40 : r12
+	 +48 : rbx
+	 +56 : rbp
+	 +64 : 戻り先アドレス
+
+	risse_coro_start は新しいコルーチンの最初の戻り先となるスタブで、
+	r12 に置かれた引数を持って risse_coro_entry を呼ぶ。
+*/
+__asm__(
+	".text\n"
+	".globl risse_coro_switch\n"
+	".hidden risse_coro_switch\n"
+	".type risse_coro_switch, @function\n"
+	".align 16\n"
+"risse_coro_switch:\n"
+	"	pushq %rbp\n"
+	"	pushq %rbx\n"
+	"	pushq %r12\n"
+	"	pushq %r13\n"
+	"	pushq %r14\n"
+	"	pushq %r15\n"
+	"	subq $16, %rsp\n"
+	"	stmxcsr 8(%rsp)\n"
+	"	fnstcw 12(%rsp)\n"
+	"	movq %rsp, (%rdi)\n"
+	"	testl %r8d, %r8d\n"
+	"	jz 1f\n"
+	"	movq %rcx, (%rdx)\n"
+	"	movq %rsi, %rsp\n"
+	"	jmp 2f\n"
+"1:\n"
+	"	movq %rsi, %rsp\n"
+	"	movq %rcx, (%rdx)\n"
+"2:\n"
+	"	ldmxcsr 8(%rsp)\n"
+	"	fldcw 12(%rsp)\n"
+	"	addq $16, %rsp\n"
+	"	popq %r15\n"
+	"	popq %r14\n"
+	"	popq %r13\n"
+	"	popq %r12\n"
+	"	popq %rbx\n"
+	"	popq %rbp\n"
+	"	ret\n"
+	".size risse_coro_switch, .-risse_coro_switch\n"
+
+	".globl risse_coro_start\n"
+	".hidden risse_coro_start\n"
+	".type risse_coro_start, @function\n"
+	".align 16\n"
+"risse_coro_start:\n"
+	"	.cfi_startproc\n"
+	"	.cfi_undefined rip\n"
+	"	movq %r12, %rdi\n"
+	"	andq $-16, %rsp\n"
+	"	call risse_coro_entry\n"
+	"	ud2\n"
+	"	.cfi_endproc\n"
+	".size risse_coro_start, .-risse_coro_start\n"
+);
+
+extern "C" {
+void risse_coro_switch(void ** from_sp, void * to_sp,
+	char ** end_ptr, char * new_end, int end_first) __attribute__((visibility("hidden")));
+void risse_coro_start() __attribute__((visibility("hidden")));
+void risse_coro_entry(void * coro) __attribute__((visibility("hidden"), noreturn));
+}
+
+
+namespace Risse {
+
+
+//---------------------------------------------------------------------------
+/**
+ * コルーチンのスタックのプール
+ * @note	スタックは GC の管理外のメモリ (mmap) に確保される
+ */
+class tCoroutineStackPool
+{
+public:
+	/**
+	 * スタック
+	 */
+	struct tStack
+	{
+		char * Base; //!< マッピングの先頭 (ガードページを含む; NULL = スタック無し)
+		size_t Size; //!< マッピングのサイズ (ガードページを含む)
+
+		/**
+		 * スタックの上端を得る
+		 */
+		char * GetTop() const { return Base + Size; }
+	};
+
+	static const size_t DefaultMaxPooled = 64; //!< プールに保持するスタックの最大数のデフォルト
+
+private:
+	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
+	std::vector<tStack> FreeStacks; //!< 再利用を待つスタック
+	size_t MaxPooled; //!< プールに保持するスタックの最大数
+	size_t PageSize; //!< ページサイズ
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tCoroutineStackPool()
+	{
+		MaxPooled = DefaultMaxPooled;
+		PageSize = (size_t)::sysconf(_SC_PAGESIZE);
+	}
+
+	/**
+	 * スタックを得る
+	 * @param size	必要なスタックのサイズ (ガードページを含まない)
+	 * @return	スタック
+	 */
+	tStack Acquire(size_t size)
+	{
+		// サイズをページ単位に切り上げ、ガードページの分を足す
+		size = (size + PageSize - 1) / PageSize * PageSize + PageSize;
+
+		{
+			volatile tCriticalSection::tLocker lock(CS);
+			for(std::vector<tStack>::reverse_iterator i = FreeStacks.rbegin();
+				i != FreeStacks.rend(); i++)
+			{
+				if(i->Size == size)
+				{
+					tStack stack = *i;
+					FreeStacks.erase((i+1).base());
+					return stack;
+				}
+			}
+		}
+
+		// プールに無いので新たに確保する
+		// 確保に失敗した場合は、GC を行ってコルーチン (とそのスタック) を
+		// 回収させてから再試行する
+		for(int retry = 0; retry < 3; retry++)
+		{
+			void * p = ::mmap(NULL, size, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+			if(p != MAP_FAILED)
+			{
+				// スタックの下端をガードページにする
+				::mprotect(p, PageSize, PROT_NONE);
+				tStack stack;
+				stack.Base = static_cast<char*>(p);
+				stack.Size = size;
+				return stack;
+			}
+			CollectGarbage();
+		}
+		tInsufficientResourceExceptionClass::ThrowCouldNotCreateCoroutine();
+		tStack stack = { NULL, 0 };
+		return stack; // not reached
+	}
+
+	/**
+	 * スタックを返す
+	 * @param stack	スタック
+	 * @note	プールがいっぱいの場合はスタックを解放する
+	 */
+	void Release(const tStack & stack)
+	{
+		{
+			volatile tCriticalSection::tLocker lock(CS);
+			if(FreeStacks.size() < MaxPooled)
+			{
+				FreeStacks.push_back(stack);
+				return;
+			}
+		}
+		::munmap(stack.Base, stack.Size);
+	}
+
+	/**
+	 * プールに保持するスタックの最大数を設定する
+	 * @param max	最大数 (0 = プールを使わない)
+	 */
+	void SetMaxPooled(size_t max)
+	{
+		std::vector<tStack> release;
+		{
+			volatile tCriticalSection::tLocker lock(CS);
+			MaxPooled = max;
+			while(FreeStacks.size() > MaxPooled)
+			{
+				release.push_back(FreeStacks.back());
+				FreeStacks.pop_back();
+			}
+		}
+		for(std::vector<tStack>::iterator i = release.begin(); i != release.end(); i++)
+			::munmap(i->Base, i->Size);
+	}
+
+	/**
+	 * プールに保持するスタックの最大数を得る
+	 * @return	最大数
+	 */
+	size_t GetMaxPooled() const { return MaxPooled; }
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+static tCoroutineStackPool * StackPool = NULL; //!< スタックのプール
+//---------------------------------------------------------------------------
+
+
+struct tCoroutineThreadRecord;
+//---------------------------------------------------------------------------
+/**
+ * コルーチンのコンテキスト
+ */
+struct tCoroutineContext
+{
+	void * SP; //!< 中断しているときのスタックポインタ
+	char * StackTop; //!< スタックの上端
+	tCoroutineContext * Caller; //!< このコルーチンを resume したコルーチン (NULL = スレッドのスタック)
+	tCoroutineThreadRecord * Thread; //!< このコルーチンを実行しているスレッドの記録
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * コルーチンを実行するスレッドごとの記録
+ * @note	記録は ThreadRecords からたどれるため、GC のルートから参照されて
+ *			いる。スレッドが終了すると ThreadRecords から取り除かれ、GC に
+ *			回収される。
+ */
+struct tCoroutineThreadRecord : public tCollectee
+{
+	tCoroutineThreadRecord * Next; //!< 次の記録
+	tCoroutineContext * Innermost; //!< このスレッドで実行中の最も内側のコルーチン (NULL = 無し)
+	void * BaseSP; //!< コルーチンを実行している間のスレッドのスタックのスタックポインタ
+	char * BaseTop; //!< スレッドのスタックの上端
+	char ** StackEnd; //!< GC が保持しているこのスレッドのスタックの上端へのポインタ
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+static tCoroutineThreadRecord * ThreadRecords = NULL; //!< スレッドごとの記録のリスト
+static __thread tCoroutineThreadRecord * CurrentThreadRecord = NULL; //!< このスレッドの記録
+static void (*PrevPushOtherRoots)() = NULL; //!< 元の GC_push_other_roots
+#if defined(GC_PTHREADS)
+static pthread_key_t ThreadRecordKey; //!< スレッドの終了時に記録を取り除くためのキー
+#endif
+//---------------------------------------------------------------------------
+
+
+#if defined(GC_PTHREADS)
+//---------------------------------------------------------------------------
+/**
+ * スレッドの終了時に呼ばれ、そのスレッドの記録を ThreadRecords から取り除く
+ * @param data	スレッドの記録
+ * @note	終了するスレッドで実行中のコルーチンは無いので、Innermost は
+ *			NULL になっている
+ */
+static void RemoveThreadRecord(void * data)
+{
+	tCoroutineThreadRecord * record = static_cast<tCoroutineThreadRecord *>(data);
+	RISSE_ASSERT(record->Innermost == NULL);
+
+	LOCK();
+	for(tCoroutineThreadRecord ** p = &ThreadRecords; *p; p = &(*p)->Next)
+	{
+		if(*p == record) { *p = record->Next; break; }
+	}
+	UNLOCK();
+
+	CurrentThreadRecord = NULL;
+}
+//---------------------------------------------------------------------------
+#endif
+
+
+//---------------------------------------------------------------------------
+/**
+ * このスレッドの記録を得る
+ * @return	このスレッドの記録
+ */
+static tCoroutineThreadRecord * GetCurrentThreadRecord()
+{
+	if(RISSE_LIKELY(CurrentThreadRecord != NULL)) return CurrentThreadRecord;
+
+	tCoroutineThreadRecord * record = new tCoroutineThreadRecord();
+	record->Innermost = NULL;
+	record->BaseSP = NULL;
+	record->BaseTop = NULL;
+
+	LOCK();
+#if defined(GC_PTHREADS)
+	GC_thread me = GC_lookup_thread(pthread_self());
+	if(me->flags & MAIN_THREAD)
+		record->StackEnd = reinterpret_cast<char**>(&GC_stackbottom);
+	else
+		record->StackEnd = reinterpret_cast<char**>(&me->stack_end);
+#else
+	record->StackEnd = reinterpret_cast<char**>(&GC_stackbottom);
+#endif
+	record->Next = ThreadRecords;
+	ThreadRecords = record;
+	UNLOCK();
+
+#if defined(GC_PTHREADS)
+	pthread_setspecific(ThreadRecordKey, record);
+#endif
+	CurrentThreadRecord = record;
+	return record;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * GC_push_other_roots のフック
+ * @note	実行中のコルーチンの連鎖のうち、スレッドのスタックとしては
+ *			スキャンされないスタックをプッシュする
+ */
+static void PushCoroutineStacks()
+{
+	for(tCoroutineThreadRecord * record = ThreadRecords; record; record = record->Next)
+	{
+		if(!record->Innermost) continue;
+
+		// 連鎖上のコルーチンのスタック
+		// (最も内側のコルーチンの SP は古い値だが、余分にスキャンするだけなので問題ない)
+		tCoroutineContext * context = record->Innermost;
+		for(; context; context = context->Caller)
+		{
+			if(context->SP)
+				GC_push_all_stack(static_cast<ptr_t>(context->SP), context->StackTop);
+		}
+
+		// スレッドの本来のスタック
+		if(record->BaseSP)
+			GC_push_all_stack(static_cast<ptr_t>(record->BaseSP), record->BaseTop);
+	}
+
+	if(PrevPushOtherRoots) PrevPushOtherRoots();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * コルーチンの実装
+ * @note	hamigaki.coroutine の coroutine クラスと同じように使えるようにしてある
+ */
+class risse_coroutine_type
+{
+public:
+	class self;
+	typedef tVariant (*tBody)(self &self, tCoroutineImpl * coroimpl, tCoroutine * coro, tVariant arg);
+	typedef boost::tuple<tCoroutineImpl *, tCoroutine *, tVariant> tArguments;
+
+	/**
+	 * コルーチン内から見た自分自身
+	 */
+	class self
+	{
+		risse_coroutine_type & Owner;
+	public:
+		self(risse_coroutine_type & owner) : Owner(owner) {;}
+
+		/**
+		 * 呼び出し元に戻る
+		 * @param value	呼び出し元の operator () の戻り値となる値
+		 * @return	次に operator () が呼ばれたときの引数
+		 */
+		tArguments yield(const tVariant & value)
+		{
+			Owner.Result = value;
+			Owner.SwitchToCaller();
+			return Owner.Arguments;
+		}
+	};
+
+private:
+	tBody Body; //!< コルーチンの本体
+	tCoroutineStackPool::tStack Stack; //!< スタック
+	tCoroutineContext Context; //!< コンテキスト
+	tArguments Arguments; //!< operator () の引数
+	tVariant Result; //!< operator () の戻り値
+	bool Exited; //!< 本体が終了したかどうか
+	bool Abnormal; //!< 本体が例外で終了したかどうか
+#ifdef RISSE_HEAP_PROFILE
+	tHeapProfilerSite * ProfilerSite; //!< 中断しているときのコルーチン内の確保位置
+#endif
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param body			コルーチンの本体
+	 * @param stack_size	スタックサイズ
+	 */
+	risse_coroutine_type(tBody body, ptrdiff_t stack_size)
+	{
+		Body = body;
+		Exited = false;
+		Abnormal = false;
+#ifdef RISSE_HEAP_PROFILE
+		ProfilerSite = NULL;
+#endif
+
+		Stack = StackPool->Acquire((size_t)stack_size);
+
+		// 最初の切り替えで risse_coro_start に戻るように、スタックに
+		// 切り替え時と同じ形の保存領域を作っておく
+		char * top = Stack.GetTop();
+		void ** sp = reinterpret_cast<void**>(top - 80);
+		risse_uint32 mxcsr;
+		risse_uint16 fpucw;
+		__asm__ __volatile__("stmxcsr %0" : "=m"(mxcsr));
+		__asm__ __volatile__("fnstcw %0" : "=m"(fpucw));
+		sp[0] = NULL;
+		*reinterpret_cast<risse_uint32*>(reinterpret_cast<char*>(sp) + 8) = mxcsr;
+		*reinterpret_cast<risse_uint16*>(reinterpret_cast<char*>(sp) + 12) = fpucw;
+		sp[2] = sp[3] = sp[4] = NULL; // r15, r14, r13
+		sp[5] = this; // r12 (risse_coro_entry の引数)
+		sp[6] = sp[7] = NULL; // rbx, rbp
+		sp[8] = reinterpret_cast<void*>(&risse_coro_start); // 戻り先
+		sp[9] = NULL; // risse_coro_start の戻り先 (無し)
+
+		Context.SP = sp;
+		Context.StackTop = top;
+		Context.Caller = NULL;
+		Context.Thread = NULL;
+	}
+
+	/**
+	 * デストラクタ
+	 * @note	中断したまま破棄されたコルーチンのスタックは巻き戻されない
+	 *			(スタック上のオブジェクトのデストラクタは呼ばれない)。
+	 *			デストラクタは GC のファイナライザから、コルーチンを実行していた
+	 *			スレッドとは別のスレッドで呼ばれるため、ここでスクリプトの
+	 *			スタックフレームを巻き戻すと、yield をまたいで保持されている
+	 *			ロック (tSynchronizer) を獲得していないスレッドから解除する
+	 *			ことになってしまう。yield の間保持されているのはコルーチン
+	 *			自身のロックで、そのコルーチンはもう到達できないので、解除
+	 *			されなくても問題はない。中断中の tHeapProfilerSite の連鎖は
+	 *			ProfilerSite に退避されているので、それごと捨てられる。
+	 */
+	~risse_coroutine_type()
+	{
+		ReleaseStack();
+	}
+
+	/**
+	 * コルーチンを実行する
+	 * @return	yield の引数、あるいは本体の戻り値
+	 */
+	tVariant operator () (tCoroutineImpl * coroimpl, tCoroutine * coro, const tVariant & arg)
+	{
+		RISSE_ASSERT(!Exited);
+		Arguments = tArguments(coroimpl, coro, arg);
+
+		Switch();
+
+		if(Exited)
+		{
+			// スタックはもう必要ない
+			ReleaseStack();
+			if(Abnormal) throw tCoroutineAbnormalExit();
+		}
+
+		tVariant ret = Result;
+		Result.Clear();
+		return ret;
+	}
+
+	/**
+	 * 本体が例外で終了したことを表す例外
+	 */
+	class tCoroutineAbnormalExit {};
+
+	/**
+	 * コンテキストを得る
+	 * @return	コンテキスト
+	 */
+	tCoroutineContext * GetContext() { return &Context; }
+
+	/**
+	 * コルーチンの開始点 (risse_coro_entry から呼ばれる)
+	 */
+	void Entry()
+	{
+		self s(*this);
+		try
+		{
+			Result = Body(s, Arguments.get<0>(), Arguments.get<1>(), Arguments.get<2>());
+		}
+		catch(...)
+		{
+			// 例外の値は Body 内で tCoroutine に記録されている
+			Result.Clear();
+			Abnormal = true;
+		}
+		Exited = true;
+		SwitchToCaller();
+	}
+
+private:
+	/**
+	 * このコルーチンに切り替え、yield されるか本体が終了するまで実行する
+	 */
+	void Switch()
+	{
+		// 実行中のコルーチンの連鎖につなぐ
+		tCoroutineThreadRecord * record = GetCurrentThreadRecord();
+		tCoroutineContext * caller = record->Innermost;
+		Context.Caller = caller;
+		Context.Thread = record;
+		void ** from_sp;
+		char * from_top;
+		if(caller)
+		{
+			from_sp = &caller->SP;
+			from_top = caller->StackTop;
+		}
+		else
+		{
+			record->BaseTop = *record->StackEnd;
+			from_sp = &record->BaseSP;
+			from_top = record->BaseTop;
+		}
+		record->Innermost = &Context;
+
+#ifdef RISSE_HEAP_PROFILE
+		// 確保位置の連鎖をコルーチンのものに入れ替える
+		tHeapProfilerSite * caller_site = tHeapProfiler::ExchangeCurrentSite(ProfilerSite);
+#endif
+
+		// 切り替える
+		risse_coro_switch(from_sp, Context.SP,
+			record->StackEnd, Context.StackTop, Context.StackTop < from_top);
+
+		// 戻ってきた
+		// (yield されたか、本体が終了した)
+#ifdef RISSE_HEAP_PROFILE
+		ProfilerSite = tHeapProfiler::ExchangeCurrentSite(caller_site);
+#endif
+		record = Context.Thread;
+		record->Innermost = caller;
+		if(!caller) record->BaseSP = NULL;
+		Context.Caller = NULL;
+		Context.Thread = NULL;
+	}
+
+	/**
+	 * 呼び出し元に切り替える
+	 */
+	void SwitchToCaller()
+	{
+		tCoroutineThreadRecord * record = Context.Thread;
+		RISSE_ASSERT(record != NULL);
+		void * to_sp;
+		char * to_top;
+		if(Context.Caller)
+		{
+			to_sp = Context.Caller->SP;
+			to_top = Context.Caller->StackTop;
+		}
+		else
+		{
+			to_sp = record->BaseSP;
+			to_top = record->BaseTop;
+		}
+		risse_coro_switch(&Context.SP, to_sp,
+			record->StackEnd, to_top, to_top < Context.StackTop);
+	}
+
+	/**
+	 * スタックをプールに返す
+	 */
+	void ReleaseStack()
+	{
+		if(Stack.Base)
+		{
+			StackPool->Release(Stack);
+			Stack.Base = NULL;
+			Context.SP = NULL;
+		}
+	}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+typedef risse_coroutine_type::tCoroutineAbnormalExit tCoroutineAbnormalExit;
+//---------------------------------------------------------------------------
+
+
+/**
+ * 現在実行中のコルーチンコンテキストを得る
+ */
+tCoroutineContext * GetCurrentCoroutineContext(risse_coroutine_type * coro)
+{
+	return coro->GetContext();
+}
+
+
+/**
+ * コルーチンコンテキストの内容をGCに対してプッシュする
+ */
+struct GC_ms_entry *MarkCoroutineContext(
+									tCoroutineContext * co_context,
+									struct GC_ms_entry *mark_sp,
+									struct GC_ms_entry *mark_sp_limit)
+{
+	// 中断中のスタックをプッシュする
+	// 実行中のコルーチンのスタックはスレッドのスタックとして、あるいは
+	// PushCoroutineStacks によってプッシュされるが、ここで重ねて
+	// プッシュしても問題はない
+	if(co_context->SP)
+	{
+		for(ptr_t p = static_cast<ptr_t>(co_context->SP); p < co_context->StackTop;
+			p += sizeof(GC_PTR) / sizeof(*p))
+		{
+			void * ptr = (*(void**)p);
+			mark_sp = GC_MARK_AND_PUSH((GC_PTR)ptr, mark_sp, mark_sp_limit, (GC_PTR*)co_context);
+		}
+	}
+	return mark_sp;
+}
+
+static const ptrdiff_t DefaultStackSize = 65536; //!< スタックサイズのデフォルト
+
+} // namespace Risse
+
+
+//---------------------------------------------------------------------------
+void risse_coro_entry(void * coro)
+{
+	static_cast<Risse::risse_coroutine_type *>(coro)->Entry();
+	// ここには戻ってこない
+	::abort();
+}
+//---------------------------------------------------------------------------
+
+//========================================================================
+//                          x86-64 の場合 - 終わり
+//========================================================================
+
+
+
 #elif defined(RISSE_CORO_POSIX)
 
 //========================================================================
@@ -192,6 +924,7 @@ typedef ::ucontext_t tCoroutineContext;
 
 typedef coro::coroutine<
 	tVariant (tCoroutineImpl * coroimpl, tCoroutine * coro, tVariant)> risse_coroutine_base;
+typedef coro::abnormal_exit tCoroutineAbnormalExit;
 
 
 class risse_coroutine_type : public risse_coroutine_base
@@ -264,7 +997,7 @@ fflush(stdout);
 	return mark_sp;
 }
 
-static const ptrdiff_t StackSize = 65536; //!< スタックサイズ
+static const ptrdiff_t DefaultStackSize = 65536; //!< スタックサイズのデフォルト
 
 
 } // namespace Risse
@@ -301,6 +1034,7 @@ typedef int tCoroutineContext;
 
 typedef coro::coroutine<
 	tVariant (tCoroutineImpl * coroimpl, tCoroutine * coro, tVariant)> risse_coroutine_type;
+typedef coro::abnormal_exit tCoroutineAbnormalExit;
 
 
 /**
@@ -320,7 +1054,7 @@ struct GC_ms_entry *MarkCoroutineContext(
 	return mark_sp;
 }
 
-static const ptrdiff_t StackSize = 65536; //!< スタックサイズ
+static const ptrdiff_t DefaultStackSize = 65536; //!< スタックサイズのデフォルト
 
 } // namespace Risse
 
@@ -583,6 +1317,7 @@ namespace coro = hamigaki::coroutines;
 
 typedef coro::coroutine<
 	tVariant (tCoroutineImpl * coroimpl, tCoroutine * coro, tVariant)> risse_coroutine_type;
+typedef coro::abnormal_exit tCoroutineAbnormalExit;
 
 
 namespace Risse {
@@ -603,7 +1338,7 @@ tCoroutineContext * GetCurrentCoroutineContext(risse_coroutine_type * coro)
 	return p;
 }
 
-static const ptrdiff_t StackSize = -1; //!< スタックサイズ
+static const ptrdiff_t DefaultStackSize = -1; //!< スタックサイズのデフォルト (-1 = プラットフォームのデフォルト)
 
 } // namespace Risse
 //========================================================================
@@ -628,16 +1363,64 @@ static const ptrdiff_t StackSize = -1; //!< スタックサイズ
 namespace Risse
 {
 
+//---------------------------------------------------------------------------
+static risse_size CoroutineStackSize = 0; //!< コルーチンのスタックサイズ (0 = DefaultStackSize)
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 void InitCoroutine()
 {
 #ifdef RISSE_TRACK_FIBERS
 	fibers_critical_section = new tCriticalSection();
 #endif
+#ifdef RISSE_CORO_X86_64
+	StackPool = new tCoroutineStackPool();
+#if defined(GC_PTHREADS)
+	pthread_key_create(&ThreadRecordKey, &RemoveThreadRecord);
+#endif
+	PrevPushOtherRoots = GC_push_other_roots;
+	GC_push_other_roots = &PushCoroutineStacks;
+#endif
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void SetCoroutineStackSize(risse_size size)
+{
+	// 小さすぎるスタックでは最初の切り替えでガードページに触れてしまうので
+	// 切り上げる
+	if(size != 0 && size < MinCoroutineStackSize) size = MinCoroutineStackSize;
+	CoroutineStackSize = size;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size GetCoroutineStackSize()
+{
+	if(CoroutineStackSize) return CoroutineStackSize;
+	return DefaultStackSize < 0 ? 0 : (risse_size)DefaultStackSize;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void SetCoroutineStackPoolSize(risse_size count)
+{
+#ifdef RISSE_CORO_X86_64
+	StackPool->SetMaxPooled(count);
+#else
+	(void)count; // スタックのプールを持たないプラットフォーム
+#endif
 }
 //---------------------------------------------------------------------------
 
 
+class tStacklessCoroutine;
+static void ContinueStackless(risse_coroutine_type::self &self,
+	tStacklessCoroutine * stackless, tVariant & ret);
 //---------------------------------------------------------------------------
 /**
  * コルーチンの本当の実装クラス
@@ -651,13 +1434,16 @@ public:
 
 	risse_coroutine_type::self * CoroutineSelf;
 	tCoroutineContext * Context;
+	tStacklessCoroutine * Stackless; //!< 移行元のスタックレスな実装クラス (移行したのでなければ NULL)
 	bool Alive;
 	bool Running;
 
-	tCoroutineImpl() : Coroutine(Body, StackSize)
+	tCoroutineImpl() : Coroutine(Body,
+		CoroutineStackSize ? (ptrdiff_t)CoroutineStackSize : DefaultStackSize)
 	{
 		CoroutineSelf = NULL;
 		Context = NULL;
+		Stackless = NULL;
 		Alive = true;
 		Running = false;
 	}
@@ -689,7 +1475,12 @@ private:
 
 		try
 		{
-			if(!coro->Function.IsNull())
+			if(coroimpl->Stackless)
+			{
+				// スタックレスで実行していた関数の続きを実行する
+				ContinueStackless(self, coroimpl->Stackless, ret);
+			}
+			else if(!coro->Function.IsNull())
 			{
 				coro->Function.FuncCall(
 					coro->Engine, &ret, tString::GetEmptyString(), 0,
@@ -874,6 +1665,129 @@ struct GC_ms_entry *MarkCoroutinePtr(GC_word *addr,
 
 
 
+//---------------------------------------------------------------------------
+/**
+ * スタックレスなコルーチンの実装クラス
+ * @note	関数をバイトコードインタプリタの中断可能なモードで実行する。
+ *			関数のトップレベルでの yield の呼び出しはインタプリタが横取りし、
+ *			実行位置はヒープ上の tResumableFrame に記録されるので、コルーチンごとの
+ *			スタックは必要ない。
+ */
+class tStacklessCoroutine : public tCollectee
+{
+public:
+	tCodeExecutor * Executor; //!< コード実行クラスのインスタンス
+	tResumableFrame * State; //!< 実行の状態 (実行が終了すると NULL)
+	tVariant FirstArg; //!< 関数の1番目の引数 (最初の Resume の引数)
+	bool Started; //!< 実行を開始したかどうか
+	bool Alive; //!< 生存しているかどうか
+	bool Running; //!< 実行中かどうか
+
+	/**
+	 * コンストラクタ
+	 */
+	tStacklessCoroutine()
+	{
+		Executor = NULL;
+		State = NULL;
+		Started = false;
+		Alive = true;
+		Running = false;
+	}
+
+	/**
+	 * スタックレスなコルーチンを作成する
+	 * @param engine		スクリプトエンジンインスタンス
+	 * @param function		呼び出される関数
+	 * @param function_arg	呼び出される関数の2番目の引数 (コルーチンオブジェクト)
+	 * @return	作成されたオブジェクト (スタックレスで実行できない場合は NULL)
+	 */
+	static tStacklessCoroutine * Create(tScriptEngine * engine,
+		const tVariant & function, const tVariant & function_arg)
+	{
+		if(function.GetType() != tVariant::vtObject) return NULL;
+		if(function_arg.GetType() != tVariant::vtObject) return NULL;
+
+		// tVariant::FuncCall と同じ規則で、関数の本体と this を求める
+		tVariant This = function.SelectContext(0, function_arg);
+		tObjectInterface * intf = function.GetObjectInterface();
+		tFunctionInstance * func = dynamic_cast<tFunctionInstance*>(intf);
+		if(func)
+		{
+			// synchronized な関数はロックを yield をまたいで保持しなければ
+			// ならないので、スタックレスでは実行しない
+			if(func->GetSynchronized()) return NULL;
+			const tVariant & body = func->GetBody();
+			if(body.GetType() != tVariant::vtObject) return NULL;
+			tVariant body_this = body.SelectContext(0, This);
+			This = body_this;
+			intf = body.GetObjectInterface();
+		}
+
+		const tCodeBlock * codeblock;
+		tVariant * frame = NULL;
+		tSharedVariableFrames * shared = NULL;
+		if(tCodeBlockStackAdapter * adapter = dynamic_cast<tCodeBlockStackAdapter*>(intf))
+		{
+			codeblock = adapter->GetCodeBlock();
+			frame = adapter->GetFrame();
+			shared = adapter->GetShared();
+		}
+		else if(tCodeBlock * cb = dynamic_cast<tCodeBlock*>(intf))
+		{
+			codeblock = cb;
+		}
+		else
+		{
+			// ネイティブ関数などはスタックレスでは実行できない
+			return NULL;
+		}
+
+		if(!codeblock->IsSimpleGenerator()) return NULL;
+
+		// 横取りすべき yield メソッドを求める
+		tVariant yield_method = function_arg.GetPropertyDirect(engine, ss_yield, 0, function_arg);
+		if(yield_method.GetType() != tVariant::vtObject) return NULL;
+
+		tStacklessCoroutine * coro = new tStacklessCoroutine();
+		coro->Executor = codeblock->GetExecutor();
+		coro->State = new tResumableFrame();
+		coro->State->Frame = frame;
+		coro->State->Shared = shared;
+		coro->State->Global = codeblock->GetScriptBlockInstance()->GetGlobal();
+		coro->State->This = This;
+		coro->State->YieldMethod = yield_method.GetObjectInterface();
+		coro->State->YieldContext = function_arg.GetObjectInterface();
+		return coro;
+	}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * スタックレスで実行していた関数の続きを、ネイティブなスタックを持つコルーチン上で実行する
+ * @param self			コルーチン内から見た自分自身
+ * @param stackless		移行元のスタックレスな実装クラス
+ * @param ret			関数の戻り値の格納先
+ * @note	トップレベルでの yield は引き続きインタプリタが横取りするので、
+ *			ここで改めて yield する
+ */
+static void ContinueStackless(risse_coroutine_type::self &self,
+	tStacklessCoroutine * stackless, tVariant & ret)
+{
+	tResumableFrame * state = stackless->State;
+	state->OnNativeStack = true;
+	state->Migrating = false;
+
+	tVariant value; // 移行した位置では値は格納されない
+	while(stackless->Executor->Resume(state, value, &ret))
+		value = self.yield(ret).get<2>();
+			// yield の戻りはこの場合tupleになるので、3番目の値を取り出す
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tCoroutine::tCoroutine(tScriptEngine * engine,
 	const tVariant & function, const tVariant arg)
@@ -888,13 +1802,32 @@ tCoroutine::tCoroutine(tScriptEngine * engine,
 	Function = function;
 	FunctionArg = arg;
 
-	Ptr = new tCoroutinePtr();
+	// 実装クラスは最初の Resume() の時点で作成する
+	// (スタックフルな実装クラスは作成した時点でスタックを確保するため)
+	Ptr = NULL;
+	Stackless = NULL;
+	Disposed = false;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tCoroutine::Prepare()
+{
+	if(Ptr || Stackless) return; // すでに決定済み
+
+	Stackless = tStacklessCoroutine::Create(Engine, Function, FunctionArg);
+	if(!Stackless)
+	{
+		// スタックフルで実行する
+		Ptr = new tCoroutinePtr();
 
 #ifdef RISSE_CORO_DEBUG
-	fflush(stdout); fflush(stderr);
-	fprintf(stdout, "made Ptr %p, tCoroutineImpl %p\n", Ptr, Ptr->Impl);
-	fflush(stdout); fflush(stderr);
+		fflush(stdout); fflush(stderr);
+		fprintf(stdout, "made Ptr %p, tCoroutineImpl %p\n", Ptr, Ptr->Impl);
+		fflush(stdout); fflush(stderr);
 #endif
+	}
 }
 //---------------------------------------------------------------------------
 
@@ -902,7 +1835,7 @@ tCoroutine::tCoroutine(tScriptEngine * engine,
 //---------------------------------------------------------------------------
 tVariant tCoroutine::Resume(const tVariant &arg)
 {
-	if(!Ptr)
+	if(Disposed)
 	{
 		// コルーチンは dispose() 済み
 		tInaccessibleResourceExceptionClass::Throw();
@@ -914,6 +1847,9 @@ tVariant tCoroutine::Resume(const tVariant &arg)
 		tCoroutineExceptionClass::ThrowCoroutineHasAlreadyExited();
 	}
 
+	Prepare();
+	if(Stackless) return ResumeStackless(arg);
+
 	if(Ptr->Impl->Running)
 	{
 		// コルーチンはすでに実行中
@@ -927,7 +1863,7 @@ tVariant tCoroutine::Resume(const tVariant &arg)
 		// コルーチンの実行
 		ret = Ptr->Impl->Coroutine(Ptr->Impl, this, arg);
 	}
-	catch(coro::abnormal_exit & e)
+	catch(tCoroutineAbnormalExit & e)
 	{
 		// コルーチン中で例外が発生した場合はこれ。
 		Ptr->Impl->Running = false;
@@ -944,28 +1880,108 @@ tVariant tCoroutine::Resume(const tVariant &arg)
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+tVariant tCoroutine::ResumeStackless(const tVariant &arg)
+{
+	if(Stackless->Running)
+	{
+		// コルーチンはすでに実行中
+		tCoroutineExceptionClass::ThrowCoroutineIsRunning();
+	}
+
+	tResumableFrame * state = Stackless->State;
+	if(!Stackless->Started)
+	{
+		// 初回
+		// 引数は tResumableFrame 中に保持されるので、ヒープ上に作成する
+		Stackless->FirstArg = arg;
+		tMethodArgument & args = tMethodArgument::Allocate(2);
+		args.SetArgument(0, &Stackless->FirstArg);
+		args.SetArgument(1, &FunctionArg);
+		state->Args = &args;
+		Stackless->Started = true;
+	}
+
+	Stackless->Running = true;
+	tVariant ret;
+	bool suspended;
+	try
+	{
+		// コルーチンの実行
+		suspended = Stackless->Executor->Resume(state, arg, &ret);
+	}
+	catch(...)
+	{
+		// コルーチン中で例外が発生した
+		Stackless->Running = false;
+		Stackless->Alive = false;
+		Stackless->State = NULL;
+		throw;
+	}
+	Stackless->Running = false;
+	if(!suspended)
+	{
+		// 実行が終了した
+		Stackless->Alive = false;
+		Stackless->State = NULL;
+	}
+	else if(state->Migrating)
+	{
+		// スクリプトのコードを呼び出す可能性のある命令の手前で中断した。
+		// 呼び出された先から yield される可能性があるので、ここからは
+		// ネイティブなスタックを持つコルーチン上で続きを実行する
+		Ptr = new tCoroutinePtr();
+		Ptr->Impl->Stackless = Stackless;
+		Stackless = NULL;
+		return Resume(arg); // 移行した位置では arg は使われない
+	}
+	return ret;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tVariant tCoroutine::DoYield(const tVariant &arg)
 {
-#ifdef RISSE_CORO_DEBUG
-	fflush(stdout); fflush(stderr);
-	fprintf(stdout, "in tCoroutine::DoYield: tCoroutineImpl %p: Alive(%s), Running(%s)\n", Ptr->Impl, Ptr->Impl->Alive?"true":"false", Ptr->Impl->Running?"true":"false");
-	fflush(stdout); fflush(stderr);
-#endif
-	if(!Ptr)
+	if(Disposed)
 	{
 		// コルーチンは dispose() 済み
 		tInaccessibleResourceExceptionClass::Throw();
 	}
 
-
 	if(!GetAlive())
 	{
 		// コルーチンは無効
 		tCoroutineExceptionClass::ThrowCoroutineHasAlreadyExited();
 	}
 
-	if(!Ptr->Impl->CoroutineSelf)
+	if(Stackless)
+	{
+		if(!Stackless->Started)
+		{
+			// コルーチンは開始していない
+			tCoroutineExceptionClass::ThrowCoroutineHasNotStartedYet();
+		}
+
+		// トップレベルでの yield はインタプリタが横取りし、入れ子になった
+		// 関数を呼び出す前にはネイティブなスタックへ移行するので、スタックレスで
+		// 実行中のコルーチンに対する yield がここに来ることはない
+		RISSE_ASSERT(!Stackless->Running);
+
+		// コルーチンは待ちの状態 (実行中でない)
+		tCoroutineExceptionClass::ThrowCoroutineIsNotRunning();
+	}
+
+#ifdef RISSE_CORO_DEBUG
+	if(Ptr)
+	{
+		fflush(stdout); fflush(stderr);
+		fprintf(stdout, "in tCoroutine::DoYield: tCoroutineImpl %p: Alive(%s), Running(%s)\n", Ptr->Impl, Ptr->Impl->Alive?"true":"false", Ptr->Impl->Running?"true":"false");
+		fflush(stdout); fflush(stderr);
+	}
+#endif
+
+	if(!Ptr || !Ptr->Impl->CoroutineSelf)
 	{
 		// コルーチンは開始していない
 		tCoroutineExceptionClass::ThrowCoroutineHasNotStartedYet();
@@ -986,7 +2002,10 @@ tVariant tCoroutine::DoYield(const tVariant &arg)
 //---------------------------------------------------------------------------
 bool tCoroutine::GetAlive() const
 {
-	return Ptr && Ptr->Impl->Alive;
+	if(Disposed) return false;
+	if(Stackless) return Stackless->Alive;
+	if(Ptr) return Ptr->Impl->Alive;
+	return true; // まだ開始していない
 }
 //---------------------------------------------------------------------------
 
@@ -996,18 +2015,30 @@ void tCoroutine::Dispose()
 {
 	if(GetAlive())
 	{
-		if(Ptr->Impl->Running)
+		if(Stackless ? Stackless->Running : (Ptr && Ptr->Impl->Running))
 		{
 			// コルーチンはすでに実行中
 			// 実行中のコルーチンは dispose できない
 			tCoroutineExceptionClass::ThrowCoroutineIsRunning();
 		}
-		delete Ptr->Impl;
+		if(Ptr) delete Ptr->Impl;
 		Ptr = NULL; // Ptr のデストラクタは今のところ呼んではならない
+		Stackless = NULL;
+		Disposed = true;
 	}
 }
 //---------------------------------------------------------------------------
 
+
+//---------------------------------------------------------------------------
+bool tCoroutine::GetStackless()
+{
+	if(Disposed) return false;
+	Prepare();
+	return Stackless != NULL;
+}
+//---------------------------------------------------------------------------
+
 //---------------------------------------------------------------------------
 } // namespace Risse
 
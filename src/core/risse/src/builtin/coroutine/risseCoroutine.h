@@ -18,7 +18,7 @@
 #include "../../risseGC.h"
 #include "../../risseVariant.h"
 
-#define RISSE_CORO_DEBUG
+// #define RISSE_CORO_DEBUG
 // #define RISSE_TRACK_FIBERS
 
 
@@ -36,19 +36,67 @@ void InitCoroutine();
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+static const risse_size MinCoroutineStackSize = 16384; //!< コルーチンのスタックサイズの最小値 (ガードページを含まない)
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * コルーチンのスタックサイズを設定する
+ * @param size	スタックサイズ(バイト; 0 = プラットフォームのデフォルト)
+ * @note	設定以降に作成されるコルーチンにのみ影響する。
+ *			0 以外で MinCoroutineStackSize より小さい値は MinCoroutineStackSize
+ *			に切り上げられる。
+ */
+void SetCoroutineStackSize(risse_size size);
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * コルーチンのスタックサイズを得る
+ * @return	スタックサイズ(バイト; 0 = プラットフォームのデフォルト)
+ */
+risse_size GetCoroutineStackSize();
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 再利用のために保持しておくコルーチンのスタックの最大数を設定する
+ * @param count	最大数 (0 = 保持しない)
+ * @note	コルーチンのスタックを自前で確保するプラットフォームでのみ意味を持つ
+ */
+void SetCoroutineStackPoolSize(risse_size count);
+//---------------------------------------------------------------------------
+
+
 class tCoroutineImpl;
 class tCoroutinePtr;
+class tStacklessCoroutine;
 //---------------------------------------------------------------------------
 /**
  * コルーチンの実装クラス
  * @note	コルーチンに関する実装はすべてこのクラス内で隠蔽することにする
+ * @note	呼び出し先の関数が、yield をその関数のトップレベルからしか呼ばない
+ *			単純なジェネレータである場合は、専用のスタックを持たないスタックレスな
+ *			コルーチンとして実行する。そうでない場合 (yield がネストした関数呼び出し
+ *			の中から呼ばれうる場合) は、専用のスタックを持つスタックフルな
+ *			コルーチン (tCoroutineImpl) として実行する。どちらで実行するかは
+ *			最初の Resume() の時点で決まる。スタックレスなコルーチンも、
+ *			スクリプトのコードを呼び出す可能性のある命令に達した時点で
+ *			スタックフルなコルーチンに移行し、続きをそちらで実行する
+ *			(呼び出された先から yield される可能性があるため)。
  */
 class tCoroutine : public tCollectee
 {
 	friend class tCoroutineImpl;
 
 	tScriptEngine * Engine; //!< スクリプトエンジンインスタンス
-	tCoroutinePtr * Ptr; //!< 実装クラス
+	tCoroutinePtr * Ptr; //!< スタックフルな実装クラス (スタックフルで実行を始めるまでは NULL)
+	tStacklessCoroutine * Stackless; //!< スタックレスな実装クラス (スタックレスで実行しない場合は NULL)
+	bool Disposed; //!< Dispose() 済みかどうか
 	tVariant Function; //!< 呼び出し先の関数
 	tVariant FunctionArg; //!< 呼び出し先関数の2番目の引数
 	const tVariant * ExceptionValue; //!< コルーチン中で例外が発生した場合、その値
@@ -96,6 +144,28 @@ public:
 	 */
 	void Dispose();
 
+	/**
+	 * コルーチンがスタックレスで実行されるかどうかを得る
+	 * @return	スタックレスで実行される場合に真
+	 * @note	まだ実行方法が決まっていない場合はここで決定する。
+	 *			スタックレスで開始したコルーチンも、入れ子になった関数を
+	 *			呼び出す時点でネイティブなスタックへ移行し、以降は偽を返す
+	 */
+	bool GetStackless();
+
+private:
+	/**
+	 * コルーチンの実行方法 (スタックレスかスタックフルか) を決定し、実装クラスを作成する
+	 */
+	void Prepare();
+
+	/**
+	 * スタックレスなコルーチンを実行する
+	 * @param arg	呼び出される関数の1番目の引数、あるいは yield メソッドの
+	 *				戻り値となる値
+	 * @return	yield された値 (実行が終了した場合は関数の戻り値)
+	 */
+	tVariant ResumeStackless(const tVariant &arg);
 };
 //---------------------------------------------------------------------------
 
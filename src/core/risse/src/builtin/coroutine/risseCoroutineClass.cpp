@@ -93,7 +93,6 @@ tVariant tCoroutineInstance::yield(const tMethodArgument & args) const
 {
 	volatile tSynchronizer sync(this); // sync
 
-	GC_gcollect();
 #ifdef RISSE_CORO_DEBUG
 	fflush(stdout); fflush(stderr);
 	fprintf(stdout, "in tCoroutineInstance::yield b: tCoroutine %p: tCoroutineInstance %p\n",
@@ -133,6 +132,33 @@ bool tCoroutineInstance::get_alive() const
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+bool tCoroutineInstance::get_stackless() const
+{
+	volatile tSynchronizer sync(this); // sync
+
+	return Coroutine->GetStackless();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_int64 tCoroutineInstance::get_stackSize()
+{
+	return (risse_int64)GetCoroutineStackSize();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tCoroutineInstance::set_stackSize(risse_int64 size)
+{
+	// 0 (あるいは負の値) を指定するとプラットフォームのデフォルトに戻る
+	SetCoroutineStackSize(size > 0 ? (risse_size)size : 0);
+}
+//---------------------------------------------------------------------------
+
+
 
 
 
@@ -144,6 +170,8 @@ RISSE_IMPL_CLASS_BEGIN(tCoroutineClass, ss_Coroutine, engine->ObjectClass)
 	BindFunction(this, ss_yield, &tCoroutineInstance::yield);
 	BindFunction(this, ss_dispose, &tCoroutineInstance::dispose);
 	BindProperty(this, ss_alive, &tCoroutineInstance::get_alive);
+	BindProperty(this, ss_stackless, &tCoroutineInstance::get_stackless);
+	BindProperty(this, ss_stackSize, &tCoroutineInstance::get_stackSize, &tCoroutineInstance::set_stackSize);
 RISSE_IMPL_CLASS_END()
 //---------------------------------------------------------------------------
 
@@ -51,6 +51,9 @@ public: // Risse用メソッドなど
 	tVariant yield(const tMethodArgument & args) const;
 	void dispose() const;
 	bool get_alive() const;
+	bool get_stackless() const;
+	static risse_int64 get_stackSize();
+	static void set_stackSize(risse_int64 size);
 };
 //---------------------------------------------------------------------------
 
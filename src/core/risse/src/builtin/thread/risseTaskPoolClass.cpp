@@ -0,0 +1,343 @@
+/*---------------------------------------------------------------------------*/
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief Risse用 "Future" クラスと "TaskPool" クラスの実装
+//---------------------------------------------------------------------------
+#include "../../prec.h"
+#include "../../risseTypes.h"
+#include "risseTaskPoolClass.h"
+#include "../../risseTaskPool.h"
+#include "../../risseStaticStrings.h"
+#include "../../risseObjectClass.h"
+#include "../../risseArrayClass.h"
+#include "../../risseScriptEngine.h"
+#include "../../risseExceptionClass.h"
+
+/*
+	Risseスクリプトから見える "Future" クラスと "TaskPool" クラスの実装
+
+	Future.new() { ... } はブロックをタスクプールで実行し、get() でその
+	戻り値を得る。TaskPool.map(array) { |value, index| ... } と
+	TaskPool.each(array) { |value, index| ... } は配列の各要素に対して
+	ブロックをタスクプールで並列に実行する。
+*/
+
+namespace Risse
+{
+RISSE_DEFINE_SOURCE_ID(6721,48013,22157,18830,39046,2217,60519,31784);
+
+
+//---------------------------------------------------------------------------
+/**
+ * Risseスクリプトのメソッドをタスクプールで実行するタスク
+ */
+class tScriptTask : public tTask
+{
+	tScriptEngine * Engine; //!< スクリプトエンジンインスタンス
+	tVariant Method; //!< 実行するメソッド
+	tVariant Ret; //!< メソッドの戻り値
+	const tVariant * Exception; //!< 例外が発生した場合の例外オブジェクト
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param engine	スクリプトエンジンインスタンス
+	 * @param method	実行するメソッド
+	 */
+	tScriptTask(tScriptEngine * engine, const tVariant & method)
+	{
+		Engine = engine;
+		Method = method;
+		Exception = NULL;
+	}
+
+	/**
+	 * メソッドの戻り値を得る
+	 * @return	メソッドの戻り値
+	 * @note	例外が発生していた場合はそれを再び投げる
+	 */
+	const tVariant & GetResult() const
+	{
+		if(Exception) throw Exception;
+		return Ret;
+	}
+
+protected:
+	/**
+	 * タスクの処理
+	 */
+	void Execute()
+	{
+		try
+		{
+			try
+			{
+				Method.FuncCall(Engine, &Ret);
+			}
+			catch(const tTemporaryException * te)
+			{
+				te->ThrowConverted(Engine);
+			}
+		}
+		catch(const tVariant * e)
+		{
+			Exception = e;
+		}
+	}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 配列の要素の範囲に対して Risseスクリプトのメソッドを実行するタスク
+ */
+class tScriptRangeTask : public tTask
+{
+	tScriptEngine * Engine; //!< スクリプトエンジンインスタンス
+	const tVariant * Method; //!< 実行するメソッド
+	const gc_vector<tVariant> * Values; //!< 配列の要素
+	gc_vector<tVariant> * Results; //!< 戻り値の格納先 (NULL=戻り値は必要なし)
+	risse_size Begin; //!< 範囲の開始インデックス
+	risse_size End; //!< 範囲の終了インデックス (この位置は含まない)
+	const tVariant * Exception; //!< 例外が発生した場合の例外オブジェクト
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param engine	スクリプトエンジンインスタンス
+	 * @param method	実行するメソッド
+	 * @param values	配列の要素
+	 * @param results	戻り値の格納先 (NULL=戻り値は必要なし)
+	 * @param begin		範囲の開始インデックス
+	 * @param end		範囲の終了インデックス (この位置は含まない)
+	 * @note	method, values, results はタスクが完了するまで存在していること
+	 */
+	tScriptRangeTask(tScriptEngine * engine, const tVariant * method,
+		const gc_vector<tVariant> * values, gc_vector<tVariant> * results,
+		risse_size begin, risse_size end)
+	{
+		Engine = engine;
+		Method = method;
+		Values = values;
+		Results = results;
+		Begin = begin;
+		End = end;
+		Exception = NULL;
+	}
+
+	/**
+	 * 例外が発生した場合の例外オブジェクトを得る
+	 * @return	例外オブジェクト (例外が発生していない場合は NULL)
+	 */
+	const tVariant * GetException() const { return Exception; }
+
+protected:
+	/**
+	 * タスクの処理
+	 */
+	void Execute()
+	{
+		try
+		{
+			try
+			{
+				for(risse_size i = Begin; i < End; i++)
+				{
+					// 各要素は一つのタスクからしか書き込まれないので
+					// Results の保護は必要ない
+					tVariant ret;
+					Method->FuncCall(Engine, &ret, 0,
+						tMethodArgument::New((*Values)[i], tVariant((risse_int64)i)));
+					if(Results) (*Results)[i] = ret;
+				}
+			}
+			catch(const tTemporaryException * te)
+			{
+				te->ThrowConverted(Engine);
+			}
+		}
+		catch(const tVariant * e)
+		{
+			// 例外が発生した場合はこのタスクの残りの要素は実行しない
+			Exception = e;
+		}
+	}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 配列の各要素に対してブロックをタスクプールで並列に実行する
+ * @param info		ネイティブメソッドの呼び出し情報
+ * @param results	戻り値の格納先 (NULL=戻り値は必要なし)
+ */
+static void ParallelForEach(const tNativeCallInfo & info, gc_vector<tVariant> * results)
+{
+	// ワーカースレッドあたりのタスクの数
+	// 要素ごとの処理時間にばらつきがあってもワーカースレッド間で
+	// 負荷が偏らないよう、ワーカースレッドの数よりも多めに分割する
+	const risse_size tasks_per_worker = 4;
+
+	info.args.ExpectArgumentCount(1);
+	info.args.ExpectBlockArgumentCount(1);
+	const tVariant & method = info.args.GetBlockArgument(0);
+
+	// 配列の要素を取り出す
+	// (配列は複数のスレッドから同時に読み出せないので、先にすべて取り出しておく)
+	gc_vector<tVariant> values;
+	tEnumerableIterator it(info.args[0]);
+	values.reserve(it.GetCount());
+	while(it.Next()) values.push_back(it.GetValue());
+
+	risse_size count = values.size();
+	if(results) results->resize(count);
+	if(count == 0) return;
+
+	// 範囲ごとのタスクに分割して実行する
+	tTaskPool & pool = tTaskPool::GetInstance();
+	risse_size task_count = pool.GetWorkerCount() * tasks_per_worker;
+	if(task_count > count) task_count = count;
+
+	gc_vector<tScriptRangeTask *> tasks;
+	tasks.reserve(task_count);
+	for(risse_size n = 0; n < task_count; n++)
+	{
+		tScriptRangeTask * task = new tScriptRangeTask(info.engine, &method,
+			&values, results, count * n / task_count, count * (n + 1) / task_count);
+		tasks.push_back(task);
+		pool.Submit(task);
+	}
+
+	// すべてのタスクの完了を待つ
+	for(risse_size n = 0; n < task_count; n++)
+		pool.Wait(tasks[n]);
+
+	// 例外が発生していた場合は最初の物を再び投げる
+	for(risse_size n = 0; n < task_count; n++)
+		if(tasks[n]->GetException()) throw tasks[n]->GetException();
+}
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+tFutureInstance::tFutureInstance()
+{
+	Task = NULL;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFutureInstance::construct()
+{
+	// 特にやることはない
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tFutureInstance::initialize(const tNativeCallInfo & info)
+{
+	volatile tSynchronizer sync(this); // sync
+
+	// 親クラスの同名メソッドを呼び出す
+	info.InitializeSuperClass();
+
+	// ブロック引数をタスクプールで実行する
+	info.args.ExpectBlockArgumentCount(1);
+	Task = new tScriptTask(info.engine, info.args.GetBlockArgument(0));
+	tTaskPool::GetInstance().Submit(Task);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tVariant tFutureInstance::get() const
+{
+	// タスクの完了を待機する
+	if(!Task) return tVariant();
+	tTaskPool::GetInstance().Wait(Task);
+	return Task->GetResult();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tFutureInstance::get_done() const
+{
+	return !Task || Task->GetDone();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+RISSE_IMPL_CLASS_BEGIN(tFutureClass, ss_Future, engine->ObjectClass)
+	RISSE_BIND_CONSTRUCTORS
+	BindFunction(this, ss_get, &tFutureInstance::get);
+	BindProperty(this, ss_done, &tFutureInstance::get_done);
+RISSE_IMPL_CLASS_END()
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+tVariant tTaskPoolClass::map(const tNativeCallInfo & info)
+{
+	gc_vector<tVariant> results;
+	ParallelForEach(info, &results);
+
+	tVariant array = tVariant(info.engine->ArrayClass).New();
+	for(gc_vector<tVariant>::iterator i = results.begin(); i != results.end(); i++)
+		array.Invoke(info.engine, ss_push, *i);
+	return array;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tTaskPoolClass::each(const tNativeCallInfo & info)
+{
+	ParallelForEach(info, NULL);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_int64 tTaskPoolClass::get_workerCount()
+{
+	return (risse_int64)tTaskPool::GetInstance().GetWorkerCount();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+RISSE_IMPL_CLASS_BEGIN(tTaskPoolClass, ss_TaskPool, engine->ObjectClass)
+	BindFunction(this, ss_map, &tTaskPoolClass::map);
+	BindFunction(this, ss_each, &tTaskPoolClass::each);
+	BindProperty(this, ss_workerCount, &tTaskPoolClass::get_workerCount);
+RISSE_IMPL_CLASS_END()
+//---------------------------------------------------------------------------
+
+
+
+} /* namespace Risse */
@@ -0,0 +1,76 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief Risse用 "Future" クラスと "TaskPool" クラスの実装
+//---------------------------------------------------------------------------
+
+#ifndef risseTaskPoolClassH
+#define risseTaskPoolClassH
+
+#include "../../risseObject.h"
+#include "../../risseClass.h"
+#include "../../risseGC.h"
+
+namespace Risse
+{
+class tScriptTask;
+//---------------------------------------------------------------------------
+/**
+ * "Future" クラスのインスタンス用 C++クラス
+ */
+class tFutureInstance : public tObjectBase
+{
+private:
+	tScriptTask * Task; //!< タスクプールで実行されるタスク
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tFutureInstance();
+
+	/**
+	 * ダミーのデストラクタ(おそらく呼ばれない)
+	 */
+	virtual ~tFutureInstance() {;}
+
+public: // Risse用メソッドなど
+	void construct();
+	void initialize(const tNativeCallInfo & info);
+	tVariant get() const;
+	bool get_done() const;
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * "Future" クラス
+ */
+RISSE_DEFINE_CLASS_BEGIN(tFutureClass, tClassBase, tFutureInstance, itNormal)
+RISSE_DEFINE_CLASS_END()
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * "TaskPool" クラス
+ */
+RISSE_DEFINE_CLASS_BEGIN(tTaskPoolClass, tClassBase, tObjectBase, itNormal)
+public: // Risse用メソッドなど
+	static tVariant map(const tNativeCallInfo & info);
+	static void each(const tNativeCallInfo & info);
+	static risse_int64 get_workerCount();
+RISSE_DEFINE_CLASS_END()
+//---------------------------------------------------------------------------
+} // namespace Risse
+
+
+#endif
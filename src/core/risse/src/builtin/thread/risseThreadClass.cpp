@@ -14,6 +14,7 @@
 #include "../../risseTypes.h"
 #include "risseThreadClass.h"
 #include "../../risseThread.h"
+#include "../../risseTaskPool.h"
 #include "../../risseStaticStrings.h"
 #include "../../risseObjectClass.h"
 #include "../../risseScriptEngine.h"
@@ -289,6 +290,8 @@ tThreadPackageInitializer::tThreadPackageInitializer() :
 	tBuiltinPackageInitializer(ss_thread)
 {
 	ThreadClass = NULL;
+	FutureClass = NULL;
+	TaskPoolClass = NULL;
 }
 //---------------------------------------------------------------------------
 
@@ -299,6 +302,14 @@ void tThreadPackageInitializer::Initialize(tScriptEngine * engine, const tString
 {
 	ThreadClass = new tThreadClass(engine);
 	ThreadClass->RegisterInstance(global);
+	FutureClass = new tFutureClass(engine);
+	FutureClass->RegisterInstance(global);
+	TaskPoolClass = new tTaskPoolClass(engine);
+	TaskPoolClass->RegisterInstance(global);
+
+	// タスクプールのインスタンスはメインスレッドで作成しておく
+	// (ワーカースレッドは最初にタスクが積まれるまで作成されない)
+	tTaskPool::GetInstance();
 }
 //---------------------------------------------------------------------------
 
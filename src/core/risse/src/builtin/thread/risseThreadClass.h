@@ -18,6 +18,7 @@
 #include "../../risseClass.h"
 #include "../../risseGC.h"
 #include "../risseBuiltinPackageInitializer.h"
+#include "risseTaskPoolClass.h"
 
 namespace Risse
 {
@@ -84,6 +85,8 @@ class tThreadPackageInitializer : public tBuiltinPackageInitializer
 {
 public:
 	tThreadClass * ThreadClass;
+	tFutureClass * FutureClass;
+	tTaskPoolClass * TaskPoolClass;
 
 	/**
 	 * コンストラクタ
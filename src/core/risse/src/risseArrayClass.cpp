@@ -55,7 +55,7 @@ void tArrayInstance::initialize(const tNativeCallInfo &info)
 	// 引数を元に配列を構成する
 	// ここの動作は push と同じ
 	for(risse_size i = 0; i < info.args.GetArgumentCount(); i++)
-		Array.push_back(info.args[i]);
+		Array.PushBack(info.args[i]);
 }
 //---------------------------------------------------------------------------
 
@@ -65,10 +65,10 @@ tVariant tArrayInstance::iget(risse_offset ofs_index)
 {
 	volatile tSynchronizer sync(this); // sync
 
-	if(ofs_index < 0) ofs_index += Array.size(); // 折り返す
+	if(ofs_index < 0) ofs_index += Array.GetSize(); // 折り返す
 
 	risse_size index = static_cast<risse_size>(ofs_index);
-	if(ofs_index < 0 || index >= Array.size())
+	if(ofs_index < 0 || index >= Array.GetSize())
 	{
 		// 範囲外
 		// default の値を得て、それを返す
@@ -76,7 +76,7 @@ tVariant tArrayInstance::iget(risse_offset ofs_index)
 	}
 
 	// 値を返す
-	return Array[index];
+	return Array.Get(index);
 }
 //---------------------------------------------------------------------------
 
@@ -86,33 +86,33 @@ void tArrayInstance::iset(const tVariant & value, risse_offset ofs_index)
 {
 	volatile tSynchronizer sync(this); // sync
 
-	if(ofs_index < 0) ofs_index += Array.size(); // 折り返す
+	if(ofs_index < 0) ofs_index += Array.GetSize(); // 折り返す
 
 	if(ofs_index < 0)  { /* それでもまだ負: TOOD: out of bound 例外 */ return; }
 
 	risse_size index = static_cast<risse_size>(ofs_index);
-	if(index >= Array.size())
+	if(index >= Array.GetSize())
 	{
 		// 配列を拡張する
 		// もし、拡張する際に値を埋める必要があるならば
 		// 値を埋める
-		if(index > Array.size())
+		if(index > Array.GetSize())
 		{
 			// filler で埋める
-			Array.resize(index+1, GetPropertyDirect(ss_filler));
+			Array.Resize(index+1, GetPropertyDirect(ss_filler));
 
 			// 値の上書き
-			Array[index] = value;
+			Array.Set(index, value);
 		}
-		else /* if index == Array.size() */
+		else /* if index == Array.GetSize() */
 		{
-			Array.push_back(value);
+			Array.PushBack(value);
 		}
 	}
 	else
 	{
 		// 既存の値の上書き
-		Array[index] = value;
+		Array.Set(index, value);
 	}
 }
 //---------------------------------------------------------------------------
@@ -124,7 +124,7 @@ void tArrayInstance::push(const tMethodArgument & args)
 	volatile tSynchronizer sync(this); // sync
 
 	for(risse_size i = 0; i < args.GetArgumentCount(); i++)
-		Array.push_back(args[i]);
+		Array.PushBack(args[i]);
 }
 //---------------------------------------------------------------------------
 
@@ -134,12 +134,9 @@ tVariant tArrayInstance::pop()
 {
 	volatile tSynchronizer sync(this); // sync
 
-	if(Array.size() > 0)
+	if(Array.GetSize() > 0)
 	{
-		tVariant val;
-		val = Array.back();
-		Array.pop_back();
-		return val;
+		return Array.PopBack();
 	}
 	else
 	{
@@ -155,7 +152,7 @@ void tArrayInstance::unshift(const tMethodArgument & args)
 	volatile tSynchronizer sync(this); // sync
 
 	risse_size i = args.GetArgumentCount();
-	while(i--) Array.push_front(args[i]);
+	while(i--) Array.PushFront(args[i]);
 }
 //---------------------------------------------------------------------------
 
@@ -165,12 +162,9 @@ tVariant tArrayInstance::shift()
 {
 	volatile tSynchronizer sync(this); // sync
 
-	if(Array.size() > 0)
+	if(Array.GetSize() > 0)
 	{
-		tVariant val;
-		val = Array.front();
-		Array.pop_front();
-		return val;
+		return Array.PopFront();
 	}
 	else
 	{
@@ -185,7 +179,7 @@ size_t tArrayInstance::get_length() const
 {
 	volatile tSynchronizer sync(this); // sync
 
-	return Array.size();
+	return Array.GetSize();
 }
 //---------------------------------------------------------------------------
 
@@ -195,15 +189,15 @@ void tArrayInstance::set_length(size_t new_size)
 {
 	volatile tSynchronizer sync(this); // sync
 
-	if(Array.size() < new_size)
+	if(Array.GetSize() < new_size)
 	{
 		// 拡張
-		Array.resize(new_size, GetPropertyDirect(ss_filler));
+		Array.Resize(new_size, GetPropertyDirect(ss_filler));
 	}
 	else
 	{
 		// 縮小
-		Array.resize(new_size);
+		Array.Resize(new_size, tVariant());
 	}
 }
 //---------------------------------------------------------------------------
@@ -216,11 +210,12 @@ tString tArrayInstance::join(const tMethodArgument & args)
 	volatile tSynchronizer sync(this); // sync
 
 	tString ret;
-	for(tArray::iterator i = Array.begin(); i != Array.end(); i++)
+	risse_size size = Array.GetSize();
+	for(risse_size i = 0; i < size; i++)
 	{
-		if(i != Array.begin() && args.HasArgument(0))
+		if(i != 0 && args.HasArgument(0))
 			ret += args[0].operator tString();
-		ret += (*i).operator tString();
+		ret += Array.Get(i).operator tString();
 	}
 	return ret;
 }
@@ -238,18 +233,12 @@ tVariant tArrayInstance::remove(const tVariant & value, const tMethodArgument &
 
 	volatile tSynchronizer sync(this); // sync
 
-	for(tArray::iterator i = Array.begin(); i != Array.end(); /**/)
+	risse_size i = 0;
+	while((i = Array.Find(value, i)) != risse_size_max)
 	{
-		if(i->DiscEqual(value))
-		{
-			i = Array.erase(i);
-			any_removed = true;
-			if(!remove_all) break;
-		}
-		else
-		{
-			i++;
-		}
+		Array.Erase(i);
+		any_removed = true;
+		if(!remove_all) break;
 	}
 
 	return any_removed ? value : GetPropertyDirect(ss_default);
@@ -263,14 +252,14 @@ tVariant tArrayInstance::erase(risse_offset ofs_index)
 	// 配列中の idx にある要素を削除する
 	volatile tSynchronizer sync(this); // sync
 
-	if(ofs_index < 0) ofs_index += Array.size(); // 折り返す
+	if(ofs_index < 0) ofs_index += Array.GetSize(); // 折り返す
 
 	risse_size index = static_cast<risse_size>(ofs_index);
-	if(index < Array.size() && ofs_index >= 0)
+	if(index < Array.GetSize() && ofs_index >= 0)
 	{
 		// 範囲内であればそこの要素を削除し、そこにあった値を返す
-		tVariant val = Array[index];
-		Array.erase(Array.begin() + index);
+		tVariant val = Array.Get(index);
+		Array.Erase(index);
 		return val;
 	}
 	else
@@ -289,13 +278,7 @@ bool tArrayInstance::has(const tVariant & value)
 	// 比較には === 演算子を用いる
 	volatile tSynchronizer sync(this); // sync
 
-	for(tArray::iterator i = Array.begin(); i != Array.end(); i++)
-	{
-		if(i->DiscEqual(value))
-			return true;
-	}
-
-	return false;
+	return Array.Find(value) != risse_size_max;
 }
 //---------------------------------------------------------------------------
 
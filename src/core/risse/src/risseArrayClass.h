@@ -18,6 +18,7 @@
 #include "risseClass.h"
 #include "risseGC.h"
 #include "risseNativeBinder.h"
+#include "risseArrayStorage.h"
 
 namespace Risse
 {
@@ -28,7 +29,7 @@ namespace Risse
 class tArrayInstance : public tObjectBase
 {
 public:
-	typedef gc_deque<tVariant> tArray; //!< 配列の中身のtypedef
+	typedef tArrayStorage tArray; //!< 配列の中身のtypedef
 
 private:
 	tArray Array; //!< 配列の中身
@@ -0,0 +1,208 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief Array クラスの要素を保持するストレージ
+//---------------------------------------------------------------------------
+#include "prec.h"
+#include "risseArrayStorage.h"
+
+namespace Risse
+{
+RISSE_DEFINE_SOURCE_ID(40531,10457,61866,19214,44680,27107,5123,33380);
+
+
+//---------------------------------------------------------------------------
+void tArrayStorage::PushBack(const tVariant & value)
+{
+	PrepareFor(value);
+	switch(Kind)
+	{
+	case akInteger:	Elements.PushBack<risse_int64>(value.CastToInteger_Integer()); break;
+	case akReal:	Elements.PushBack<risse_real>(value.CastToReal_Real()); break;
+	case akVariant:	Elements.PushBack<tVariant>(value); break;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tArrayStorage::PushFront(const tVariant & value)
+{
+	PrepareFor(value);
+	switch(Kind)
+	{
+	case akInteger:	Elements.PushFront<risse_int64>(value.CastToInteger_Integer()); break;
+	case akReal:	Elements.PushFront<risse_real>(value.CastToReal_Real()); break;
+	case akVariant:	Elements.PushFront<tVariant>(value); break;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tVariant tArrayStorage::PopBack()
+{
+	tVariant val = Get(GetSize() - 1);
+	switch(Kind)
+	{
+	case akInteger:	Elements.PopBack<risse_int64>(); break;
+	case akReal:	Elements.PopBack<risse_real>(); break;
+	case akVariant:	Elements.PopBack<tVariant>(); break;
+	}
+	return val;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tVariant tArrayStorage::PopFront()
+{
+	tVariant val = Get(0);
+	switch(Kind)
+	{
+	case akInteger:	Elements.PopFront<risse_int64>(); break;
+	case akReal:	Elements.PopFront<risse_real>(); break;
+	case akVariant:	Elements.PopFront<tVariant>(); break;
+	}
+	return val;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tArrayStorage::Erase(risse_size index)
+{
+	switch(Kind)
+	{
+	case akInteger:	Elements.Erase<risse_int64>(index); break;
+	case akReal:	Elements.Erase<risse_real>(index); break;
+	case akVariant:	Elements.Erase<tVariant>(index); break;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tArrayStorage::Resize(risse_size new_size, const tVariant & filler)
+{
+	if(new_size > GetSize()) PrepareFor(filler);
+	switch(Kind)
+	{
+	case akInteger:
+		Elements.Resize<risse_int64>(new_size,
+			new_size > Elements.GetSize() ? filler.CastToInteger_Integer() : 0);
+		break;
+	case akReal:
+		Elements.Resize<risse_real>(new_size,
+			new_size > Elements.GetSize() ? filler.CastToReal_Real() : 0.0);
+		break;
+	case akVariant:
+		Elements.Resize<tVariant>(new_size, filler);
+		break;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tArrayStorage::Find(const tVariant & value, risse_size start) const
+{
+	switch(Kind)
+	{
+	case akInteger:
+	  {
+		// integer 以外は === で一致することはない
+		if(value.GetType() != tVariant::vtInteger) return risse_size_max;
+		risse_int64 v = value.CastToInteger_Integer();
+		const risse_int64 * p = Elements.GetElements<risse_int64>();
+		risse_size size = Elements.GetSize();
+		for(risse_size i = start; i < size; i++)
+			if(p[i] == v) return i;
+		return risse_size_max;
+	  }
+
+	case akReal:
+	  {
+		// real 以外は === で一致することはない
+		if(value.GetType() != tVariant::vtReal) return risse_size_max;
+		risse_real v = value.CastToReal_Real();
+		const risse_real * p = Elements.GetElements<risse_real>();
+		risse_size size = Elements.GetSize();
+		for(risse_size i = start; i < size; i++)
+			if(p[i] == v) return i;
+		return risse_size_max;
+	  }
+
+	case akVariant:
+	  {
+		const tVariant * p = Elements.GetElements<tVariant>();
+		risse_size size = Elements.GetSize();
+		for(risse_size i = start; i < size; i++)
+			if(p[i].DiscEqual(value)) return i;
+		return risse_size_max;
+	  }
+	}
+	return risse_size_max;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tArrayStorage::PrepareFor(const tVariant & value)
+{
+	if(Accepts(value)) return;
+
+	// 空の配列ならば、最初に格納される値に合わせて表現を選び直す
+	if(GetSize() == 0)
+	{
+		// (要素が無いので領域を捨てれば別の型として使える)
+		Elements.Clear();
+		switch(value.GetType())
+		{
+		case tVariant::vtInteger:	Kind = akInteger; return;
+		case tVariant::vtReal:		Kind = akReal; return;
+		default:					Kind = akVariant; return;
+		}
+	}
+
+	ConvertToVariant();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tArrayStorage::ConvertToVariant()
+{
+	if(Kind == akVariant) return;
+
+	// パックされた領域から tVariant の領域を新たに作り、差し替える
+	// (古い領域は GC により回収される)
+	risse_size size = GetSize();
+	tArrayBuffer variants;
+	variants.Resize<tVariant>(size, tVariant());
+	switch(Kind)
+	{
+	case akInteger:
+		for(risse_size i = 0; i < size; i++)
+			variants.At<tVariant>(i) = tVariant(Elements.At<risse_int64>(i));
+		break;
+	case akReal:
+		for(risse_size i = 0; i < size; i++)
+			variants.At<tVariant>(i) = tVariant(Elements.At<risse_real>(i));
+		break;
+	case akVariant:
+		break;
+	}
+	Elements.Swap(variants);
+	Kind = akVariant;
+}
+//---------------------------------------------------------------------------
+
+} // namespace Risse
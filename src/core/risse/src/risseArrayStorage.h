@@ -0,0 +1,484 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief Array クラスの要素を保持するストレージ
+//---------------------------------------------------------------------------
+#ifndef risseArrayStorageH
+#define risseArrayStorageH
+
+#include "risseTypes.h"
+#include "risseGC.h"
+#include "risseVariant.h"
+#include <algorithm>
+
+namespace Risse
+{
+/*
+	Array の要素は連続したメモリ領域に格納される。
+
+	領域の先頭と末尾にはそれぞれ余裕が取られ、push/pop だけでなく
+	unshift/shift も償却 O(1) で行うことができる (ギャップバッファ)。
+
+	また、配列の要素がすべて integer、あるいはすべて real である場合は
+	tVariant ではなく risse_int64 や risse_real をそのまま並べた「パックされた」
+	表現を用いる。パックされた表現はポインタを含まないので、GC のスキャン
+	対象にもならない。パックされた表現の配列に異なる型の値が格納されようとした
+	場合は、tVariant を並べた汎用の表現に変換される (逆方向の変換は行わない)。
+*/
+
+
+//---------------------------------------------------------------------------
+/**
+ * tArrayBuffer の要素の特性クラス
+ */
+template <typename T>
+struct tArrayElementTraits;
+//---------------------------------------------------------------------------
+/**
+ * tArrayElementTraits の risse_int64 特化
+ */
+template <>
+struct tArrayElementTraits<risse_int64>
+{
+	enum { IsAtomic = 1 }; //!< ポインタを含まないかどうか
+	static void Construct(risse_int64 * p) { *p = 0; } //!< 要素を初期化する
+	static void Reset(risse_int64 & v) { ; } //!< 使われなくなった要素を破壊する
+};
+//---------------------------------------------------------------------------
+/**
+ * tArrayElementTraits の risse_real 特化
+ */
+template <>
+struct tArrayElementTraits<risse_real>
+{
+	enum { IsAtomic = 1 }; //!< ポインタを含まないかどうか
+	static void Construct(risse_real * p) { *p = 0.0; } //!< 要素を初期化する
+	static void Reset(risse_real & v) { ; } //!< 使われなくなった要素を破壊する
+};
+//---------------------------------------------------------------------------
+/**
+ * tArrayElementTraits の tVariant 特化
+ */
+template <>
+struct tArrayElementTraits<tVariant>
+{
+	enum { IsAtomic = 0 }; //!< ポインタを含まないかどうか
+	static void Construct(tVariant * p) { new (p) tVariant(); } //!< 要素を初期化する
+	static void Reset(tVariant & v) { v.Clear(); }
+		//!< 使われなくなった要素を破壊する(GCにマークされ続けないように)
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 先頭と末尾に余裕を持つ連続領域の配列
+ * @note	スレッド保護無し
+ * @note	要素の型は保持しない。領域は呼び出し側が知っている型 (tArrayStorage の
+ *			Kind) の配列として解釈され、各メソッドの T にはその型を指定すること。
+ *			異なる型で領域にアクセスしてはならない (型を変える場合は Clear() してから)。
+ */
+class tArrayBuffer : public tCollectee
+{
+	union
+	{
+		void * Buffer; //!< 領域
+		risse_int64 * Integers; //!< 領域 (risse_int64 の配列として見た場合)
+		risse_real * Reals; //!< 領域 (risse_real の配列として見た場合)
+		tVariant * Variants; //!< 領域 (tVariant の配列として見た場合)
+	};
+	risse_size Head; //!< 最初の要素の Buffer 内のインデックス
+	risse_size Size; //!< 要素数
+	risse_size Capacity; //!< Buffer に確保されている要素数
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tArrayBuffer() : Buffer(NULL), Head(0), Size(0), Capacity(0) {;}
+
+	/**
+	 * 要素数を得る
+	 * @return	要素数
+	 */
+	risse_size GetSize() const { return Size; }
+
+	/**
+	 * 要素への参照を得る
+	 * @param index	インデックス (範囲内であること)
+	 * @return	要素への参照
+	 */
+	template <typename T>
+	T & At(risse_size index)
+		{ RISSE_ASSERT(index < Size); return static_cast<T*>(Buffer)[Head + index]; }
+
+	/**
+	 * 要素へのconst参照を得る
+	 * @param index	インデックス (範囲内であること)
+	 * @return	要素へのconst参照
+	 */
+	template <typename T>
+	const T & At(risse_size index) const
+		{ RISSE_ASSERT(index < Size); return static_cast<const T*>(Buffer)[Head + index]; }
+
+	/**
+	 * 最初の要素へのポインタを得る
+	 * @return	最初の要素へのポインタ (要素が無い場合は無効なポインタの可能性がある)
+	 * @note	要素を追加/削除するとこのポインタは無効になる
+	 */
+	template <typename T>
+	const T * GetElements() const { return static_cast<const T*>(Buffer) + Head; }
+
+	/**
+	 * 末尾に要素を追加する
+	 * @param value	値
+	 */
+	template <typename T>
+	void PushBack(const T & value)
+	{
+		if(Head + Size >= Capacity) MakeRoom<T>(false);
+		static_cast<T*>(Buffer)[Head + Size] = value;
+		Size ++;
+	}
+
+	/**
+	 * 先頭に要素を追加する
+	 * @param value	値
+	 */
+	template <typename T>
+	void PushFront(const T & value)
+	{
+		if(Head == 0) MakeRoom<T>(true);
+		Head --;
+		static_cast<T*>(Buffer)[Head] = value;
+		Size ++;
+	}
+
+	/**
+	 * 末尾の要素を削除する
+	 */
+	template <typename T>
+	void PopBack()
+	{
+		RISSE_ASSERT(Size > 0);
+		Size --;
+		tArrayElementTraits<T>::Reset(static_cast<T*>(Buffer)[Head + Size]);
+	}
+
+	/**
+	 * 先頭の要素を削除する
+	 */
+	template <typename T>
+	void PopFront()
+	{
+		RISSE_ASSERT(Size > 0);
+		tArrayElementTraits<T>::Reset(static_cast<T*>(Buffer)[Head]);
+		Head ++;
+		Size --;
+	}
+
+	/**
+	 * 指定位置の要素を削除する
+	 * @param index	インデックス (範囲内であること)
+	 */
+	template <typename T>
+	void Erase(risse_size index)
+	{
+		RISSE_ASSERT(index < Size);
+		T * p = static_cast<T*>(Buffer) + Head;
+		if(index < Size / 2)
+		{
+			// 前半の要素を後ろにずらす
+			for(risse_size i = index; i > 0; i--) p[i] = p[i-1];
+			PopFront<T>();
+		}
+		else
+		{
+			// 後半の要素を前にずらす
+			for(risse_size i = index; i < Size - 1; i++) p[i] = p[i+1];
+			PopBack<T>();
+		}
+	}
+
+	/**
+	 * 要素数を変更する
+	 * @param new_size	新しい要素数
+	 * @param filler	拡張された部分を埋める値
+	 */
+	template <typename T>
+	void Resize(risse_size new_size, const T & filler)
+	{
+		if(new_size > Size)
+		{
+			if(Head + new_size > Capacity) Reallocate<T>(new_size, false);
+			T * p = static_cast<T*>(Buffer);
+			for(risse_size i = Size; i < new_size; i++) p[Head + i] = filler;
+			Size = new_size;
+		}
+		else
+		{
+			while(Size > new_size) PopBack<T>();
+		}
+	}
+
+	/**
+	 * 要素をすべて削除し、領域を解放する
+	 * @note	領域は GC により回収される。この後は別の型として使ってよい
+	 */
+	void Clear()
+	{
+		Buffer = NULL;
+		Head = Size = Capacity = 0;
+	}
+
+	/**
+	 * 内容を交換する
+	 * @param rhs	交換する相手
+	 */
+	void Swap(tArrayBuffer & rhs)
+	{
+		std::swap(Buffer, rhs.Buffer);
+		std::swap(Head, rhs.Head);
+		std::swap(Size, rhs.Size);
+		std::swap(Capacity, rhs.Capacity);
+	}
+
+private:
+	/**
+	 * 先頭あるいは末尾に最低でも1要素分の空きを作る
+	 * @param front	先頭に空きを作る場合に真、末尾の場合に偽
+	 */
+	template <typename T>
+	void MakeRoom(bool front)
+	{
+		if(Size < Capacity / 2)
+		{
+			// 領域の半分以上が空いている; 再確保せずに要素を移動する
+			// (移動する要素数はその後に追加可能な要素数以下なので、償却 O(1) となる)
+			risse_size new_head = front ? (Capacity - Size + 1) / 2 : 0;
+			Move<T>(new_head);
+		}
+		else
+		{
+			Reallocate<T>(Size + 1, front);
+		}
+	}
+
+	/**
+	 * 同じ領域内で要素を移動する
+	 * @param new_head	新しい Head
+	 */
+	template <typename T>
+	void Move(risse_size new_head)
+	{
+		typedef tArrayElementTraits<T> tTraits;
+		T * p = static_cast<T*>(Buffer);
+		if(new_head < Head)
+		{
+			for(risse_size i = 0; i < Size; i++)
+				p[new_head + i] = p[Head + i];
+			for(risse_size i = (new_head + Size > Head ? new_head + Size : Head);
+				i < Head + Size; i++)
+				tTraits::Reset(p[i]);
+		}
+		else if(new_head > Head)
+		{
+			for(risse_size i = Size; i > 0; i--)
+				p[new_head + i - 1] = p[Head + i - 1];
+			for(risse_size i = Head;
+				i < (Head + Size < new_head ? Head + Size : new_head); i++)
+				tTraits::Reset(p[i]);
+		}
+		Head = new_head;
+	}
+
+	/**
+	 * 領域を再確保する
+	 * @param min_size	最低限格納できなければならない要素数
+	 * @param front		先頭に空きを作る場合に真、末尾の場合に偽
+	 */
+	template <typename T>
+	void Reallocate(risse_size min_size, bool front)
+	{
+		typedef tArrayElementTraits<T> tTraits;
+		risse_size new_capacity = min_size < 4 ? 8 : min_size * 2;
+		T * new_buffer = static_cast<T*>(tTraits::IsAtomic ?
+			MallocAtomicCollectee(sizeof(T) * new_capacity) :
+			MallocCollectee(sizeof(T) * new_capacity));
+		for(risse_size i = 0; i < new_capacity; i++)
+			tTraits::Construct(new_buffer + i);
+
+		risse_size new_head = front ? (new_capacity - Size + 1) / 2 : 0;
+		T * p = static_cast<T*>(Buffer);
+		for(risse_size i = 0; i < Size; i++)
+			new_buffer[new_head + i] = p[Head + i];
+
+		Buffer = new_buffer;
+		Head = new_head;
+		Capacity = new_capacity;
+	}
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * Array の要素を保持するストレージ
+ * @note	スレッド保護無し
+ */
+class tArrayStorage : public tCollectee
+{
+public:
+	/**
+	 * 要素の表現
+	 */
+	enum tKind
+	{
+		akInteger,	//!< すべて integer (risse_int64 の配列)
+		akReal,		//!< すべて real (risse_real の配列)
+		akVariant	//!< 汎用 (tVariant の配列)
+	};
+
+private:
+	tKind Kind; //!< 現在の要素の表現
+	tArrayBuffer Elements; //!< 要素 (Kind に応じて risse_int64/risse_real/tVariant の配列として解釈する)
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tArrayStorage() : Kind(akInteger) {;}
+
+	/**
+	 * 現在の要素の表現を得る
+	 * @return	現在の要素の表現
+	 */
+	tKind GetKind() const { return Kind; }
+
+	/**
+	 * 要素数を得る
+	 * @return	要素数
+	 */
+	risse_size GetSize() const { return Elements.GetSize(); }
+
+	/**
+	 * 要素を得る
+	 * @param index	インデックス (範囲内であること)
+	 * @return	要素
+	 */
+	tVariant Get(risse_size index) const
+	{
+		switch(Kind)
+		{
+		case akInteger:	return tVariant(Elements.At<risse_int64>(index));
+		case akReal:	return tVariant(Elements.At<risse_real>(index));
+		case akVariant:	return Elements.At<tVariant>(index);
+		}
+		return tVariant();
+	}
+
+	/**
+	 * 要素を設定する
+	 * @param index	インデックス (範囲内であること)
+	 * @param value	値
+	 */
+	void Set(risse_size index, const tVariant & value)
+	{
+		if(Accepts(value))
+		{
+			switch(Kind)
+			{
+			case akInteger:	Elements.At<risse_int64>(index) = value.CastToInteger_Integer(); return;
+			case akReal:	Elements.At<risse_real>(index) = value.CastToReal_Real(); return;
+			case akVariant:	Elements.At<tVariant>(index) = value; return;
+			}
+		}
+		ConvertToVariant();
+		Elements.At<tVariant>(index) = value;
+	}
+
+	/**
+	 * 末尾に要素を追加する
+	 * @param value	値
+	 */
+	void PushBack(const tVariant & value);
+
+	/**
+	 * 先頭に要素を追加する
+	 * @param value	値
+	 */
+	void PushFront(const tVariant & value);
+
+	/**
+	 * 末尾の要素を取り出す
+	 * @return	取り出された要素 (要素があること)
+	 */
+	tVariant PopBack();
+
+	/**
+	 * 先頭の要素を取り出す
+	 * @return	取り出された要素 (要素があること)
+	 */
+	tVariant PopFront();
+
+	/**
+	 * 指定位置の要素を削除する
+	 * @param index	インデックス (範囲内であること)
+	 */
+	void Erase(risse_size index);
+
+	/**
+	 * 要素数を変更する
+	 * @param new_size	新しい要素数
+	 * @param filler	拡張された部分を埋める値
+	 */
+	void Resize(risse_size new_size, const tVariant & filler);
+
+	/**
+	 * 値と === で一致する最初の要素のインデックスを探す
+	 * @param value	値
+	 * @param start	検索を開始するインデックス
+	 * @return	見つかった要素のインデックス(見つからなかった場合は risse_size_max)
+	 */
+	risse_size Find(const tVariant & value, risse_size start = 0) const;
+
+private:
+	/**
+	 * 値を現在の表現のまま格納できるかどうかを返す
+	 * @param value	値
+	 * @return	現在の表現のまま格納できるかどうか
+	 */
+	bool Accepts(const tVariant & value) const
+	{
+		switch(Kind)
+		{
+		case akInteger:	return value.GetType() == tVariant::vtInteger;
+		case akReal:	return value.GetType() == tVariant::vtReal;
+		case akVariant:	return true;
+		}
+		return false;
+	}
+
+	/**
+	 * 値を追加する前に、必要ならば表現を変換する
+	 * @param value	追加しようとしている値
+	 */
+	void PrepareFor(const tVariant & value);
+
+	/**
+	 * 要素の表現を汎用の表現に変換する
+	 */
+	void ConvertToVariant();
+};
+//---------------------------------------------------------------------------
+} // namespace Risse
+
+
+#endif
@@ -15,6 +15,10 @@
 #include "risseCharUtils.h"
 #include "risseString.h"
 
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
 
 namespace Risse
 {
@@ -552,6 +556,136 @@ static bool Utf8ToRisseChar(const char * & in, risse_char *out)
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+/**
+ * UTF-8 文字列中の ASCII 文字の連続を risse_char に変換する
+ * @param out	出力 risse_char 文字列 (NULL可)
+ * @param in	入力 UTF-8 文字列 (変換した分だけ進められる)
+ * @return	変換したコードポイント数
+ * @note	非 ASCII 文字か null 終端に達した時点で戻る。
+ *			スクリプトのソースなどはほとんどが ASCII 文字なので、その部分は
+ *			ここでまとめて処理する。
+ *			SSE2 版は 16 バイト境界にそろえたロードを行うので、null 終端を
+ *			越えて読むことはあってもページ境界を越えて読むことはない。
+ */
+static risse_size ConvertAsciiRunToRisseChar(risse_char * out, const char * & in)
+{
+	const unsigned char * p = reinterpret_cast<const unsigned char *>(in);
+	const unsigned char * start = p;
+
+#ifdef __SSE2__
+	// 16 バイト境界まではバイト単位で処理する
+	while(reinterpret_cast<risse_ptruint>(p) & 0x0f)
+	{
+		if(*p == 0 || *p >= 0x80) goto done;
+		if(out) *(out++) = *p;
+		p++;
+	}
+
+	{
+		const __m128i zero = _mm_setzero_si128();
+		for(;;)
+		{
+			__m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+			// 最上位ビットが立っているバイトや 0 のバイトがあれば抜ける
+			if(_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))
+				break;
+			if(out)
+			{
+				__m128i lo = _mm_unpacklo_epi8(v, zero);
+				__m128i hi = _mm_unpackhi_epi8(v, zero);
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 0 ), _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 4 ), _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 8 ), _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 12), _mm_unpackhi_epi16(hi, zero));
+				out += 16;
+			}
+			p += 16;
+		}
+	}
+#endif
+
+	// 残りをバイト単位で処理する
+	while(*p != 0 && *p < 0x80)
+	{
+		if(out) *(out++) = *p;
+		p++;
+	}
+
+#ifdef __SSE2__
+done:
+#endif
+	in = reinterpret_cast<const char *>(p);
+	return p - start;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * risse_char 文字列中の ASCII 文字の連続を UTF-8 に変換する
+ * @param out		出力 UTF-8 文字列 (NULL可)
+ * @param in		入力 risse_char 文字列 (変換した分だけ進められる)
+ * @param in_len	入力文字列の残りのサイズ (risse_size_max の場合は自動判定)
+ * @return	変換したコードポイント数 (= 出力バイト数)
+ * @note	非 ASCII 文字か null 終端か in_len に達した時点で戻る。
+ */
+static risse_size ConvertAsciiRunToUtf8(char * out, const risse_char * & in, risse_size in_len)
+{
+	const risse_char * p = in;
+	const risse_char * start = p;
+
+#ifdef __SSE2__
+	// 16 バイト境界まではコードポイント単位で処理する
+	while(reinterpret_cast<risse_ptruint>(p) & 0x0f)
+	{
+		if(!in_len || *p <= 0 || *p >= 0x80) goto done;
+		if(out) *(out++) = static_cast<char>(*p);
+		p++;
+		if(in_len != risse_size_max) in_len--;
+	}
+
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i high = _mm_set1_epi32(~0x7f);
+		while(in_len >= 4)
+		{
+			__m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+			// 0x80 以上のコードポイントや 0 があれば抜ける
+			if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(v, high), zero)) != 0xffff ||
+				_mm_movemask_epi8(_mm_cmpeq_epi32(v, zero)))
+				break;
+			if(out)
+			{
+				__m128i w = _mm_packs_epi32(v, v);
+				w = _mm_packus_epi16(w, w);
+				risse_uint32 four = static_cast<risse_uint32>(_mm_cvtsi128_si32(w));
+				memcpy(out, &four, 4);
+				out += 4;
+			}
+			p += 4;
+			if(in_len != risse_size_max) in_len -= 4;
+		}
+	}
+#endif
+
+	// 残りをコードポイント単位で処理する
+	while(in_len && *p > 0 && *p < 0x80)
+	{
+		if(out) *(out++) = static_cast<char>(*p);
+		p++;
+		if(in_len != risse_size_max) in_len--;
+	}
+
+#ifdef __SSE2__
+done:
+#endif
+	in = p;
+	return p - start;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 risse_size ConvertUtf8ToRisseCharString(risse_char *out, const char * in)
 {
@@ -559,6 +693,15 @@ risse_size ConvertUtf8ToRisseCharString(risse_char *out, const char * in)
 	risse_size count = 0;
 	while(*in)
 	{
+		if(!(*in & 0x80))
+		{
+			// ASCII 文字の連続はまとめて処理する
+			risse_size n = ConvertAsciiRunToRisseChar(out, in);
+			count += n;
+			if(out) out += n;
+			continue;
+		}
+
 		risse_char c;
 		if(out)
 		{
@@ -585,6 +728,16 @@ risse_size ConvertCharToUtf8String(char * out, const risse_char * in, risse_size
 	risse_size count = 0;
 	while(in_len && *in)
 	{
+		if(*in > 0 && *in < 0x80)
+		{
+			// ASCII 文字の連続はまとめて処理する
+			risse_size n = ConvertAsciiRunToUtf8(out, in, in_len);
+			count += n;
+			if(out) out += n;
+			if(in_len != risse_size_max) in_len -= n;
+			continue;
+		}
+
 		risse_int n;
 		if(out)
 		{
@@ -16,6 +16,8 @@
 #include "risseScriptBlockClass.h"
 #include "compiler/risseCodeGen.h"
 #include "risseCodeExecutor.h"
+#include "risseOpCodes.h"
+#include "risseStaticStrings.h"
 
 namespace Risse
 {
@@ -41,6 +43,9 @@ tCodeBlock::tCodeBlock(tScriptBlockInstance * sb)
 	TryIdentifierRelocationSize = 0;
 
 	Executor = NULL;
+
+	SimpleGeneratorChecked = false;
+	SimpleGenerator = false;
 }
 //---------------------------------------------------------------------------
 
@@ -88,7 +93,8 @@ void tCodeBlock::Assign(const tCodeGenerator *gen)
 	// CodeBlockRelocations のコピー
 	const gc_vector<std::pair<risse_size, risse_size> > & cb_relocations =
 			gen->GetCodeBlockRelocations();
-	CodeBlockRelocations = new (GC) tRelocation[CodeBlockRelocationSize = cb_relocations.size()];
+	// (再配置情報などはポインタを含まないので atomic な領域に確保する)
+	CodeBlockRelocations = new (PointerFreeGC) tRelocation[CodeBlockRelocationSize = cb_relocations.size()];
 	ind = 0;
 	for(gc_vector<std::pair<risse_size, risse_size> >::const_iterator i =
 		cb_relocations.begin(); i != cb_relocations.end(); i++, ind++)
@@ -97,7 +103,7 @@ void tCodeBlock::Assign(const tCodeGenerator *gen)
 	// TryIdentifierRelocations のコピー
 	const gc_vector<std::pair<risse_size, risse_size> > & ti_relocations =
 			gen->GetTryIdentifierRelocations();
-	TryIdentifierRelocations = new (GC) tRelocation[TryIdentifierRelocationSize = ti_relocations.size()];
+	TryIdentifierRelocations = new (PointerFreeGC) tRelocation[TryIdentifierRelocationSize = ti_relocations.size()];
 	ind = 0;
 	for(gc_vector<std::pair<risse_size, risse_size> >::const_iterator i =
 		ti_relocations.begin(); i != ti_relocations.end(); i++, ind++)
@@ -110,7 +116,7 @@ void tCodeBlock::Assign(const tCodeGenerator *gen)
 
 	// CodeToSourcePosition のコピー
 	const gc_vector<std::pair<risse_size, risse_size> > & cb_code_src = gen->GetCodeToSourcePosition();
-	CodeToSourcePosition = new (GC) std::pair<risse_size, risse_size>[cb_code_src.size()];
+	CodeToSourcePosition = new (PointerFreeGC) std::pair<risse_size, risse_size>[cb_code_src.size()];
 	ind = 0;
 	for(gc_vector<std::pair<risse_size, risse_size> >::const_iterator i = cb_code_src.begin();
 		i != cb_code_src.end(); i++, ind++)
@@ -289,6 +295,173 @@ risse_size tCodeBlock::CodePositionToSourcePosition(risse_size pos) const
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+bool tCodeBlock::IsSimpleGenerator() const
+{
+	// 複数のスレッドから同時に調べられても結果は同じなのでロックはしない
+	if(!SimpleGeneratorChecked)
+	{
+		SimpleGenerator = CheckSimpleGenerator();
+		SimpleGeneratorChecked = true;
+	}
+	return SimpleGenerator;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tCodeBlock::CheckSimpleGenerator() const
+{
+	/*
+		スタックレスなコルーチンでは、yield の呼び出しはこの関数のトップレベルで
+		インタプリタが横取りする。このため、この関数から呼ばれた別の関数の中から
+		yield が呼ばれてはならない。ここでは、コルーチンオブジェクト (2番目の引数)
+		や this、this-proxy、およびそれらから得た yield メソッドがこの関数の外に
+		漏れ出ないことをバイトコードから保守的に判定する。
+		レジスタはフロー非依存に扱うので、レジスタが使い回されている場合は
+		判定が保守的になる (スタックフルなコルーチンにフォールバックする) だけである。
+	*/
+	enum
+	{
+		rcCoroutine	= 1, //!< コルーチンオブジェクトあるいは this が入りうる
+		rcProxy		= 2, //!< this-proxy が入りうる
+		rcYield		= 4, //!< yield メソッドが入りうる
+		rcName		= 8, //!< メンバ名として "yield" が入りうる
+		rcEscape	= rcCoroutine | rcProxy | rcYield //!< 外に漏れ出てはならない
+	};
+	gc_vector<risse_uint8> regs(NumRegs, 0);
+	const risse_uint32 * code_end = Code + CodeSize;
+
+	// レジスタを分類する
+	// (ocAssign によるコピーを追うため、分類が変化しなくなるまで繰り返す)
+	bool changed = true;
+	while(changed)
+	{
+		changed = false;
+		for(tVMCodeIterator i(Code); (const risse_uint32*)i != code_end; ++i)
+		{
+			const risse_uint32 * code = i;
+			const tVMInsnInfo & info = VMInsnInfo[code[0]];
+			if(info.Flags[0] != tVMInsnInfo::vifRegister || code[1] == InvalidRegNum)
+				continue;
+
+			risse_uint8 cls;
+			switch(code[0])
+			{
+			case ocAssign:
+				cls = regs[code[2]];
+				break;
+			case ocAssignConstant:
+				cls = (Consts[code[2]].GetType() == tVariant::vtString &&
+					(tString)Consts[code[2]] == ss_yield) ? rcName : 0;
+				break;
+			case ocAssignParam:
+				cls = rcName | (code[2] == 1 ? rcCoroutine : 0);
+				break;
+			case ocAssignThis:
+				cls = rcName | rcCoroutine;
+				break;
+			case ocAssignThisProxy:
+				cls = rcName | rcProxy;
+				break;
+			case ocDGet:
+			case ocDGetF:
+				cls = rcName;
+				if((regs[code[2]] & (rcCoroutine|rcProxy)) && (regs[code[3]] & rcName))
+					cls |= rcYield;
+				break;
+			default:
+				// 第1オペランドが書き込み先ではない命令も含まれるが、保守的な側に倒れるだけ
+				cls = rcName;
+			}
+			if((regs[code[1]] | cls) != regs[code[1]])
+			{
+				regs[code[1]] |= cls;
+				changed = true;
+			}
+		}
+	}
+
+	// 分類されたレジスタの使われ方を調べる
+	for(tVMCodeIterator i(Code); (const risse_uint32*)i != code_end; ++i)
+	{
+		const risse_uint32 * code = i;
+		switch(code[0])
+		{
+		case ocTryFuncCall: // try ブロックの中身は別の関数として呼ばれる
+		case ocSync: // synchronized ブロックの中身も同様
+		case ocSetFrame: // this を共有する関数やブロックが作られる
+		case ocAssignNewBinding: // バインディングを通してローカル変数が読まれうる
+			return false;
+
+		case ocNew:
+		case ocFuncCall:
+		case ocFuncCallBlock:
+			// 引数の省略 (...) を行うとコルーチンオブジェクトがそのまま渡る
+			if(code[3] & FuncCallFlag_Omitted) return false;
+			{
+				// 引数として漏れ出ないか
+				risse_size argc = code[4] + (code[0] == ocFuncCallBlock ? code[5] : 0);
+				const risse_uint32 * argv = code + (code[0] == ocFuncCallBlock ? 6 : 5);
+				for(risse_size n = 0; n < argc; n++)
+					if(regs[argv[n]] & rcEscape) return false;
+			}
+			break;
+
+		default:
+			;
+		}
+
+		const tVMInsnInfo & info = VMInsnInfo[code[0]];
+		for(risse_size n = 0; n < MaxVMInsnOperand &&
+			info.Flags[n] != tVMInsnInfo::vifVoid; n++)
+		{
+			if(info.Flags[n] != tVMInsnInfo::vifRegister) continue;
+			if(code[n+1] == InvalidRegNum) continue;
+			risse_uint8 cls = regs[code[n+1]] & rcEscape;
+			if(!cls) continue;
+
+			bool allowed;
+			switch(code[0])
+			{
+			case ocAssign:
+				// コピー元は分類を引き継いでいる
+				allowed = true;
+				break;
+			case ocAssignConstant:
+			case ocAssignParam:
+			case ocAssignThis:
+			case ocAssignThisProxy:
+			case ocAssert:
+			case ocAssertType:
+				allowed = n == 0;
+				break;
+			case ocDGet:
+			case ocDGetF:
+				// 書き込み先か、yield メソッド以外に対するメンバの読み出し
+				allowed = n == 0 || (n == 1 && !(cls & rcYield));
+				break;
+			case ocDSet:
+			case ocDSetF:
+				// yield メソッド以外に対するメンバへの書き込み
+				allowed = n == 0 && !(cls & rcYield);
+				break;
+			case ocFuncCall:
+				// 戻り値の書き込み先か、yield メソッドの呼び出し
+				allowed = n == 0 || (n == 1 && !(cls & (rcCoroutine|rcProxy)));
+				break;
+			default:
+				allowed = false;
+			}
+			if(!allowed) return false;
+		}
+	}
+
+	return true;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tObjectInterface::tRetValue tCodeBlock::Operate(RISSE_OBJECTINTERFACE_OPERATE_IMPL_ARG)
 {
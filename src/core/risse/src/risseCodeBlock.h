@@ -54,6 +54,9 @@ class tCodeBlock : public tObjectInterface
 
 	tCodeExecutor * Executor; //!< コード実行クラスのインスタンス
 
+	mutable bool SimpleGeneratorChecked; //!< SimpleGenerator を調べたかどうか
+	mutable bool SimpleGenerator; //!< スタックレスなコルーチンとして実行できるかどうか
+
 public:
 	/**
 	 * コンストラクタ
@@ -157,6 +160,21 @@ public:
 	 */
 	risse_size CodePositionToSourcePosition(risse_size pos) const;
 
+	/**
+	 * このコードブロックをスタックレスなコルーチンとして実行できるかどうかを得る
+	 * @return	スタックレスなコルーチンとして実行できる場合に真
+	 * @note	2番目の引数 (コルーチンオブジェクト) と this の yield が、この関数の
+	 *			トップレベルからしか呼ばれ得ない場合に真となる。結果はキャッシュされる。
+	 */
+	bool IsSimpleGenerator() const;
+
+private:
+	/**
+	 * コードを調べ、スタックレスなコルーチンとして実行できるかどうかを判定する
+	 * @return	スタックレスなコルーチンとして実行できる場合に真
+	 */
+	bool CheckSimpleGenerator() const;
+
 public: // tObjectInterface メンバ
 
 	tRetValue Operate(RISSE_OBJECTINTERFACE_OPERATE_DECL_ARG);
@@ -401,6 +419,24 @@ public:
 		tVariant * frame , const tSharedVariableFramesOverlay & shared_overlay):
 		 CodeBlock(codeblock), Frame(frame), Shared(shared_overlay) {;}
 
+	/**
+	 * コードブロックを得る
+	 * @return	コードブロック
+	 */
+	const tCodeBlock * GetCodeBlock() const { return CodeBlock; }
+
+	/**
+	 * スタックフレームを得る
+	 * @return	スタックフレーム (NULL = 実行時に割り当てる)
+	 */
+	tVariant * GetFrame() const { return Frame; }
+
+	/**
+	 * 共有フレームを得る
+	 * @return	共有フレーム
+	 */
+	tSharedVariableFrames * GetShared() { return &Shared; }
+
 public: // tObjectInterface メンバ
 
 	tRetValue Operate(RISSE_OBJECTINTERFACE_OPERATE_DECL_ARG);
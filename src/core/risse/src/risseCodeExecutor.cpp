@@ -26,6 +26,7 @@
 #include "risseStaticStrings.h"
 #include "risseArrayClass.h"
 #include "risseDictionaryClass.h"
+#include "risseHeapProfiler.h"
 /*
 	このソースは、実行スピード重視の、いわばダーティーな実装を行う。
 	ダーティーな実装は極力コメントを残し、わかりやすくしておくこと。
@@ -56,6 +57,166 @@ void tCodeInterpreter::Execute(
 		tVariant * frame, tSharedVariableFrames * shared,
 		tVariant * result)
 {
+	Run(args, global, This, frame, shared, result, NULL);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tCodeInterpreter::Resume(tResumableFrame * state, const tVariant & value,
+	tVariant * result)
+{
+	RISSE_ASSERT(state != NULL);
+
+	// 再開の場合は yield の戻り値を格納してから続きを実行する
+	if(state->Code && state->ResultRegister != InvalidRegNum)
+		state->Frame[state->ResultRegister] = value;
+
+	return Run(*state->Args, state->Global, state->This,
+		state->Frame, state->Shared, result, state);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 関数呼び出しが、中断可能なモードで横取りすべき yield の呼び出しかどうかを判定する
+ * @param state		実行の状態
+ * @param method	呼び出されるメソッドオブジェクト
+ * @param This		現在の"Thisオブジェクト"
+ * @return	横取りすべき yield の呼び出しならば真
+ */
+static inline bool IsResumableYieldCall(const tResumableFrame * state,
+	const tVariant & method, const tVariant & This)
+{
+	if(method.GetType() != tVariant::vtObject) return false;
+	if(method.GetObjectInterface() != state->YieldMethod) return false;
+	const tVariant & context = method.SelectContext(0, This);
+	return context.GetType() == tVariant::vtObject &&
+		context.GetObjectInterface() == state->YieldContext;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 命令が、ネイティブなスタックを持たない中断可能なモードのまま実行できるものかどうかを判定する
+ * @param state		実行の状態
+ * @param code		命令
+ * @param frame		スタックフレーム
+ * @param This		現在の"Thisオブジェクト"
+ * @return	スクリプトのコードを呼び出す可能性がなく、そのまま実行できるならば真
+ * @note	スクリプトのコードが呼ばれると、その中から yield される可能性がある。
+ *			演算命令はオペランドにオブジェクトが無ければスクリプトのコードを
+ *			呼び出さない。
+ */
+static bool IsResumableSafeInsn(const tResumableFrame * state,
+	const risse_uint32 * code, const tVariant * frame, const tVariant & This)
+{
+	switch(code[0])
+	{
+	case ocNoOperation:
+	case ocAssign:
+	case ocAssignConstant:
+	case ocAssignThis:
+	case ocAssignThisProxy:
+	case ocAssignSuper:
+	case ocAssignGlobal:
+	case ocAssignParam:
+	case ocAssignBlockParam:
+	case ocWrite:
+	case ocRead:
+	case ocJump:
+	case ocReturn:
+		// レジスタの読み書きのみ
+		return true;
+
+	case ocFuncCall:
+		// 横取りする yield の呼び出し
+		return IsResumableYieldCall(state, frame[code[2]], This);
+
+	case ocDGet:
+	case ocDGetF:
+	{
+		// コルーチンオブジェクトからの yield メソッドの取り出し
+		const tVariant & obj = frame[code[2]];
+		const tVariant & name = frame[code[3]];
+		return obj.GetType() == tVariant::vtObject &&
+			obj.GetObjectInterface() == state->YieldContext &&
+			name.GetType() == tVariant::vtString && (tString)name == ss_yield;
+	}
+
+	case ocBranch:
+	case ocLogNot:
+	case ocBitNot:
+	case ocDecAssign:
+	case ocIncAssign:
+	case ocPlus:
+	case ocMinus:
+	case ocString:
+	case ocBoolean:
+	case ocReal:
+	case ocInteger:
+	case ocOctet:
+	case ocLogOr:
+	case ocLogAnd:
+	case ocBitOr:
+	case ocBitXor:
+	case ocBitAnd:
+	case ocNotEqual:
+	case ocEqual:
+	case ocDiscNotEqual:
+	case ocDiscEqual:
+	case ocLesser:
+	case ocGreater:
+	case ocLesserOrEqual:
+	case ocGreaterOrEqual:
+	case ocRBitShift:
+	case ocLShift:
+	case ocRShift:
+	case ocMod:
+	case ocDiv:
+	case ocIdiv:
+	case ocMul:
+	case ocAdd:
+	case ocSub:
+	case ocAssert:
+	case ocAssertType:
+	case ocThrow:
+		break;
+
+	default:
+		// 関数の呼び出し、メンバへのアクセス、オブジェクトの作成など
+		return false;
+	}
+
+	// 演算命令
+	const tVMInsnInfo & info = VMInsnInfo[code[0]];
+	for(risse_size n = 0; n < MaxVMInsnOperand &&
+		info.Flags[n] != tVMInsnInfo::vifVoid; n++)
+	{
+		if(info.Flags[n] != tVMInsnInfo::vifRegister) continue;
+		if(code[n+1] == InvalidRegNum) continue;
+		if(frame[code[n+1]].GetType() == tVariant::vtObject) return false;
+	}
+	return true;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tCodeInterpreter::Run(
+		const tMethodArgument & args,
+		const tVariant & global,
+		const tVariant & This,
+		tVariant * frame, tSharedVariableFrames * shared,
+		tVariant * result,
+		tResumableFrame * state)
+{
+	// 中断していた実行の再開かどうか
+	// 再開の場合、スタックフレームと共有フレームは中断したときのものをそのまま使う
+	bool resuming = state && state->Code;
+
 	// context でスタックフレームが指定されていない場合、スタックを割り当てる
 	// TODO: スタックフレームの再利用など
 	// 毎回スタックを new で割り当てるのは効率が悪い？
@@ -63,7 +224,7 @@ void tCodeInterpreter::Execute(
 		frame = new tVariant[CodeBlock->GetNumRegs()];
 
 	// 共有変数領域の割り当て
-	if(CodeBlock->GetSharedVariableNestCount() != risse_size_max)
+	if(!resuming && CodeBlock->GetSharedVariableNestCount() != risse_size_max)
 	{
 		if(!shared)
 		{
@@ -80,9 +241,11 @@ void tCodeInterpreter::Execute(
 	RISSE_ASSERT(shared != NULL);
 
 	tSharedVariableFramesOverlay shared_overlay(shared,
-				CodeBlock->GetNestLevel(), CodeBlock->GetNumSharedVars());
+				CodeBlock->GetNestLevel(), resuming ? 0 : CodeBlock->GetNumSharedVars());
 		// 共有フレームのうち、CodeBlock->GetNestLevel() にある共有フレームを
 		// 新しく置き換えるためのオブジェクトを準備する。
+		// 再開の場合は、中断したときに置き換え済みの共有フレームが shared に
+		// 入っているので、置き換えは行わない。
 
 	// ローカル変数に値を持ってくる
 	// いくつかのローカル変数は ASSERT が有効になっていなければ
@@ -90,7 +253,7 @@ void tCodeInterpreter::Execute(
 #ifdef RISSE_ASSERT_ENABLED
 	risse_size framesize = CodeBlock->GetNumRegs();
 #endif
-	const risse_uint32 * code = CodeBlock->GetCode();
+	const risse_uint32 * code = resuming ? state->Code : CodeBlock->GetCode();
 	const risse_uint32 * code_origin = CodeBlock->GetCode();
 #ifdef RISSE_ASSERT_ENABLED
 	risse_size codesize = CodeBlock->GetCodeSize();
@@ -102,6 +265,12 @@ void tCodeInterpreter::Execute(
 
 	tScriptEngine * engine = CodeBlock->GetScriptBlockInstance()->GetScriptEngine();
 
+#ifdef RISSE_HEAP_PROFILE
+	// ヒーププロファイラに実行中の位置を伝える
+	// (code のアドレスを渡すため、code はレジスタに置かれなくなる)
+	tHeapProfilerSite heap_profiler_site(CodeBlock, &code);
+#endif
+
 	try
 	{
 		/*
@@ -138,6 +307,20 @@ void tCodeInterpreter::Execute(
 		// ループ
 		while(true)
 		{
+			if(state && !state->OnNativeStack &&
+				!IsResumableSafeInsn(state, code, frame, This))
+			{
+				// スクリプトのコードを呼び出す可能性のある命令
+				// この命令の手前で中断し、ネイティブなスタックへの移行を要求する
+				state->Code = code;
+				state->Frame = frame;
+				state->ResultRegister = InvalidRegNum;
+				state->Migrating = true;
+				if(!resuming)
+					state->Shared = new tSharedVariableFrames(shared_overlay);
+				return true;
+			}
+
 			switch(*code)
 			{
 			case ocNoOperation	: // nop	 なにもしない
@@ -179,11 +362,24 @@ void tCodeInterpreter::Execute(
 
 			case ocAssignThisProxy		: // this	 = this-proxyの代入
 				RISSE_ASSERT(CI(code[1]) < framesize);
-				AR(code[1]) = tVariant(
-					new((tThisProxy*)(&ThisProxy.Storage[0])) tThisProxy(
-						const_cast<tVariant&>(This),
-						const_cast<tVariant&>(global),
-						engine));
+				if(state)
+				{
+					// 中断可能なモードでは、中断をまたいでも this-proxy が
+					// 有効である必要があるのでヒープ上に作成する
+					// (This と global は state のメンバを指している)
+					AR(code[1]) = tVariant(new tThisProxy(
+							const_cast<tVariant&>(This),
+							const_cast<tVariant&>(global),
+							engine));
+				}
+				else
+				{
+					AR(code[1]) = tVariant(
+						new((tThisProxy*)(&ThisProxy.Storage[0])) tThisProxy(
+							const_cast<tVariant&>(This),
+							const_cast<tVariant&>(global),
+							engine));
+				}
 				code += 2;
 				break;
 
@@ -453,6 +649,26 @@ void tCodeInterpreter::Execute(
 					// code[5] ～   引数
 					// TODO: 引数展開など
 					RISSE_ASSERT(code[4] < MaxArgCount); // 引数は最大MaxArgCount個まで
+					if(state && IsResumableYieldCall(state, AR(code[2]), This))
+					{
+						// 中断可能なモードでの yield の呼び出し
+						// 呼び出しは行わず、実行位置を記録して呼び出し元に戻る
+						if(result)
+						{
+							if(code[3] & FuncCallFlag_Omitted)
+								*result = args.Get(0, tVariant::GetVoidObject());
+							else if(code[4] >= 1)
+								*result = AR(code[5]);
+							else
+								result->Clear();
+						}
+						state->Code = code + code[4] + 5;
+						state->Frame = frame;
+						state->ResultRegister = code[1];
+						if(!resuming)
+							state->Shared = new tSharedVariableFrames(shared_overlay);
+						return true;
+					}
 					if(code[3] & FuncCallFlag_Omitted)
 					{
 						// 引数の省略
@@ -639,13 +855,14 @@ void tCodeInterpreter::Execute(
 				break;
 
 			case ocExitTryBlock		: //!< 例外保護ブロックから抜ける(VMのみで使用)
-				return; // 呼び出し元にそのまま戻る
+				return false; // 呼び出し元にそのまま戻る
 	#endif
 			case ocReturn			: // ret	 return ステートメント
 				RISSE_ASSERT(code[1] == InvalidRegNum || CI(code[1]) < framesize);
 				if(code[1] != InvalidRegNum && result) *result = AR(code[1]);
 				//code += 2;
-				return;
+				if(state) state->Code = NULL; // 実行は終了した
+				return false;
 
 			case ocExitTryException	: // returne	return 例外を発生させる
 				RISSE_ASSERT(CI(code[1]) == InvalidRegNum || CI(code[1]) < framesize);
@@ -1145,6 +1362,7 @@ void tCodeInterpreter::Execute(
 	{
 		throw;
 	}
+	return false; // ここには来ない
 }
 //---------------------------------------------------------------------------
 
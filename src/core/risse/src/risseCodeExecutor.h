@@ -16,12 +16,61 @@
 #include "risseGC.h"
 #include "risseCodeBlock.h"
 #include "risseObject.h"
+#include "risseOpCodes.h"
 
 //---------------------------------------------------------------------------
 namespace Risse
 {
 class tCodeBlock;
 class tScriptEngine;
+//---------------------------------------------------------------------------
+/**
+ * 中断と再開が可能なコード実行の状態
+ * @note	スタックレスなコルーチン (ジェネレータ) の実行に用いる。
+ *			関数のトップレベルから YieldMethod が呼び出されると、インタプリタは
+ *			その呼び出しを行う代わりに実行位置をこのオブジェクトに記録して
+ *			呼び出し元に戻る。レジスタや共有変数はもともとヒープ上にあるため、
+ *			C のスタックを保存しておく必要はない。
+ *			ただし、入れ子になった関数の中から yield されると C のスタックを
+ *			保存しなければならなくなる。このため、OnNativeStack が偽の間は
+ *			スクリプトのコードを呼び出す可能性のある命令の手前で中断し、
+ *			Migrating を真にして戻る。呼び出し元はネイティブなスタックを持つ
+ *			コルーチンを用意し、その上で OnNativeStack を真にして続きを実行する。
+ */
+class tResumableFrame : public tCollectee
+{
+public:
+	const risse_uint32 * Code; //!< 再開する位置 (NULL = まだ開始していない)
+	tVariant * Frame; //!< スタックフレーム (NULL = 開始時に割り当てる)
+	tSharedVariableFrames * Shared; //!< 共有フレーム (NULL = 共有フレームを指定しない)
+	const tMethodArgument * Args; //!< 関数の引数
+	tVariant Global; //!< メソッドが実行されるべきパッケージグローバル
+	tVariant This; //!< メソッドが実行されるべき"Thisオブジェクト"
+	const tObjectInterface * YieldMethod; //!< 呼び出しを横取りする yield メソッド
+	const tObjectInterface * YieldContext; //!< 横取りする yield メソッドのコンテキスト
+	risse_uint32 ResultRegister; //!< 再開時に値を格納するレジスタ (InvalidRegNum = 格納しない)
+	bool OnNativeStack; //!< ネイティブなスタックを持つコルーチン上で実行しているかどうか
+	bool Migrating; //!< ネイティブなスタックへの移行のために中断したかどうか
+
+	/**
+	 * コンストラクタ
+	 */
+	tResumableFrame()
+	{
+		Code = NULL;
+		Frame = NULL;
+		Shared = NULL;
+		Args = &tMethodArgument::Empty();
+		YieldMethod = NULL;
+		YieldContext = NULL;
+		ResultRegister = InvalidRegNum;
+		OnNativeStack = false;
+		Migrating = false;
+	}
+};
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 /**
  * バイトコード実行クラスの基底クラス
@@ -63,6 +112,17 @@ public:
 		const tVariant & This = tVariant::GetNullObject(),
 		tVariant * frame = NULL, tSharedVariableFrames * shared = NULL,
 		tVariant * result = NULL) = 0;
+
+	/**
+	 * 中断可能なモードでコードを実行あるいは再開する
+	 * @param state		実行の状態 (初回は state->Code を NULL にしておくこと)
+	 * @param value		再開時に yield の戻り値となる値 (初回は無視される)
+	 * @param result	戻りの値あるいは yield された値を格納する先
+	 * @return	yield により (あるいはネイティブなスタックへの移行のために)
+	 *			中断した場合に真、実行が終了した場合に偽
+	 */
+	virtual bool Resume(tResumableFrame * state, const tVariant & value,
+		tVariant * result = NULL) = 0;
 };
 //---------------------------------------------------------------------------
 
@@ -88,6 +148,24 @@ public:
 		const tVariant & This = tVariant::GetNullObject(),
 		tVariant * frame = NULL, tSharedVariableFrames * shared = NULL,
 		tVariant * result = NULL);
+
+	bool Resume(tResumableFrame * state, const tVariant & value,
+		tVariant * result = NULL);
+
+private:
+	/**
+	 * コードを実行する (Execute() と Resume() の実装)
+	 * @param state		中断可能なモードで実行する場合は実行の状態、そうでなければ NULL
+	 * @return	yield により中断した場合に真
+	 * @note	そのほかの引数は Execute() と同じ
+	 */
+	bool Run(
+		const tMethodArgument & args,
+		const tVariant & global,
+		const tVariant & This,
+		tVariant * frame, tSharedVariableFrames * shared,
+		tVariant * result,
+		tResumableFrame * state);
 };
 //---------------------------------------------------------------------------
 
@@ -38,6 +38,8 @@ void * _AlignedMallocCollectee(size_t size, size_t align, bool atomic)
 		GC_MALLOC_ATOMIC(size + align + sizeof(void*)) :
 		GC_MALLOC       (size + align + sizeof(void*));
 	void *org_ptr = ptr;
+	RISSE_HEAP_PROFILE_ALLOCATED(ptr, size + align + sizeof(void*),
+		atomic ? hakAtomic : hakCollectee);
 
 	// ptr の直前に、オリジナルのメモリブロックのポインタを格納する
 	(reinterpret_cast<void**>(ptr))[-1] = org_ptr;
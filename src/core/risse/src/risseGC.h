@@ -38,6 +38,46 @@
 
 namespace Risse
 {
+//---------------------------------------------------------------------------
+/**
+ * ヒーププロファイラに報告するメモリ確保の種類
+ */
+enum tHeapAllocKind
+{
+	hakCollectee, //!< MallocCollectee などによる (ポインタを含みうる) 領域
+	hakAtomic, //!< MallocAtomicCollectee などによる (ポインタを含まない) 領域
+	hakString, //!< 文字列のバッファ
+	hakObject, //!< Risse オブジェクト (tObjectInterface 派生クラス) のインスタンス
+	hakCount //!< 種類の数
+};
+//---------------------------------------------------------------------------
+
+
+#ifdef RISSE_HEAP_PROFILE
+//---------------------------------------------------------------------------
+extern volatile bool HeapProfilerEnabled; //!< ヒーププロファイラが有効かどうか
+
+/**
+ * メモリ確保をヒーププロファイラに報告する (実装は risseHeapProfiler.cpp)
+ * @param ptr	確保されたメモリブロック
+ * @param size	確保されたサイズ (0 の場合はメモリブロックから調べる)
+ * @param kind	メモリ確保の種類
+ */
+void HeapProfilerAllocated(void * ptr, size_t size, tHeapAllocKind kind);
+//---------------------------------------------------------------------------
+	/**
+	 * メモリ確保をヒーププロファイラに報告するマクロ
+	 * (RISSE_HEAP_PROFILE が定義されていない場合は何もしない)
+	 */
+	#define RISSE_HEAP_PROFILE_ALLOCATED(ptr, size, kind) \
+		do { if(::Risse::HeapProfilerEnabled) \
+			::Risse::HeapProfilerAllocated((ptr), (size), (kind)); } while(0)
+#else
+	#define RISSE_HEAP_PROFILE_ALLOCATED(ptr, size, kind)
+#endif
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 typedef	gc			tCollectee; //!< コレクタの対象となるクラスの基本クラス
 typedef	gc_cleanup	tDestructee; //!< コレクタの対象かつデストラクタが呼ばれるクラスの基本クラス
@@ -90,7 +130,9 @@ class gc_map : public std::map<T1, T2, COMP, gc_allocator<std::pair<T1, T2> > >,
  */
 static inline void * MallocCollectee(size_t size)
 {
-	return GC_MALLOC(size);
+	void * ptr = GC_MALLOC(size);
+	RISSE_HEAP_PROFILE_ALLOCATED(ptr, size, hakCollectee);
+	return ptr;
 }
 //---------------------------------------------------------------------------
 
@@ -99,15 +141,19 @@ static inline void * MallocCollectee(size_t size)
 /**
  * コレクタの対象となることができるメモリ領域を確保する
  * @param size	確保するサイズ
+ * @param kind	ヒーププロファイラに報告するメモリ確保の種類
  * @return	確保されたメモリブロックへのポインタ
  * @note	MallocCollectee と異なり、メモリ領域中にはなんら有効なポインタが
  *			含まれていないと見なされる(atomicなメモリ領域を確保する)。
  *			メモリ領域中にポインタを含まないようなデータ
  *			の確保にはこっちの関数を使うこと。
  */
-static inline void * MallocAtomicCollectee(size_t size)
+static inline void * MallocAtomicCollectee(size_t size,
+	tHeapAllocKind kind = hakAtomic)
 {
-	return GC_MALLOC_ATOMIC(size);
+	void * ptr = GC_MALLOC_ATOMIC(size);
+	RISSE_HEAP_PROFILE_ALLOCATED(ptr, size, kind);
+	return ptr;
 }
 //---------------------------------------------------------------------------
 
@@ -117,14 +163,19 @@ static inline void * MallocAtomicCollectee(size_t size)
  * コレクタの対象となることができるメモリ領域のサイズを変更する
  * @param old_block	変更したいメモリブロック
  * @param size		変更後のサイズ
+ * @param kind		ヒーププロファイラに報告するメモリ確保の種類
+ *					(メモリブロックが移動した場合のみ報告される)
  * @return	確保されたメモリブロックへのポインタ
  * @note	メモリブロックのサイズを変更しても、MallocCollecteeAtomic や
  *			MallocCollectee で確保したメモリの属性 (atomicかそうでないか)
  *			は保持される。
  */
-static inline void * ReallocCollectee(void * old_block, size_t size)
+static inline void * ReallocCollectee(void * old_block, size_t size,
+	tHeapAllocKind kind = hakCollectee)
 {
-	return GC_REALLOC(old_block, size);
+	void * ptr = GC_REALLOC(old_block, size);
+	if(ptr != old_block) RISSE_HEAP_PROFILE_ALLOCATED(ptr, size, kind);
+	return ptr;
 }
 //---------------------------------------------------------------------------
 
@@ -213,6 +264,20 @@ public:
 
 
 
+//---------------------------------------------------------------------------
+/**
+ * 型 T がポインタを含まないことを宣言する
+ * @note	gc_vector などのコンテナ (gc_allocator) や Risa の tRingBuffer は、
+ *			この宣言が行われた型の要素を atomic な領域 (GC がポインタの
+ *			スキャンを行わない領域) に格納するようになる。tAtomicCollectee
+ *			派生であることはコンテナの領域には影響しないため、コンテナに
+ *			入れるポインタを含まない構造体はこの宣言を行うこと。
+ *			グローバル名前空間で使用すること。
+ */
+#define RISSE_DECLARE_POINTER_FREE(T) GC_DECLARE_PTRFREE(T)
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 /**
  * 強制的にガーベジを回収する
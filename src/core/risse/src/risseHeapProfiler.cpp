@@ -0,0 +1,372 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief 確保位置別のヒーププロファイラ
+//---------------------------------------------------------------------------
+#include "prec.h"
+#include "risseHeapProfiler.h"
+
+#ifdef RISSE_HEAP_PROFILE
+
+#include "risseHashTable.h"
+#include "risseCodeBlock.h"
+#include "risseScriptBlockClass.h"
+#include <algorithm>
+
+#ifdef _MSC_VER
+	#define RISSE_HEAP_PROFILER_TLS __declspec(thread)
+#else
+	#define RISSE_HEAP_PROFILER_TLS __thread
+#endif
+
+namespace Risse
+{
+RISSE_DEFINE_SOURCE_ID(29488,6147,51020,19342,33941,55871,40172,8893);
+
+
+//---------------------------------------------------------------------------
+volatile bool HeapProfilerEnabled = false;
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 標本
+ */
+struct tHeapProfilerSample : public tCollectee
+{
+	GC_word HiddenObject; //!< 標本となったメモリブロックのポインタを反転したもの (回収されると 0 になる)
+	tHeapAllocKind Kind; //!< メモリ確保の種類
+	risse_size Bytes; //!< この標本が代表するバイト数
+	const char * Tag; //!< ネイティブコードのタグ
+	const tCodeBlock * CodeBlock; //!< 確保を行ったコードブロック
+	risse_size CodePosition; //!< 確保を行ったコード上の位置
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 報告の項目をバイト数の降順に並べるための比較関数
+ */
+struct tHeapProfilerEntryComparator
+{
+	bool operator () (const tHeapProfiler::tEntry & a, const tHeapProfiler::tEntry & b) const
+		{ return a.Bytes > b.Bytes; }
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+static tCriticalSection * CS = NULL; //!< 以下の変数を保護するクリティカルセクション
+static risse_size SamplingInterval = tHeapProfiler::DefaultSamplingInterval; //!< サンプリング間隔
+static gc_vector<tHeapProfilerSample *> * Samples = NULL; //!< 標本の配列
+static tHeapProfiler::tListener * Listener = NULL; //!< リスナ
+static GC_word LastGCNo = 0; //!< 最後に CheckCollection() で確認した GC_gc_no
+
+static RISSE_HEAP_PROFILER_TLS tHeapProfilerSite * CurrentSite = NULL; //!< このスレッドの現在の確保位置
+static RISSE_HEAP_PROFILER_TLS risse_offset Countdown = 0; //!< 次の標本までのバイト数
+static RISSE_HEAP_PROFILER_TLS bool InProfiler = false; //!< このスレッドがプロファイラ内を実行中かどうか
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void HeapProfilerAllocated(void * ptr, size_t size, tHeapAllocKind kind)
+{
+	if(!ptr || InProfiler) return;
+
+	// 標本を取るかどうか
+	if(size == 0)
+	{
+		// サイズが指定されていない場合はメモリブロックから調べる
+		void * base = GC_base(ptr);
+		if(!base) return; // GC 管理下のメモリブロックではない
+		size = GC_size(base);
+	}
+	Countdown -= (risse_offset)size;
+	if(Countdown > 0) return;
+
+	InProfiler = true;
+
+	void * base = GC_base(ptr);
+	if(base)
+	{
+		// 標本を作成する
+		tHeapProfilerSample * sample = new tHeapProfilerSample();
+		sample->HiddenObject = ~(GC_word)base;
+		sample->Kind = kind;
+		sample->Bytes = size > SamplingInterval ? size : SamplingInterval;
+		sample->Tag = NULL;
+		sample->CodeBlock = NULL;
+		sample->CodePosition = risse_size_max;
+
+		// 確保位置を記録する
+		// スクリプトの位置を優先するが、内側にネイティブコードのタグがあれば
+		// そちらを優先する
+		tHeapProfilerSite * site = CurrentSite;
+		if(site)
+		{
+			if(site->Tag)
+			{
+				sample->Tag = site->Tag;
+			}
+			else
+			{
+				sample->CodeBlock = site->CodeBlock;
+				sample->CodePosition = *site->Code - site->CodeBlock->GetCode();
+			}
+		}
+
+		{
+			// HeapProfilerEnabled の確認からここまでの間に Disable() が
+			// 呼ばれている可能性があるので、ロック内で改めて確認する。
+			// disappearing link の登録もロック内で行い、Disable() が登録を
+			// 解除しそこなう標本が無いようにする。
+			volatile tCriticalSection::tLocker lock(*CS);
+			if(HeapProfilerEnabled && Samples)
+			{
+				// メモリブロックが回収されたら HiddenObject がクリアされるようにする
+				GC_general_register_disappearing_link(
+					reinterpret_cast<void**>(&sample->HiddenObject), base);
+				Samples->push_back(sample);
+			}
+		}
+	}
+
+	Countdown = (risse_offset)SamplingInterval;
+	InProfiler = false;
+}
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+void tHeapProfiler::Enable(risse_size interval)
+{
+	// 最初の呼び出しはメインスレッドから行われると仮定し、
+	// CS の作成に関してはスレッド保護を行わない
+	if(!CS) CS = new tCriticalSection();
+
+	volatile tCriticalSection::tLocker lock(*CS);
+
+	if(interval == 0) interval = 1;
+	SamplingInterval = interval;
+	if(!Samples) Samples = new gc_vector<tHeapProfilerSample *>();
+	LastGCNo = GC_gc_no;
+	HeapProfilerEnabled = true;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tHeapProfiler::Disable()
+{
+	if(!CS) return;
+
+	volatile tCriticalSection::tLocker lock(*CS);
+
+	HeapProfilerEnabled = false;
+	if(Samples)
+	{
+		// 生きている標本の disappearing link の登録を解除する
+		for(gc_vector<tHeapProfilerSample *>::iterator i = Samples->begin();
+			i != Samples->end(); i++)
+		{
+			if((*i)->HiddenObject)
+				GC_unregister_disappearing_link(
+					reinterpret_cast<void**>(&(*i)->HiddenObject));
+		}
+		Samples = NULL;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tHeapProfiler::GetSamplingInterval()
+{
+	return SamplingInterval;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tHeapProfiler::GetReport(tReport & report)
+{
+	report.clear();
+	if(!CS) return;
+
+	// 死んだ標本を取り除きつつ、生きている標本をコピーする
+	gc_vector<tHeapProfilerSample *> live;
+	{
+		volatile tCriticalSection::tLocker lock(*CS);
+		if(!Samples) return;
+
+		gc_vector<tHeapProfilerSample *>::iterator d = Samples->begin();
+		for(gc_vector<tHeapProfilerSample *>::iterator i = Samples->begin();
+			i != Samples->end(); i++)
+		{
+			if((*i)->HiddenObject) *(d++) = *i;
+		}
+		Samples->erase(d, Samples->end());
+		live = *Samples;
+	}
+
+	// 確保位置と種類ごとに集計する
+	// (ロックの外で行うので、ここで行うメモリ確保が標本になることがある)
+	tHashTable<tString, risse_size> index;
+	for(gc_vector<tHeapProfilerSample *>::iterator i = live.begin();
+		i != live.end(); i++)
+	{
+		const tHeapProfilerSample * sample = *i;
+
+		tString site;
+		if(sample->CodeBlock)
+		{
+			tScriptBlockInstance * sb = sample->CodeBlock->GetScriptBlockInstance();
+			risse_size pos = sample->CodeBlock->CodePositionToSourcePosition(sample->CodePosition);
+			site = sb->GetName() + RISSE_WS(":") +
+				tString::AsString((risse_int64)(1 + sb->PositionToLine(pos)));
+		}
+		else if(sample->Tag)
+		{
+			site = tString(sample->Tag);
+		}
+		else
+		{
+			site = RISSE_WS("(native)");
+		}
+
+		tString key = site + RISSE_WS(" ") + tString(GetKindName(sample->Kind));
+		risse_size * found = index.Find(key);
+		if(found)
+		{
+			tEntry & entry = report[*found];
+			entry.Bytes += sample->Bytes;
+			entry.Samples ++;
+		}
+		else
+		{
+			tEntry entry;
+			entry.Site = site;
+			entry.Kind = sample->Kind;
+			entry.Bytes = sample->Bytes;
+			entry.Samples = 1;
+			index.Add(key, report.size());
+			report.push_back(entry);
+		}
+	}
+
+	// バイト数の降順に並べる
+	std::sort(report.begin(), report.end(), tHeapProfilerEntryComparator());
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tHeapProfiler::SetListener(tListener * listener)
+{
+	Listener = listener;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tHeapProfiler::CheckCollection()
+{
+	if(!HeapProfilerEnabled || !Listener) return false;
+
+	{
+		volatile tCriticalSection::tLocker lock(*CS);
+		if(LastGCNo == GC_gc_no) return false;
+		LastGCNo = GC_gc_no;
+	}
+
+	tReport report;
+	GetReport(report);
+	Listener->OnReport(report);
+	return true;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+const char * tHeapProfiler::GetKindName(tHeapAllocKind kind)
+{
+	switch(kind)
+	{
+	case hakCollectee:	return "collectee";
+	case hakAtomic:		return "atomic";
+	case hakString:		return "string";
+	case hakObject:		return "object";
+	case hakCount:		break;
+	}
+	return "unknown";
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tHeapProfilerSite * tHeapProfiler::ExchangeCurrentSite(tHeapProfilerSite * site)
+{
+	tHeapProfilerSite * prev = CurrentSite;
+	CurrentSite = site;
+	return prev;
+}
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+tHeapProfilerSite::tHeapProfilerSite(const char * tag)
+{
+	Tag = tag;
+	CodeBlock = NULL;
+	Code = NULL;
+	Prev = CurrentSite;
+	CurrentSite = this;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tHeapProfilerSite::tHeapProfilerSite(const tCodeBlock * codeblock,
+	const risse_uint32 * const * code)
+{
+	Tag = NULL;
+	CodeBlock = codeblock;
+	Code = code;
+	Prev = CurrentSite;
+	CurrentSite = this;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tHeapProfilerSite::~tHeapProfilerSite()
+{
+	RISSE_ASSERT(CurrentSite == this);
+	CurrentSite = Prev;
+}
+//---------------------------------------------------------------------------
+
+} // namespace Risse
+
+#endif
@@ -0,0 +1,213 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief 確保位置別のヒーププロファイラ
+//---------------------------------------------------------------------------
+
+#ifndef risseHeapProfilerH
+#define risseHeapProfilerH
+
+/*! @note
+ヒーププロファイラについて
+
+ヒーププロファイラは、マクロ RISSE_HEAP_PROFILE を定義してビルドした場合に
+のみ有効になる。定義しない場合は、メモリ確保経路に追加されるコードは無い。
+
+有効になったヒーププロファイラは、MallocCollectee などのメモリ確保関数、
+tString の内部バッファの確保、および tObjectInterface のインスタンスの作成を
+監視する。すべての確保を記録すると重すぎるので、確保されたバイト数が
+サンプリング間隔に達するごとに一つの確保を標本として記録する。標本は
+サンプリング間隔分 (あるいはその確保のサイズが大きければそのサイズ分) の
+バイト数を代表するものとして集計される。
+
+標本には確保位置が記録される。確保位置は、スクリプトの実行中であれば
+実行中のコードブロックとそのソース上の位置、ネイティブコードであれば
+RISSE_HEAP_PROFILE_TAG で指定されたタグとなる。
+
+標本となったメモリブロックには disappearing link が登録され、メモリブロックが
+回収されると標本は「死んだ」ことになる。GetReport() は生きている標本のみを
+確保位置と種類ごとに集計し、バイト数の降順に並べたものを返す。
+
+GC はコレクションの完了を通知してくれないため、CheckCollection() を定期的に
+(アイドル時などに) 呼ぶと、コレクションが行われていた場合にリスナに報告が
+送られるようになっている。
+*/
+
+#ifdef RISSE_HEAP_PROFILE
+
+#include "risseTypes.h"
+#include "risseGC.h"
+#include "risseString.h"
+#include "risseThread.h"
+
+namespace Risse
+{
+class tCodeBlock;
+class tHeapProfilerSite;
+//---------------------------------------------------------------------------
+/**
+ * ヒーププロファイラ
+ */
+class tHeapProfiler
+{
+public:
+	static const risse_size DefaultSamplingInterval = 64*1024; //!< デフォルトのサンプリング間隔(バイト)
+
+	/**
+	 * 報告の一項目
+	 */
+	struct tEntry
+	{
+		tString Site; //!< 確保位置
+		tHeapAllocKind Kind; //!< メモリ確保の種類
+		risse_uint64 Bytes; //!< 生きているバイト数 (推定値)
+		risse_size Samples; //!< 生きている標本の数
+	};
+
+	typedef gc_vector<tEntry> tReport; //!< 報告の型
+
+	/**
+	 * コレクションごとの報告を受け取るためのインターフェース
+	 */
+	class tListener
+	{
+	public:
+		virtual ~tListener() {;}
+
+		/**
+		 * 報告を受け取る
+		 * @param report	報告 (バイト数の降順)
+		 * @note	CheckCollection() を呼んだスレッドで呼ばれる
+		 */
+		virtual void OnReport(const tReport & report) = 0;
+	};
+
+public:
+	/**
+	 * プロファイラを有効にする
+	 * @param interval	サンプリング間隔(バイト)
+	 * @note	すでに有効な場合はサンプリング間隔のみを変更する
+	 */
+	static void Enable(risse_size interval = DefaultSamplingInterval);
+
+	/**
+	 * プロファイラを無効にし、記録をすべて破棄する
+	 */
+	static void Disable();
+
+	/**
+	 * プロファイラが有効かどうかを得る
+	 * @return	プロファイラが有効かどうか
+	 */
+	static bool IsEnabled() { return HeapProfilerEnabled; }
+
+	/**
+	 * サンプリング間隔を得る
+	 * @return	サンプリング間隔(バイト)
+	 */
+	static risse_size GetSamplingInterval();
+
+	/**
+	 * 生きている標本を集計した報告を得る
+	 * @param report	報告の格納先 (内容は置き換えられる)
+	 * @note	死んだ標本はこの時点で破棄される
+	 */
+	static void GetReport(tReport & report);
+
+	/**
+	 * コレクションごとの報告を受け取るリスナを設定する
+	 * @param listener	リスナ (NULL=リスナ無し)
+	 */
+	static void SetListener(tListener * listener);
+
+	/**
+	 * 前回の呼び出し以降にコレクションが行われていればリスナに報告を送る
+	 * @return	報告を送った場合に真
+	 */
+	static bool CheckCollection();
+
+	/**
+	 * メモリ確保の種類の名前を得る
+	 * @param kind	メモリ確保の種類
+	 * @return	名前
+	 */
+	static const char * GetKindName(tHeapAllocKind kind);
+
+	/**
+	 * メモリ確保の種類がポインタを含まない (GC がスキャンしない) ものかどうかを得る
+	 * @param kind	メモリ確保の種類
+	 * @return	ポインタを含まない種類ならば真
+	 */
+	static bool IsPointerFreeKind(tHeapAllocKind kind)
+		{ return kind == hakAtomic || kind == hakString; }
+
+	/**
+	 * このスレッドの現在の確保位置を入れ替える
+	 * @param site	新しい確保位置 (NULL=無し)
+	 * @return	それまでの確保位置
+	 * @note	スタックを切り替えるコルーチンの実装が、切り替えの前後で
+	 *			それぞれのスタック上の tHeapProfilerSite の連鎖を保存/復帰
+	 *			するために使う
+	 */
+	static tHeapProfilerSite * ExchangeCurrentSite(tHeapProfilerSite * site);
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * ヒーププロファイラに確保位置を伝えるためのクラス
+ * @note	スタック上にのみ配置すること。生存している間、このスレッドで
+ *			行われたメモリ確保はこのオブジェクトが表す位置で行われたものとして
+ *			記録される。
+ */
+class tHeapProfilerSite
+{
+	friend class tHeapProfiler;
+
+	const char * Tag; //!< ネイティブコードのタグ (スクリプトの場合は NULL)
+	const tCodeBlock * CodeBlock; //!< 実行中のコードブロック (ネイティブコードの場合は NULL)
+	const risse_uint32 * const * Code; //!< 実行中のコードへのポインタを保持している変数へのポインタ
+	tHeapProfilerSite * Prev; //!< 一つ外側の確保位置
+
+public:
+	/**
+	 * コンストラクタ(ネイティブコード用)
+	 * @param tag	タグ (静的な文字列であること)
+	 */
+	tHeapProfilerSite(const char * tag);
+
+	/**
+	 * コンストラクタ(スクリプト用)
+	 * @param codeblock	実行中のコードブロック
+	 * @param code		実行中のコードへのポインタを保持している変数へのポインタ
+	 */
+	tHeapProfilerSite(const tCodeBlock * codeblock, const risse_uint32 * const * code);
+
+	/**
+	 * デストラクタ
+	 */
+	~tHeapProfilerSite();
+};
+//---------------------------------------------------------------------------
+} // namespace Risse
+
+	/**
+	 * このマクロを書いたスコープの終わりまでに行われるメモリ確保を
+	 * tag の位置で行われたものとしてヒーププロファイラに記録させる
+	 */
+	#define RISSE_HEAP_PROFILE_TAG(tag) \
+		::Risse::tHeapProfilerSite risse_heap_profiler_site_(tag)
+#else
+	#define RISSE_HEAP_PROFILE_TAG(tag)
+#endif
+
+
+#endif
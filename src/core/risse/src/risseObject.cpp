@@ -14,10 +14,238 @@
 
 #include "risseObject.h"
 #include "risseExceptionClass.h"
+#include <wx/thread.h>
+
+#ifdef _MSC_VER
+	#define RISSE_OBJECT_TLS __declspec(thread)
+#else
+	#define RISSE_OBJECT_TLS __thread
+#endif
 
 namespace Risse
 {
 RISSE_DEFINE_SOURCE_ID(53018,62403,2623,19559,39811,3052,55606,53445);
+//---------------------------------------------------------------------------
+/**
+ * シン・ロックの所有スレッドを表す値を得るための変数
+ * @note	この変数のアドレスがスレッドごとに異なることを利用する。
+ *			アドレスの下位 3 ビットが 0 になるように 8 バイトの型とする。
+ */
+static RISSE_OBJECT_TLS risse_uint64 ThinLockOwner = 0;
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/*
+	シン・ロックの競合の待ち合わせ
+
+	シン・ロックの状態の Lock は所有スレッドしか書き換えられないので、
+	他のスレッドが保持しているシン・ロックを待つスレッドはその場で膨張させる
+	ことはできない。そのようなスレッドは ThinLockWaiters を増やして
+	ThinLockCondition で待ち、所有スレッドはシン・ロックを解除する際や
+	膨張させる際に ThinLockWaiters が 0 でなければ ThinLockCondition に
+	通知する。待っていたスレッドはロックを獲得した時点で膨張させるので、
+	以降の競合は tCriticalSection で待つことになる。
+	ThinLockWaiters の増加と Lock の確認、Lock の交換と ThinLockWaiters の
+	確認はいずれもアトミック操作の後に行うので、通知が失われることはない。
+*/
+static wxMutex ThinLockMutex; //!< ThinLockCondition 用のミューテックス
+static wxCondition ThinLockCondition(ThinLockMutex); //!< シン・ロックが解除または膨張されたことを通知するための条件変数
+static tAtomicCounter ThinLockWaiters; //!< ThinLockCondition を待っているスレッドの数
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * シン・ロックを待っているスレッドがあれば起こす
+ */
+static inline void NotifyThinLockWaiters()
+{
+	if((long)ThinLockWaiters > 0)
+	{
+		wxMutexLocker lock(ThinLockMutex);
+		ThinLockCondition.Broadcast();
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * 現在のスレッドを表すシン・ロックの所有スレッドの値を得る
+ * @return	所有スレッドの値
+ */
+static inline risse_ptruint GetThinLockOwner()
+{
+	return reinterpret_cast<risse_ptruint>(&ThinLockOwner);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tObjectInterface::tInflatedLock * tObjectInterface::CreateInflatedLock(tCriticalSection * cs)
+{
+	tInflatedLock * lock = new tInflatedLock();
+	lock->CS = cs;
+	lock->PendingCount = 0;
+	return lock;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tCriticalSection * tObjectInterface::Inflate() const
+{
+	{
+		// ロックを獲得してから膨張させる (すでにこのスレッドがシン・ロックを
+		// 保持している場合は再突入となる)
+		tSynchronizer sync(this);
+		risse_ptruint lock = reinterpret_cast<risse_ptruint>(Lock);
+		if(lock & ThinLockCountMask) InflateHeld(lock);
+	}
+	return static_cast<tInflatedLock *>(Lock)->CS;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tObjectInterface::InflateHeld(risse_ptruint lock) const
+{
+	RISSE_ASSERT((lock & ~ThinLockCountMask) == GetThinLockOwner());
+
+	// 保持しているネスト数の分だけ CS をロックする。
+	// これらのロックは、シン・ロックとして獲得した tSynchronizer が
+	// Leave() で一つずつ解除する。
+	tInflatedLock * inflated = CreateInflatedLock(new tCriticalSection());
+	risse_size count = static_cast<risse_size>(lock & ThinLockCountMask);
+	for(risse_size i = 0; i < count; i++)
+		new (reinterpret_cast<tCriticalSection::tLocker*>(inflated->Lockers[i]))
+			tCriticalSection::tLocker(*inflated->CS);
+	inflated->PendingCount = count;
+
+	// シン・ロックの状態の Lock は所有スレッド以外は書き換えないので、
+	// この交換は必ず成功する
+	void * prev = AtomicCompareExchangePointer(&Lock,
+		reinterpret_cast<void *>(lock), inflated);
+	RISSE_ASSERT(prev == reinterpret_cast<void *>(lock));
+	(void)prev;
+
+	// シン・ロックを待っているスレッドには CS で待ち直してもらう
+	NotifyThinLockWaiters();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tObjectInterface::Enter(tSynchronizer & sync) const
+{
+	risse_ptruint owner = GetThinLockOwner();
+	bool contended = false;
+
+	while(true)
+	{
+		void * current = Lock;
+		risse_ptruint lock = reinterpret_cast<risse_ptruint>(current);
+
+		if(lock == ThinLockFree)
+		{
+			// ロックされていない
+			if(AtomicCompareExchangePointer(&Lock, current,
+				reinterpret_cast<void *>(owner | 1)) != current) continue;
+
+			sync.Object = this;
+			sync.CS = NULL;
+
+			// 他のスレッドとの競合があった場合は、次からは CS で待てるように
+			// ここで膨張させる
+			if(contended) InflateHeld(owner | 1);
+			return;
+		}
+
+		if(lock & ThinLockCountMask)
+		{
+			if((lock & ~ThinLockCountMask) == owner)
+			{
+				// このスレッドが保持している
+				if((lock & ThinLockCountMask) == ThinLockCountMask)
+				{
+					// ネストが深すぎるので膨張させる
+					InflateHeld(lock);
+					continue;
+				}
+				AtomicCompareExchangePointer(&Lock, current,
+					reinterpret_cast<void *>(lock + 1));
+				sync.Object = this;
+				sync.CS = NULL;
+				return;
+			}
+
+			// 他のスレッドが保持しているので、解除されるか膨張されるのを待つ
+			// (ThinLockWaiters を増やしてから Lock を確認し直すので、
+			// その後の解除や膨張の通知は必ず届く)
+			contended = true;
+			{
+				wxMutexLocker mlock(ThinLockMutex);
+				++ThinLockWaiters;
+				if(Lock == current) ThinLockCondition.Wait();
+				--ThinLockWaiters;
+			}
+			continue;
+		}
+
+		// 膨張している
+		tCriticalSection * cs = static_cast<tInflatedLock *>(current)->CS;
+		new (reinterpret_cast<tCriticalSection::tLocker*>(sync.Locker))
+			tCriticalSection::tLocker(*cs);
+		sync.Object = this;
+		sync.CS = cs;
+		return;
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tObjectInterface::Leave(tSynchronizer & sync) const
+{
+	if(sync.CS)
+	{
+		// CS でロックを行った
+		(reinterpret_cast<tCriticalSection::tLocker*>(sync.Locker))->~tLocker();
+		return;
+	}
+
+	void * current = Lock;
+	risse_ptruint lock = reinterpret_cast<risse_ptruint>(current);
+	if(lock & ThinLockCountMask)
+	{
+		// シン・ロックのまま
+		RISSE_ASSERT((lock & ~ThinLockCountMask) == GetThinLockOwner());
+		if((lock & ThinLockCountMask) == 1)
+		{
+			// 解除する; 待っているスレッドがあれば起こす
+			AtomicCompareExchangePointer(&Lock, current,
+				reinterpret_cast<void *>(ThinLockFree));
+			NotifyThinLockWaiters();
+		}
+		else
+		{
+			AtomicCompareExchangePointer(&Lock, current,
+				reinterpret_cast<void *>(lock - 1));
+		}
+		return;
+	}
+
+	// 保持している間に膨張した; 膨張時に引き継いだロックを一つ解除する
+	tInflatedLock * inflated = static_cast<tInflatedLock *>(current);
+	RISSE_ASSERT(inflated->PendingCount > 0);
+	inflated->PendingCount --;
+	(reinterpret_cast<tCriticalSection::tLocker*>(
+		inflated->Lockers[inflated->PendingCount]))->~tLocker();
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tIdentifyObject::tRetValue tIdentifyObject::Operate(RISSE_OBJECTINTERFACE_OPERATE_IMPL_ARG)
 {
@@ -35,28 +35,73 @@ class tRTTI;
  */
 class tObjectInterface : public tCollectee, public tOperateRetValue
 {
+public:
+	class tSynchronizer;
+
+private:
+	/*
+		オブジェクトのロックについて
+
+		ほとんどのオブジェクトは一度もロックされないか、ロックされても
+		作成したスレッド以外からアクセスされることはない。このため、
+		オブジェクトは最初は tCriticalSection を持たず、ロックワード (Lock)
+		へのアトミックな比較と交換のみでロックを行う (シン・ロック)。
+		他のスレッドとの競合が起きた場合や、GetCS() で CS が必要とされた
+		場合にのみ tCriticalSection を作成し (膨張)、以降はそれを使う。
+
+		Lock の値は以下のいずれか。
+		・NULL                      ロックを行わない
+		・ThinLockFree              膨張しておらず、ロックされていない
+		・所有スレッド | ネスト数   シン・ロックを所有スレッドがネスト数だけ保持している
+		                            (所有スレッドは ThinLockCountMask の分の下位ビットが
+		                             0 のスレッドごとのアドレス、ネスト数は 1 以上)
+		・tInflatedLock へのポインタ 膨張している
+		                            (下位ビットは 0)
+
+		シン・ロックの状態の Lock を書き換えるのは所有スレッドのみである。
+		他のスレッドは ThinLockFree からの交換のみを行う。
+	*/
+
+	static const risse_ptruint ThinLockFree = 1; //!< Lock の値: 膨張しておらず、ロックされていない
+	static const risse_ptruint ThinLockCountMask = 7; //!< Lock の値のうちネスト数を表すビット
+
+	/**
+	 * 膨張したロック
+	 */
+	struct tInflatedLock : public tCollectee
+	{
+		tCriticalSection * CS; //!< クリティカルセクション
+		risse_size PendingCount; //!< 膨張時にシン・ロックから引き継いだロックのうち、まだ解除されていない物の数
+		char Lockers[ThinLockCountMask][sizeof(tCriticalSection::tLocker)];
+			//!< 膨張時にシン・ロックから引き継いだロックを配置する先
+	};
+
 	const tRTTI * RTTI; //!< このオブジェクトインターフェースの「型」をC++レベルで
 					//!< 識別するためのメンバ。簡易RTTI。とくに識別しない場合は
 					//!< NULLを入れておく。
-	tCriticalSection * CS; //!< このオブジェクトを保護するためのクリティカルセクション
+	mutable void * volatile Lock; //!< ロックワード
 
 public:
 	/**
 	 * コンストラクタ
 	 */
-	tObjectInterface() { RTTI = NULL; CS = new tCriticalSection();/*TODO: CSのキャッシュ*/}
+	tObjectInterface() { RTTI = NULL; Lock = reinterpret_cast<void *>(ThinLockFree);
+		RISSE_HEAP_PROFILE_ALLOCATED(this, 0, hakObject); }
 
 	/**
 	 * コンストラクタ(RTTIを指定)
 	 * @param rtti	RTTI
 	 */
-	tObjectInterface(const tRTTI * rtti) { RTTI = rtti; CS = new tCriticalSection();/*TODO: CSのキャッシュ*/}
+	tObjectInterface(const tRTTI * rtti) { RTTI = rtti; Lock = reinterpret_cast<void *>(ThinLockFree);
+		RISSE_HEAP_PROFILE_ALLOCATED(this, 0, hakObject); }
 
 	/**
 	 * コンストラクタ(RTTIとCSを指定)
 	 * @param rtti	RTTI
+	 * @param cs	ロックに使う CS (NULL = ロックを行わない)
 	 */
-	tObjectInterface(const tRTTI * rtti, tCriticalSection * cs) { RTTI = rtti; CS = cs; }
+	tObjectInterface(const tRTTI * rtti, tCriticalSection * cs)
+		{ RTTI = rtti; Lock = cs ? CreateInflatedLock(cs) : NULL; }
 
 	/**
 	 * デストラクタ(おそらく呼ばれない)
@@ -111,27 +156,70 @@ public:
 
 	/**
 	 * CS を持っているかどうかを返す
+	 * @return	ロックを行うオブジェクトならば真
 	 */
-	bool HasCS() const { return CS != NULL; }
+	bool HasCS() const { return Lock != NULL; }
 
 	/**
 	 * CS を返す
 	 * @note	CS のロックは tSynchronizer の方を使うこと。
 	 *			これを使うのは RISSE_ASSERT_CS_LOCKED ぐらいにしておくこと。
+	 *			ロックが膨張していない場合はここで膨張させる。
 	 */
-	tCriticalSection * GetCS() const { return CS; }
+	tCriticalSection * GetCS() const
+	{
+		void * lock = Lock;
+		if(!lock) return NULL;
+		if(!(reinterpret_cast<risse_ptruint>(lock) & ThinLockCountMask))
+			return static_cast<tInflatedLock *>(lock)->CS;
+		return Inflate();
+	}
+
+private:
+	/**
+	 * 膨張したロックを作成する
+	 * @param cs	クリティカルセクション
+	 * @return	膨張したロック
+	 */
+	static tInflatedLock * CreateInflatedLock(tCriticalSection * cs);
+
+	/**
+	 * ロックを膨張させる
+	 * @return	膨張したロックの CS
+	 */
+	tCriticalSection * Inflate() const;
+
+	/**
+	 * 現在のスレッドが保持しているシン・ロックを膨張させる
+	 * @param lock	現在の Lock の値
+	 * @note	保持しているネスト数の分だけ CS をロックし、シン・ロックを引き継ぐ
+	 */
+	void InflateHeld(risse_ptruint lock) const;
+
+	/**
+	 * ロックを行う
+	 * @param sync	ロックの状態を記録する tSynchronizer
+	 */
+	void Enter(tSynchronizer & sync) const;
+
+	/**
+	 * ロックを解除する
+	 * @param sync	Enter() でロックの状態を記録した tSynchronizer
+	 */
+	void Leave(tSynchronizer & sync) const;
+
+public:
 
 	/**
 	 * synchronize を行うクラス
 	 */
 	class tSynchronizer
 	{
+		friend class tObjectInterface;
 	private:
 		char Locker[sizeof(tCriticalSection::tLocker)]; //!< ロックオブジェクトを配置する先
-		tCriticalSection * CS; //!< ロックが行うCS
-			//!< (たんにロックが行われたかどうかを表すbool値でもよいのだが
-			//!<  この構造体のサイズを推測しなければならない理由が risseVariant.h にあり
-			//!< 推測しやすいポインタサイズとした (bool はパディングがどうなるかが分かりづらい) )
+		const tObjectInterface * Object; //!< ロックを行ったオブジェクト (NULL = ロックを行っていない)
+		tCriticalSection * CS; //!< Locker でロックを行った CS (NULL = シン・ロックを行った)
 		// void * operator new(size_t); //!< heap 上に作成できません
 		// void * operator new[](size_t); //!< heap 上に作成できません
 		tSynchronizer(const tSynchronizer &); //!< copy 出来ません
@@ -143,23 +231,11 @@ public:
 		 */
 		tSynchronizer(const tObjectInterface * intf)
 		{
-			// intf が非 null かつ intf が CS を持っている場合のみに
+			// intf が非 null かつ intf がロックを行うオブジェクトの場合のみに
 			// ロックを行う。
-			// tCriticalSection::tLocker はコンストラクタでロックを
-			// 行い、デストラクタでロックの解除をするため、ロックを行う
-			// 必要がある場合はプレースメント new でロックを行う。解除は
-			// 同様にデストラクタを個別に呼び出すことで実現する。
-			if(intf && intf->CS)
-			{
-				// ロックを行う
-				CS = intf->CS;
-				new (reinterpret_cast<tCriticalSection::tLocker*>(Locker))
-					tCriticalSection::tLocker(*(intf->CS));
-			}
-			else
-			{
-				CS = NULL;
-			}
+			Object = NULL;
+			CS = NULL;
+			if(intf && intf->Lock) intf->Enter(*this);
 		}
 
 		/**
@@ -167,11 +243,7 @@ public:
 		 */
 		~tSynchronizer()
 		{
-			if(CS)
-			{
-				(reinterpret_cast<tCriticalSection::tLocker*>(Locker))->
-						~tLocker();
-			}
+			if(Object) Object->Leave(*this);
 		}
 	};
 
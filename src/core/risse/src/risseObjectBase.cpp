@@ -29,6 +29,10 @@ RISSE_DEFINE_SOURCE_ID(45114,31718,49668,18467,56195,41722,1990,5427);
 //---------------------------------------------------------------------------
 tObjectBase::tObjectBase() : PrototypeName(ss_class), MembersName(tString::GetEmptyString())
 {
+	Shape = tObjectShape::GetRoot();
+	Slots = NULL;
+	SlotCapacity = 0;
+	HashTable = NULL;
 	DefaultMethodContext = new tVariant(this);
 }
 //---------------------------------------------------------------------------
@@ -38,6 +42,10 @@ tObjectBase::tObjectBase() : PrototypeName(ss_class), MembersName(tString::GetEm
 tObjectBase::tObjectBase(const tString & prototype_name, const tString & members_name) :
 				PrototypeName(prototype_name), MembersName(members_name)
 {
+	Shape = tObjectShape::GetRoot();
+	Slots = NULL;
+	SlotCapacity = 0;
+	HashTable = NULL;
 	DefaultMethodContext = new tVariant(this);
 }
 //---------------------------------------------------------------------------
@@ -48,7 +56,29 @@ void tObjectBase::Enumurate(tEnumMemberCallback * callback)
 {
 	volatile tSynchronizer sync(this); // sync
 
-	tMemberHashTable::tIterator iterator(HashTable);
+	if(Shape)
+	{
+		// シェイプをたどると追加順とは逆順にメンバ名が得られるので、
+		// いったん配列に並べてから追加順に列挙する。
+		// コールバックの中でメンバが追加されるとスロットの配列が再確保され、
+		// 削除されると辞書モードに移行するので、メンバ情報は毎回取得し直し、
+		// コピーを渡す。シェイプはメンバの追加でしか遷移しないので、シェイプを
+		// 使っている間は列挙を始めた時点のスロット位置がそのまま使える。
+		risse_size count = Shape->GetSlotCount();
+		const tString * names[tObjectShape::MaxSlotCount];
+		for(const tObjectShape * shape = Shape; shape->GetParent(); shape = shape->GetParent())
+			names[shape->GetSlotCount() - 1] = &shape->GetName();
+		for(risse_size i = 0; i < count; i++)
+		{
+			const tMemberData * member = Shape ? Slots + i : HashTable->Find(*names[i]);
+			if(!member) continue; // 削除された
+			tMemberData data(*member);
+			if(!callback->OnEnum(*names[i], data)) return;
+		}
+		return;
+	}
+
+	tMemberHashTable::tIterator iterator(*HashTable);
 	while(!iterator.End())
 	{
 		if(!callback->OnEnum(iterator.GetKey(), iterator.GetValue())) return;
@@ -58,6 +88,83 @@ void tObjectBase::Enumurate(tEnumMemberCallback * callback)
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+void tObjectBase::AddMember(const tString & name, const tMemberData & data)
+{
+	// 既存のメンバの場合は上書きする
+	tMemberData * member = FindMember(name);
+	if(member)
+	{
+		*member = data;
+		return;
+	}
+
+	if(Shape)
+	{
+		tObjectShape * new_shape = Shape->AddMember(name);
+		if(new_shape)
+		{
+			risse_size index = Shape->GetSlotCount();
+			if(index >= SlotCapacity)
+			{
+				// スロットの配列を拡張する。
+				// 以前の配列は明示的には解放せず、GC にまかせる。
+				risse_size new_capacity = SlotCapacity ? SlotCapacity * 2 : 4;
+				if(new_capacity > tObjectShape::MaxSlotCount)
+					new_capacity = tObjectShape::MaxSlotCount;
+				tMemberData * new_slots = static_cast<tMemberData *>(
+					MallocCollectee(sizeof(tMemberData) * new_capacity));
+				for(risse_size i = 0; i < index; i++)
+					::new (new_slots + i) tMemberData(Slots[i]);
+				Slots = new_slots;
+				SlotCapacity = new_capacity;
+			}
+			::new (Slots + index) tMemberData(data);
+			Shape = new_shape;
+			return;
+		}
+
+		// シェイプでは扱えないメンバ数になった
+		ConvertToDictionary();
+	}
+
+	HashTable->Add(name, data);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tObjectBase::DeleteMember(const tString & name)
+{
+	if(Shape)
+	{
+		if(Shape->Find(name) == risse_size_max) return false;
+
+		// シェイプはメンバの削除を扱わないので辞書モードに移行する
+		ConvertToDictionary();
+	}
+
+	return HashTable->Delete(name);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tObjectBase::ConvertToDictionary()
+{
+	RISSE_ASSERT(Shape);
+
+	HashTable = new tMemberHashTable();
+	for(const tObjectShape * shape = Shape; shape->GetParent(); shape = shape->GetParent())
+		HashTable->Add(shape->GetName(), Slots[shape->GetSlotCount() - 1]);
+
+	Shape = NULL;
+	Slots = NULL;
+	SlotCapacity = 0;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tObjectBase::tRetValue tObjectBase::Read(const tString & name, tOperateFlags flags,
 	tVariant &result, const tVariant &This) const
@@ -77,7 +184,7 @@ tObjectBase::tRetValue tObjectBase::Read(const tString & name, tOperateFlags fla
 		}
 	}
 
-	tMemberData * member = HashTable.Find(name);
+	tMemberData * member = FindMember(name);
 
 	if(!member)
 	{
@@ -183,13 +290,18 @@ tObjectBase::tRetValue tObjectBase::Read(const tString & name, tOperateFlags fla
 		break;
 
 	case tMemberAttribute::pcProperty: // プロパティアクセス
+	  {
 		// member->Value を引数なしで関数呼び出しし、その結果を得る
-		tRetValue rv = member->Value.Operate(GetRTTI()->GetScriptEngine(),
+		// (プロパティハンドラの中でメンバが追加/削除されると member は
+		// 無効になるので、値をコピーしてから呼び出す)
+		tVariant getter(member->Value);
+		tRetValue rv = getter.Operate(GetRTTI()->GetScriptEngine(),
 			ocFuncCall, &result, tString::GetEmptyString(),
 			flags & ~tOperateFlags::ofUseClassMembersRule, tMethodArgument::Empty(),
 			(DefaultMethodContext && !flags.Has(tOperateFlags::ofUseClassMembersRule)) ? *DefaultMethodContext:This);
 		if(rv != rvNoError && rv != rvMemberNotFound) return rv; // rvMemberNotFound以外のなにかエラーがおこったらここで戻る
 		break;
+	  }
 	}
 
 	if(!flags.Has(tOperateFlags::ofUseClassMembersRule))
@@ -226,7 +338,7 @@ tObjectBase::tRetValue tObjectBase::Write(const tString & name, tOperateFlags fl
 	tMemberData * member;
 
 	// メンバに書き込む
-	member = HashTable.Find(name);
+	member = FindMember(name);
 
 	if(member)
 	{
@@ -284,11 +396,16 @@ tObjectBase::tRetValue tObjectBase::Write(const tString & name, tOperateFlags fl
 			return rvNoError;
 
 		case tMemberAttribute::pcProperty: // プロパティアクセス
-			return member->Value.Operate(GetRTTI()->GetScriptEngine(), ocDSet, NULL,
+		  {
+			// プロパティハンドラの中でメンバが追加/削除されると member は
+			// 無効になるので、値をコピーしてから呼び出す
+			tVariant setter(member->Value);
+			return setter.Operate(GetRTTI()->GetScriptEngine(), ocDSet, NULL,
 				tString::GetEmptyString(),
 				flags & ~tOperateFlags::ofUseClassMembersRule, tMethodArgument::New(value),
 				(DefaultMethodContext && !flags.Has(tOperateFlags::ofUseClassMembersRule)) ?
 						*DefaultMethodContext:This);
+		  }
 		}
 	}
 
@@ -301,7 +418,7 @@ tObjectBase::tRetValue tObjectBase::Write(const tString & name, tOperateFlags fl
 			// 新規作成フラグがある場合はメンバを新規作成する
 			tMemberAttribute attrib = tMemberAttribute::GetDefault();
 			attrib.Overwrite(flags);
-			HashTable.Add(name, tMemberData(tMemberData(value, attrib)));
+			AddMember(name, tMemberData(value, attrib));
 			return rvNoError;
 		}
 		return rvMemberNotFound; // そうでない場合はメンバは見つからなかったことにする
@@ -391,7 +508,7 @@ tObjectBase::tRetValue tObjectBase::Write(const tString & name, tOperateFlags fl
 		tMemberAttribute attrib;
 		attrib = tMemberAttribute::GetDefault();
 		attrib.Overwrite(flags);
-		HashTable.Add(name, tMemberData(tMemberData(value, attrib)));
+		AddMember(name, tMemberData(value, attrib));
 		return rvNoError;
 	}
 	else
@@ -421,7 +538,7 @@ tObjectBase::tRetValue tObjectBase::Delete(const tString & name, tOperateFlags f
 		}
 	}
 
-	if(!HashTable.Delete(name))
+	if(!DeleteMember(name))
 	{
 		if(flags.Has(tOperateFlags::ofInstanceMemberOnly))
 			return rvMemberNotFound; // クラスを探さない場合はここでかえる
@@ -521,7 +638,7 @@ tObjectBase::tRetValue tObjectBase::SetAttribute(
 		}
 	}
 
-	tMemberData * member = HashTable.Find(name);
+	tMemberData * member = FindMember(name);
 
 	if(!member)
 	{
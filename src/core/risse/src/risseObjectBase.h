@@ -18,6 +18,7 @@
 #include "risseVariant.h"
 #include "risseHashTable.h"
 #include "risseString.h"
+#include "risseObjectShape.h"
 
 namespace Risse
 {
@@ -70,7 +71,18 @@ public:
 protected:
 	typedef tHashTable<tString, tMemberData>
 		tMemberHashTable; //!< ハッシュ表の型
-	tMemberHashTable HashTable; //!< ハッシュ表
+
+	// メンバは通常、シェイプ(tObjectShape)とスロットの配列で保持する。
+	// メンバの削除が行われた場合などは辞書モードに移行し、ハッシュ表で保持する。
+	// メンバ情報はスロットの配列やハッシュ表に直接格納する。スロットの配列は
+	// シェイプの遷移に伴って再確保され、辞書モードへの移行でも位置が変わるので、
+	// FindMember() で得たポインタはメンバの追加や削除をまたいで保持してはならない。
+	// プロパティハンドラの呼び出しなど、スクリプトが実行されうる処理をまたぐ
+	// 場合は必要な値をコピーしておくか、スロット位置やメンバ名で取得し直すこと。
+	tObjectShape * Shape; //!< シェイプ (NULL = 辞書モード)
+	tMemberData * Slots; //!< スロットの配列 (シェイプ使用時のみ)
+	risse_size SlotCapacity; //!< スロットの配列の確保容量
+	tMemberHashTable * HashTable; //!< ハッシュ表 (辞書モード時のみ)
 	const tString & PrototypeName;
 		//!< プロトタイプ名; このインスタンスにメンバが無かったときに読みに行く先のオブジェクトの名前
 	const tString & MembersName;
@@ -103,6 +115,63 @@ public:
 	 */
 	void Enumurate(tEnumMemberCallback * callback);
 
+	/**
+	 * シェイプを得る
+	 * @return	シェイプ (辞書モードの場合は NULL)
+	 * @note	シェイプが同一ならばメンバのスロット位置も同一であるため、
+	 *			(シェイプ, スロット位置) の組をキャッシュすることで
+	 *			メンバ名の検索を省略できる。
+	 */
+	const tObjectShape * GetShape() const { return Shape; }
+
+	/**
+	 * スロットを得る
+	 * @param index	スロット位置 (GetShape() で得たシェイプにおける位置)
+	 * @return	スロット
+	 * @note	メンバが追加/削除されると参照は無効になる
+	 */
+	tMemberData & GetSlot(risse_size index) const
+	{
+		RISSE_ASSERT(Shape && index < Shape->GetSlotCount());
+		return Slots[index];
+	}
+
+private:
+	/**
+	 * このインスタンスのメンバを検索する
+	 * @param name	メンバ名
+	 * @return	メンバ情報 (見つからなかった場合は NULL)
+	 * @note	メンバが追加/削除されるとポインタは無効になる
+	 */
+	tMemberData * FindMember(const tString & name) const
+	{
+		if(Shape)
+		{
+			risse_size index = Shape->Find(name);
+			return index != risse_size_max ? Slots + index : NULL;
+		}
+		return HashTable->Find(name);
+	}
+
+	/**
+	 * このインスタンスにメンバを追加する
+	 * @param name	メンバ名 (既存のメンバの場合は上書きされる)
+	 * @param data	メンバ情報
+	 */
+	void AddMember(const tString & name, const tMemberData & data);
+
+	/**
+	 * このインスタンスのメンバを削除する
+	 * @param name	メンバ名
+	 * @return	削除されれば真
+	 */
+	bool DeleteMember(const tString & name);
+
+	/**
+	 * 辞書モードに移行する
+	 */
+	void ConvertToDictionary();
+
 public:
 
 	/**
@@ -0,0 +1,147 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief オブジェクトのメンバ配置(シェイプ)
+//---------------------------------------------------------------------------
+#include "prec.h"
+#include "risseObjectShape.h"
+
+namespace Risse
+{
+RISSE_DEFINE_SOURCE_ID(6920,33015,12477,18573,48262,2741,60394,14205);
+
+
+//---------------------------------------------------------------------------
+tObjectShape * tObjectShape::Root = NULL;
+tAtomicCounter tObjectShape::ShapeCount;
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tObjectShape::tTable::tTable()
+{
+	Tip = NULL;
+	for(risse_size i = 0; i < Size; i++) Entries[i] = NULL;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tObjectShape::tTable::Insert(tObjectShape * shape)
+{
+	// 要素を追加するのは Tip を獲得したシェイプのみなので、空きの位置を
+	// 探す処理と書き込みの間で競合は起きない。
+	// 書き込みはアトミックに行い、それまでに設定したシェイプの内容が
+	// 他のスレッドから見えるようにする。
+	for(risse_size i = 0; i < Size; i++)
+	{
+		risse_size index = (shape->Hash + i) & (Size - 1);
+		if(!Entries[index])
+		{
+			AtomicCompareExchangePointer(
+				reinterpret_cast<void * volatile *>(Entries + index), NULL, shape);
+			return;
+		}
+	}
+	RISSE_ASSERT(!"shape table overflow"); // 一本の枝の上のシェイプは MaxSlotCount 個以下
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tObjectShape::tObjectShape()
+{
+	Parent = NULL;
+	Hash = 0;
+	SlotCount = 0;
+	Table = new tTable();
+	Table->Tip = this;
+	FirstChild = NULL;
+	NextSibling = NULL;
+	SiblingCount = 0;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tObjectShape::tObjectShape(tObjectShape * parent, const tString & name, risse_uint32 hash) :
+	Name(name)
+{
+	Parent = parent;
+	Hash = hash;
+	SlotCount = parent->SlotCount + 1;
+	FirstChild = NULL;
+	NextSibling = NULL;
+	SiblingCount = 0;
+
+	// 親の表の末尾が親自身ならば、その表を延長して共有する
+	tTable * table = parent->Table;
+	if(AtomicCompareExchangePointer(
+		reinterpret_cast<void * volatile *>(&table->Tip), parent, this) != parent)
+	{
+		// すでに他の子が表を延長している (枝分かれ) ので、
+		// 祖先の分をコピーした新しい表を作る
+		table = new tTable();
+		table->Tip = this;
+		for(tObjectShape * shape = parent; shape->Parent;
+			shape = const_cast<tObjectShape *>(shape->Parent))
+			table->Insert(shape);
+	}
+	table->Insert(this);
+	Table = table;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tObjectShape * tObjectShape::AddMember(const tString & name)
+{
+	RISSE_ASSERT(Find(name) == risse_size_max);
+
+	if(SlotCount >= MaxSlotCount) return NULL; // これ以上はシェイプでは扱わない
+
+	risse_uint32 hash = MakeHash(name);
+	tObjectShape * shape = NULL;
+	while(true)
+	{
+		tObjectShape * first = FirstChild;
+		for(tObjectShape * child = first; child; child = child->NextSibling)
+		{
+			if(child->Hash == hash && child->Name == name) return child;
+		}
+
+		// 遷移先やシェイプが多すぎる場合は、シェイプでは扱わない
+		risse_size count = first ? first->SiblingCount + 1 : 0;
+		if(count >= MaxTransitionCount) return NULL;
+		if(!shape)
+		{
+			if(ShapeCount >= MaxShapeCount) return NULL;
+			shape = new tObjectShape(this, name, hash);
+		}
+
+		// 遷移先のリストの先頭に追加する
+		shape->NextSibling = first;
+		shape->SiblingCount = count;
+		if(AtomicCompareExchangePointer(
+			reinterpret_cast<void * volatile *>(&FirstChild), first, shape) == first)
+		{
+			++ShapeCount;
+			return shape;
+		}
+
+		// 他のスレッドが先に遷移先を追加したので、やり直す。
+		// 同じ名前の遷移先が追加されていた場合は作成したシェイプは使われない。
+		// そのシェイプが表に残っても、表を共有する他のシェイプからは子孫として
+		// 扱われるだけなので害はない。
+	}
+}
+//---------------------------------------------------------------------------
+
+} // namespace Risse
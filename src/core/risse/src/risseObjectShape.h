@@ -0,0 +1,208 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief オブジェクトのメンバ配置(シェイプ)
+//---------------------------------------------------------------------------
+
+#ifndef risseObjectShapeH
+#define risseObjectShapeH
+
+/*! @note
+Risse オブジェクトのシェイプについて
+
+同じクラスのインスタンスは、ほとんどの場合同じ名前のメンバを同じ順番で
+持つ。そこで、tObjectBase はインスタンスごとにハッシュ表を持つかわりに、
+「どの名前のメンバが何番目のスロットにあるか」という情報 (シェイプ) を
+同じメンバ構成のインスタンス間で共有し、インスタンスにはスロットの配列
+だけを持たせる。
+
+シェイプはメンバの追加順に従った木構造 (遷移木) をなす。ルートのシェイプは
+メンバを一つも持たず、あるシェイプにメンバ name を追加したシェイプは
+そのシェイプの子として遷移表に登録される。同じ順番で同じ名前のメンバを
+追加したインスタンスは、必ず同じシェイプを指すことになる。
+
+シェイプは一度作成されると変更されない(遷移先のリストを除く)。このため、
+シェイプが同一ならばメンバのスロット位置も同一であり、VM などでインライン
+キャッシュを行う際には (シェイプ, スロット位置) の組をキャッシュすればよい。
+
+遷移先のリストはシェイプごとの単方向リストで、ロックを使わずに先頭への
+追加 (比較と交換) のみで更新する。
+
+メンバ名→シェイプの表 (tTable) は、遷移木の一本の枝 (親子の並び) の間で
+共有する。子シェイプは、親の表の末尾 (Tip) が親自身であればその表に自分を
+追加して共有し、すでに他の子が表を延長していた場合 (枝分かれ) のみ、祖先の
+分をコピーした新しい表を作る。同じ表を共有するシェイプは一本の枝の上に
+並ぶので、表で見つかったシェイプのうち自分のスロット数以下の位置にある物
+だけが自分の祖先である。
+
+遷移木はシェイプが使われなくなっても刈り込まない。そのかわり、一つの
+シェイプからの遷移先の数を MaxTransitionCount に、シェイプの総数を
+MaxShapeCount に制限し、これを超える場合はシェイプを使わないようにする。
+動的な名前のメンバを次々に追加するようなオブジェクトはすぐに辞書モードに
+移行する。
+
+メンバの削除が行われたり、メンバの数が MaxSlotCount を超えたりした
+インスタンスは、シェイプを使うのをやめ、従来通りインスタンスごとの
+ハッシュ表 (辞書モード) に移行する。
+*/
+
+#include "risseTypes.h"
+#include "risseGC.h"
+#include "risseString.h"
+#include "risseThread.h"
+
+namespace Risse
+{
+//---------------------------------------------------------------------------
+/**
+ * オブジェクトのシェイプ
+ * @note	参照にはロックを必要としない。
+ */
+class tObjectShape : public tCollectee
+{
+public:
+	static const risse_size MaxSlotCount = 64; //!< シェイプで扱う最大のメンバ数
+	static const risse_size MaxTransitionCount = 32; //!< 一つのシェイプからの遷移先の最大数
+	static const long MaxShapeCount = 65536; //!< シェイプの最大数
+
+private:
+	/**
+	 * メンバ名→シェイプ の表 (遷移木の一本の枝の間で共有される)
+	 * @note	オープンアドレス法によるハッシュ表。要素の追加は Tip を
+	 *			獲得したシェイプのみが行い、削除は行わない。
+	 */
+	struct tTable : public tCollectee
+	{
+		static const risse_size Size = MaxSlotCount * 2; //!< 要素の数 (2の累乗)
+
+		tObjectShape * volatile Tip; //!< この表に最後に追加されたシェイプ
+		tObjectShape * volatile Entries[Size]; //!< 要素 (NULL = 空き)
+
+		/**
+		 * コンストラクタ
+		 */
+		tTable();
+
+		/**
+		 * シェイプを追加する
+		 * @param shape	シェイプ
+		 */
+		void Insert(tObjectShape * shape);
+	};
+
+	const tObjectShape * Parent; //!< 親シェイプ(ルートの場合はNULL)
+	tString Name; //!< このシェイプで追加されたメンバの名前
+	risse_uint32 Hash; //!< Name のハッシュ
+	risse_size SlotCount; //!< スロットの数
+	tTable * Table; //!< メンバ名→シェイプ の表
+	tObjectShape * volatile FirstChild; //!< 遷移先のリストの先頭 (まだ子が無い場合はNULL)
+	tObjectShape * NextSibling; //!< 同じ親を持つ次のシェイプ
+	risse_size SiblingCount; //!< 遷移先のリスト中でこのシェイプ以降にあるシェイプの数
+
+	static tObjectShape * Root; //!< ルートのシェイプ
+	static tAtomicCounter ShapeCount; //!< 作成されたシェイプの数
+
+private:
+	/**
+	 * コンストラクタ(ルート用)
+	 */
+	tObjectShape();
+
+	/**
+	 * コンストラクタ(子シェイプ用)
+	 * @param parent	親シェイプ
+	 * @param name		追加するメンバの名前
+	 * @param hash		name のハッシュ
+	 */
+	tObjectShape(tObjectShape * parent, const tString & name, risse_uint32 hash);
+
+	/**
+	 * メンバ名のハッシュを得る
+	 * @param name	メンバ名
+	 * @return	ハッシュ
+	 */
+	static risse_uint32 MakeHash(const tString & name)
+	{
+		risse_uint32 hash = name.GetHint();
+		if(!hash)
+		{
+			hash = name.GetHash();
+			name.SetHint(hash); // 計算したハッシュは文字列に格納しておく
+		}
+		return hash;
+	}
+
+public:
+	/**
+	 * ルートのシェイプを得る
+	 * @return	ルートのシェイプ
+	 * @note	最初の呼び出しは tScriptEngine の初期化中に行われるため、
+	 *			ルートの作成に関するスレッド保護は行わない
+	 */
+	static tObjectShape * GetRoot()
+	{
+		if(!Root) Root = new tObjectShape();
+		return Root;
+	}
+
+	/**
+	 * スロットの数を得る
+	 * @return	スロットの数
+	 */
+	risse_size GetSlotCount() const { return SlotCount; }
+
+	/**
+	 * 親シェイプを得る
+	 * @return	親シェイプ(ルートの場合はNULL)
+	 */
+	const tObjectShape * GetParent() const { return Parent; }
+
+	/**
+	 * このシェイプで追加されたメンバの名前を得る
+	 * @return	メンバ名 (スロット位置は GetSlotCount() - 1)
+	 */
+	const tString & GetName() const { return Name; }
+
+	/**
+	 * メンバのスロット位置を得る
+	 * @param name	メンバ名
+	 * @return	スロット位置 (見つからなかった場合は risse_size_max)
+	 */
+	risse_size Find(const tString & name) const
+	{
+		if(!SlotCount) return risse_size_max;
+		risse_uint32 hash = MakeHash(name);
+		for(risse_size i = 0; i < tTable::Size; i++)
+		{
+			const tObjectShape * shape = Table->Entries[(hash + i) & (tTable::Size - 1)];
+			if(!shape) break;
+			if(shape->Hash == hash && shape->Name == name)
+			{
+				// 自分よりも後ろにあるシェイプは子孫なので、自分は
+				// そのメンバを持たない
+				return shape->SlotCount <= SlotCount ? shape->SlotCount - 1 : risse_size_max;
+			}
+		}
+		return risse_size_max;
+	}
+
+	/**
+	 * メンバを一つ追加したシェイプを得る
+	 * @param name	追加するメンバの名前(このシェイプにまだ含まれていないこと)
+	 * @return	遷移先のシェイプ (MaxSlotCount, MaxTransitionCount あるいは
+	 *			MaxShapeCount を超える場合は NULL)
+	 */
+	tObjectShape * AddMember(const tString & name);
+};
+//---------------------------------------------------------------------------
+} // namespace Risse
+
+
+#endif
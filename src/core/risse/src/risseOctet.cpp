@@ -22,6 +22,7 @@ RISSE_DEFINE_SOURCE_ID(22894,62791,44554,18883,55951,15622,1807,62704);
 //---------------------------------------------------------------------------
 tOctetBlock::tOctetBlock(const risse_uint8 * buf, risse_size length)
 {
+	Owner = NULL;
 	Capacity = Length = length;
 	if(length)
 	{
@@ -39,6 +40,7 @@ tOctetBlock::tOctetBlock(const risse_uint8 * buf, risse_size length)
 //---------------------------------------------------------------------------
 tOctetBlock::tOctetBlock(risse_size length)
 {
+	Owner = NULL;
 	Capacity = Length = length;
 	if(length)
 		Buffer = AllocateInternalBuffer(length);
@@ -55,14 +57,17 @@ tOctetBlock::tOctetBlock(const tOctetBlock & ref,
 	if(length)
 	{
 		RISSE_ASSERT(ref.Length - offset >= length);
-		ref.Capacity = 0; // 共有可能性を表す
+		// 内容はコピーせず、ref のバッファの一部をそのまま参照する
+		ref.Capacity = Capacity = 0; // 共有可能性を表す
 		Buffer = ref.Buffer + offset;
 		Length = length;
+		Owner = ref.Owner;
 	}
 	else
 	{
 		Buffer = NULL;
 		Length = Capacity = 0;
+		Owner = NULL;
 	}
 }
 //---------------------------------------------------------------------------
@@ -103,6 +108,7 @@ void tOctetBlock::Append(const risse_uint8 * buffer, risse_size length)
 		memcpy(newbuf, Buffer, Length);
 		memcpy(newbuf + Length, buffer, length);
 		Buffer = newbuf;
+		Owner = NULL;
 	}
 	else
 	{
@@ -197,6 +203,7 @@ risse_uint8 * tOctetBlock::InternalIndepend() const
 	memcpy(newbuf, Buffer, Length);
 	Buffer = newbuf;
 	Capacity = Length;
+	Owner = NULL;
 	return Buffer;
 }
 //---------------------------------------------------------------------------
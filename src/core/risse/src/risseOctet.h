@@ -19,6 +19,17 @@ Risse オクテット列について
 
 Risse オクテット列は tOctetBlock クラスで表される。
 
+■ 部分オクテット列とバッファの所有者
+
+部分オクテット列 (Octet.substr など) は元のオクテット列とバッファを共有し、
+内容をコピーしない。バッファを共有している間は Capacity が 0 になり、
+書き換えが必要になった時点で初めてバッファがコピーされる。
+
+バッファは GC ヒープ上に確保されたものとは限らず、ファイルをメモリマップした
+領域などを指す場合もある。そのような場合は、その領域を解放する役目をもつ
+オブジェクトを Owner に保持する。Owner は部分オクテット列にも引き継がれるため、
+どれか一つでもその領域を参照するオクテット列が生きている限り、領域が
+解放されることはない。
 */
 
 #include "risseTypes.h"
@@ -39,6 +50,7 @@ class tOctetBlock : public tCollectee
 	mutable risse_uint8  *	Buffer;	//!< オクテット列バッファ (NULL = 0オクテット長)
 	mutable risse_size Capacity; //!< 確保容量 ( 0 = バッファ共有中 )
 	risse_size Length; //!< 長さ
+	mutable const tCollectee * Owner; //!< バッファの所有者 (GCヒープ外のバッファを参照している場合のみ; それ以外はNULL)
 
 public:
 	/**
@@ -48,6 +60,7 @@ public:
 	{
 		Buffer = 0;
 		Capacity = Length = 0;
+		Owner = NULL;
 	}
 
 
@@ -94,6 +107,7 @@ public:
 		ref.Capacity = Capacity = 0;
 		Buffer = ref.Buffer;
 		Length = ref.Length;
+		Owner = ref.Owner;
 		return *this;
 	}
 
@@ -113,7 +127,7 @@ public: // object property
 	{
 		Independ();
 		Length = n;
-		if(!n) Buffer = NULL, Capacity = 0;
+		if(!n) Buffer = NULL, Capacity = 0, Owner = NULL;
 	}
 
 	/**
@@ -132,18 +146,28 @@ public: // pointer
 	risse_uint8 * Allocate(risse_size n)
 	{
 		Capacity = Length = n;
+		Owner = NULL;
 		return Buffer = AllocateInternalBuffer(n);
 	}
 
 	/**
 	 * 既存のメモリ領域を「参照」するオクテット列を新規に作成して帰す
+	 * @param ptr	メモリ領域
+	 * @param len	メモリ領域の長さ
+	 * @param owner	メモリ領域の所有者 (GCヒープ外の領域を参照する場合に、
+	 *				オクテット列が生きている間その領域を解放させないために
+	 *				保持するオブジェクト; 不要ならば NULL)
+	 * @note	オクテット列は常に共有状態となるため、書き換えを行おうとすると
+	 *			内容は GC ヒープ上にコピーされる。
 	 */
-	static tOctetBlock MakeReference(const risse_uint8 * ptr, risse_size len)
+	static tOctetBlock MakeReference(const risse_uint8 * ptr, risse_size len,
+		const tCollectee * owner = NULL)
 	{
 		tOctetBlock block;
 		block.Capacity = 0;
 		block.Length = len;
 		block.Buffer = const_cast<risse_uint8 *>(ptr);
+		block.Owner = owner;
 		return block;
 	}
 
@@ -157,7 +181,7 @@ private: // storage
 	static risse_uint8 * AllocateInternalBuffer(risse_size n, risse_uint8 * prevbuf = NULL)
 	{
 		return prevbuf ?
-			static_cast<risse_uint8*>(ReallocCollectee(prevbuf, n)):
+			static_cast<risse_uint8*>(ReallocCollectee(prevbuf, n, hakAtomic)):
 			static_cast<risse_uint8*>(MallocAtomicCollectee(n));
 	}
 
@@ -314,6 +338,12 @@ public: // pointer
 		return Buffer;
 	}
 
+	/**
+	 * バッファの所有者を得る
+	 * @return	バッファの所有者 (GC ヒープ上のバッファを使っている場合は NULL)
+	 */
+	const tCollectee * GetOwner() const { return Owner; }
+
 	/**
 	 * 内部バッファへのポインタを獲る
 	 * @return	内部バッファ
@@ -38,6 +38,8 @@ RISSE_IMPL_CLASS_BEGIN(tOctetClass, ss_Octet, engine->PrimitiveClass)
 		tMemberAttribute().Set(tMemberAttribute::mcConst).Set(tMemberAttribute::ocFinal));
 	BindProperty(this, ss_length, &tOctetClass::get_length,
 		tMemberAttribute().Set(tMemberAttribute::mcConst).Set(tMemberAttribute::ocFinal));
+	BindFunction(this, ss_substr, &tOctetClass::substr,
+		tMemberAttribute().Set(tMemberAttribute::mcConst).Set(tMemberAttribute::ocFinal));
 RISSE_IMPL_CLASS_END()
 //---------------------------------------------------------------------------
 
@@ -64,5 +66,33 @@ void tOctetClass::get_length(const tNativePropGetInfo & info)
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+void tOctetClass::substr(risse_offset start, const tNativeCallInfo & info)
+{
+	if(info.result)
+	{
+		const tOctet & oct = info.This.operator tOctet();
+		if(start < 0) start += oct.GetLength();
+		if(start < 0 || static_cast<risse_size>(start) >= oct.GetLength())
+		{
+			info.result->Clear(); // 値が範囲外なので void を返す
+		}
+		else
+		{
+			// 第２引数が与えられた場合はその長さ、与えられなければオクテット列の
+			// 最後まで切り取る。
+			// 部分オクテット列は元のバッファを共有するため、内容はコピーされない。
+			risse_size len = info.args.HasArgument(1) ?
+				(risse_size)(risse_int64)info.args[1] : risse_size_max;
+
+			risse_size avail_len = oct.GetLength() - start;
+			if(len > avail_len) len = avail_len;
+			*info.result = tOctet(oct, static_cast<risse_size>(start), len);
+		}
+	}
+}
+//---------------------------------------------------------------------------
+
+
 } /* namespace Risse */
 
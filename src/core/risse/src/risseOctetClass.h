@@ -30,6 +30,7 @@ RISSE_DEFINE_CLASS_BEGIN(tOctetClass, tPrimitiveClassBase, tOctet, itPrimitive)
 public: // Risse用メソッドなど
 	static void initialize(const tNativeCallInfo & info);
 	static void get_length(const tNativePropGetInfo & info);
+	static void substr(risse_offset start, const tNativeCallInfo & info);
 RISSE_DEFINE_CLASS_END()
 //---------------------------------------------------------------------------
 } // namespace Risse
@@ -15,6 +15,7 @@
 #include "risseScriptEngine.h"
 #include "risseStaticStrings.h"
 #include "rissePackage.h"
+#include "risseObjectShape.h"
 #include "risse_parser/risseRisseScriptBlockClass.h"
 
 
@@ -55,6 +56,7 @@ tScriptEngine::tScriptEngine()
 		CommonObjectsInitialized = true;
 		// 共通初期化
 		GC_init();
+		tObjectShape::GetRoot(); // ルートのシェイプはここで作成しておく
 	}
 
 	// 各クラスのインスタンスを作成する
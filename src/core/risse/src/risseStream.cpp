@@ -280,6 +280,160 @@ void tStreamAdapter::WriteI8LE(risse_uint8 v)
 
 
 
+//---------------------------------------------------------------------------
+tBufferedStreamReader::tBufferedStreamReader(const tStreamAdapter & stream) :
+	Stream(stream)
+{
+	BufferPosition = Stream.GetPosition();
+	Current = Limit = Buffer;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tBufferedStreamReader::Sync()
+{
+	if(Current != Limit)
+	{
+		// 下位のストリームはバッファの終端の位置にあるので、
+		// 読み込んでいない分だけ戻す
+		risse_uint64 pos = Tell();
+		Stream.SetPosition(pos);
+		BufferPosition = pos;
+	}
+	else
+	{
+		BufferPosition += Limit - Buffer;
+	}
+	Current = Limit = Buffer;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tBufferedStreamReader::Seek(risse_int64 offset, tOrigin whence)
+{
+	risse_int64 pos;
+	switch(whence)
+	{
+	case soSet:
+		pos = offset;
+		break;
+	case soCurrent:
+		pos = static_cast<risse_int64>(Tell()) + offset;
+		break;
+	default:
+		// 終端からの位置はストリームのサイズがわからないと計算できないので
+		// 下位のストリームに任せる
+		Sync();
+		if(!Stream.Seek(offset, whence)) return false;
+		BufferPosition = Stream.Tell();
+		return true;
+	}
+
+	if(pos < 0) return false;
+
+	// シーク先がバッファ内ならばバッファ内の位置を変えるだけでよい
+	if(static_cast<risse_uint64>(pos) >= BufferPosition &&
+		static_cast<risse_uint64>(pos) <= BufferPosition + (Limit - Buffer))
+	{
+		Current = Buffer + static_cast<risse_size>(pos - BufferPosition);
+		return true;
+	}
+
+	// 失敗した場合に下位のストリームの位置は変わらないので、
+	// バッファもそのまま保つ
+	if(!Stream.Seek(pos, soSet)) return false;
+	BufferPosition = pos;
+	Current = Limit = Buffer;
+	return true;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tBufferedStreamReader::SetPosition(risse_uint64 pos)
+{
+	if(pos >= BufferPosition && pos <= BufferPosition + (Limit - Buffer))
+	{
+		Current = Buffer + static_cast<risse_size>(pos - BufferPosition);
+		return;
+	}
+
+	Stream.SetPosition(pos);
+	BufferPosition = pos;
+	Current = Limit = Buffer;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tBufferedStreamReader::Fill()
+{
+	BufferPosition += Limit - Buffer;
+	Current = Limit = Buffer;
+	risse_size read = Stream.Read(Buffer, BUFFER_SIZE);
+	Limit = Buffer + read;
+	return read != 0;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+risse_size tBufferedStreamReader::ReadSlow(void *buffer, risse_size read_size)
+{
+	risse_uint8 * dest = static_cast<risse_uint8 *>(buffer);
+
+	// まずバッファに残っている分をコピーする
+	risse_size done = Limit - Current;
+	memcpy(dest, Current, done);
+	Current = Limit;
+
+	risse_size remain = read_size - done;
+	if(remain >= BUFFER_SIZE)
+	{
+		// 大きな読み込みはバッファを介さずに直接読み込む
+		BufferPosition += Limit - Buffer;
+		Current = Limit = Buffer;
+		risse_size read = Stream.Read(dest + done, remain);
+		BufferPosition += read;
+		return done + read;
+	}
+
+	// バッファに読み込んでからコピーする
+	while(remain > 0 && Fill())
+	{
+		risse_size one = Limit - Current;
+		if(one > remain) one = remain;
+		memcpy(dest + done, Current, one);
+		Current += one;
+		done += one;
+		remain -= one;
+	}
+	return done;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tBufferedStreamReader::ReadBufferSlow(void *buffer, risse_size read_size)
+{
+	if(ReadSlow(buffer, read_size) != read_size)
+		tIOExceptionClass::ThrowReadError(GetName());
+}
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+
+
+
+
 //---------------------------------------------------------------------------
 } // namespace Risse
 
@@ -19,6 +19,7 @@
 #include "risseString.h"
 #include "risseVariant.h"
 #include "risseModule.h"
+#include <string.h>
 
 namespace Risse
 {
@@ -261,5 +262,238 @@ public: // ユーティリティ
 };
 //---------------------------------------------------------------------------
 
+
+//---------------------------------------------------------------------------
+/**
+ * tStreamAdapter に読み込みバッファを付加したリーダ
+ * @note	tStreamAdapter の各読み込みメソッドは一回ごとに Stream クラスの
+ *			メソッドの呼び出しを伴うため、ヘッダの解析のように小さな読み込みを
+ *			何度も行うと遅い。このクラスはストリームから BUFFER_SIZE ずつ
+ *			まとめて読み込んでおき、小さな読み込みはそのバッファから返す。
+ *			BUFFER_SIZE 以上の読み込みはバッファを介さずに直接ストリームから読む。
+ * @note	このリーダを使っている間は、下位のストリームの現在位置は
+ *			このリーダの現在位置よりも先に進んでいる場合がある。
+ *			下位のストリームを直接使う前には Sync() を呼ぶこと。
+ */
+class tBufferedStreamReader : public tCollectee, public tStreamConstants
+{
+public:
+	static const risse_size BUFFER_SIZE = 4096; //!< 読み込みバッファのサイズ
+
+private:
+	tStreamAdapter Stream; //!< 下位のストリーム
+	risse_uint64 BufferPosition; //!< バッファの先頭のストリーム中での位置
+	const risse_uint8 * Current; //!< バッファ中の現在位置
+	const risse_uint8 * Limit; //!< バッファ中の有効なデータの終端
+	risse_uint8 Buffer[BUFFER_SIZE]; //!< 読み込みバッファ
+
+	tBufferedStreamReader(const tBufferedStreamReader &); //!< non-copyable
+	void operator = (const tBufferedStreamReader &); //!< non-copyable
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param stream	下位のストリーム (このストリームの現在位置から読み込む)
+	 */
+	tBufferedStreamReader(const tStreamAdapter & stream);
+
+	/**
+	 * 下位のストリームを得る
+	 * @return	下位のストリーム
+	 * @note	下位のストリームを直接使う前には Sync() を呼ぶこと
+	 */
+	tStreamAdapter & GetStream() { return Stream; }
+
+	/**
+	 * ストリームの名前を取得する
+	 * @return	ストリームの名前を取得する
+	 */
+	tString GetName() { return Stream.GetName(); }
+
+	/**
+	 * 下位のストリームの現在位置をこのリーダの現在位置に合わせる
+	 * @note	バッファの内容は破棄される
+	 */
+	void Sync();
+
+	/**
+	 * 指定位置にシークする
+	 * @param offset	基準位置からのオフセット (正の数 = ファイルの後ろの方)
+	 * @param whence	基準位置
+	 * @return	このメソッドは成功すれば真、失敗すれば偽を返す
+	 * @note	シーク先がバッファ内であれば下位のストリームはシークしない
+	 */
+	bool Seek(risse_int64 offset, tOrigin whence);
+
+	/**
+	 * 現在位置を取得する
+	 * @return	現在位置(先頭からのオフセット)
+	 */
+	risse_uint64 Tell() const { return BufferPosition + (Current - Buffer); }
+
+	/**
+	 * ストリームのサイズを得る
+	 * @return	ストリームのサイズ
+	 */
+	risse_uint64 GetSize() { return Stream.GetSize(); }
+
+	/**
+	 * 現在位置を得る
+	 * @return	現在位置
+	 */
+	risse_uint64 GetPosition() const { return Tell(); }
+
+	/**
+	 * 現在位置を設定する
+	 * @param pos	現在位置
+	 * @note	シークに失敗した場合は例外が発生する
+	 */
+	void SetPosition(risse_uint64 pos);
+
+	/**
+	 * ストリームから読み込む
+	 * @param buffer	読み込んだデータを書き込む先のポインタ
+	 * @param read_size	読み込むサイズ
+	 * @return	実際に読み込まれたサイズ
+	 */
+	risse_size Read(void *buffer, risse_size read_size)
+	{
+		if(static_cast<risse_size>(Limit - Current) >= read_size)
+		{
+			memcpy(buffer, Current, read_size);
+			Current += read_size;
+			return read_size;
+		}
+		return ReadSlow(buffer, read_size);
+	}
+
+	/**
+	 * ストリームから読み込む
+	 * @param buffer	読み込んだデータを書き込む先のポインタ
+	 * @param read_size	読み込むサイズ
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	void ReadBuffer(void *buffer, risse_size read_size)
+	{
+		if(static_cast<risse_size>(Limit - Current) >= read_size)
+		{
+			memcpy(buffer, Current, read_size);
+			Current += read_size;
+			return;
+		}
+		ReadBufferSlow(buffer, read_size);
+	}
+
+	/**
+	 * ストリームから64bit little endian 整数を読み込んで返す
+	 * @return	読み込んだ値
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	risse_uint64 ReadI64LE()
+	{
+		risse_uint8 tmp[8];
+		const risse_uint8 * p = Take(tmp, 8);
+		return
+			 static_cast<risse_uint64>(p[0])        +
+			(static_cast<risse_uint64>(p[1]) <<  8) +
+			(static_cast<risse_uint64>(p[2]) << 16) +
+			(static_cast<risse_uint64>(p[3]) << 24) +
+			(static_cast<risse_uint64>(p[4]) << 32) +
+			(static_cast<risse_uint64>(p[5]) << 40) +
+			(static_cast<risse_uint64>(p[6]) << 48) +
+			(static_cast<risse_uint64>(p[7]) << 56);
+	}
+
+	/**
+	 * ストリームから32bit little endian 整数を読み込んで返す
+	 * @return	読み込んだ値
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	risse_uint32 ReadI32LE()
+	{
+		risse_uint8 tmp[4];
+		const risse_uint8 * p = Take(tmp, 4);
+		return
+			 static_cast<risse_uint32>(p[0])        +
+			(static_cast<risse_uint32>(p[1]) <<  8) +
+			(static_cast<risse_uint32>(p[2]) << 16) +
+			(static_cast<risse_uint32>(p[3]) << 24);
+	}
+
+	/**
+	 * ストリームから16bit little endian 整数を読み込んで返す
+	 * @return	読み込んだ値
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	risse_uint16 ReadI16LE()
+	{
+		risse_uint8 tmp[2];
+		const risse_uint8 * p = Take(tmp, 2);
+		return static_cast<risse_uint16>(p[0] + (p[1] << 8));
+	}
+
+	/**
+	 * ストリームから8bit 整数を読み込んで返す
+	 * @return	読み込んだ値
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	risse_uint8 ReadI8LE()
+	{
+		if(Current < Limit) return *(Current++);
+		risse_uint8 tmp;
+		ReadBufferSlow(&tmp, 1);
+		return tmp;
+	}
+	/**
+	 * ストリームから8bit 整数を読み込んで返す
+	 * @return	読み込んだ値
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	risse_uint8 ReadI8() { return ReadI8LE(); }
+
+private:
+	/**
+	 * 指定サイズのデータを読み込み、そのデータへのポインタを返す
+	 * @param tmp	バッファにデータが足りない場合に使う一時領域 (size バイト以上)
+	 * @param size	読み込むサイズ
+	 * @return	読み込んだデータへのポインタ (バッファ内か tmp)
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	const risse_uint8 * Take(risse_uint8 * tmp, risse_size size)
+	{
+		if(static_cast<risse_size>(Limit - Current) >= size)
+		{
+			const risse_uint8 * p = Current;
+			Current += size;
+			return p;
+		}
+		ReadBufferSlow(tmp, size);
+		return tmp;
+	}
+
+	/**
+	 * バッファを破棄し、下位のストリームから読み込み直す
+	 * @return	一バイトでも読み込めれば真
+	 */
+	bool Fill();
+
+	/**
+	 * バッファのデータでは足りない場合の Read()
+	 * @param buffer	読み込んだデータを書き込む先のポインタ
+	 * @param read_size	読み込むサイズ
+	 * @return	実際に読み込まれたサイズ
+	 */
+	risse_size ReadSlow(void *buffer, risse_size read_size);
+
+	/**
+	 * バッファのデータでは足りない場合の ReadBuffer()
+	 * @param buffer	読み込んだデータを書き込む先のポインタ
+	 * @param read_size	読み込むサイズ
+	 * @note	読み込みに失敗した場合は例外が発生する
+	 */
+	void ReadBufferSlow(void *buffer, risse_size read_size);
+};
+//---------------------------------------------------------------------------
+
 } // namespace Risse
 #endif
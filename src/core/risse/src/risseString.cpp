@@ -26,6 +26,25 @@ risse_char tStringData::EmptyBuffer[3] = { tStringData::MightBeShared, 0, 0 };
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+#define RISSE_SB(c) \
+	{ 1, tStringData::MightBeShared, static_cast<risse_char>(c), 0, 0 }
+#define RISSE_SB4(c) \
+	RISSE_SB((c)+0), RISSE_SB((c)+1), RISSE_SB((c)+2), RISSE_SB((c)+3)
+#define RISSE_SB16(c) \
+	RISSE_SB4((c)+0), RISSE_SB4((c)+4), RISSE_SB4((c)+8), RISSE_SB4((c)+12)
+tStringData::tSmallBuffer tStringData::SmallBuffers[tStringData::SmallBufferCount] = {
+	RISSE_SB16(0x00), RISSE_SB16(0x10), RISSE_SB16(0x20), RISSE_SB16(0x30),
+	RISSE_SB16(0x40), RISSE_SB16(0x50), RISSE_SB16(0x60), RISSE_SB16(0x70),
+	RISSE_SB16(0x80), RISSE_SB16(0x90), RISSE_SB16(0xa0), RISSE_SB16(0xb0),
+	RISSE_SB16(0xc0), RISSE_SB16(0xd0), RISSE_SB16(0xe0), RISSE_SB16(0xf0),
+};
+#undef RISSE_SB16
+#undef RISSE_SB4
+#undef RISSE_SB
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 tString::tString(const tString & ref,
 	risse_size offset, risse_size length)
@@ -60,6 +79,10 @@ tString::tString(const risse_char * ref, risse_size n)
 	{
 		Buffer = RISSE_STRING_EMPTY_BUFFER;
 	}
+	else if(n == 1 && (Buffer = GetSmallBuffer(ref[0])) != NULL)
+	{
+		; // 共有バッファを用いる
+	}
 	else
 	{
 		Buffer = AllocateInternalBuffer(Length);
@@ -121,6 +144,10 @@ tString & tString::operator = (const risse_char * ref)
 	{
 		Buffer = RISSE_STRING_EMPTY_BUFFER;
 	}
+	else if(Length == 1 && (Buffer = GetSmallBuffer(ref[0])) != NULL)
+	{
+		; // 共有バッファを用いる
+	}
 	else
 	{
 		Buffer = AllocateInternalBuffer(Length);
@@ -145,9 +172,12 @@ tString & tString::operator = (const risse_char ref)
 	else
 	{
 		Length = 1;
-		Buffer = AllocateInternalBuffer(1);
-		Buffer[0] = ref;
-		Buffer[1] = Buffer[1+1] = 0; // null終端と hint をクリア
+		if((Buffer = GetSmallBuffer(ref)) == NULL)
+		{
+			Buffer = AllocateInternalBuffer(1);
+			Buffer[0] = ref;
+			Buffer[1] = Buffer[1+1] = 0; // null終端と hint をクリア
+		}
 	}
 	return *this;
 }
@@ -176,6 +206,21 @@ tString & tString::operator = (const char * ref)
 {
 	Length = ConvertUtf8ToRisseCharString(NULL, ref); // コードポイント数を得る
 	if(Length == risse_size_max) tCharConversionExceptionClass::ThrowInvalidUTF8String();
+	if(Length == 0)
+	{
+		Buffer = RISSE_STRING_EMPTY_BUFFER;
+		return *this;
+	}
+	if(Length == 1)
+	{
+		risse_char ch;
+		ConvertUtf8ToRisseCharString(&ch, ref);
+		if((Buffer = GetSmallBuffer(ch)) != NULL) return *this; // 共有バッファを用いる
+		Buffer = AllocateInternalBuffer(1);
+		Buffer[0] = ch;
+		Buffer[1] = Buffer[1 + 1] = 0; // null終端と hint をクリア
+		return *this;
+	}
 	Buffer = AllocateInternalBuffer(Length);
 	ConvertUtf8ToRisseCharString(Buffer, ref);
 	Buffer[Length] = Buffer[Length + 1] = 0; // null終端と hint をクリア
@@ -193,13 +238,13 @@ risse_char * tString::AllocateInternalBuffer(
 	void *ptr;
 	if(!prevbuf)
 	{
-		ptr = MallocAtomicCollectee(newbytes);
+		ptr = MallocAtomicCollectee(newbytes, hakString);
 	}
 	else
 	{
 		char * buffer_head = reinterpret_cast<char *>(prevbuf) -
 			 ( sizeof(risse_char) + sizeof(risse_size) );
-		ptr = ReallocCollectee(buffer_head, newbytes);
+		ptr = ReallocCollectee(buffer_head, newbytes, hakString);
 	}
 
 	// ２番目の文字を指すポインタを獲る
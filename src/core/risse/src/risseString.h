@@ -157,6 +157,31 @@ risse_char は 32bit サイズであることが求められる。
 	文字列が部分共有されている場合など、このヒント領域が存在しない場合は
 	このメソッドは NULL を返す。その場合はヒントは利用できない。
 
+■ 1文字の文字列
+
+	識別子の一部や文字列の一文字ずつの走査などで、1コードポイントだけから
+	なる文字列は非常に頻繁に作成される。これらのたびにバッファを確保するのは
+	無駄なので、U+0001 ～ U+00FF の 1 文字からなる文字列は、あらかじめ
+	static に用意された共有バッファ (tStringData::SmallBuffers) を指すように
+	なっている。
+
+	1 \-1 文字 \0 hint
+	       ↑
+	     Buffer
+
+	このバッファのレイアウトは AllocateInternalBuffer で確保されるバッファと
+	同一であり、共有可能性フラグは最初から立っている。そのため、このバッファ
+	を指している文字列に対して破壊的な操作を行おうとすると、通常の共有バッファ
+	と同様に Independ によりコピーが行われる。空文字列を表す EmptyBuffer と
+	同じ考え方である。
+
+	このバッファは static 領域にあるため、4 の倍数のアドレスに配置され、かつ
+	低い番地には配置されない。よって tVariant の vtString としての表現 (ポイ
+	ンタの下位2ビットによるタグ付け) にもそのまま用いることができる。
+
+	tVariant のサイズを 2 ワードに抑える必要があるため、tString そのものの中
+	に文字を埋め込む形の表現はとっていない。
+
 */
 
 #include "risseCharUtils.h"
@@ -187,6 +212,28 @@ public:
 	static risse_char EmptyBuffer[3];
 
 	#define RISSE_STRING_EMPTY_BUFFER (tStringData::EmptyBuffer+1)
+
+	/**
+	 * 1コードポイントからなる文字列用の共有バッファ
+	 * @note	レイアウトは tString::AllocateInternalBuffer で確保される
+	 *			バッファと同一でなければならない
+	 */
+	struct tSmallBuffer
+	{
+		risse_size	Capacity;	//!< 容量 (常に 1)
+		risse_char	Shared;		//!< 共有可能性フラグ (常に MightBeShared)
+		risse_char	Char;		//!< 文字 (Buffer はここを指す)
+		risse_char	Terminator;	//!< null 終端
+		risse_char	Hint;		//!< ヒント
+	};
+
+	static const risse_size SmallBufferCount = 0x100; //!< SmallBuffers の要素数
+
+	/**
+	 * U+0000 ～ U+00FF の 1 文字の文字列を表すバッファの配列
+	 * (U+0000 の要素は使用されない)
+	 */
+	static tSmallBuffer SmallBuffers[SmallBufferCount];
 };
 //---------------------------------------------------------------------------
 
@@ -405,6 +452,21 @@ private: // buffer management
 	 */
 	static risse_char * AllocateInternalBuffer(risse_size n, risse_char *prevbuf = NULL);
 
+	/**
+	 * 1コードポイントからなる文字列用の共有バッファを得る
+	 * @param ch	文字
+	 * @return	共有バッファ (Buffer に設定可能な物) あるいは
+	 *			共有バッファが用意されていない文字の場合は NULL
+	 * @note	返されたバッファには共有可能性フラグが立っているので、
+	 *			内容を書き換えてはならない。
+	 */
+	static risse_char * GetSmallBuffer(risse_char ch)
+	{
+		if(ch > 0 && static_cast<risse_size>(ch) < SmallBufferCount)
+			return &SmallBuffers[ch].Char;
+		return NULL;
+	}
+
 
 	/**
 	 * バッファに割り当てられているコードポイント数(容量)を得る
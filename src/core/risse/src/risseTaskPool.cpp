@@ -0,0 +1,304 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief ワークスティーリングを行うタスクプール
+//---------------------------------------------------------------------------
+#ifdef RISSE_SUPPORT_THREADS
+
+#include "prec.h"
+#include "risseTaskPool.h"
+
+#ifdef _MSC_VER
+	#define RISSE_TASK_POOL_TLS __declspec(thread)
+#else
+	#define RISSE_TASK_POOL_TLS __thread
+#endif
+
+namespace Risse
+{
+RISSE_DEFINE_SOURCE_ID(51236,8817,40922,17596,4133,61873,27410,9355);
+
+
+//---------------------------------------------------------------------------
+static tTaskPool * volatile TaskPoolInstance = NULL; //!< tTaskPool のインスタンス
+static RISSE_TASK_POOL_TLS tTaskWorker * CurrentWorker = NULL; //!< このスレッドのワーカー (ワーカースレッドでない場合は NULL)
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * タスクプールのワーカースレッド
+ */
+class tTaskWorker : public tThread
+{
+	tTaskPool * Pool; //!< プール
+	risse_size Index; //!< プール内でのインデックス
+	tTaskQueue Queue; //!< このワーカースレッドのタスクキュー
+
+public:
+	/**
+	 * コンストラクタ
+	 * @param pool	プール
+	 * @param index	プール内でのインデックス
+	 */
+	tTaskWorker(tTaskPool * pool, risse_size index)
+	{
+		Pool = pool;
+		Index = index;
+	}
+
+	tTaskPool * GetPool() const { return Pool; } //!< プールを得る
+	risse_size GetIndex() const { return Index; } //!< プール内でのインデックスを得る
+	tTaskQueue & GetQueue() { return Queue; } //!< このワーカースレッドのタスクキューを得る
+
+protected:
+	/**
+	 * スレッドの実行ルーチン
+	 */
+	void Execute()
+	{
+		CurrentWorker = this;
+		while(!ShouldTerminate())
+		{
+			tTask * task = Pool->Take(this);
+			if(task)
+				Pool->Run(task);
+			else
+				Pool->Sleep(NULL);
+		}
+		CurrentWorker = NULL;
+	}
+};
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+void tTaskQueue::Push(tTask * task)
+{
+	volatile tCriticalSection::tLocker lock(CS);
+	Tasks.push_back(task);
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tTask * tTaskQueue::Pop()
+{
+	volatile tCriticalSection::tLocker lock(CS);
+	if(Tasks.empty()) return NULL;
+	tTask * task = Tasks.back();
+	Tasks.pop_back();
+	return task;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tTask * tTaskQueue::Steal()
+{
+	volatile tCriticalSection::tLocker lock(CS);
+	if(Tasks.empty()) return NULL;
+	tTask * task = Tasks.front();
+	Tasks.pop_front();
+	return task;
+}
+//---------------------------------------------------------------------------
+
+
+
+
+
+
+
+
+//---------------------------------------------------------------------------
+tTaskPool::tTaskPool() : Condition(Mutex)
+{
+	int cpus = wxThread::GetCPUCount();
+	WorkerCount = cpus > 0 ? (risse_size)cpus : 1;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tTaskPool & tTaskPool::GetInstance()
+{
+	tTaskPool * pool = TaskPoolInstance;
+	if(pool) return *pool;
+
+	// 複数のスレッドから同時に最初の呼び出しが行われた場合に備え、
+	// 作成したインスタンスはアトミックに設定する。競合に負けた方の
+	// インスタンスはまだワーカースレッドを作成していないので、
+	// そのまま捨ててよい (GC により回収される)
+	pool = new tTaskPool();
+	tTaskPool * prev = static_cast<tTaskPool *>(AtomicCompareExchangePointer(
+		reinterpret_cast<void * volatile *>(&TaskPoolInstance), NULL, pool));
+	return prev ? *prev : *pool;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tTaskPool::Submit(tTask * task)
+{
+	RISSE_ASSERT(!task->Submitted);
+	task->Submitted = true;
+
+	EnsureWorkers();
+
+	// ワーカースレッド上からの場合はそのワーカースレッドのキューに、
+	// そうでなければ共有のキューに積む
+	tTaskWorker * self = CurrentWorker;
+	if(self && self->GetPool() == this)
+		self->GetQueue().Push(task);
+	else
+		Injected.Push(task);
+	++Pending;
+
+	// 待っているスレッドがあれば起こす
+	// Sleep() は Sleepers を増やしてから Pending を確認するので、ここで
+	// Sleepers が 0 ならば、待とうとしているスレッドは必ず Pending の
+	// 増加に気づく
+	if((long)Sleepers > 0)
+	{
+		wxMutexLocker lock(Mutex);
+		Condition.Broadcast();
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tTaskPool::Wait(tTask * task)
+{
+	RISSE_ASSERT(task->Submitted);
+
+	tTaskWorker * self = CurrentWorker;
+	if(!self || self->GetPool() != this)
+	{
+		// このプールのワーカースレッド以外では、他のタスクは実行せずに
+		// 完了を待つだけにする。呼び出し元がスクリプトオブジェクトの
+		// ロックなどを持っている場合に、無関係なタスクがそれらのロックを
+		// 持ったまま実行されてしまうのを防ぐため
+		wxMutexLocker lock(Mutex);
+		++Sleepers;
+		while(!task->Done) Condition.Wait();
+		--Sleepers;
+		return;
+	}
+
+	while(!task->Done)
+	{
+		// 待っている間は他のタスクを実行する
+		tTask * other = Take(self);
+		if(other)
+			Run(other);
+		else
+			Sleep(task);
+	}
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+bool tTaskPool::IsWorkerThread()
+{
+	return CurrentWorker != NULL;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tTaskPool::EnsureWorkers()
+{
+	volatile tCriticalSection::tLocker lock(CS);
+
+	if(Workers.size() != 0) return; // already started
+
+	Workers.reserve(WorkerCount);
+	for(risse_size i = 0; i < WorkerCount; i++)
+		Workers.push_back(new tTaskWorker(this, i));
+	for(risse_size i = 0; i < WorkerCount; i++)
+		Workers[i]->Run();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+tTask * tTaskPool::Take(tTaskWorker * self)
+{
+	if((long)Pending <= 0) return NULL; // 何も積まれていない
+
+	tTask * task = NULL;
+
+	// 自分のキューの末尾から
+	if(self) task = self->GetQueue().Pop();
+
+	// 共有のキューの先頭から
+	if(!task) task = Injected.Steal();
+
+	// 他のワーカースレッドのキューの先頭から
+	// (ワーカースレッドごとに異なる位置から探し始める)
+	if(!task)
+	{
+		risse_size count = Workers.size();
+		risse_size start = self ? self->GetIndex() + 1 : 0;
+		for(risse_size i = 0; i < count && !task; i++)
+		{
+			tTaskWorker * victim = Workers[(start + i) % count];
+			if(victim != self) task = victim->GetQueue().Steal();
+		}
+	}
+
+	if(task) --Pending;
+	return task;
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tTaskPool::Run(tTask * task)
+{
+	try
+	{
+		task->Execute();
+	}
+	catch(...)
+	{
+		// 例外は握りつぶす (tTask::Execute() のコメントを参照)
+	}
+
+	// 完了を通知する
+	wxMutexLocker lock(Mutex);
+	task->Done = true;
+	if((long)Sleepers > 0) Condition.Broadcast();
+}
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+void tTaskPool::Sleep(tTask * task)
+{
+	wxMutexLocker lock(Mutex);
+	++Sleepers;
+	if((long)Pending <= 0 && !(task && task->Done))
+		Condition.Wait();
+	--Sleepers;
+}
+//---------------------------------------------------------------------------
+} // namespace Risse
+
+#endif // #ifdef RISSE_SUPPORT_THREADS
@@ -0,0 +1,212 @@
+//---------------------------------------------------------------------------
+/*
+	Risse [りせ]
+	 stands for "Risse Is a Sweet Script Engine"
+	Copyright (C) 2000 W.Dee <dee@kikyou.info> and contributors
+
+	See details of license at "license.txt"
+*/
+//---------------------------------------------------------------------------
+//! @file
+//! @brief ワークスティーリングを行うタスクプール
+//---------------------------------------------------------------------------
+#ifndef risseTaskPoolH
+#define risseTaskPoolH
+
+/*! @note
+	tTaskPool は CPU の数だけのワーカースレッドを持ち、短い処理 (タスク) を
+	それらのスレッドで実行する。スクリプトの Thread クラスのようにタスクごとに
+	スレッドを作成するわけではないので、小さなタスクを大量に実行することが
+	できる。画像のデコードやコンパイルなどのネイティブのサブシステムも、
+	tTask の派生クラスを作成して Submit() すれば同じプールでタスクを実行できる。
+
+	各ワーカースレッドは自分専用のタスクキューを持つ。ワーカースレッド上で
+	Submit() されたタスクはそのワーカースレッドのキューの末尾に積まれ、
+	ワーカースレッドは自分のキューの末尾からタスクを取り出して実行する。
+	自分のキューが空になったワーカースレッドは、ワーカースレッド以外から
+	Submit() されたタスクを溜めておく共有のキューか、他のワーカースレッドの
+	キューの先頭からタスクを盗んで (steal して) 実行する。
+
+	キューはクリティカルセクションで保護された両端キューであり、ロックフリー
+	ではない。一回のロックで行うのはタスクの出し入れだけなので、タスクの実行
+	時間に比べて十分に短いと考えられる。
+
+	Wait() でタスクの完了を待つスレッドは、ただ待つのではなく、待っている間に
+	キューにある他のタスクを実行する。このため、タスクの中でさらにタスクを
+	Submit() してその完了を待っても、ワーカースレッドが足りなくなって
+	デッドロックすることはない。
+
+	ワーカースレッドは最初にタスクが Submit() されたときに作成され、プロセスの
+	終了まで存在し続ける。
+*/
+
+#ifdef RISSE_SUPPORT_THREADS
+
+#include "risseTypes.h"
+#include "risseGC.h"
+#include "risseThread.h"
+
+namespace Risse
+{
+class tTaskPool;
+class tTaskWorker;
+//---------------------------------------------------------------------------
+/**
+ * タスクの基本クラス
+ */
+class tTask : public tCollectee
+{
+	friend class tTaskPool;
+
+	volatile bool Submitted; //!< Submit() されたかどうか
+	volatile bool Done; //!< 実行が完了したかどうか
+
+public:
+	/**
+	 * コンストラクタ
+	 */
+	tTask() : Submitted(false), Done(false) {;}
+
+	/**
+	 * 実行が完了したかどうかを得る
+	 * @return	実行が完了したかどうか
+	 */
+	bool GetDone() const { return Done; }
+
+protected:
+	/**
+	 * タスクの処理(サブクラスで実装する)
+	 * @note	いずれかのワーカースレッド上で呼ばれる (Wait() を呼び出して
+	 *			待っているワーカースレッドを含む)。
+	 *			例外はこのメソッド内で処理すること。このメソッドの外に
+	 *			投げられた例外は握りつぶされる。
+	 */
+	virtual void Execute() = 0;
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * タスクキュー
+ */
+class tTaskQueue
+{
+	tCriticalSection CS; //!< このオブジェクトを保護するクリティカルセクション
+	gc_deque<tTask *> Tasks; //!< タスクの両端キュー
+
+public:
+	/**
+	 * 末尾にタスクを積む
+	 * @param task	タスク
+	 */
+	void Push(tTask * task);
+
+	/**
+	 * 末尾からタスクを取り出す
+	 * @return	タスク (キューが空の場合は NULL)
+	 */
+	tTask * Pop();
+
+	/**
+	 * 先頭からタスクを取り出す
+	 * @return	タスク (キューが空の場合は NULL)
+	 */
+	tTask * Steal();
+};
+//---------------------------------------------------------------------------
+
+
+//---------------------------------------------------------------------------
+/**
+ * タスクプール
+ */
+class tTaskPool : public tDestructee
+{
+	friend class tTaskWorker;
+
+	tCriticalSection CS; //!< Workers を保護するクリティカルセクション
+	gc_vector<tTaskWorker *> Workers; //!< ワーカースレッドの配列
+	risse_size WorkerCount; //!< ワーカースレッドの数
+	tTaskQueue Injected; //!< ワーカースレッド以外から Submit() されたタスクのキュー
+	tAtomicCounter Pending; //!< キューに積まれているタスクの数
+	tAtomicCounter Sleepers; //!< Condition を待っているスレッドの数
+	wxMutex Mutex; //!< Condition 用のミューテックス
+	wxCondition Condition; //!< タスクが積まれたか、タスクが完了したことを通知するための条件変数
+
+	/**
+	 * コンストラクタ
+	 */
+	tTaskPool();
+
+public:
+	/**
+	 * デストラクタ(おそらく呼ばれない)
+	 */
+	~tTaskPool() {;}
+
+	/**
+	 * インスタンスを得る
+	 * @return	インスタンス
+	 * @note	どのスレッドから呼んでもよい
+	 */
+	static tTaskPool & GetInstance();
+
+	/**
+	 * ワーカースレッドの数を得る
+	 * @return	ワーカースレッドの数
+	 */
+	risse_size GetWorkerCount() const { return WorkerCount; }
+
+	/**
+	 * タスクを実行キューに積む
+	 * @param task	タスク (同じタスクを複数回 Submit() することはできない)
+	 */
+	void Submit(tTask * task);
+
+	/**
+	 * タスクの完了を待つ
+	 * @param task	Submit() 済みのタスク
+	 * @note	このプールのワーカースレッドから呼ばれた場合は、待っている間は
+	 *			キューにある他のタスクを実行する。それ以外のスレッドからの場合は
+	 *			単に完了を待つ
+	 */
+	void Wait(tTask * task);
+
+	/**
+	 * 現在のスレッドがこのプールのワーカースレッドかどうかを得る
+	 * @return	ワーカースレッドかどうか
+	 */
+	static bool IsWorkerThread();
+
+private:
+	/**
+	 * ワーカースレッドが作成されていなければ作成する
+	 */
+	void EnsureWorkers();
+
+	/**
+	 * 実行するタスクを取り出す
+	 * @param self	現在のスレッドのワーカー (ワーカースレッドでない場合は NULL)
+	 * @return	タスク (実行できるタスクが無い場合は NULL)
+	 */
+	tTask * Take(tTaskWorker * self);
+
+	/**
+	 * タスクを実行し、完了を通知する
+	 * @param task	タスク
+	 */
+	void Run(tTask * task);
+
+	/**
+	 * タスクが積まれるか、タスクが完了するまで待つ
+	 * @param task	完了を待っているタスク (無い場合は NULL)
+	 */
+	void Sleep(tTask * task);
+};
+//---------------------------------------------------------------------------
+} // namespace Risse
+
+#endif // #ifdef RISSE_SUPPORT_THREADS
+
+#endif
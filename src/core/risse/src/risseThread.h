@@ -401,6 +401,32 @@ Risse は wxWidgets と boost という２つのライブラリのスレッド
 			void reset() { static_cast<long volatile &>(v) = 0; }
 		};
 
+		/**
+		 * ポインタのアトミックな比較と交換を行う
+		 * @param dest		対象となるポインタ変数
+		 * @param comparand	*dest がこの値と等しい場合のみ交換を行う
+		 * @param exchange	交換する値
+		 * @return	交換前の *dest の値 (comparand と等しければ交換が行われた)
+		 */
+		inline void * AtomicCompareExchangePointer(void * volatile * dest,
+			void * comparand, void * exchange)
+		{
+			return ::InterlockedCompareExchangePointer(
+				const_cast<void **>(dest), exchange, comparand);
+		}
+
+		/**
+		 * ポインタのアトミックな交換を行う
+		 * @param dest		対象となるポインタ変数
+		 * @param exchange	交換する値
+		 * @return	交換前の *dest の値
+		 */
+		inline void * AtomicExchangePointer(void * volatile * dest, void * exchange)
+		{
+			return ::InterlockedExchangePointer(
+				const_cast<void **>(dest), exchange);
+		}
+
 	#elif defined(__GLIBCPP__) || defined(__GLIBCXX__)
 		// GCC (GLIBCPP) 版
 
@@ -452,6 +478,33 @@ Risse は wxWidgets と boost という２つのライブラリのスレッド
 			void reset() { static_cast<_Atomic_word volatile &>(v) = 0; }
 		};
 
+		/**
+		 * ポインタのアトミックな比較と交換を行う
+		 * @param dest		対象となるポインタ変数
+		 * @param comparand	*dest がこの値と等しい場合のみ交換を行う
+		 * @param exchange	交換する値
+		 * @return	交換前の *dest の値 (comparand と等しければ交換が行われた)
+		 */
+		inline void * AtomicCompareExchangePointer(void * volatile * dest,
+			void * comparand, void * exchange)
+		{
+			return __sync_val_compare_and_swap(dest, comparand, exchange);
+		}
+
+		/**
+		 * ポインタのアトミックな交換を行う
+		 * @param dest		対象となるポインタ変数
+		 * @param exchange	交換する値
+		 * @return	交換前の *dest の値
+		 */
+		inline void * AtomicExchangePointer(void * volatile * dest, void * exchange)
+		{
+			// __sync_lock_test_and_set は acquire バリアしか保証しないので
+			// その前に完全なバリアを置く
+			__sync_synchronize();
+			return __sync_lock_test_and_set(dest, exchange);
+		}
+
 	#else
 		#error "non-supported platform; write your own atomic-counter implementation here"
 		/*
@@ -520,6 +573,15 @@ namespace Risse
 // スレッドをサポートしない場合は何もしない tAtomicCounter を定義する
 	typedef long tAtomicCounter;
 
+	// スレッドをサポートしない場合は単純な比較と交換を行う
+	inline void * AtomicCompareExchangePointer(void * volatile * dest,
+		void * comparand, void * exchange)
+	{
+		void * prev = *dest;
+		if(prev == comparand) *dest = exchange;
+		return prev;
+	}
+
 
 //---------------------------------------------------------------------------
 
@@ -3492,7 +3492,7 @@ public: // スレッド同期
 		void operator = (const tSynchronizer &); //!< コピー不可です
 		void * operator new(size_t); //!< ヒープ上に置かないでください
 		void * operator new [] (size_t); //!< ヒープ上に置かないでください
-		char Synchronizer[sizeof(void*)+sizeof(tCriticalSection::tLocker)]; //!< tObjectInterface::tSynchronizer を作成する先
+		char Synchronizer[sizeof(void*)*2+sizeof(tCriticalSection::tLocker)]; //!< tObjectInterface::tSynchronizer を作成する先
 	public:
 		/**
 		 * コンストラクタ
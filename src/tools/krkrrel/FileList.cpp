@@ -28,12 +28,17 @@ namespace Risa {
 // e:正規表現パターン
 // i:正規表現パターン
 // c:正規表現パターン
+// l:正規表現パターン
+// z:正規表現パターン
 // a:正規表現パターン
 // e: が先頭につく行は exclude (除外) 用パターン
 // i: が先頭につく行は include (含める) 用パターン
-// c: が先頭につく行は compress (圧縮) 用パターン
+// c: が先頭につく行は compress (ZLIB で圧縮) 用パターン
+// l: が先頭につく行は lz4 (LZ4 で圧縮; 展開が非常に速い) 用パターン
+// z: が先頭につく行は zstd (Zstandard で圧縮; 圧縮率が高く、展開も速い) 用パターン
 // a: が先頭につく行は asis  (圧縮しない) 用パターン
-// e i c a の代わりに E I C A を使用すると、大文字・小文字を区別しなくなる
+// e i c l z a の代わりに E I C L Z A を使用すると、大文字・小文字を区別しなくなる
+// 圧縮方法は最後に合致したパターンのものになる
 
 // パターンは先頭から順番に処理される
 // パターンをクリアしたい場合は、相反する側のパターンに . を指定する
@@ -227,7 +232,7 @@ void XP4ClassifyFiles(iRisaProgressCallback * callback,
 	struct tPattern
 	{
 		enum tType {
-			include, exclude, compress, asis
+			include, exclude, compress, lz4, zstd, asis
 		} type;
 
 		wxRegEx regex;
@@ -261,6 +266,14 @@ void XP4ClassifyFiles(iRisaProgressCallback * callback,
 				patterns[pattern_count].type = tPattern::compress;
 			else if(pat.StartsWith(wxT("C:"))) // compress, case ignore
 				patterns[pattern_count].type = tPattern::compress,   flags |= wxRE_ICASE;
+			else if(pat.StartsWith(wxT("l:"))) // lz4, case sens
+				patterns[pattern_count].type = tPattern::lz4;
+			else if(pat.StartsWith(wxT("L:"))) // lz4, case ignore
+				patterns[pattern_count].type = tPattern::lz4,        flags |= wxRE_ICASE;
+			else if(pat.StartsWith(wxT("z:"))) // zstd, case sens
+				patterns[pattern_count].type = tPattern::zstd;
+			else if(pat.StartsWith(wxT("Z:"))) // zstd, case ignore
+				patterns[pattern_count].type = tPattern::zstd,       flags |= wxRE_ICASE;
 			else if(pat.StartsWith(wxT("a:"))) // asis, case sens
 				patterns[pattern_count].type = tPattern::asis;
 			else if(pat.StartsWith(wxT("A:"))) // asis, case ignore
@@ -296,10 +309,19 @@ void XP4ClassifyFiles(iRisaProgressCallback * callback,
 						flags &= ~ RISA_XP4_FILE_EXCLUDED;
 						break;
 					case tPattern::compress:
-						flags |=   RISA_XP4_FILE_COMPRESSED;
+						flags &= ~ RISA_XP4_FILE_CODEC_MASK;
+						flags |=   RISA_XP4_FILE_COMPRESSED|RISA_XP4_FILE_CODEC_ZLIB;
+						break;
+					case tPattern::lz4:
+						flags &= ~ RISA_XP4_FILE_CODEC_MASK;
+						flags |=   RISA_XP4_FILE_COMPRESSED|RISA_XP4_FILE_CODEC_LZ4;
+						break;
+					case tPattern::zstd:
+						flags &= ~ RISA_XP4_FILE_CODEC_MASK;
+						flags |=   RISA_XP4_FILE_COMPRESSED|RISA_XP4_FILE_CODEC_ZSTD;
 						break;
 					case tPattern::asis:
-						flags &= ~ RISA_XP4_FILE_COMPRESSED;
+						flags &= ~ (RISA_XP4_FILE_COMPRESSED|RISA_XP4_FILE_CODEC_MASK);
 						break;
 					}
 				}
@@ -315,7 +337,7 @@ void XP4ClassifyFiles(iRisaProgressCallback * callback,
 			{
 				i->SetFlags(
 					(i->GetFlags() &
-						~(RISA_XP4_FILE_EXCLUDED|RISA_XP4_FILE_COMPRESSED)
+						~(RISA_XP4_FILE_EXCLUDED|RISA_XP4_FILE_COMPRESSED|RISA_XP4_FILE_CODEC_MASK)
 					) | flags); // フラグを設定
 				i++;
 			}
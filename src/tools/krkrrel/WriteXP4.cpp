@@ -16,6 +16,9 @@
 #include "XP4Archive.h"
 #include "FileList.h"
 #include <zlib.h>
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zstd.h>
 
 /*
 	XP4 アーカイブファイルは、実のところ XP3 アーカイブと大差はない。
@@ -101,14 +104,14 @@ static wxFileOffset CopyFile(iRisaProgressCallback * callback,
  * コンストラクタ
  * @param offset		(非圧縮時の)ストレージ先頭からのオフセット
  * @param size			(非圧縮時の)サイズ
- * @param iscompressed	ZLIB 圧縮の際に真
+ * @param method		格納方法 (RISA_XP4_SEGM_ENCODE_*)
  */
 tXP4WriterSegment::tXP4WriterSegment(
 		wxFileOffset offset,
 		wxFileOffset size,
-		bool iscompressed)
+		wxByte method)
 			: Offset(offset), Size(size),
-			 IsCompressed(iscompressed)
+			 Method(method)
 {
 	StoreOffset = 0;
 	StoreSize = 0;
@@ -143,7 +146,7 @@ void tXP4WriterSegment::WriteBody(iRisaProgressCallback * callback,
 	file.Align(8);
 
 	// 圧縮する？
-	if(IsCompressed)
+	if(Method != RISA_XP4_SEGM_ENCODE_RAW)
 	{
 		// 圧縮する
 		// 入力ファイルをオフセットまでシーク
@@ -156,25 +159,29 @@ void tXP4WriterSegment::WriteBody(iRisaProgressCallback * callback,
 		try
 		{
 			srcbuf = new unsigned char[static_cast<size_t>(Size)];
-			unsigned long compsize = 0;
-			outbuf = new wxByte[compsize =
-					static_cast<unsigned long>(Size + Size /100 + 1024)];
-			input.ReadBuffer(srcbuf, static_cast<unsigned int>(Size));
-
-			int res;
 			unsigned long srclen = static_cast<unsigned long>(Size);
+			unsigned long outsize = srclen + srclen / 100 + 1024;
+			if(outsize < static_cast<unsigned long>(ZSTD_compressBound(srclen)))
+				outsize = static_cast<unsigned long>(ZSTD_compressBound(srclen));
+			if(outsize < static_cast<unsigned long>(LZ4_compressBound(srclen)))
+				outsize = static_cast<unsigned long>(LZ4_compressBound(srclen));
+			outbuf = new wxByte[outsize];
+			input.ReadBuffer(srcbuf, static_cast<unsigned int>(Size));
 
-			// compress with zlib deflate
-			res = compress2(outbuf, &compsize, srcbuf, srclen,
-				Z_DEFAULT_COMPRESSION);
-			if(res != Z_OK) IsCompressed  = false; // 圧縮に失敗
-
-			if(compsize >= srclen) IsCompressed = false; // 圧縮に失敗
+			unsigned long compsize = Compress(outbuf, outsize, srcbuf, srclen);
 
-			// ファイルに書き込む
-			StoreSize = compsize;
-			StoreOffset = file.Tell();
-			file.WriteBuffer(outbuf, compsize);
+			if(compsize == 0 || compsize >= srclen)
+			{
+				// 圧縮に失敗したか、圧縮しても小さくならなかった
+				Method = RISA_XP4_SEGM_ENCODE_RAW;
+			}
+			else
+			{
+				// ファイルに書き込む
+				StoreSize = compsize;
+				StoreOffset = file.Tell();
+				file.WriteBuffer(outbuf, compsize);
+			}
 		}
 		catch(...)
 		{
@@ -187,7 +194,7 @@ void tXP4WriterSegment::WriteBody(iRisaProgressCallback * callback,
 	}
 
 	// 圧縮しない？
-	if(!IsCompressed)
+	if(Method == RISA_XP4_SEGM_ENCODE_RAW)
 	{
 		// 圧縮しない
 
@@ -209,6 +216,51 @@ void tXP4WriterSegment::WriteBody(iRisaProgressCallback * callback,
 //---------------------------------------------------------------------------
 
 
+//---------------------------------------------------------------------------
+/**
+ * メモリ上のデータを Method に従って圧縮する
+ * @param outbuf	出力バッファ
+ * @param outsize	出力バッファのサイズ
+ * @param srcbuf	入力データ
+ * @param srclen	入力データのサイズ
+ * @return	圧縮後のサイズ (圧縮に失敗した場合は 0)
+ */
+unsigned long tXP4WriterSegment::Compress(unsigned char * outbuf, unsigned long outsize,
+		const unsigned char * srcbuf, unsigned long srclen)
+{
+	switch(Method)
+	{
+	case RISA_XP4_SEGM_ENCODE_ZLIB:
+		{
+			// compress with zlib deflate
+			unsigned long compsize = outsize;
+			int res = compress2(outbuf, &compsize, srcbuf, srclen,
+				Z_DEFAULT_COMPRESSION);
+			return res == Z_OK ? compsize : 0;
+		}
+
+	case RISA_XP4_SEGM_ENCODE_LZ4:
+		{
+			// compress with LZ4
+			// 展開速度は圧縮レベルに依存しないので、高圧縮版 (HC) を用いる
+			int res = LZ4_compress_HC(
+				reinterpret_cast<const char *>(srcbuf), reinterpret_cast<char *>(outbuf),
+				static_cast<int>(srclen), static_cast<int>(outsize), LZ4HC_CLEVEL_DEFAULT);
+			return res > 0 ? static_cast<unsigned long>(res) : 0;
+		}
+
+	case RISA_XP4_SEGM_ENCODE_ZSTD:
+		{
+			// compress with Zstandard
+			size_t res = ZSTD_compress(outbuf, outsize, srcbuf, srclen, 19);
+			return ZSTD_isError(res) ? 0 : static_cast<unsigned long>(res);
+		}
+	}
+	return 0;
+}
+//---------------------------------------------------------------------------
+
+
 //---------------------------------------------------------------------------
 /**
  * メタデータを書き込む
@@ -236,8 +288,7 @@ void tXP4WriterSegment::WriteMetaData(wxMemoryBuffer & buf)
 	i32 = wxUINT32_SWAP_ON_BE(33);
 	buf.AppendData(&i32, sizeof(i32));
 	// Flags
-	buf.AppendByte(
-		IsCompressed ? RISA_XP4_SEGM_ENCODE_ZLIB : RISA_XP4_SEGM_ENCODE_RAW);
+	buf.AppendByte(Method);
 	// Offset
 	i64 = wxUINT64_SWAP_ON_BE(Offset);
 	buf.AppendData(&i64, sizeof(i64));
@@ -332,7 +383,16 @@ void tXP4WriterStorage::WriteBody(
 	if(Flags & RISA_XP4_FILE_COMPRESSED)
 	{
 		// ファイルは圧縮されている
-		// ZLIB はシークを苦手とするので、COMPRESS_SPLIT_UNIT ごとに
+		// 圧縮方法を決める
+		wxByte method;
+		switch(Flags & RISA_XP4_FILE_CODEC_MASK)
+		{
+		case RISA_XP4_FILE_CODEC_LZ4:  method = RISA_XP4_SEGM_ENCODE_LZ4;  break;
+		case RISA_XP4_FILE_CODEC_ZSTD: method = RISA_XP4_SEGM_ENCODE_ZSTD; break;
+		default:                       method = RISA_XP4_SEGM_ENCODE_ZLIB; break;
+		}
+
+		// 圧縮データはシークを苦手とするので、COMPRESS_SPLIT_UNIT ごとに
 		// 圧縮元ファイルを分割し、それごとに圧縮を行うこととする
 		wxFileOffset left = Size;
 		wxFileOffset offset = 0;
@@ -341,7 +401,7 @@ void tXP4WriterStorage::WriteBody(
 			wxFileOffset onesize =
 				left > COMPRESS_SPLIT_UNIT ? COMPRESS_SPLIT_UNIT : left;
 			SegmentVector.push_back(
-				tXP4WriterSegment(offset, onesize, true));
+				tXP4WriterSegment(offset, onesize, method));
 			offset += onesize;
 			left -= onesize;
 		}
@@ -351,7 +411,7 @@ void tXP4WriterStorage::WriteBody(
 		// ファイルは圧縮されていない
 		// ファイル一個まるごとを表すセグメントを一個追加する
 		SegmentVector.push_back(
-			tXP4WriterSegment(0, Size, false));
+			tXP4WriterSegment(0, Size, RISA_XP4_SEGM_ENCODE_RAW));
 	}
 
 	// 入力ファイルを開く
@@ -31,7 +31,7 @@ class tXP4WriterSegment
 {
 	wxFileOffset Offset; //!< (非圧縮時の)ストレージ先頭からのオフセット
 	wxFileOffset Size; //!< (非圧縮時の)サイズ
-	bool IsCompressed; //!< ZLIB 圧縮の際に真
+	wxByte Method; //!< 格納方法 (RISA_XP4_SEGM_ENCODE_*)
 
 	wxFileOffset StoreOffset; //!< (実際に格納されている)オフセット
 	wxFileOffset StoreSize; //!< (実際に格納されている)サイズ  無圧縮の場合は Size と同じ
@@ -40,7 +40,7 @@ public:
 	tXP4WriterSegment(
 		wxFileOffset offset,
 		wxFileOffset size,
-		bool iscompressed);
+		wxByte method);
 
 	~tXP4WriterSegment();
 
@@ -53,6 +53,10 @@ public:
 		wxFileEx & input, wxFileEx & file);
 
 	void WriteMetaData(wxMemoryBuffer & buf);
+
+private:
+	unsigned long Compress(unsigned char * outbuf, unsigned long outsize,
+		const unsigned char * srcbuf, unsigned long srclen);
 };
 //---------------------------------------------------------------------------
 
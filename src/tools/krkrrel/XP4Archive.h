@@ -25,6 +25,8 @@ namespace Risa {
 #define RISA_XP4_SEGM_ENCODE_METHOD_MASK  0x03
 #define RISA_XP4_SEGM_ENCODE_RAW       0
 #define RISA_XP4_SEGM_ENCODE_ZLIB      1
+#define RISA_XP4_SEGM_ENCODE_LZ4       2
+#define RISA_XP4_SEGM_ENCODE_ZSTD      3
 
 #define RISA_XP4_FILE_COMPRESSED 0x80	//!< not a real code; only used in tXP4Writer related
 #define RISA_XP4_FILE_EXCLUDED	0x40	//!< not a real code; only used in tXP4Writer related
@@ -34,6 +36,10 @@ namespace Risa {
 #define RISA_XP4_FILE_STATE_ADDED	1
 #define RISA_XP4_FILE_STATE_DELETED	2
 #define RISA_XP4_FILE_STATE_MODIFIED	3
+#define RISA_XP4_FILE_CODEC_MASK	0x0300	//!< not a real code; only used in tXP4Writer related
+#define RISA_XP4_FILE_CODEC_ZLIB	0x0000	//!< not a real code; only used in tXP4Writer related
+#define RISA_XP4_FILE_CODEC_LZ4		0x0100	//!< not a real code; only used in tXP4Writer related
+#define RISA_XP4_FILE_CODEC_ZSTD	0x0200	//!< not a real code; only used in tXP4Writer related
 //---------------------------------------------------------------------------
 
 //---------------------------------------------------------------------------
@@ -0,0 +1,64 @@
+import * in risa.event;
+import * in thread;
+import * in risa.stdio;
+
+// 多数のタイマーを同時に動かし、タイマースケジューラのスループットを計測する
+
+var queue = new EventQueue();
+
+var thread = Thread.new() function() {
+	queue.loop();
+}
+
+// キュー用スレッドを開始する
+thread.start();
+
+var timer_count = 500; // タイマーの数
+var fire_count = 20; // 一つのタイマーが発生させるイベントの数
+var fired = 0; // 発生したイベントの総数
+var finished = 0; // fire_count 回のイベントを発生し終わったタイマーの数
+
+class CountingTimer extends Timer
+{
+	function construct() { var this.count = 0; }
+
+	function initialize(iv)
+	{
+		super::initialize();
+		interval = iv;
+		capacity = 0; // イベントを捨てないように容量の制限は無しにする
+		queue = global.queue;
+		enabled = true;
+	}
+
+	function onTimer(tick)
+	{
+		fired ++;
+		if(++count == fire_count)
+		{
+			enabled = false;
+			if(++finished == timer_count) queue.quit(); // すべて終わったらキュースレッドを終了させる
+		}
+	}
+}
+
+var start_tick = Timer.getTickCount();
+
+// 5ms から 20ms までのさまざまな周期のタイマーを起動する
+var timers = [];
+for(var i = 0; i < timer_count; i++) timers.push(new CountingTimer(5 + i % 16));
+
+// キュー用スレッドが終了するまで待つ
+thread.join();
+
+var elapsed = Timer.getTickCount() - start_tick;
+if(elapsed == 0) elapsed = 1;
+
+var rate = fired * 1000 \ elapsed; // 一秒あたりのイベント数
+
+if(fired == timer_count * fire_count)
+	stdout.print("ok \{rate} events/s");
+else
+	stdout.print("missing events : \{fired} / \{timer_count * fire_count}\n");
+
+//=> /^ok \d+ events\/s$/
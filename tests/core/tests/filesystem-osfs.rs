@@ -50,6 +50,12 @@ var data = st.read();
 st.dispose();
 assert(data == (octet)"'elio world!ABCD");
 
+// アクセスパターンのヒントを付けて開いても同じように読めるはず
+var st = fs.open('/tmp/test.txt', fs.omRead | fs.omSequential | fs.omWillNeed | fs.omDirect);
+var data = st.read();
+st.dispose();
+assert(data == (octet)"'elio world!ABCD");
+
 // 大文字と小文字が違うファイルを開こうとしてみる
 var raised = false;
 try {
@@ -152,6 +158,17 @@ fs.removeFile('/tmp/subdir/subfolder/test4.txt');
 fs.removeDirectory('/tmp/subdir/subfolder/');
 assert(!fs.isDirectory('/tmp/subdir/subfolder/'));
 
+// ファイルをメモリ上にマップしてみる
+// マップされたオクテット列は GC に回収されるまでマップされたままであり、
+// Windows ではマップ中のファイルは削除できないので、map.txt は削除しない
+// (test.txt と同様に残しておく)
+fs.open('/tmp/map.txt', fs.omWrite).print("Hello world!").dispose();
+fs.open('/tmp/empty.txt', fs.omWrite).dispose();
+var osfs = fs.getFileSystemAt('/tmp/');
+assert(osfs.map('map.txt') == (octet)"Hello world!");
+assert(osfs.map('empty.txt') == <% %>); // 長さ 0 のファイルは空のオクテット列になる (マップはされない)
+fs.removeFile('/tmp/empty.txt');
+
 // クリーンナップ。
 // OSFS は安全のため、ファイルの再帰的な削除はサポートされていない。
 fs.removeFile('/tmp/subdir/test3.txt');
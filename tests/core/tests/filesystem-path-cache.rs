@@ -0,0 +1,31 @@
+import risa.fs as fs;
+import risa.stdio as stdio;
+
+// パス解決キャッシュ
+
+fs.cwd = '/tmp';
+fs.createDirectory('pc', true);
+fs.open('pc/file1', fs.omWrite) {}
+
+// 同じパスを二度解決すると二度目はキャッシュにヒットするはず
+assert(fs.isFile('pc/file1'));
+var hits = fs.pathCacheHits;
+assert(fs.isFile('pc/file1'));
+assert(fs.pathCacheHits == hits + 1);
+
+// cwd を変えると相対パスの解決結果も変わる
+fs.cwd = '/tmp/pc';
+assert(!fs.isFile('pc/file1'));
+assert(fs.isFile('file1'));
+assert(fs.isFile('/tmp/pc/file1'));
+
+// マウント/アンマウントでも解決結果が変わる
+fs.cwd = '/tmp';
+fs.mount('pc/mnt', new fs.TmpFS());
+fs.open('pc/mnt/file2', fs.omWrite) {}
+assert(fs.isFile('pc/mnt/file2'));
+fs.unmount('pc/mnt');
+assert(!fs.isFile('pc/mnt/file2'));
+
+// ok を表示
+stdio.stdout.print("ok"); //=> ok
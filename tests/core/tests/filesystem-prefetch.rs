@@ -0,0 +1,72 @@
+import risa.fs as fs;
+import risa.stdio as stdio;
+
+// ファイルの先読み
+
+fs.mount('/tmp/pf', new fs.TmpFS());
+fs.open('/tmp/pf/a.txt', fs.omWrite).print("Hello world!").dispose();
+fs.open('/tmp/pf/b.txt', fs.omWrite).print("0123456789").dispose();
+fs.open('/tmp/pf/c.txt', fs.omWrite).print("abcdefghij").dispose();
+
+// 先読みが終わるまで待つと、内容がメモリ上に保持されるはず
+fs.prefetch(['/tmp/pf/a.txt', '/tmp/pf/b.txt'], 1);
+fs.waitPrefetch();
+assert(fs.prefetchedBytes == 22);
+
+// 読み込み専用で開くと先読みした内容が返され、キャッシュからは取り除かれる
+var hits = fs.prefetchHits;
+var st = fs.open('/tmp/pf/a.txt');
+var data = st.read();
+st.dispose();
+assert(data == (octet)"Hello world!");
+assert(fs.prefetchHits == hits + 1);
+assert(fs.prefetchedBytes == 10);
+
+// 二度目は普通に開かれる
+fs.open('/tmp/pf/a.txt').dispose();
+assert(fs.prefetchHits == hits + 1);
+
+// 書き込むと先読みした内容は破棄される
+fs.open('/tmp/pf/b.txt', fs.omWrite).print("9876543210").dispose();
+assert(fs.prefetchedBytes == 0);
+fs.prefetch('/tmp/pf/b.txt');
+fs.waitPrefetch();
+st = fs.open('/tmp/pf/b.txt');
+data = st.read();
+st.dispose();
+assert(data == (octet)"9876543210");
+
+// 読み込み中に開くと、読み込みが終わるのを待って先読みした内容が返される
+hits = fs.prefetchHits;
+fs.prefetch('/tmp/pf/c.txt');
+st = fs.open('/tmp/pf/c.txt');
+data = st.read();
+st.dispose();
+assert(data == (octet)"abcdefghij");
+assert(fs.prefetchHits == hits || fs.prefetchHits == hits + 1); // まだ読み込みが始まっていなければ普通に開かれる
+assert(fs.prefetchedBytes == 0);
+
+// キャンセル
+fs.prefetch('/tmp/pf/c.txt');
+fs.cancelPrefetch('/tmp/pf/c.txt');
+fs.waitPrefetch();
+assert(fs.prefetchedBytes == 0);
+
+// 上限を超える分は先読みされない
+// (同じ優先度ならば先に要求された a.txt が残る)
+var budget = fs.prefetchBudget;
+fs.prefetchBudget = 15;
+fs.prefetch(['/tmp/pf/a.txt', '/tmp/pf/b.txt'], 0);
+fs.waitPrefetch();
+assert(fs.prefetchedBytes == 12);
+hits = fs.prefetchHits;
+fs.open('/tmp/pf/b.txt').dispose();
+assert(fs.prefetchHits == hits);
+fs.cancelPrefetch();
+assert(fs.prefetchedBytes == 0);
+fs.prefetchBudget = budget;
+
+fs.unmount('/tmp/pf');
+
+// ok を表示
+stdio.stdout.print("ok"); //=> ok
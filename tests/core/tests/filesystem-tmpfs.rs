@@ -63,6 +63,35 @@ try {
 }
 assert(raised);
 
+// 複数のページにまたがる大きなファイルを少しずつ書き込んでみる
+var line = '';
+for(var i = 0; i < 100; i++) line += '0123456789';
+fs.open('/tmp/large.txt', fs.omWrite) { |st|
+	for(var i = 0; i < 200; i++) st.print(line); // 200000 バイト
+}
+fs.open('/tmp/large.txt') { |st|
+	assert(st.size == 200000);
+	st.position = 65530;
+	assert(st.read(12) == (octet)"012345678901");
+}
+
+// ファイルをコピーし、コピー先に書き込んでもコピー元は変わらないことを確認する
+tmpfs.copyFile('/large.txt', '/large2.txt');
+fs.open('/tmp/large2.txt', fs.omUpdate) { |st|
+	st.position = 65530;
+	st.print("ABCDEFGHIJKL");
+}
+fs.open('/tmp/large2.txt') { |st|
+	st.position = 65530;
+	assert(st.read(12) == (octet)"ABCDEFGHIJKL");
+}
+fs.open('/tmp/large.txt') { |st|
+	st.position = 65530;
+	assert(st.read(12) == (octet)"012345678901");
+}
+fs.removeFile('/tmp/large.txt');
+fs.removeFile('/tmp/large2.txt');
+
 // サブディレクトリを作る
 fs.createDirectory('/tmp/subdir');
 
@@ -172,6 +172,8 @@ public:
 		BindFunction(this, ss_construct, &tScriptClass::construct);
 		BindFunction(this, ss_initialize, &tScriptClass::initialize);
 		BindFunction(this, tSS<'p','r','i','n','t'>(), &tScriptClass::print);
+		BindFunction(this, tSS<'d','e','c','o','d','e','U','t','f','8'>(), &tScriptClass::decodeUtf8);
+		BindFunction(this, tSS<'e','n','c','o','d','e','U','t','f','8'>(), &tScriptClass::encodeUtf8);
 	}
 
 	static void construct()
@@ -192,6 +194,52 @@ public:
 		fflush(stdout);
 	}
 
+	//! @brief		UTF-8 のオクテット列を文字列に変換する (文字コード変換のテスト用)
+	//! @param		data		UTF-8 のオクテット列 (途中に 0 を含まないこと)
+	//! @param		misalign	変換元を 16 バイト境界から何バイトずらして置くか
+	//! @return		変換された文字列 (UTF-8 として正しくない場合は void)
+	//! @note		ConvertUtf8ToRisseCharString の ASCII 高速化の部分は 16 バイト
+	//!				境界を基準に動作するので、変換元の位置をずらしてテストできるようにする
+	static tVariant decodeUtf8(const tOctet & data, risse_size misalign)
+	{
+		risse_size length = data.GetLength();
+		char * buf = static_cast<char *>(AlignedMallocAtomicCollectee(length + 16 + 1, 4));
+		char * in = buf + (misalign & 15);
+		memcpy(in, data.Pointer(), length);
+		in[length] = 0;
+
+		risse_size count = ConvertUtf8ToRisseCharString(NULL, in);
+		if(count == risse_size_max) return tVariant();
+		if(count == 0) return tVariant(tString());
+		risse_char * out = static_cast<risse_char *>(
+			MallocAtomicCollectee(sizeof(risse_char) * (count + 1)));
+		ConvertUtf8ToRisseCharString(out, in);
+		return tVariant(tString(out, count));
+	}
+
+	//! @brief		文字列を UTF-8 のオクテット列に変換する (文字コード変換のテスト用)
+	//! @param		str			文字列
+	//! @param		misalign	変換元を 16 バイト境界から何コードポイントずらして置くか
+	//! @param		with_length	真ならば変換元の長さを渡し、偽ならば null 終端で判定させる
+	//! @return		変換されたオクテット列
+	//! @note		decodeUtf8 と同じく、ConvertCharToUtf8String の ASCII 高速化の
+	//!				部分を変換元の位置をずらしてテストできるようにする
+	static tVariant encodeUtf8(const tString & str, risse_size misalign, bool with_length)
+	{
+		risse_size length = str.GetLength();
+		risse_char * buf = static_cast<risse_char *>(
+			AlignedMallocAtomicCollectee(sizeof(risse_char) * (length + 16 + 1), 4));
+		risse_char * in = buf + (misalign & (16 / sizeof(risse_char) - 1));
+		memcpy(in, str.c_str(), sizeof(risse_char) * length);
+		in[length] = 0;
+
+		risse_size in_len = with_length ? length : risse_size_max;
+		risse_size size = ConvertCharToUtf8String(NULL, in, in_len);
+		char * out = static_cast<char *>(MallocAtomicCollectee(size + 1));
+		ConvertCharToUtf8String(out, in, in_len);
+		return tVariant(tOctet(reinterpret_cast<const risse_uint8 *>(out), size));
+	}
+
 public:
 };
 //---------------------------------------------------------------------------
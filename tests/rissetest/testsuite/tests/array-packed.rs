@@ -0,0 +1,33 @@
+// 整数のみ/実数のみの配列は内部でパックされた表現を用いるが、
+// 異なる型の値を格納してもスクリプトからは区別がつかないことを確認する
+var a = [1, 2, 3];
+a.push(4);
+a.unshift(0);
+assert(a.join(",") == "0,1,2,3,4");
+assert(a.has(3));
+assert(!a.has(3.0));
+assert(!a.has("3"));
+
+a[2] = "x"; // 汎用の表現に変換される
+assert(a.join(",") == "0,1,x,3,4");
+assert(a[0] === 0);
+assert(a[4] === 4);
+
+var r = [1.5, 2.5];
+r.push(3);
+assert(r[2] === 3);
+assert(r[0] === 1.5);
+
+var q = [];
+for(var i = 0; i < 100; i++) q.push(i);
+for(var i = 0; i < 100; i++) q.unshift(i);
+var sum = 0;
+while(q.length > 0) sum += q.shift();
+assert(sum == 9900);
+
+var f = [1, 2];
+f.length = 4; // filler (void) で埋められる
+assert(f[3] === void);
+assert(f[1] === 2);
+
+"ok"; //=> "ok"
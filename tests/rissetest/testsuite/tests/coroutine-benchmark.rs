@@ -0,0 +1,34 @@
+import * in coroutine;
+import Date in date;
+
+/*
+	Rough benchmark of coroutine context switches and coroutine creation.
+	The figures are printed only to be read by humans; the test checks the
+	format of the result.
+*/
+
+var switches = 100000;
+var creations = 2000;
+
+var c = Coroutine.new() static function(arg, co) {
+	while(true) co.yield(void);
+}
+
+var start = new Date().getTime();
+for(var i = 0; i < switches; i++) c.resume();
+var elapsed = new Date().getTime() - start;
+if(elapsed == 0) elapsed = 1;
+var switches_per_sec = (switches * 2 * 1000) \ elapsed; // resume + yield
+
+start = new Date().getTime();
+for(var i = 0; i < creations; i++)
+{
+	var n = Coroutine.new() static function(arg, co) { return arg; }
+	n.resume(i);
+}
+elapsed = new Date().getTime() - start;
+var creation_us = (elapsed * 1000) \ creations;
+
+"switches/sec: " + switches_per_sec.toString() +
+	", create+run: " + creation_us.toString() + " us"
+	//=> /^"switches\/sec: \d+, create\+run: \d+ us"$/
@@ -0,0 +1,24 @@
+import * in coroutine;
+
+/*
+	Many coroutines alive at the same time.
+	This exercises the GC scanning of many suspended coroutines.
+*/
+
+var cos = [];
+for(var i = 0; i < 2000; i++)
+{
+	cos.push(Coroutine.new() static function(arg, co) {
+		var n = arg;
+		while(true) n += co.yield(n);
+	});
+}
+
+var sum = 0;
+for(var round = 0; round < 3; round++)
+{
+	for(var i = 0; i < cos.length; i++)
+		sum += cos[i].resume(1);
+}
+
+sum //=> 12000
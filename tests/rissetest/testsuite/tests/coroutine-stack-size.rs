@@ -0,0 +1,26 @@
+import * in coroutine;
+
+var org = Coroutine.stackSize;
+Coroutine.stackSize = 262144;
+var size = Coroutine.stackSize;
+
+// deep recursion in a coroutine with a large stack
+var c = Coroutine.new() static function(arg, co) {
+	function rec(n) { return n == 0 ? 0 : 1 + rec(n - 1); }
+	co.yield(rec(arg));
+}
+var depth = c.resume(100);
+
+// too small sizes are rounded up to the minimum, so the coroutine still runs
+Coroutine.stackSize = 1;
+var min = Coroutine.stackSize;
+// (the nested call makes the coroutine run on its own native stack)
+var d = Coroutine.new() static function(arg, co) {
+	function inc(n) { return n + 1; }
+	co.yield(inc(arg));
+}
+var small = d.resume(1);
+
+Coroutine.stackSize = org;
+
+size.toString() + " " + depth.toString() + " " + min.toString() + " " + small.toString() //=> "262144 100 16384 2"
@@ -0,0 +1,24 @@
+import * in coroutine;
+
+/*
+	Tens of thousands of simple generators alive at the same time.
+	They run stackless, so no coroutine stack is allocated for them.
+*/
+
+var gens = [];
+for(var i = 0; i < 20000; i++)
+{
+	gens.push(Coroutine.new() static function(arg, co) {
+		var n = arg;
+		while(true) n += co.yield(n);
+	});
+}
+
+var sum = 0;
+for(var round = 0; round < 3; round++)
+{
+	for(var i = 0; i < gens.length; i++)
+		sum += gens[i].resume(1);
+}
+
+(gens[0].stackless ? "stackless " : "stackful ") + sum.toString() //=> "stackless 120000"
@@ -0,0 +1,33 @@
+import * in coroutine;
+
+/*
+	A generator that starts stackless may still yield from a nested call
+	that reaches the coroutine object through a variable. It moves to a
+	native stack before making the call, so the yield behaves the same as
+	in a stackful coroutine.
+*/
+
+var c;
+
+function helper(v)
+{
+	return c.yield(v); // reaches the coroutine through a variable, not through the body
+}
+
+c = Coroutine.new() static function(arg, co) {
+	var n = co.yield(arg);
+	n = helper(n + 1);
+	co.yield(n + 1);
+	return "end";
+}
+
+var ret = (c.stackless ? "t" : "f") + ":";
+ret += " " + c.resume(1).toString();
+ret += (c.stackless ? "t" : "f");
+ret += " " + c.resume(10).toString();
+ret += (c.stackless ? "t" : "f");
+ret += " " + c.resume(20).toString();
+ret += " " + c.resume().toString();
+ret += (c.alive ? "t" : "f");
+
+ret //=> "t: 1t 11f 21 endf"
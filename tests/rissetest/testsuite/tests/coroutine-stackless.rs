@@ -0,0 +1,36 @@
+import * in coroutine;
+
+/*
+	A generator that yields only from its own top level runs stackless.
+	One that hands the coroutine object to another function may yield from
+	a nested call, so it falls back to a stackful coroutine.
+	Both must behave the same from the caller's point of view.
+*/
+
+function emit_twice(co, v)
+{
+	co.yield(v);
+	co.yield(v);
+}
+
+var a = Coroutine.new() static function(arg, co) {
+	for(var i = arg; i < arg + 3; i++) co.yield(i);
+	return "end";
+}
+
+var b = Coroutine.new() static function(arg, co) {
+	emit_twice(co, arg);
+	return "end";
+}
+
+var ret = (a.stackless ? "t" : "f") + (b.stackless ? "t" : "f") + ":";
+ret += " " + a.resume(10).toString();
+ret += " " + b.resume(5).toString();
+ret += " " + a.resume().toString();
+ret += " " + b.resume().toString();
+ret += " " + a.resume().toString();
+ret += " " + b.resume().toString();
+ret += " " + a.resume().toString();
+ret += (a.alive ? "t" : "f") + (b.alive ? "t" : "f");
+
+ret //=> "tf: 10 5 11 5 12 end endff"
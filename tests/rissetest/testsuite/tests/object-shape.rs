@@ -0,0 +1,28 @@
+// 同じメンバ構成を持つオブジェクトはシェイプを共有するが、
+// それぞれの値は独立していることを確認する
+var a = new Object();
+var a.x = 1;
+var a.y = 2;
+
+var b = new Object();
+var b.x = 10;
+var b.y = 20;
+var b.z = 30;
+
+a.x = 3;
+assert(a.x == 3);
+assert(a.y == 2);
+assert(b.x == 10);
+assert(b.y == 20);
+assert(b.z == 30);
+
+// メンバを削除したオブジェクトは辞書モードに移行するが、
+// 残りのメンバはそのまま読み書きできる
+delete b.y;
+assert(b.x == 10);
+assert(b.z == 30);
+var b.y = 40;
+assert(b.y == 40);
+assert(a.y == 2);
+
+"\{a.x}:\{b.y}" //=> "3:40"
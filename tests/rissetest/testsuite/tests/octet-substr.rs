@@ -0,0 +1,17 @@
+var o = <% 11 22 33 44 55 %>;
+
+// 部分オクテット列は元のオクテット列とバッファを共有するが、
+// それらに対する破壊的な操作が互いに影響を及ぼさないことを確認する
+assert(o.substr(1, 3) == <% 22 33 44 %>);
+assert(o.substr(3) == <% 44 55 %>);
+assert(o.substr(-2, 1) == <% 44 %>);
+assert(o.substr(2, 100) == <% 33 44 55 %>);
+assert(o.substr(5) === void);
+assert(o.substr(-6) === void);
+
+var p = o.substr(1, 2);
+p += <% 66 %>;
+assert(p == <% 22 33 66 %>);
+assert(o == <% 11 22 33 44 55 %>);
+
+"\{o.substr(1, 2).length}" //=> "2"
@@ -0,0 +1,32 @@
+// プロパティハンドラの中でプロパティを持つオブジェクトにメンバを追加/削除
+// しても (スロットの配列の再確保や辞書モードへの移行が起こっても)、
+// ハンドラの呼び出しとその結果が正しいことを確認する
+var global.v = 0;
+
+property q
+{
+	getter ()
+	{
+		var global.q_a1 = 1;
+		var global.q_a2 = 2;
+		var global.q_a3 = 3;
+		var global.q_a4 = 4;
+		var global.q_a5 = 5;
+		var global.q_a6 = 6;
+		var global.q_a7 = 7;
+		var global.q_a8 = 8;
+		return v;
+	}
+	setter (x)
+	{
+		delete global.q_a1;
+		var global.q_b1 = 1;
+		v = x * 2;
+	}
+}
+
+var s1 = q;
+q = 21;
+var s2 = q;
+
+return "\{s1},\{s2},\{q_a8},\{q_b1}"; //=> "0,42,8,1"
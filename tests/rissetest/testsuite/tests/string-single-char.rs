@@ -0,0 +1,23 @@
+// 1文字の文字列は共有バッファを用いるので、それらに対する破壊的な
+// 操作がほかの文字列に影響を及ぼさないことを確認する
+var a = "a";
+var b = "a";
+a += "bc";
+b += "d";
+assert(a == "abc");
+assert(b == "ad");
+assert("a" == "a");
+assert("a".length == 1);
+
+var c = "x";
+var d = c;
+d += c;
+assert(c == "x");
+assert(d == "xx");
+
+var s = "";
+for(var i = 0; i < 3; i++) s += "z";
+assert(s == "zzz");
+assert("z" == "z");
+
+"ok"; //=> "ok"
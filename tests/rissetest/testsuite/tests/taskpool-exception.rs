@@ -0,0 +1,26 @@
+import * in thread;
+
+var f = Future.new() function() {
+	throw "Exception!";
+};
+
+var result = "";
+try
+{
+	f.get();
+}
+catch(e)
+{
+	result += "future ";
+}
+
+try
+{
+	TaskPool.each([1, 2, 3]) function(v, i) { if(v == 2) throw "Exception!"; };
+}
+catch(e)
+{
+	result += "each";
+}
+
+return result; //=> "future each"
@@ -0,0 +1,20 @@
+import * in thread;
+
+function square(n)
+{
+	return Future.new() function() { return n * n; };
+}
+
+var futures = [];
+for(var i = 0; i < 20; i++) futures.push(square(i));
+
+var sum = 0;
+for(var i = 0; i < futures.length; i++) sum += futures[i].get();
+
+var nested = Future.new() function() {
+	// タスクの中から別のタスクの完了を待つ
+	var inner = Future.new() function() { return "inner"; };
+	return inner.get() + " outer";
+};
+
+return "" + sum + " " + nested.get() + " " + futures[0].done; //=> "2470 inner outer true"
@@ -0,0 +1,13 @@
+import * in thread;
+
+var a = [];
+for(var i = 0; i < 1000; i++) a.push(i);
+
+var doubled = TaskPool.map(a) function(v, i) { return v * 2; };
+
+var sum = 0;
+for(var i = 0; i < doubled.length; i++) sum += doubled[i];
+
+var indexed = TaskPool.map(["a", "b", "c"]) function(v, i) { return v + i; };
+
+return "" + doubled.length + " " + sum + " " + indexed.join(","); //=> "1000 999000 a0,b1,c2"
@@ -0,0 +1,116 @@
+// UTF-8 <-> 文字列 の変換の ASCII 文字の連続を処理する部分 (16 バイト単位で
+// 処理する高速化された部分) を、ASCII 文字の連続とマルチバイト文字が混在する
+// 入力について、16 バイト境界に対するあらゆる位置でテストする。
+// 期待値は 1 文字ずつ変換した結果をつなげたもの (1 文字だけの入力は高速化
+// された部分を通らず、1 文字ずつ処理する部分で変換される) とする。
+// (テストに使う文字は、このスクリプト自身の読み込み時の変換に依存しない
+// よう \x やオクテット列リテラルで表記する)
+
+var ascii = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+var multi = [ "\xe9", "\x3042", "\x1f600" ]; // 2, 3, 4 バイトになる文字
+var max_run = 40; // 16 バイト境界をまたいで 2 ブロック以上になる長さ
+
+function slowEncode(str)
+{
+	var r = <% %>;
+	for(var i = 0; i < str.length; i++)
+		r += Script.encodeUtf8(str.charAt(i), 0, true);
+	return r;
+}
+
+function slowDecode(oct)
+{
+	// 1 文字分のバイト数は、変換に成功するまで 1 バイトずつ延ばして決める
+	// (正しくないシーケンスがあれば void を返す)
+	var r = "";
+	var i = 0;
+	while(i < oct.length)
+	{
+		var n = 1;
+		while(i + n <= oct.length)
+		{
+			var c = Script.decodeUtf8(oct.substr(i, n), 0);
+			if(c !== void) { r += c; break; }
+			n++;
+		}
+		if(i + n > oct.length) return void;
+		i += n;
+	}
+	return r;
+}
+
+function run(n) { return n == 0 ? "" : ascii.substr(0, n); }
+
+// 1 文字ずつの変換が正しいことをまず確認する
+assert(slowEncode(multi[0]) == <% c3 a9 %>);
+assert(slowEncode(multi[1]) == <% e3 81 82 %>);
+assert(slowEncode(multi[2]) == <% f0 9f 98 80 %>);
+assert(slowDecode(<% 41 c3 a9 e3 81 82 f0 9f 98 80 42 %>) == "A" + multi[0] + multi[1] + multi[2] + "B");
+
+var count = 0;
+
+// 正しい入力: ASCII 文字の連続の前後にマルチバイト文字を置く
+for(var k = 0; k < multi.length; k++)
+{
+	for(var n = 0; n <= max_run; n++)
+	{
+		var str = run(n) + multi[k] + run(max_run - n) + multi[k] + run(n);
+		var oct = slowEncode(str);
+		assert(slowDecode(oct) == str);
+
+		// UTF-8 -> 文字列
+		for(var m = 0; m < 16; m++)
+		{
+			assert(Script.decodeUtf8(oct, m) == str);
+			count++;
+		}
+
+		// 文字列 -> UTF-8 (risse_char は 4 バイトなので 16 バイト境界内の位置は 4 通り)
+		for(var m = 0; m < 4; m++)
+		{
+			assert(Script.encodeUtf8(str, m, true) == oct);
+			assert(Script.encodeUtf8(str, m, false) == oct);
+			count++;
+		}
+	}
+}
+
+// ASCII のみの入力
+for(var n = 1; n <= max_run; n++)
+{
+	var str = run(n);
+	var oct = slowEncode(str);
+	for(var m = 0; m < 16; m++) assert(Script.decodeUtf8(oct, m) == str);
+	for(var m = 0; m < 4; m++) assert(Script.encodeUtf8(str, m, true) == oct);
+	for(var m = 0; m < 4; m++) assert(Script.encodeUtf8(str, m, false) == oct);
+}
+
+// 正しくない入力: ASCII 文字の連続の直後に、途中で切れたシーケンスや
+// 不正なバイトを置く。いずれも位置にかかわらず変換に失敗しなければならない
+var bad = [
+	<% c3 %>,          // 2 バイトのシーケンスが途中で終わる
+	<% e3 81 %>,       // 3 バイトのシーケンスが途中で終わる
+	<% f0 9f 98 %>,    // 4 バイトのシーケンスが途中で終わる
+	<% e3 41 42 %>,    // 後続バイトの位置に ASCII 文字がある
+	<% 80 %>,          // 先頭に後続バイトがある
+	<% bf 41 %>,       // 先頭に後続バイトがある (直後に ASCII 文字)
+	<% fe %>,          // UTF-8 には現れないバイト
+	<% ff 41 %>        // UTF-8 には現れないバイト (直後に ASCII 文字)
+];
+for(var k = 0; k < bad.length; k++)
+{
+	for(var n = 0; n <= max_run; n++)
+	{
+		var head = slowEncode(run(n));
+		assert(slowDecode(head + bad[k]) === void);
+		for(var m = 0; m < 16; m++)
+		{
+			// 入力の最後にある場合と、後ろにさらに ASCII 文字が続く場合
+			assert(Script.decodeUtf8(head + bad[k], m) === void);
+			assert(Script.decodeUtf8(head + bad[k] + slowEncode(run(max_run)), m) === void);
+			count++;
+		}
+	}
+}
+
+"\{count}" //=> "7708"